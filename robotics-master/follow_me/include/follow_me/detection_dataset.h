@@ -0,0 +1,250 @@
+// labeled dataset of the detection of moving persons: scans with, for each frame, the state of the robot and the
+// ground truth positions of the moving persons (see detection_evaluation.h for the scoring of the detector core)
+// binary file, in the byte order of the host:
+//   "FMDS", uint32 version
+//   per frame: uint32 size of the rest of the frame, float64 stamp, uint8 flags (1: robot moving, 2: labeled),
+//              uint8 nb_persons, nb_persons x (int16 x, int16 y) in mm in the frame of the laser,
+//              the scan encoded by scan_encoder (see scan_codec.h) without tolerance: the ranges are kept to the mm
+// the frames are encoded one after the other (a frame refers to the last keyframe): about 1.1 bytes per beam,
+// 6 times smaller than the text log (see scan_log.h)
+// a frame that is not labeled is not scored: a dataset can be annotated partially
+// the frames come from a log (its person records label all the frames, see scan_log.h) and from annotations:
+//   <stamp>,<x>,<y>    a moving person in the frame of the laser at the scan of this stamp (the closest one)
+//   <stamp>            no moving person at the scan of this stamp
+//   the lines starting with '#' are comments
+
+#ifndef FOLLOW_ME_DETECTION_DATASET_H
+#define FOLLOW_ME_DETECTION_DATASET_H
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <stdint.h>
+#include <vector>
+#include "follow_me/scan_codec.h"
+#include "follow_me/scan_log.h"
+
+#define dataset_magic "FMDS"
+#define dataset_version 1
+#define dataset_moving_speed 0.01// m/s or rad/s, the robot is moving above (from the odometry of a log)
+
+struct dataset_frame {
+
+    log_scan scan;
+    bool robot_moving;
+    bool labeled;
+    std::vector<log_person> persons;// in the frame of the laser, at the stamp of the scan
+
+};
+
+class detection_dataset {
+public:
+
+    std::vector<dataset_frame> frames;
+
+bool load(const char* filename) {
+
+    FILE* f = fopen(filename, "rb");
+    if ( !f )
+        return false;
+    std::vector<uint8_t> data;
+    uint8_t buffer[65536];
+    size_t nb;
+    while ( ( nb = fread(buffer, 1, sizeof(buffer), f) ) > 0 )
+        data.insert(data.end(), buffer, buffer + nb);
+    fclose(f);
+
+    uint32_t version;
+    if ( ( data.size() < 8 ) || memcmp(&data[0], dataset_magic, 4) )
+        return false;
+    memcpy(&version, &data[4], 4);
+    if ( version != dataset_version )
+        return false;
+
+    frames.clear();
+    scan_decoder decoder;
+    scan_frame decoded;
+    size_t position = 8;
+    while ( position + 4 <= data.size() ) {
+        uint32_t size;
+        memcpy(&size, &data[position], 4);
+        position += 4;
+        if ( size > data.size() - position )
+            return false;// truncated
+        if ( !parse(&data[position], size, decoder, decoded) )
+            return false;
+        position += size;
+    }
+    return true;
+
+}
+
+bool save(const char* filename) const {
+
+    FILE* f = fopen(filename, "wb");
+    if ( !f )
+        return false;
+    uint32_t version = dataset_version;
+    fwrite(dataset_magic, 1, 4, f);
+    fwrite(&version, 4, 1, f);
+
+    scan_codec_config config = default_scan_codec_config();
+    config.static_tolerance = 0;
+    scan_encoder encoder(config);
+    std::vector<uint8_t> frame, scan;
+    for (size_t loop=0; loop<frames.size(); loop++) {
+        const dataset_frame& d = frames[loop];
+        encoder.encode(d.scan.ranges.empty() ? 0 : &d.scan.ranges[0], d.scan.ranges.size(), d.scan.angle_min, d.scan.angle_increment,
+                       d.scan.range_min, d.scan.range_max, scan);
+        int nb_persons = std::min((int)d.persons.size(), 255);
+        frame.resize(4 + 10 + 4 * nb_persons);
+        uint32_t size = frame.size() - 4 + scan.size();
+        uint8_t flags = ( d.robot_moving ? 1 : 0 ) | ( d.labeled ? 2 : 0 );
+        memcpy(&frame[0], &size, 4);
+        memcpy(&frame[4], &d.scan.stamp, 8);
+        frame[12] = flags;
+        frame[13] = nb_persons;
+        for (int p=0; p<nb_persons; p++) {
+            int16_t xy[2] = { to_mm(d.persons[p].x), to_mm(d.persons[p].y) };
+            memcpy(&frame[14 + 4 * p], xy, 4);
+        }
+        fwrite(&frame[0], 1, frame.size(), f);
+        fwrite(&scan[0], 1, scan.size(), f);
+    }
+    bool written = !ferror(f);
+    fclose(f);
+    return written;
+
+}
+
+// the frames of a log: the robot is moving if the odometry at the stamp of the scan says so, the person records
+// label all the frames (the log is labeled) or none
+void import_log(const scan_log& log) {
+
+    frames.clear();
+    frames.resize(log.scans.size());
+    for (size_t loop=0; loop<log.scans.size(); loop++) {
+        dataset_frame& d = frames[loop];
+        d.scan = log.scans[loop];
+        log_pose o;
+        d.robot_moving = scan_log::interpolate(log.odom, d.scan.stamp, o) &&
+                         ( ( fabs(o.linear_speed) > dataset_moving_speed ) || ( fabs(o.angular_speed) > dataset_moving_speed ) );
+        d.labeled = log.labeled();
+        size_t first, last;
+        log.persons_at(d.scan.stamp, first, last);
+        d.persons.assign(log.persons.begin() + first, log.persons.begin() + last);
+    }
+
+}
+
+// annotations (see above): each line labels the frame of the closest stamp, if it is closer than half the period of
+// the scans; the first line of a frame replaces its labels. returns the number of lines imported, -1 if the file
+// cannot be read; nb_ignored: lines that are malformed or without frame
+int import_annotations(const char* filename, int& nb_ignored) {
+
+    FILE* f = fopen(filename, "r");
+    nb_ignored = 0;
+    if ( !f )
+        return -1;
+    double tolerance = ( frames.size() > 1 ) ? ( frames.back().scan.stamp - frames.front().scan.stamp ) / ( frames.size() - 1 ) / 2 : 1e-3;
+    std::vector<bool> annotated(frames.size(), false);
+    int nb_imported = 0;
+    char line[256];
+    while ( fgets(line, sizeof(line), f) ) {
+        log_person p;
+        int nb_fields = sscanf(line, "%lf , %f , %f", &p.stamp, &p.x, &p.y);
+        if ( ( line[0] == '#' ) || ( nb_fields == EOF ) )
+            continue;
+        int frame = closest_frame(p.stamp);
+        if ( ( ( nb_fields != 1 ) && ( nb_fields != 3 ) ) || ( frame < 0 ) || ( fabs(frames[frame].scan.stamp - p.stamp) > tolerance ) ) {
+            nb_ignored++;
+            continue;
+        }
+        dataset_frame& d = frames[frame];
+        if ( !annotated[frame] ) {
+            annotated[frame] = true;
+            d.labeled = true;
+            d.persons.clear();
+        }
+        if ( nb_fields == 3 ) {
+            p.stamp = d.scan.stamp;
+            d.persons.push_back(p);
+        }
+        nb_imported++;
+    }
+    fclose(f);
+    return nb_imported;
+
+}
+
+int nb_labeled() const {
+
+    int nb = 0;
+    for (size_t loop=0; loop<frames.size(); loop++)
+        nb += frames[loop].labeled;
+    return nb;
+
+}
+
+private:
+
+static int16_t to_mm(float v) {
+
+    return (int16_t)std::max(-32767.0f, std::min(32767.0f, roundf(v * 1000)));
+
+}
+
+bool parse(const uint8_t* data, uint32_t size, scan_decoder& decoder, scan_frame& decoded) {
+
+    if ( size < 10 )
+        return false;
+    dataset_frame d;
+    memcpy(&d.scan.stamp, data, 8);
+    d.robot_moving = data[8] & 1;
+    d.labeled = data[8] & 2;
+    int nb_persons = data[9];
+    if ( size < 10 + 4 * (uint32_t)nb_persons )
+        return false;
+    for (int p=0; p<nb_persons; p++) {
+        int16_t xy[2];
+        memcpy(xy, data + 10 + 4 * p, 4);
+        log_person person;
+        person.stamp = d.scan.stamp;
+        person.x = xy[0] * 0.001f;
+        person.y = xy[1] * 0.001f;
+        d.persons.push_back(person);
+    }
+    uint32_t offset = 10 + 4 * nb_persons;
+    if ( !decoder.decode(data + offset, size - offset, decoded) )
+        return false;
+    d.scan.angle_min = decoded.angle_min;
+    d.scan.angle_increment = decoded.angle_increment;
+    d.scan.range_min = decoded.range_min;
+    d.scan.range_max = decoded.range_max;
+    d.scan.ranges.swap(decoded.ranges);
+    frames.push_back(d);
+    return true;
+
+}
+
+// frame of the closest stamp (the frames are sorted by stamp), -1 if none
+int closest_frame(double stamp) const {
+
+    if ( frames.empty() )
+        return -1;
+    size_t low = 0, high = frames.size() - 1;
+    while ( high - low > 1 ) {
+        size_t middle = ( low + high ) / 2;
+        if ( frames[middle].scan.stamp <= stamp )
+            low = middle;
+        else
+            high = middle;
+    }
+    return ( fabs(frames[low].scan.stamp - stamp) <= fabs(frames[high].scan.stamp - stamp) ) ? low : high;
+
+}
+
+};
+
+#endif
@@ -0,0 +1,105 @@
+// scoring of the detector core (see detector_core.h) on a labeled dataset (see detection_dataset.h)
+// - the frames are processed as moving_person_detector does: only when the robot is stopped, the background being
+//   stored on the first frame after a motion
+// - on the labeled frames, each label is matched to the closest detected person not yet matched, if it is closer
+//   than match_distance: true positive (and its localization error), else missed; the remaining detected persons
+//   are false positives
+
+#ifndef FOLLOW_ME_DETECTION_EVALUATION_H
+#define FOLLOW_ME_DETECTION_EVALUATION_H
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+#include "follow_me/detection_dataset.h"
+#include "follow_me/detector_core.h"
+
+#define match_distance 0.5// m, between a detected person and a label
+
+struct detection_score {
+
+    long nb_true, nb_false, nb_missed;// detected persons matching a label, not matching any label, labels not detected
+    long nb_frames, nb_scored;// processed (robot stopped), and labeled among them
+    double localization_error;// m, sum over the true positives
+    double time;// s, processing time of the detector core over the frames processed
+
+    float precision() const { return ( nb_true + nb_false ) ? (float)nb_true / ( nb_true + nb_false ) : 1; }
+    float recall() const { return ( nb_true + nb_missed ) ? (float)nb_true / ( nb_true + nb_missed ) : 1; }
+    float f1() const { return ( precision() + recall() > 0 ) ? 2 * precision() * recall() / ( precision() + recall() ) : 0; }
+    double mean_error() const { return nb_true ? localization_error / nb_true : 0; }
+    double latency() const { return nb_frames ? time / nb_frames : 0; }
+
+};
+
+inline detection_score empty_detection_score() {
+
+    detection_score s;
+    s.nb_true = s.nb_false = s.nb_missed = 0;
+    s.nb_frames = s.nb_scored = 0;
+    s.localization_error = s.time = 0;
+    return s;
+
+}
+
+inline void score_frame(const std::vector<detector_point>& detected, const std::vector<log_person>& labels, detection_score& score) {
+
+    std::vector<bool> matched(detected.size(), false);
+    for (size_t l=0; l<labels.size(); l++) {
+        int best = -1;
+        float best_distance = match_distance;
+        for (size_t loop=0; loop<detected.size(); loop++) {
+            float d = hypot(detected[loop].x - labels[l].x, detected[loop].y - labels[l].y);
+            if ( !matched[loop] && ( d < best_distance ) ) {
+                best = loop;
+                best_distance = d;
+            }
+        }
+        if ( best >= 0 ) {
+            matched[best] = true;
+            score.nb_true++;
+            score.localization_error += best_distance;
+        }
+        else
+            score.nb_missed++;
+    }
+    score.nb_false += std::count(matched.begin(), matched.end(), false);
+    score.nb_scored++;
+
+}
+
+// the frames of the dataset through "detector" (its thresholds are kept), the results are added to "score"
+inline void evaluate(detector_pipeline& detector, const detection_dataset& dataset, detection_score& score) {
+
+    bool previous_moving = true;
+    for (size_t loop=0; loop<dataset.frames.size(); loop++) {
+        const dataset_frame& frame = dataset.frames[loop];
+        const log_scan& s = frame.scan;
+        if ( !frame.robot_moving && !s.ranges.empty() ) {
+            detector.set_scan(&s.ranges[0], s.ranges.size(), s.angle_min, s.angle_increment, s.range_min, s.range_max);
+            if ( previous_moving )
+                detector.store_background();
+            detector.detect();
+            score.time += detector.processing_time;
+            score.nb_frames++;
+            if ( frame.labeled )
+                score_frame(detector.moving_persons, frame.persons, score);
+        }
+        previous_moving = frame.robot_moving;
+    }
+
+}
+
+// a new detector for the scans of the dataset with the thresholds "params", scored on the whole dataset
+inline void evaluate(const detector_params& params, const detection_dataset& dataset, detection_score& score) {
+
+    if ( dataset.frames.empty() )
+        return;
+    const log_scan& first = dataset.frames[0].scan;
+    detector_pipeline* detector = make_detector_pipeline(first.ranges.size(), first.angle_min, first.angle_increment);
+    detector->params = params;
+    evaluate(*detector, dataset, score);
+    delete detector;
+
+}
+
+#endif
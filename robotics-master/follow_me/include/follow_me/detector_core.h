@@ -0,0 +1,929 @@
+// processing core of moving_person_detector: background subtraction, clustering, moving legs and moving persons
+// the core is a template on the traits of the laser:
+// - for a known laser (nb_beams > 0), the buffers are std::array of the size of the scan, the angles of the beams
+//   are computed at compile time and the loops have a constant bound (the compiler unrolls and vectorizes them)
+// - generic_laser_traits (nb_beams = 0) gives the runtime sized version, used for any other laser
+// make_detector_pipeline() chooses the version that matches the scan received
+// the ranges can be denoised before the detection of motion (see range_filter.h and detector_pipeline::filter)
+// each cluster has an id, kept from scan to scan while the cluster has the same first and last hits
+// the clustering can be incremental (see detector_pipeline::incremental): a beam has changed when its range has moved
+// more than a tolerance or its dynamic flag has changed, the previous clusters without changed beam are kept with their
+// id, and the cuts are only tested again around the changed beams and where the range difference is close to
+// cluster_threshold. The clusters are the same as with a full clustering, ids included
+
+#ifndef FOLLOW_ME_DETECTOR_CORE_H
+#define FOLLOW_ME_DETECTOR_CORE_H
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstring>
+#include <cmath>
+#include <stdint.h>
+#include <vector>
+#include "follow_me/geometry.h"
+#include "follow_me/range_filter.h"
+#include "follow_me/scan_frontend.h"
+#include "follow_me/simd.h"
+
+#define incremental_tolerance 0.25// of cluster_threshold, a beam has changed if its range has moved more than this distance
+#define incremental_changed_max 0.05// fraction of changed beams above which the whole scan is segmented again
+#define incremental_retry 10// scans segmented again in full after the incremental clustering has fallen back to it
+#define fragile_margin 1e-4f// m, for the rounding of the range differences
+
+#if defined(__GNUC__) && !defined(__clang__) && __GNUC__ >= 8
+#define FOLLOW_ME_UNROLL _Pragma("GCC unroll 4")
+#else
+#define FOLLOW_ME_UNROLL
+#endif
+
+// thresholds of the detection: the traits give their default value, they can be changed at runtime (see detector_pipeline::params)
+struct detector_params {
+
+    float cluster_threshold;// threshold for clustering
+    float detection_threshold;// threshold for motion detection
+    int dynamic_threshold;// % of dynamic hits to decide if a cluster is static or dynamic
+    float leg_size_min, leg_size_max;
+    float legs_distance_max;
+
+};
+
+// traits of the lasers: number of beams, angles, ranges and default thresholds
+struct default_detector_thresholds {
+
+    static constexpr float cluster_threshold = 0.2;
+    static constexpr float detection_threshold = 0.2;
+    static constexpr int dynamic_threshold = 75;
+    static constexpr float leg_size_min = 0.05;
+    static constexpr float leg_size_max = 0.25;
+    static constexpr float legs_distance_max = 0.7;
+
+};
+
+// Hokuyo URG-04LX of robair: 726 beams over 255 degrees
+struct hokuyo_urg_traits : default_detector_thresholds {
+
+    static constexpr const char* name = "hokuyo_urg_726";
+    static constexpr int nb_beams = 726;
+    static constexpr float angle_min = -2.356194;
+    static constexpr float angle_increment = 0.006136;
+    static constexpr float range_min = 0.02;
+    static constexpr float range_max = 5.6;
+
+};
+
+// 360 degrees lasers with 0.25 degree (1440 beams) and 0.176 degree (2048 beams) resolutions
+struct lidar_1440_traits : default_detector_thresholds {
+
+    static constexpr const char* name = "lidar_1440";
+    static constexpr int nb_beams = 1440;
+    static constexpr float angle_min = -M_PI;
+    static constexpr float angle_increment = 2 * M_PI / 1440;
+    static constexpr float range_min = 0.05;
+    static constexpr float range_max = 12;
+
+};
+
+struct lidar_2048_traits : default_detector_thresholds {
+
+    static constexpr const char* name = "lidar_2048";
+    static constexpr int nb_beams = 2048;
+    static constexpr float angle_min = -M_PI;
+    static constexpr float angle_increment = 2 * M_PI / 2048;
+    static constexpr float range_min = 0.05;
+    static constexpr float range_max = 25;
+
+};
+
+// any laser: the number of beams and the angles are read in the scan
+struct generic_laser_traits : default_detector_thresholds {
+
+    static constexpr const char* name = "generic";
+    static constexpr int nb_beams = 0;
+    static constexpr float angle_min = 0;
+    static constexpr float angle_increment = 0;
+
+};
+
+template <class Traits>
+detector_params traits_detector_params() {
+
+    detector_params p;
+    p.cluster_threshold = Traits::cluster_threshold;
+    p.detection_threshold = Traits::detection_threshold;
+    p.dynamic_threshold = Traits::dynamic_threshold;
+    p.leg_size_min = Traits::leg_size_min;
+    p.leg_size_max = Traits::leg_size_max;
+    p.legs_distance_max = Traits::legs_distance_max;
+    return p;
+
+}
+
+// sin and cos usable at compile time (std::sin and std::cos are not constexpr)
+constexpr double constexpr_sin(double a) {
+
+    a = normalize_angle(a);
+    double term = a, sum = a;
+    for (int loop=1; loop<12; loop++) {
+        term *= -a * a / ( ( 2 * loop ) * ( 2 * loop + 1 ) );
+        sum += term;
+    }
+    return sum;
+
+}
+
+constexpr double constexpr_cos(double a) { return constexpr_sin(a + M_PI / 2); }
+
+// cos and sin of each beam of a known laser
+template <class Traits>
+struct angle_table {
+
+    float cos[Traits::nb_beams];
+    float sin[Traits::nb_beams];
+
+constexpr angle_table() : cos(), sin() {
+
+    for (int loop=0; loop<Traits::nb_beams; loop++) {
+        cos[loop] = constexpr_cos((double)Traits::angle_min + loop * (double)Traits::angle_increment);
+        sin[loop] = constexpr_sin((double)Traits::angle_min + loop * (double)Traits::angle_increment);
+    }
+
+}
+
+};
+
+// the generic version computes its angles at runtime
+template <>
+struct angle_table<generic_laser_traits> {
+
+    const float* cos;
+    const float* sin;
+
+constexpr angle_table() : cos(0), sin(0) {}
+
+};
+
+// storage of one value per beam: a std::array for a known laser, a vector reused from scan to scan otherwise
+template <class T, int N>
+struct beam_buffer {
+
+    std::array<T, N> data;
+
+void resize(int) {}
+T& operator[](int i) { return data[i]; }
+const T& operator[](int i) const { return data[i]; }
+const T* ptr() const { return data.data(); }
+
+};
+
+template <class T>
+struct beam_buffer<T, 0> {
+
+    std::vector<T> data;
+
+void resize(int n) { if ( (int)data.size() < n ) data.resize(n); }
+T& operator[](int i) { return data[i]; }
+const T& operator[](int i) const { return data[i]; }
+const T* ptr() const { return data.data(); }
+
+};
+
+struct detector_point {
+
+    float x, y;
+
+};
+
+struct detector_cluster {
+
+    int start, end;// first and last hit
+    float size;// length of the polyline of the hits
+    detector_point middle;// middle of the first and last hits
+    int dynamic;// percentage of dynamic hits
+    int id;// kept from scan to scan while the cluster has the same first and last hits
+
+};
+
+// interface shared by all the versions of the core
+class detector_pipeline {
+public:
+
+    detector_params params;
+
+    // results of detect(), the storage is reused from scan to scan
+    std::vector<detector_cluster> clusters;
+    std::vector<int> moving_legs;// index of the clusters that are moving legs
+    std::vector<detector_point> moving_persons;
+    detector_point goal_to_reach;// the last moving person detected
+
+    // the current scan: range and cartesian coordinates of each hit
+    int nb_beams;
+    const float* range;
+    const float* hit_x;
+    const float* hit_y;
+    const unsigned char* dynamic;
+    float angle_min, angle_increment, range_max;
+
+    // denoising of the ranges given to set_scan(), disabled by default (see range_filter.h)
+    range_filter filter;
+
+    // beams processed by the detection of motion and the clustering (see scan_frontend.h)
+    scan_frontend frontend;
+    double processing_time;// s, of the last detect()
+
+    // the clustering tests the cuts only around the beams that have changed since the previous scan (without
+    // front-end, false by default); the whole scan is segmented otherwise
+    bool incremental;
+    int nb_cuts_tested;// beams where the last detect() has tested if a cluster starts
+    int nb_distances;// distances between consecutive hits computed by the last detect() for the size of the clusters
+
+virtual ~detector_pipeline() {}
+
+virtual const char* name() const = 0;
+// the version can process this scan
+virtual bool accepts(int nb, float angle_min, float angle_increment) const = 0;
+// ranges and cartesian coordinates of the hits of a scan (nothing is done for a scan without beam)
+virtual void set_scan(const float* ranges, int nb, float angle_min, float angle_increment, float range_min, float range_max) = 0;
+// the current scan becomes the background
+virtual void store_background() = 0;
+// detection of motion, clustering, detection of moving legs and moving persons
+virtual void detect() = 0;
+
+};
+
+template <class Traits>
+class detector_core : public detector_pipeline {
+public:
+
+    static constexpr int N = Traits::nb_beams;
+
+detector_core() {
+
+    params = traits_detector_params<Traits>();
+    nb_beams = N;
+    angle_min = Traits::angle_min;
+    angle_increment = Traits::angle_increment;
+    range_max = 0;
+    processing_time = 0;
+    all_beams = true;
+    kept_range = kept_x = kept_y = 0;
+    kept_dynamic = 0;
+    incremental = false;
+    nb_cuts_tested = 0;
+    nb_distances = 0;
+    clustering_valid = false;
+    dynamic_tree_valid = false;
+    clustering_threshold = 0;
+    nb_full_scans = 0;
+    next_cluster_id = 0;
+    clusters.reserve(64);
+    previous_clusters.reserve(64);
+    moving_legs.reserve(16);
+    moving_persons.reserve(16);
+    set_pointers();
+
+}
+
+const char* name() const { return Traits::name; }
+
+bool accepts(int nb, float angle_min, float angle_increment) const { return matches(nb, angle_min, angle_increment); }
+
+static bool matches(int nb, float angle_min, float angle_increment) {
+
+    if ( !N )
+        return true;
+    const float traits_angle_min = Traits::angle_min, traits_angle_increment = Traits::angle_increment;
+    return ( nb == N ) && ( fabs(angle_min - traits_angle_min) < 1e-4 ) && ( fabs(angle_increment - traits_angle_increment) < 1e-6 );
+
+}
+
+void set_scan(const float* ranges, int nb, float angle_min, float angle_increment, float range_min, float range_max) {
+
+    // a scan without beam is ignored: the previous scan is kept
+    if ( nb <= 0 )
+        return;
+    this->range_max = range_max;
+    ranges = filter.apply(ranges, N ? N : nb, angle_increment, range_min, range_max);
+    if ( !N ) {
+        this->angle_min = angle_min;
+        this->angle_increment = angle_increment;
+        if ( nb != nb_beams )
+            clustering_valid = false;
+        nb_beams = nb;
+        buffer_range.resize(nb);
+        buffer_background.resize(nb);
+        buffer_dynamic.resize(nb);
+        buffer_x.resize(nb);
+        buffer_y.resize(nb);
+        previous_range.resize(nb);
+        reference_range.resize(nb);
+        hit_distance.resize(nb);
+        previous_dynamic.resize(nb);
+        cut.resize(nb);
+        fragile.resize(nb);
+        dynamic_tree.resize(nb + 1);
+        set_pointers();
+        if ( ( nb != (int)generic_cos.size() ) || ( angle_min != generic_angle_min ) || ( angle_increment != generic_angle_increment ) ) {
+            // the angles of the beams are computed once for a laser
+            generic_angle_min = angle_min;
+            generic_angle_increment = angle_increment;
+            generic_cos.resize(nb);
+            generic_sin.resize(nb);
+            for (int loop=0; loop<nb; loop++) {
+                generic_cos[loop] = cos(angle_min + loop * angle_increment);
+                generic_sin[loop] = sin(angle_min + loop * angle_increment);
+            }
+        }
+        convert(ranges, nb, range_min, range_max, &generic_cos[0], &generic_sin[0]);
+    }
+    else
+        convert(ranges, N, range_min, range_max, table.cos, table.sin);
+
+}
+
+void store_background() {
+
+    const int nb = N ? N : nb_beams;
+    FOLLOW_ME_UNROLL
+    for (int loop=0; loop<nb; loop++)
+        buffer_background[loop] = buffer_range[loop];
+
+}
+
+void detect() {
+
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+    // without front-end, the loops on all the beams are used
+    all_beams = !frontend.active();
+    if ( !all_beams )
+        frontend.select(range, N ? N : nb_beams, angle_min, angle_increment, range_max);
+
+    detect_motion();
+    perform_clustering();
+    detect_moving_legs();
+    detect_moving_persons();
+
+    processing_time = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    frontend.adapt(processing_time);
+
+}
+
+private:
+
+    static constexpr angle_table<Traits> table = angle_table<Traits>();
+
+    beam_buffer<float, N> buffer_range, buffer_background, buffer_x, buffer_y;
+    beam_buffer<unsigned char, N> buffer_dynamic;
+    beam_buffer<float, N> hit_distance;// distance between each hit and the previous one, for the size of the clusters
+
+    // angles of the generic version
+    std::vector<float> generic_cos, generic_sin;
+    float generic_angle_min, generic_angle_increment;
+
+    bool all_beams;// the front-end keeps all the beams
+
+    // hits kept by the front-end, in sequence for the clustering: the buffers of the scan from the first kept beam when
+    // the kept beams are contiguous (angular sector only), gathered otherwise (the storage is reused)
+    const float *kept_range, *kept_x, *kept_y;
+    const unsigned char* kept_dynamic;
+    std::vector<float> gathered_range, gathered_x, gathered_y, kept_distance;
+    std::vector<unsigned char> gathered_dynamic;
+
+    // clusters of the previous scan, for their ids
+    std::vector<detector_cluster> previous_clusters;
+    int next_cluster_id;
+
+    // state of the incremental clustering:
+    // - the ranges of the previous scan: the distances (see hit_distance) are only computed again for the blocks of
+    //   beams whose ranges have changed, and the sizes for the clusters of these blocks
+    // - the range of each beam when the cuts around it were last tested
+    // - the dynamic flags of the previous scan, and the dynamic hits in a fenwick tree (number of dynamic hits of any
+    //   interval of beams in log(nb))
+    // - the beams where a cluster starts, and the fragile ones: their range difference was within twice the tolerance
+    //   of cluster_threshold, the cut may change without a changed beam
+    beam_buffer<float, N> previous_range, reference_range;
+    beam_buffer<unsigned char, N> previous_dynamic, cut, fragile;
+    beam_buffer<int, N ? N + 1 : 0> dynamic_tree;
+    std::vector<int> changed;// beams that have changed, and fragile beams whose cut has changed
+    std::vector<unsigned char> updated_block;// blocks of 16 beams with a range that is not exactly the one of the previous scan
+    std::vector<int> candidates;// beams of a run of clusters where a cut may have appeared or disappeared
+    bool clustering_valid;// the state matches the previous scan
+    bool dynamic_tree_valid;// built after a full clustering only when an incremental one needs it
+    float clustering_threshold;// cluster_threshold of the state
+    int nb_full_scans;// scans to segment in full before trying the incremental clustering again
+
+void set_pointers() {
+
+    range = buffer_range.ptr();
+    hit_x = buffer_x.ptr();
+    hit_y = buffer_y.ptr();
+    dynamic = buffer_dynamic.ptr();
+
+}
+
+// store the range and the coordinates in cartesian framework of each hit
+void convert(const float* ranges, const int nb, float range_min, float range_max, const float* c, const float* s) {
+
+    FOLLOW_ME_UNROLL
+    for (int loop=0; loop<nb; loop++) {
+        float r = ranges[loop];
+        r = ( ( r < range_max ) && ( r > range_min ) ) ? r : range_max;
+        buffer_range[loop] = r;
+        buffer_x[loop] = r * c[loop];
+        buffer_y[loop] = r * s[loop];
+    }
+
+}
+
+// a hit is dynamic if its range differs from the background by more than detection_threshold
+void detect_motion() {
+
+    const int nb = N ? N : nb_beams;
+    const float threshold = params.detection_threshold;
+    if ( all_beams ) {
+        FOLLOW_ME_UNROLL
+        for (int loop=0; loop<nb; loop++)
+            buffer_dynamic[loop] = fabs(buffer_background[loop] - buffer_range[loop]) > threshold;
+    }
+    else {
+        const int nb_kept = frontend.nb_selected;
+        if ( (int)kept_distance.size() < nb + 4 ) {
+            gathered_range.resize(nb + 4);
+            gathered_x.resize(nb + 4);
+            gathered_y.resize(nb + 4);
+            gathered_dynamic.resize(nb + 4);
+            kept_distance.resize(nb + 4);
+        }
+        if ( !nb_kept )
+            return;
+
+        const int first = frontend.selected[0];
+        if ( frontend.selected[nb_kept - 1] - first == nb_kept - 1 ) {
+            FOLLOW_ME_UNROLL
+            for (int loop=first; loop<first+nb_kept; loop++)
+                buffer_dynamic[loop] = fabs(buffer_background[loop] - buffer_range[loop]) > threshold;
+            kept_range = range + first;
+            kept_x = hit_x + first;
+            kept_y = hit_y + first;
+            kept_dynamic = dynamic + first;
+            return;
+        }
+
+        const int* selected = &frontend.selected[0];
+        const float* background = buffer_background.ptr();
+        unsigned char* all_dynamic = &buffer_dynamic[0];
+        float* r = &gathered_range[0];
+        float* x = &gathered_x[0];
+        float* y = &gathered_y[0];
+        unsigned char* d = &gathered_dynamic[0];
+        for (int loop=0; loop<nb_kept; loop++) {
+            const int hit = selected[loop];
+            r[loop] = range[hit];
+            x[loop] = hit_x[hit];
+            y[loop] = hit_y[hit];
+            d[loop] = all_dynamic[hit] = fabs(background[hit] - r[loop]) > threshold;
+        }
+        kept_range = r;
+        kept_x = x;
+        kept_y = y;
+        kept_dynamic = d;
+    }
+
+}
+
+// a new cluster starts when the range changes by more than cluster_threshold between two consecutive hits
+void perform_clustering() {
+
+    previous_clusters.swap(clusters);
+    clusters.clear();
+    nb_cuts_tested = 0;
+    nb_distances = 0;
+    if ( !all_beams ) {
+        perform_clustering_selected();
+        clustering_valid = false;
+    }
+    else
+        if ( incremental && clustering_valid && ( clustering_threshold == params.cluster_threshold ) && !nb_full_scans )
+            perform_clustering_incremental();
+    else {
+        nb_full_scans = std::max(nb_full_scans - 1, 0);
+        perform_clustering_full();
+    }
+    assign_ids();
+
+}
+
+void perform_clustering_full() {
+
+    const int nb = N ? N : nb_beams;
+    if ( !nb )
+        return;
+
+    compute_distances(0, nb);
+    int start = 0;
+    int nb_dynamic = buffer_dynamic[0];
+    for (int loop=1; loop<nb; loop++) {
+        if ( fabs(buffer_range[loop-1] - buffer_range[loop]) < params.cluster_threshold )
+            nb_dynamic += buffer_dynamic[loop];
+        else {
+            end_cluster(start, loop - 1, polyline(hit_distance.ptr(), start, loop - 1), nb_dynamic, loop - start);
+            start = loop;
+            nb_dynamic = buffer_dynamic[loop];
+        }
+    }
+    end_cluster(start, nb - 1, polyline(hit_distance.ptr(), start, nb - 1), nb_dynamic, nb - start);
+    nb_cuts_tested = nb;
+
+    // the scan compared with the next one, unless the next one is also segmented in full
+    clustering_valid = incremental && !nb_full_scans;
+    if ( !clustering_valid )
+        return;
+    clustering_threshold = params.cluster_threshold;
+    const float tolerance = incremental_tolerance * params.cluster_threshold;
+    cut[0] = 1;
+    fragile[0] = 0;
+    for (int loop=1; loop<nb; loop++) {
+        const float difference = fabs(buffer_range[loop-1] - buffer_range[loop]);
+        cut[loop] = !( difference < params.cluster_threshold );
+        fragile[loop] = fabs(difference - params.cluster_threshold) <= 2 * tolerance + fragile_margin;
+    }
+    std::memcpy(&previous_range[0], range, nb * sizeof(float));
+    std::memcpy(&reference_range[0], range, nb * sizeof(float));
+    std::memcpy(&previous_dynamic[0], dynamic, nb);
+    dynamic_tree_valid = false;
+
+}
+
+// the fenwick tree of the dynamic hits of the current scan
+void build_dynamic_tree(int nb) {
+
+    dynamic_tree[0] = 0;
+    for (int loop=0; loop<nb; loop++)
+        dynamic_tree[loop+1] = buffer_dynamic[loop];
+    for (int loop=1; loop<=nb; loop++) {
+        const int parent = loop + ( loop & -loop );
+        if ( parent <= nb )
+            dynamic_tree[parent] += dynamic_tree[loop];
+    }
+    dynamic_tree_valid = true;
+
+}
+
+// the previous clusters without changed beam and still cut at both ends are kept; each run of consecutive clusters
+// that cannot be kept is segmented again
+void perform_clustering_incremental() {
+
+    const int nb = N ? N : nb_beams;
+    const float tolerance = incremental_tolerance * params.cluster_threshold;
+    const bool update_tree = dynamic_tree_valid;
+    if ( !dynamic_tree_valid )
+        build_dynamic_tree(nb);
+
+    // the beams are compared by blocks of 16 (4 at a time): the distances of a block with an updated range are computed
+    // again (4 at a time), and only the beams with an event are processed one by one; with ranges that move more than
+    // the tolerance, testing the cuts around each changed beam would cost more than a full clustering
+    changed.clear();
+    updated_block.assign(( nb + 15 ) / 16, 0);
+    const size_t changed_max = incremental_changed_max * nb;
+    for (int block=0; block<nb; block+=16) {
+        const int last = std::min(block + 16, nb);
+        bool updated;
+        int events = block_events(block, last, tolerance, updated);
+        if ( updated ) {
+            compute_distances(block, last);
+            std::memcpy(&previous_range[block], range + block, ( last - block ) * sizeof(float));
+            updated_block[block / 16] = 1;
+        }
+        for (int loop=block; events; loop++, events>>=1) {
+            if ( !( events & 1 ) )
+                continue;
+            const bool range_changed = fabs(buffer_range[loop] - reference_range[loop]) > tolerance;
+            const bool dynamic_changed = buffer_dynamic[loop] != previous_dynamic[loop];
+            if ( dynamic_changed ) {
+                if ( update_tree )
+                    for (int node=loop+1; node<=nb; node+=node & -node)
+                        dynamic_tree[node] += (int)buffer_dynamic[loop] - (int)previous_dynamic[loop];
+                previous_dynamic[loop] = buffer_dynamic[loop];
+            }
+            if ( range_changed ) {
+                // the cuts before and after the beam are tested, and their fragility is computed for the new range
+                reference_range[loop] = buffer_range[loop];
+                test_cut(loop, tolerance);
+                if ( loop + 1 < nb )
+                    test_cut(loop + 1, tolerance);
+                changed.push_back(loop);
+            }
+            else
+                if ( dynamic_changed )
+                    changed.push_back(loop);
+            else {
+                // fragile cut
+                const unsigned char previous_cut = cut[loop];
+                test_cut(loop, tolerance);
+                if ( cut[loop] != previous_cut )
+                    changed.push_back(loop);
+            }
+        }
+        if ( changed.size() > changed_max ) {
+            nb_full_scans = incremental_retry;
+            perform_clustering_full();
+            return;
+        }
+    }
+
+    size_t next_changed = 0, loop = 0;
+    while ( loop < previous_clusters.size() ) {
+        if ( reusable(previous_clusters[loop], next_changed) ) {
+            keep_cluster(previous_clusters[loop]);
+            loop++;
+            continue;
+        }
+        const size_t first = loop;
+        while ( ( loop < previous_clusters.size() ) && !reusable(previous_clusters[loop], next_changed) )
+            loop++;
+        segment(first, loop - 1);
+    }
+
+}
+
+// events of the beams [first, last), one bit per beam: the range has moved more than the tolerance, the dynamic flag
+// has changed or the cut is fragile; "updated" is true if a range is not exactly the one of the previous scan
+int block_events(int first, int last, float tolerance, bool& updated) const {
+
+    using namespace simd;
+    int events = 0, different = 0, loop = first;
+    if ( last - first == 16 ) {
+        const float4 t(tolerance);
+        for (; loop<last; loop+=4) {
+            const float4 r = load(range + loop), previous_r = load(previous_range.ptr() + loop);
+            different |= movemask(( r < previous_r ) | ( r > previous_r ));
+            events |= movemask(abs(r - load(reference_range.ptr() + loop)) > t) << ( loop - first );
+        }
+    }
+    for (; loop<last; loop++) {
+        different |= buffer_range[loop] != previous_range[loop];
+        events |= ( fabs(buffer_range[loop] - reference_range[loop]) > tolerance ) << ( loop - first );
+    }
+    // the dynamic flags and the fragile cuts are compared 8 at a time, most of them are unchanged and not fragile
+    for (loop=first; loop<last; loop+=8) {
+        const int end = std::min(loop + 8, last);
+        if ( end - loop == 8 ) {
+            uint64_t d, previous_d, f;
+            std::memcpy(&d, dynamic + loop, 8);
+            std::memcpy(&previous_d, previous_dynamic.ptr() + loop, 8);
+            std::memcpy(&f, fragile.ptr() + loop, 8);
+            if ( !( ( d ^ previous_d ) | f ) )
+                continue;
+        }
+        for (int hit=loop; hit<end; hit++)
+            events |= ( ( buffer_dynamic[hit] != previous_dynamic[hit] ) | fragile[hit] ) << ( hit - first );
+    }
+    updated = different;
+    return events;
+
+}
+
+// the distance of each hit of the beams [first, last) to the previous hit, and of the next hit to the last one, 4 at a
+// time (the same values as distance())
+void compute_distances(int first, int last) {
+
+    using namespace simd;
+    const int nb = N ? N : nb_beams;
+    int loop = std::max(first, 1);
+    const int end = std::min(last, nb - 1);// last distance computed
+    for (; loop+3<=end; loop+=4) {
+        const float4 dx = load(hit_x + loop - 1) - load(hit_x + loop), dy = load(hit_y + loop - 1) - load(hit_y + loop);
+        store(&hit_distance[loop], sqrt(dx * dx + dy * dy));
+    }
+    for (; loop<=end; loop++)
+        hit_distance[loop] = distance(loop - 1, loop);
+    nb_distances += end - std::max(first, 1) + 1;
+
+}
+
+// a cluster starts at "hit" if its range differs from the previous one by more than cluster_threshold; the cut is
+// fragile if the reference ranges can move within the tolerance and change it
+void test_cut(int hit, float tolerance) {
+
+    if ( !hit )
+        return;
+    cut[hit] = !( fabs(buffer_range[hit-1] - buffer_range[hit]) < params.cluster_threshold );
+    fragile[hit] = fabs(fabs(reference_range[hit-1] - reference_range[hit]) - params.cluster_threshold) <= 2 * tolerance + fragile_margin;
+    nb_cuts_tested++;
+
+}
+
+// the previous cluster "c" has no changed beam and is still cut at both ends; "next_changed" is the first changed
+// beam not before c
+bool reusable(const detector_cluster& c, size_t& next_changed) const {
+
+    while ( ( next_changed < changed.size() ) && ( changed[next_changed] < c.start ) )
+        next_changed++;
+    if ( ( next_changed < changed.size() ) && ( changed[next_changed] <= c.end ) )
+        return false;
+    const int nb = N ? N : nb_beams;
+    return cut[c.start] && ( ( c.end + 1 == nb ) || cut[c.end+1] );
+
+}
+
+// a kept cluster has the same hits and dynamic hits; its size and middle are computed again if one of its ranges
+// has moved within the tolerance
+void keep_cluster(const detector_cluster& c) {
+
+    clusters.push_back(c);
+    int block = c.start / 16;
+    while ( ( block <= c.end / 16 ) && !updated_block[block] )
+        block++;
+    if ( block > c.end / 16 )
+        return;
+    detector_cluster& k = clusters.back();
+    k.size = polyline(hit_distance.ptr(), c.start, c.end);
+    k.middle.x = ( buffer_x[c.start] + buffer_x[c.end] ) / 2;
+    k.middle.y = ( buffer_y[c.start] + buffer_y[c.end] ) / 2;
+
+}
+
+// new clusters of the beams of the previous clusters [first, last]: the cuts inside a previous cluster can only have
+// changed at a changed beam or just after it, so only these beams and the starts of the previous clusters are tested
+void segment(size_t first, size_t last) {
+
+    const int first_hit = previous_clusters[first].start, last_hit = previous_clusters[last].end;
+    candidates.clear();
+    for (size_t loop=first+1; loop<=last; loop++)
+        candidates.push_back(previous_clusters[loop].start);
+    for (std::vector<int>::const_iterator hit=std::lower_bound(changed.begin(), changed.end(), first_hit); ( hit != changed.end() ) && ( *hit <= last_hit ); ++hit) {
+        if ( *hit > first_hit )
+            candidates.push_back(*hit);
+        if ( *hit < last_hit )
+            candidates.push_back(*hit + 1);
+    }
+    std::sort(candidates.begin(), candidates.end());
+    candidates.erase(std::unique(candidates.begin(), candidates.end()), candidates.end());
+
+    int start = first_hit;
+    for (size_t loop=0; loop<candidates.size(); loop++)
+        if ( cut[candidates[loop]] ) {
+            const int end = candidates[loop] - 1;
+            end_cluster(start, end, polyline(hit_distance.ptr(), start, end), count_dynamic(start, end), end - start + 1);
+            start = candidates[loop];
+        }
+    end_cluster(start, last_hit, polyline(hit_distance.ptr(), start, last_hit), count_dynamic(start, last_hit), last_hit - start + 1);
+    nb_cuts_tested += candidates.size() + 1;
+
+}
+
+// dynamic hits of the beams [first, last], from the fenwick tree
+int count_dynamic(int first, int last) const {
+
+    int count = 0;
+    for (int node=last+1; node>0; node-=node & -node)
+        count += dynamic_tree[node];
+    for (int node=first; node>0; node-=node & -node)
+        count -= dynamic_tree[node];
+    return count;
+
+}
+
+// length of the polyline of the hits [start, end], from the distances between consecutive hits (4 sums, so that the
+// additions do not wait for each other)
+static float polyline(const float* hit_distance, int start, int end) {
+
+    float size[4] = { 0, 0, 0, 0 };
+    int loop = start + 1;
+    for (; loop+3<=end; loop+=4)
+        for (int lane=0; lane<4; lane++)
+            size[lane] += hit_distance[loop+lane];
+    for (; loop<=end; loop++)
+        size[0] += hit_distance[loop];
+    return ( size[0] + size[1] ) + ( size[2] + size[3] );
+
+}
+
+// a new cluster takes the id of the previous cluster with the same first and last hits, a new id otherwise (both
+// lists are sorted by first hit)
+void assign_ids() {
+
+    size_t previous = 0;
+    for (size_t loop=0; loop<clusters.size(); loop++) {
+        detector_cluster& c = clusters[loop];
+        if ( c.id >= 0 )
+            continue;
+        while ( ( previous < previous_clusters.size() ) && ( previous_clusters[previous].start < c.start ) )
+            previous++;
+        if ( ( previous < previous_clusters.size() ) && ( previous_clusters[previous].start == c.start ) && ( previous_clusters[previous].end == c.end ) )
+            c.id = previous_clusters[previous].id;
+        else
+            c.id = next_cluster_id++;
+    }
+
+}
+
+// same clustering on the hits kept by the front-end (see detect_motion()): consecutive kept hits are compared, and the
+// polyline joins them
+void perform_clustering_selected() {
+
+    using namespace simd;
+    const int nb = frontend.nb_selected;
+    const std::vector<int>& selected = frontend.selected;
+    const std::vector<unsigned char>& break_before = frontend.break_before;
+    if ( !nb )
+        return;
+
+    int loop = 1;
+    for (; loop+4<=nb; loop+=4) {
+        const float4 dx = load(kept_x + loop - 1) - load(kept_x + loop), dy = load(kept_y + loop - 1) - load(kept_y + loop);
+        store(&kept_distance[loop], sqrt(dx * dx + dy * dy));
+    }
+    for (; loop<nb; loop++) {
+        const float dx = kept_x[loop - 1] - kept_x[loop], dy = kept_y[loop - 1] - kept_y[loop];
+        kept_distance[loop] = sqrt(dx * dx + dy * dy);
+    }
+    nb_distances = nb - 1;
+
+    int start = 0;
+    int nb_dynamic = kept_dynamic[0];
+    for (loop=1; loop<nb; loop++) {
+        if ( !break_before[loop] && ( fabs(kept_range[loop-1] - kept_range[loop]) < params.cluster_threshold ) )
+            nb_dynamic += kept_dynamic[loop];
+        else {
+            end_cluster(selected[start], selected[loop - 1], polyline(&kept_distance[0], start, loop - 1), nb_dynamic, loop - start);
+            start = loop;
+            nb_dynamic = kept_dynamic[loop];
+        }
+    }
+    end_cluster(selected[start], selected[nb - 1], polyline(&kept_distance[0], start, nb - 1), nb_dynamic, nb - start);
+    nb_cuts_tested = nb;
+
+}
+
+void end_cluster(int start, int end, float size, int nb_dynamic, int nb_hits) {
+
+    detector_cluster c;
+    c.start = start;
+    c.end = end;
+    c.size = size;
+    c.middle.x = ( buffer_x[start] + buffer_x[end] ) / 2;
+    c.middle.y = ( buffer_y[start] + buffer_y[end] ) / 2;
+    c.dynamic = (float)nb_dynamic / (float)nb_hits * 100;
+    c.id = -1;
+    clusters.push_back(c);
+
+}
+
+// a moving leg is a cluster of a size in [leg_size_min, leg_size_max] with more than dynamic_threshold% of dynamic hits
+void detect_moving_legs() {
+
+    moving_legs.clear();
+    for (size_t loop=0; loop<clusters.size(); loop++)
+        if ( ( clusters[loop].size > params.leg_size_min ) && ( clusters[loop].size < params.leg_size_max ) &&
+             ( clusters[loop].dynamic >= params.dynamic_threshold ) )
+            moving_legs.push_back(loop);
+
+}
+
+// a moving person has two moving legs located at less than legs_distance_max one from the other
+void detect_moving_persons() {
+
+    moving_persons.clear();
+    for (size_t leg1=0; leg1<moving_legs.size(); leg1++)
+        for (size_t leg2=leg1+1; leg2<moving_legs.size(); leg2++) {
+            const detector_point& a = clusters[moving_legs[leg1]].middle;
+            const detector_point& b = clusters[moving_legs[leg2]].middle;
+            if ( point_distance(a, b) < params.legs_distance_max ) {
+                detector_point p;
+                p.x = ( a.x + b.x ) / 2;
+                p.y = ( a.y + b.y ) / 2;
+                moving_persons.push_back(p);
+                goal_to_reach = p;
+            }
+        }
+
+}
+
+float distance(int a, int b) const {
+
+    float dx = buffer_x[a] - buffer_x[b], dy = buffer_y[a] - buffer_y[b];
+    return sqrt(dx * dx + dy * dy);
+
+}
+
+};
+
+template <class Traits>
+constexpr angle_table<Traits> detector_core<Traits>::table;
+
+// the specialized version of the core for the laser that produces this scan, the generic one otherwise
+inline detector_pipeline* make_detector_pipeline(int nb, float angle_min, float angle_increment) {
+
+    if ( detector_core<hokuyo_urg_traits>::matches(nb, angle_min, angle_increment) )
+        return new detector_core<hokuyo_urg_traits>();
+    if ( detector_core<lidar_1440_traits>::matches(nb, angle_min, angle_increment) )
+        return new detector_core<lidar_1440_traits>();
+    if ( detector_core<lidar_2048_traits>::matches(nb, angle_min, angle_increment) )
+        return new detector_core<lidar_2048_traits>();
+    return new detector_core<generic_laser_traits>();
+
+}
+
+#endif
@@ -0,0 +1,216 @@
+// robot centred euclidean distance field of the hits of the scan: the clearance (distance to the closest hit) and its
+// gradient at any position are read in O(1), without loop over the hits
+// - exact transform of Felzenszwalb and Huttenlocher: the distance to the closest hit of each column (two sweeps), then
+//   along each row the lower envelope of the parabolas of the columns, in O(cells)
+// - the hits of the previous scan are kept: only the columns where a cell has changed are transformed again, the
+//   others keep their distances. All the rows are transformed at each scan: a hit that moves changes the distances of
+//   its column up to the next hits of the column, so most of the rows change even when one person only moves
+// - without any hit, the clearance is the size of the grid
+
+#ifndef FOLLOW_ME_DISTANCE_FIELD_H
+#define FOLLOW_ME_DISTANCE_FIELD_H
+
+#include <algorithm>
+#include <cmath>
+#include <stdint.h>
+#include <vector>
+#include "follow_me/simd.h"
+
+class distance_field {
+public:
+
+    int nb_columns_updated;// by the last build
+
+distance_field(float extent = 8.0, float cell_size = 0.05) {
+
+    resolution = cell_size;
+    size = (int)( extent / cell_size );
+    half_extent = size * resolution / 2;
+    infinity = 2 * size * resolution;
+    occupied.assign(size * size, 0);
+    column_distance.assign(size * size, no_hit());
+    distance.assign(size * size, infinity);
+    padded = ( size + 3 ) & ~3;
+    row.resize(padded);
+    squared.assign(padded, 0);
+    column_changed.assign(size, 0);
+    envelope.resize(size);
+    boundaries.resize(size + 1);
+    nb_columns_updated = 0;
+
+}
+
+int cells_per_side() const { return size; }
+float cell_size() const { return resolution; }
+const float* data() const { return &distance[0]; }
+
+// x and y (in the robot frame) of the origin of the grid
+float origin() const { return -half_extent; }
+
+// the field is updated from the hits (in the robot frame); the hits outside of the grid are ignored
+void build(const float* x, const float* y, int nb_points) {
+
+    // the cells that change between the previous scan and this one: their columns are transformed again
+    for (size_t loop=0; loop<hits.size(); loop++)
+        occupied[hits[loop]] = 2;// was occupied
+    previous_hits.swap(hits);
+    hits.clear();
+    for (int loop=0; loop<nb_points; loop++) {
+        int ix = (int)floor(( x[loop] + half_extent ) / resolution);
+        int iy = (int)floor(( y[loop] + half_extent ) / resolution);
+        if ( ( ix < 0 ) || ( ix >= size ) || ( iy < 0 ) || ( iy >= size ) )
+            continue;
+        int cell = ix * size + iy;// column major
+        if ( occupied[cell] == 1 )
+            continue;
+        if ( occupied[cell] == 0 )
+            column_changed[ix] = 1;
+        occupied[cell] = 1;
+        hits.push_back(cell);
+    }
+    for (size_t loop=0; loop<previous_hits.size(); loop++)
+        if ( occupied[previous_hits[loop]] == 2 ) {
+            occupied[previous_hits[loop]] = 0;
+            column_changed[previous_hits[loop] / size] = 1;
+        }
+
+    nb_columns_updated = 0;
+    for (int ix=0; ix<size; ix++)
+        if ( column_changed[ix] ) {
+            transform_column(ix);
+            column_changed[ix] = 0;
+            nb_columns_updated++;
+        }
+    for (int iy=0; iy<size; iy++)
+        transform_row(iy);
+
+}
+
+// the next build transforms all the columns
+void invalidate() {
+
+    std::fill(column_changed.begin(), column_changed.end(), 1);
+
+}
+
+// clearance at (x, y), the positions outside of the grid are clamped to its border
+float at(float x, float y) const {
+
+    return distance[index(x, y)];
+
+}
+
+// gradient of the clearance at (x, y) (central differences, one sided on the border): points away from the closest hit
+void gradient(float x, float y, float& gx, float& gy) const {
+
+    int ix = std::max(0, std::min(size - 1, (int)floor(( x + half_extent ) / resolution)));
+    int iy = std::max(0, std::min(size - 1, (int)floor(( y + half_extent ) / resolution)));
+    int x0 = std::max(0, ix - 1), x1 = std::min(size - 1, ix + 1);
+    int y0 = std::max(0, iy - 1), y1 = std::min(size - 1, iy + 1);
+    gx = ( distance[iy * size + x1] - distance[iy * size + x0] ) / ( ( x1 - x0 ) * resolution );
+    gy = ( distance[y1 * size + ix] - distance[y0 * size + ix] ) / ( ( y1 - y0 ) * resolution );
+
+}
+
+private:
+
+    int size;// number of cells per side
+    float resolution;
+    float half_extent;
+    float infinity;
+    // the columns are stored contiguously (column major), the distances row by row
+    std::vector<uint8_t> occupied;// 0: free, 1: hit of this scan, 2: hit of the previous scan only (during build)
+    std::vector<int> hits, previous_hits;// occupied cells
+    std::vector<float> column_distance;// squared distance (in cells) to the closest hit of the column
+    std::vector<float> distance;
+    int padded;// size rounded to 4
+    std::vector<float> row, squared;// work arrays of a column or a row
+    std::vector<uint8_t> column_changed;
+    std::vector<int> envelope;// columns of the parabolas of the lower envelope
+    std::vector<float> boundaries;// between the parabolas of the envelope
+
+static float no_hit() { return 1e20f; }
+
+int index(float x, float y) const {
+
+    int ix = (int)floor(( x + half_extent ) / resolution);
+    int iy = (int)floor(( y + half_extent ) / resolution);
+    ix = std::max(0, std::min(size - 1, ix));
+    iy = std::max(0, std::min(size - 1, iy));
+    return iy * size + ix;
+
+}
+
+// distance to the closest hit of the column: a sweep in each direction
+void transform_column(int ix) {
+
+    const uint8_t* o = &occupied[ix * size];
+    float* f = &column_distance[ix * size];
+    int last = -1;// row of the last hit
+    for (int iy=0; iy<size; iy++) {
+        if ( o[iy] )
+            last = iy;
+        row[iy] = ( last < 0 ) ? no_hit() : ( iy - last ) * ( iy - last );
+    }
+    last = -1;
+    for (int iy=size-1; iy>=0; iy--) {
+        if ( o[iy] )
+            last = iy;
+        f[iy] = ( last < 0 ) ? row[iy] : std::min(row[iy], (float)( ( last - iy ) * ( last - iy ) ));
+    }
+
+}
+
+// lower envelope of the parabolas (x - q)^2 + f(q) of the row, then the distance of each cell
+void transform_row(int iy) {
+
+    for (int q=0; q<size; q++)
+        row[q] = column_distance[q * size + iy];
+
+    // the columns without hit do not take part
+    int nb = 0;
+    for (int q=0; q<size; q++) {
+        if ( row[q] >= no_hit() )
+            continue;
+        while ( nb > 0 ) {
+            int p = envelope[nb - 1];
+            // intersection of the parabolas of p and q
+            float s = ( ( row[q] + q * q ) - ( row[p] + p * p ) ) / ( 2 * ( q - p ) );
+            if ( ( nb > 1 ) && ( s <= boundaries[nb - 1] ) )
+                nb--;
+            else {
+                boundaries[nb] = s;
+                break;
+            }
+        }
+        if ( nb == 0 )
+            boundaries[0] = -INFINITY;
+        envelope[nb++] = q;
+    }
+
+    float* d = &distance[iy * size];
+    if ( nb == 0 ) {
+        std::fill(d, d + size, infinity);
+        return;
+    }
+
+    // squared distances, then the square roots 4 by 4
+    boundaries[nb] = INFINITY;
+    int k = 0;
+    for (int x=0; x<size; x++) {
+        while ( boundaries[k + 1] < x )
+            k++;
+        int q = envelope[k];
+        squared[x] = ( x - q ) * ( x - q ) + row[q];
+    }
+    using namespace simd;
+    const float4 scale(resolution), cap(infinity);
+    for (int x=0; x<padded; x+=4)
+        store(&squared[x], min(cap, sqrt(load(&squared[x])) * scale));
+    std::copy(squared.begin(), squared.begin() + size, d);
+
+}
+
+};
+
+#endif
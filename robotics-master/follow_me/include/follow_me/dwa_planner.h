@@ -0,0 +1,237 @@
+// local planner based on the Dynamic Window Approach
+// the (v, w) pairs reachable during the next control period are sampled, each arc is simulated over a short horizon
+// and scored by its heading toward the goal, its clearance to the obstacles and its velocity
+// the clearance of each simulated position is read in the distance field of the scan (see distance_field.h)
+// the samples are processed 4 by 4 (see simd.h) and split over a pool of threads
+
+#ifndef FOLLOW_ME_DWA_PLANNER_H
+#define FOLLOW_ME_DWA_PLANNER_H
+
+#include <algorithm>
+#include <cmath>
+#include <functional>
+#include <vector>
+#include "follow_me/distance_field.h"
+#include "follow_me/simd.h"
+#include "follow_me/thread_pool.h"
+
+struct dwa_config {
+
+    // dynamic constraints of the robot
+    float max_speed, min_speed;// m/s, min_speed < 0 allows to move backward
+    float max_rotation_speed;// rad/s
+    float max_acceleration, max_rotation_acceleration;
+    float control_period;// s, the dynamic window is the set of speeds reachable during one period
+
+    float robot_radius;// m
+
+    // simulation of each arc
+    float horizon;// s
+    int nb_steps;
+
+    int nb_speed_samples, nb_rotation_samples;
+
+    // weights of the score
+    float weight_heading, weight_clearance, weight_velocity;
+    float max_clearance;// a clearance above this distance is not rewarded
+
+};
+
+inline dwa_config default_dwa_config() {
+
+    dwa_config c;
+    c.max_speed = 0.5;
+    c.min_speed = 0;
+    c.max_rotation_speed = 1.0;
+    c.max_acceleration = 0.5;
+    c.max_rotation_acceleration = 1.5;
+    c.control_period = 0.05;
+    c.robot_radius = 0.25;
+    c.horizon = 2.0;
+    c.nb_steps = 20;
+    c.nb_speed_samples = 32;
+    c.nb_rotation_samples = 64;
+    c.weight_heading = 1.0;
+    c.weight_clearance = 0.6;
+    c.weight_velocity = 0.4;
+    c.max_clearance = 1.0;
+    return c;
+
+}
+
+class dwa_planner {
+private:
+
+    dwa_config config;
+    thread_pool* pool;
+
+    // samples stored as structure of arrays, padded to a multiple of 4
+    int nb_samples;
+    std::vector<float> sample_speed, sample_rotation_speed;
+    std::vector<float> step_cos, step_sin;// rotation of the heading during one step of the simulation
+    std::vector<float> sample_score, sample_clearance;
+
+    // current problem
+    const distance_field* grid;
+    float goal_x, goal_y;
+
+public:
+
+dwa_planner(const dwa_config& c, thread_pool* p = 0) : config(c), pool(p), nb_samples(0), grid(0) {
+
+    int nb = config.nb_speed_samples * config.nb_rotation_samples;
+    nb = ( nb + 3 ) & ~3;
+    sample_speed.resize(nb);
+    sample_rotation_speed.resize(nb);
+    step_cos.resize(nb);
+    step_sin.resize(nb);
+    sample_score.resize(nb);
+    sample_clearance.resize(nb);
+
+}
+
+const dwa_config& parameters() const { return config; }
+
+int number_of_samples() const { return nb_samples; }
+
+// select the best (v, w) to reach the goal (in the robot frame) from the current speeds
+// returns false if no admissible arc exists: the robot has to stop
+bool plan(const distance_field& clearance, float current_speed, float current_rotation_speed, float goal_x_robot, float goal_y_robot, float& best_speed, float& best_rotation_speed, float& best_clearance) {
+
+    grid = &clearance;
+    goal_x = goal_x_robot;
+    goal_y = goal_y_robot;
+
+    generate_samples(current_speed, current_rotation_speed);
+
+    const int nb_blocks = nb_samples / 4;
+    std::function<void(int, int)> evaluate = [this](int begin, int end) {
+        for (int block = begin; block < end; block++)
+            evaluate_block(block * 4);
+    };
+    if ( pool )
+        pool->parallel_for(nb_blocks, 16, evaluate);
+    else
+        evaluate(0, nb_blocks);
+
+    int best = -1;
+    for (int loop=0; loop<nb_samples; loop++)
+        if ( ( sample_score[loop] > -1 ) && ( ( best == -1 ) || ( sample_score[loop] > sample_score[best] ) ) )
+            best = loop;
+
+    if ( best == -1 ) {
+        best_speed = 0;
+        best_rotation_speed = 0;
+        best_clearance = 0;
+        return false;
+    }
+
+    best_speed = sample_speed[best];
+    best_rotation_speed = sample_rotation_speed[best];
+    best_clearance = sample_clearance[best];
+    return true;
+
+}
+
+private:
+
+// sampling of the dynamic window
+void generate_samples(float current_speed, float current_rotation_speed) {
+
+    float dv = config.max_acceleration * config.control_period;
+    float dw = config.max_rotation_acceleration * config.control_period;
+    float v_min = std::max(config.min_speed, current_speed - dv);
+    float v_max = std::min(config.max_speed, current_speed + dv);
+    float w_min = std::max(-config.max_rotation_speed, current_rotation_speed - dw);
+    float w_max = std::min(config.max_rotation_speed, current_rotation_speed + dw);
+    if ( v_min > v_max )
+        v_min = v_max = std::max(config.min_speed, std::min(config.max_speed, current_speed));
+    if ( w_min > w_max )
+        w_min = w_max = std::max(-config.max_rotation_speed, std::min(config.max_rotation_speed, current_rotation_speed));
+
+    float step = config.horizon / config.nb_steps;
+
+    nb_samples = 0;
+    for (int loop_v=0; loop_v<config.nb_speed_samples; loop_v++) {
+        float v = v_min + ( v_max - v_min ) * loop_v / std::max(1, config.nb_speed_samples - 1);
+        for (int loop_w=0; loop_w<config.nb_rotation_samples; loop_w++) {
+            float w = w_min + ( w_max - w_min ) * loop_w / std::max(1, config.nb_rotation_samples - 1);
+            sample_speed[nb_samples] = v;
+            sample_rotation_speed[nb_samples] = w;
+            step_cos[nb_samples] = cos(w * step);
+            step_sin[nb_samples] = sin(w * step);
+            nb_samples++;
+        }
+    }
+
+    // padding: copies of the last sample
+    while ( nb_samples & 3 ) {
+        sample_speed[nb_samples] = sample_speed[nb_samples-1];
+        sample_rotation_speed[nb_samples] = sample_rotation_speed[nb_samples-1];
+        step_cos[nb_samples] = step_cos[nb_samples-1];
+        step_sin[nb_samples] = step_sin[nb_samples-1];
+        nb_samples++;
+    }
+
+}
+
+// simulation and scoring of the samples [first, first+4)
+void evaluate_block(int first) {
+
+    using namespace simd;
+
+    const float step = config.horizon / config.nb_steps;
+    const int size = grid->cells_per_side();
+    const float4 zero(0.0f), one(1.0f);
+    const float4 dt(step);
+    const float4 inverse_resolution(1.0f / grid->cell_size());
+    const float4 offset(-grid->origin());
+    const int4 max_index(size - 1), min_index(0);
+
+    float4 v = load(&sample_speed[first]);
+    float4 cw = load(&step_cos[first]);
+    float4 sw = load(&step_sin[first]);
+
+    // each arc starts at the robot, heading along x
+    float4 x = zero, y = zero, c = one, s = zero;
+    float4 clearance(1e6f);
+    float4 vdt = v * dt;
+
+    for (int k=0; k<config.nb_steps; k++) {
+        // heading at the middle of the step
+        float4 cm = c * cw - s * sw;
+        float4 sm = s * cw + c * sw;
+        x = x + vdt * ( c + cm ) * float4(0.5f);
+        y = y + vdt * ( s + sm ) * float4(0.5f);
+        c = cm;
+        s = sm;
+
+        int4 ix = max(min_index, min(max_index, to_int(( x + offset ) * inverse_resolution)));
+        int4 iy = max(min_index, min(max_index, to_int(( y + offset ) * inverse_resolution)));
+        clearance = min(clearance, gather(grid->data(), mullo(iy, size) + ix));
+    }
+
+    // clearance: the arc must not hit an obstacle and the robot must be able to stop before it
+    float4 margin = clearance - float4(config.robot_radius);
+    float4 braking = abs(v) * abs(v) / float4(2 * config.max_acceleration);
+    float4 admissible = ( zero < margin ) & ( braking < margin );
+    float4 clearance_score = min(margin, float4(config.max_clearance)) / float4(config.max_clearance);
+
+    // heading: cosine between the final heading and the direction of the goal from the final position
+    float4 dx = float4(goal_x) - x;
+    float4 dy = float4(goal_y) - y;
+    float4 norm = sqrt(dx * dx + dy * dy + float4(1e-6f));
+    float4 heading_score = ( ( dx * c + dy * s ) / norm + one ) * float4(0.5f);
+
+    float4 velocity_score = v / float4(config.max_speed);
+
+    float4 score = float4(config.weight_heading) * heading_score + float4(config.weight_clearance) * clearance_score + float4(config.weight_velocity) * velocity_score;
+
+    store(&sample_score[first], select(admissible, score, float4(-2.0f)));
+    store(&sample_clearance[first], margin);
+
+}
+
+};
+
+#endif
@@ -0,0 +1,346 @@
+// flight recorder: the last seconds of scans, odometry, goals and cmd_vel kept in memory and written to disk only
+// when something happens (obstacle stop, goal reached, saturation of a PID, manual request)
+// - all the storage is allocated at the construction: ring buffers sized for "duration" seconds at the given rates,
+//   the scans are stored as uint16 millimetres (see scan_codec.h), decimated to max_beams if the laser is denser
+// - the record functions only copy into the rings: no allocation, no lock, no system call
+// - a trigger is served post_trigger seconds later (to keep what follows the event), by the record function that
+//   passes this time: the rings are copied into a second preallocated set and a writer thread writes this snapshot
+//   in a log of the format of scan_log.h, with the extra records
+//     goal <stamp> <x> <y>
+//     cmd_vel <stamp> <linear> <angular>
+//     event <stamp> <reason>
+//   so that the dumps can be replayed by the benchmarks and the tools
+// - the triggers that arrive while a snapshot is pending or being written, or less than min_interval after the
+//   previous one, are counted and dropped
+// the recorder is used by one thread (the callbacks of a node), the writer thread only reads the snapshot
+
+#ifndef FOLLOW_ME_FLIGHT_RECORDER_H
+#define FOLLOW_ME_FLIGHT_RECORDER_H
+
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+#include <string>
+#include <thread>
+#include <vector>
+#include "follow_me/scan_codec.h"
+#include "follow_me/scan_log.h"
+
+struct recorder_config {
+
+    float duration;// s kept in memory
+    int max_beams;// per scan stored
+    float scan_rate, odom_rate, goal_rate, cmd_vel_rate;// hz, upper bounds: they size the rings
+    float post_trigger;// s recorded after a trigger before the snapshot
+    float min_interval;// s between two dumps
+    std::string directory;
+
+};
+
+inline recorder_config default_recorder_config() {
+
+    recorder_config c;
+    c.duration = 10;
+    c.max_beams = 2048;
+    c.scan_rate = 15;// hokuyo at 10 hz
+    c.odom_rate = 60;
+    c.goal_rate = 15;
+    c.cmd_vel_rate = 120;// cmd_vel_mux at 100 hz
+    c.post_trigger = 1;
+    c.min_interval = 5;
+    c.directory = "/tmp";
+    return c;
+
+}
+
+struct recorded_scan {
+
+    double stamp;
+    float angle_min, angle_increment, range_min, range_max;
+    int nb_beams;
+
+};
+
+struct recorded_goal {
+
+    double stamp;
+    float x, y;
+
+};
+
+struct recorded_cmd_vel {
+
+    double stamp;
+    float linear, angular;
+
+};
+
+// fixed capacity ring: the oldest element is overwritten
+template <class T>
+class record_ring {
+public:
+
+    std::vector<T> items;
+    int nb, next;
+
+void allocate(int capacity) {
+
+    items.resize(std::max(1, capacity));
+    nb = next = 0;
+
+}
+
+// slot of the new element
+T& push() {
+
+    T& item = items[next];
+    next = ( next + 1 ) % items.size();
+    if ( nb < (int)items.size() )
+        nb++;
+    return item;
+
+}
+
+// index in items of the element i, from the oldest (0)
+int index(int i) const { return ( next - nb + i + (int)items.size() ) % items.size(); }
+
+// same capacity: no allocation
+void copy_to(record_ring& other) const {
+
+    std::copy(items.begin(), items.end(), other.items.begin());
+    other.nb = nb;
+    other.next = next;
+
+}
+
+};
+
+// the content of the recorder: the rings and the ranges of the scans (max_beams per slot of the scan ring)
+struct recorder_buffers {
+
+    record_ring<recorded_scan> scans;
+    std::vector<uint16_t> ranges;
+    record_ring<log_pose> odom;
+    record_ring<recorded_goal> goals;
+    record_ring<recorded_cmd_vel> cmd_vel;
+    char reason[32];
+    double trigger_stamp;
+
+void allocate(const recorder_config& c) {
+
+    scans.allocate(ceil(c.duration * c.scan_rate));
+    ranges.resize(scans.items.size() * c.max_beams);
+    odom.allocate(ceil(c.duration * c.odom_rate));
+    goals.allocate(ceil(c.duration * c.goal_rate));
+    cmd_vel.allocate(ceil(c.duration * c.cmd_vel_rate));
+    reason[0] = 0;
+    trigger_stamp = 0;
+
+}
+
+void copy_to(recorder_buffers& other) const {
+
+    scans.copy_to(other.scans);
+    // only the slots in use
+    for (int loop=0; loop<scans.nb; loop++) {
+        int i = scans.index(loop);
+        int size = other.ranges.size() / scans.items.size();
+        std::copy(ranges.begin() + i * size, ranges.begin() + i * size + scans.items[i].nb_beams, other.ranges.begin() + i * size);
+    }
+    odom.copy_to(other.odom);
+    goals.copy_to(other.goals);
+    cmd_vel.copy_to(other.cmd_vel);
+    memcpy(other.reason, reason, sizeof(reason));
+    other.trigger_stamp = trigger_stamp;
+
+}
+
+};
+
+class flight_recorder {
+public:
+
+    recorder_config config;
+
+    long nb_triggers, nb_dropped;
+    std::atomic<long> nb_dumps, nb_failed;// written by the writer thread
+
+flight_recorder(const recorder_config& c = default_recorder_config()) : config(c) {
+
+    config.max_beams = std::max(1, config.max_beams);
+    live.allocate(config);
+    snapshot.allocate(config);
+    nb_triggers = nb_dropped = 0;
+    nb_dumps = nb_failed = 0;
+    pending = false;
+    pending_stamp = 0;
+    last_trigger = -1e9;
+    snapshot_ready = false;
+    running = true;
+    writer = std::thread(&flight_recorder::write_snapshots, this);
+
+}
+
+~flight_recorder() {
+
+    running = false;
+    writer.join();
+
+}
+
+void record_scan(double stamp, const float* ranges, int nb, float angle_min, float angle_increment, float range_min, float range_max) {
+
+    check_pending(stamp);
+    // a laser denser than max_beams is decimated
+    int step = ( nb + config.max_beams - 1 ) / config.max_beams;
+    int i = live.scans.next;
+    recorded_scan& s = live.scans.push();
+    s.stamp = stamp;
+    s.angle_min = angle_min;
+    s.angle_increment = angle_increment * std::max(step, 1);
+    s.range_min = range_min;
+    s.range_max = range_max;
+    uint16_t* q = &live.ranges[i * config.max_beams];
+    if ( step <= 1 ) {
+        s.nb_beams = nb;
+        scan_codec::quantize(ranges, nb, range_min, range_max, q);
+    }
+    else {
+        s.nb_beams = ( nb + step - 1 ) / step;
+        for (int loop=0; loop<s.nb_beams; loop++)
+            scan_codec::quantize(ranges + loop * step, 1, range_min, range_max, q + loop);
+    }
+
+}
+
+void record_odom(const log_pose& p) {
+
+    check_pending(p.stamp);
+    live.odom.push() = p;
+
+}
+
+void record_goal(double stamp, float x, float y) {
+
+    check_pending(stamp);
+    recorded_goal& g = live.goals.push();
+    g.stamp = stamp;
+    g.x = x;
+    g.y = y;
+
+}
+
+void record_cmd_vel(double stamp, float linear, float angular) {
+
+    check_pending(stamp);
+    recorded_cmd_vel& c = live.cmd_vel.push();
+    c.stamp = stamp;
+    c.linear = linear;
+    c.angular = angular;
+
+}
+
+// the rings will be written post_trigger seconds after "stamp"; false if the trigger is dropped
+bool trigger(double stamp, const char* reason) {
+
+    nb_triggers++;
+    if ( pending || snapshot_ready.load(std::memory_order_acquire) || ( stamp - last_trigger < config.min_interval ) ) {
+        nb_dropped++;
+        return false;
+    }
+    pending = true;
+    pending_stamp = stamp + config.post_trigger;
+    last_trigger = stamp;
+    live.trigger_stamp = stamp;
+    // the reason is copied without the characters that would break the log
+    int loop = 0;
+    for (; reason[loop] && ( loop < (int)sizeof(live.reason) - 1 ); loop++)
+        live.reason[loop] = isalnum(reason[loop]) ? reason[loop] : '_';
+    live.reason[loop] = 0;
+    return true;
+
+}
+
+private:
+
+    recorder_buffers live, snapshot;
+    bool pending;// a trigger waits for post_trigger
+    double pending_stamp, last_trigger;
+    std::atomic<bool> snapshot_ready;// the snapshot is owned by the writer thread
+    std::atomic<bool> running;
+    std::thread writer;
+
+void check_pending(double stamp) {
+
+    if ( !pending || ( stamp < pending_stamp ) )
+        return;
+    live.copy_to(snapshot);
+    pending = false;
+    snapshot_ready.store(true, std::memory_order_release);
+
+}
+
+// writer thread: polls the snapshot, the recording thread never waits for it nor wakes it up
+void write_snapshots() {
+
+    while ( running || snapshot_ready.load(std::memory_order_acquire) ) {
+        if ( !snapshot_ready.load(std::memory_order_acquire) ) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(50));
+            continue;
+        }
+        write(snapshot);
+        snapshot_ready.store(false, std::memory_order_release);
+    }
+
+}
+
+void write(const recorder_buffers& b) {
+
+    char name[256];
+    time_t now = time(0);
+    struct tm local;
+    localtime_r(&now, &local);
+    char date[32];
+    strftime(date, sizeof(date), "%Y%m%d-%H%M%S", &local);
+    snprintf(name, sizeof(name), "%s/flight_%s_%s.log", config.directory.c_str(), date, b.reason);
+    FILE* f = fopen(name, "w");
+    if ( !f ) {
+        nb_failed++;
+        return;
+    }
+
+    fprintf(f, "# follow_me flight recorder: %s at %.6f\n", b.reason, b.trigger_stamp);
+    fprintf(f, "event %.6f %s\n", b.trigger_stamp, b.reason);
+    for (int loop=0; loop<b.odom.nb; loop++)
+        scan_log::write_odom(f, b.odom.items[b.odom.index(loop)]);
+    for (int loop=0; loop<b.goals.nb; loop++) {
+        const recorded_goal& g = b.goals.items[b.goals.index(loop)];
+        fprintf(f, "goal %.6f %f %f\n", g.stamp, g.x, g.y);
+    }
+    for (int loop=0; loop<b.cmd_vel.nb; loop++) {
+        const recorded_cmd_vel& c = b.cmd_vel.items[b.cmd_vel.index(loop)];
+        fprintf(f, "cmd_vel %.6f %f %f\n", c.stamp, c.linear, c.angular);
+    }
+    for (int loop=0; loop<b.scans.nb; loop++) {
+        int i = b.scans.index(loop);
+        const recorded_scan& s = b.scans.items[i];
+        const uint16_t* q = &b.ranges[i * config.max_beams];
+        fprintf(f, "scan %.6f %f %f %f %f %i", s.stamp, s.angle_min, s.angle_increment, s.range_min, s.range_max, s.nb_beams);
+        // the invalid ranges are written as range_max, as the detector reads them
+        for (int beam=0; beam<s.nb_beams; beam++)
+            fprintf(f, " %.3f", q[beam] ? q[beam] * 0.001f : s.range_max);
+        fprintf(f, "\n");
+    }
+    fclose(f);
+    nb_dumps++;
+
+}
+
+};
+
+#endif
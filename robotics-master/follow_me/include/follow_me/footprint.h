@@ -0,0 +1,269 @@
+// collision of the footprint of the robot (a polygon) swept by a rotation on itself or by a translation along x,
+// checked against the scan
+// - the tables are computed once from the polygon: for each angular sector around the centre of rotation, the
+//   largest distance reached by the footprint swept by rotations of [0, k * rotation_step] and by translations of
+//   [0, k * translation_step] (forward and backward)
+// - each scan is reduced to the closest hit of each sector, in the frame of the robot; the hits inside the polygon
+//   (the robot itself, dust on the laser) are ignored
+// - a motion collides if the closest hit of a sector is below the table of this motion in this sector: a query is a
+//   vectorized comparison of nb_sectors ranges (see simd.h), the free motion is a binary search on the tables
+// the check is conservative: the polygon is sampled every sample_spacing, the margin is added radially and a
+// motion is rounded up to the next table; the motions are checked up to max_rotation and max_translation
+
+#ifndef FOLLOW_ME_FOOTPRINT_H
+#define FOLLOW_ME_FOOTPRINT_H
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+#include "follow_me/simd.h"
+
+#define sample_spacing 0.01// m, sampling of the polygon when the tables are computed
+
+struct footprint_config {
+
+    std::vector<float> polygon;// x0, y0, x1, y1, ... in the frame of the robot, around the centre of rotation
+    float laser_x, laser_y, laser_yaw;// pose of the laser in the frame of the robot
+    float margin;// m
+    int nb_sectors;// angular resolution of the tables, multiple of 4
+    int rotation_step;// sectors between two rotation tables
+    float max_rotation;// rad
+    float translation_step, max_translation;// m
+
+};
+
+inline footprint_config default_footprint_config() {
+
+    // robair: a square of 0.5 m centred on the wheels, the laser on the axis of rotation
+    static const float robair[] = { 0.25, 0.25, -0.25, 0.25, -0.25, -0.25, 0.25, -0.25 };
+    footprint_config c;
+    c.polygon.assign(robair, robair + 8);
+    c.laser_x = c.laser_y = c.laser_yaw = 0;
+    c.margin = 0.05;
+    c.nb_sectors = 360;
+    c.rotation_step = 2;
+    c.max_rotation = M_PI;
+    c.translation_step = 0.05;
+    c.max_translation = 2.0;
+    return c;
+
+}
+
+class footprint_clearance {
+public:
+
+    footprint_config config;
+    int nb_rotations, nb_translations;// tables per direction, the table 0 is the footprint at rest
+    int nb_hits, nb_self_hits;// of the last scan
+
+footprint_clearance(const footprint_config& c = default_footprint_config()) : config(c) {
+
+    config.nb_sectors = std::max(4, ( config.nb_sectors + 3 ) & ~3);
+    config.rotation_step = std::max(1, config.rotation_step);
+    sector_width = 2 * M_PI / config.nb_sectors;
+    nb_rotations = (int)ceil(config.max_rotation / ( config.rotation_step * sector_width ));
+    nb_translations = (int)ceil(config.max_translation / config.translation_step);
+    nb_hits = nb_self_hits = 0;
+
+    int n = config.nb_sectors;
+    rest.assign(n, 0);
+    body.assign(n, INFINITY);
+    for (int edge=0; edge<nb_vertices(); edge++) {
+        add_segment(rest, vertex_x(edge), vertex_y(edge), vertex_x(edge + 1), vertex_y(edge + 1));
+        add_segment(body, vertex_x(edge), vertex_y(edge), vertex_x(edge + 1), vertex_y(edge + 1), true);
+    }
+
+    // rotation by k sectors in the direction d: the footprint of the sector b - d * k reaches the sector b
+    for (int direction=0; direction<2; direction++) {
+        std::vector<float>& tables = rotations[direction];
+        tables.resize(( nb_rotations + 1 ) * n);
+        std::copy(rest.begin(), rest.end(), tables.begin());
+        for (int k=1; k<=nb_rotations; k++) {
+            float* table = &tables[k * n];
+            std::copy(table - n, table, table);
+            for (int shift=( k - 1 ) * config.rotation_step + 1; shift<=k*config.rotation_step; shift++)
+                for (int b=0; b<n; b++)
+                    table[b] = std::max(table[b], rest[( b + ( direction ? shift : n - shift % n ) ) % n]);
+        }
+    }
+
+    // translation from (k - 1) * step to k * step: the polygon at the end and the paths of its vertices
+    for (int direction=0; direction<2; direction++) {
+        std::vector<float>& tables = translations[direction];
+        tables.resize(( nb_translations + 1 ) * n);
+        std::copy(rest.begin(), rest.end(), tables.begin());
+        float sign = direction ? -1 : 1;
+        for (int k=1; k<=nb_translations; k++) {
+            std::vector<float> table(tables.begin() + ( k - 1 ) * n, tables.begin() + k * n);
+            float from = sign * ( k - 1 ) * config.translation_step, to = sign * k * config.translation_step;
+            for (int edge=0; edge<nb_vertices(); edge++) {
+                add_segment(table, vertex_x(edge) + to, vertex_y(edge), vertex_x(edge + 1) + to, vertex_y(edge + 1));
+                add_segment(table, vertex_x(edge) + from, vertex_y(edge), vertex_x(edge) + to, vertex_y(edge));
+            }
+            std::copy(table.begin(), table.end(), tables.begin() + k * n);
+        }
+    }
+    closest.assign(n, INFINITY);
+    scan_nb_beams = -1;
+
+}
+
+// the closest hit of each sector; the angles of the beams are computed only when the laser changes
+void set_scan(const float* ranges, int nb_beams, float angle_min, float angle_increment, float range_min, float range_max) {
+
+    if ( ( scan_nb_beams != nb_beams ) || ( scan_angle_min != angle_min ) || ( scan_angle_increment != angle_increment ) ) {
+        scan_nb_beams = nb_beams;
+        scan_angle_min = angle_min;
+        scan_angle_increment = angle_increment;
+        beam_cos.resize(( nb_beams + 3 ) & ~3);
+        beam_sin.resize(beam_cos.size());
+        for (int loop=0; loop<(int)beam_cos.size(); loop++) {
+            beam_cos[loop] = cos(config.laser_yaw + angle_min + loop * angle_increment);
+            beam_sin[loop] = sin(config.laser_yaw + angle_min + loop * angle_increment);
+        }
+        padded_ranges.resize(beam_cos.size());
+        sector.resize(beam_cos.size());
+        distance.resize(beam_cos.size());
+    }
+
+    // polar coordinates around the centre of rotation, 4 beams at a time; the invalid ranges are pushed to infinity
+    using namespace simd;
+    std::copy(ranges, ranges + nb_beams, padded_ranges.begin());
+    std::fill(padded_ranges.begin() + nb_beams, padded_ranges.end(), 0.0f);
+    const float4 lx(config.laser_x), ly(config.laser_y), r_min(range_min), r_max(range_max), infinity(INFINITY);
+    const float4 to_sector(1 / sector_width), pi(M_PI);
+    const int4 last(config.nb_sectors - 1), zero(0);
+    for (int loop=0; loop<(int)padded_ranges.size(); loop+=4) {
+        float4 r = load(&padded_ranges[loop]);
+        float4 x = lx + r * load(&beam_cos[loop]);
+        float4 y = ly + r * load(&beam_sin[loop]);
+        float4 valid = ( r_min < r ) & ( r < r_max );
+        store(&distance[loop], select(valid, sqrt(x * x + y * y), infinity));
+        int4 s = to_int(( fast_atan2(y, x) + pi ) * to_sector);
+        store(&sector[loop], max(zero, min(last, s)));
+    }
+
+    std::fill(closest.begin(), closest.end(), INFINITY);
+    nb_hits = nb_self_hits = 0;
+    for (int loop=0; loop<nb_beams; loop++) {
+        float d = distance[loop];
+        if ( d == INFINITY )
+            continue;
+        int s = sector[loop];
+        if ( d < body[s] )
+            nb_self_hits++;
+        else {
+            closest[s] = std::min(closest[s], d);
+            nb_hits++;
+        }
+    }
+
+}
+
+// the rotation from the current orientation of the robot to "angle" (rad, counterclockwise if positive)
+bool rotation_collides(float angle) const {
+
+    int k = (int)ceil(fabs(angle) / ( config.rotation_step * sector_width ));
+    return collides(&rotations[angle < 0][std::min(k, nb_rotations) * config.nb_sectors]);
+
+}
+
+// the translation from the current position of the robot to "distance" along x (m, backward if negative)
+bool translation_collides(float distance) const {
+
+    int k = (int)ceil(fabs(distance) / config.translation_step);
+    return collides(&translations[distance < 0][std::min(k, nb_translations) * config.nb_sectors]);
+
+}
+
+// largest rotation (rad, >= 0) without collision in the direction (1: counterclockwise, -1: clockwise)
+float free_rotation(int direction) const {
+
+    return free_motion(rotations[direction < 0], nb_rotations) * config.rotation_step * sector_width;
+
+}
+
+// largest translation (m, >= 0) without collision in the direction (1: forward, -1: backward)
+float free_translation(int direction) const {
+
+    return free_motion(translations[direction < 0], nb_translations) * config.translation_step;
+
+}
+
+// closest hit of each sector (+inf for none), sector 0 at -pi
+const std::vector<float>& closest_hits() const { return closest; }
+
+private:
+
+    float sector_width;
+    std::vector<float> rest;// extent of the footprint at rest in each sector
+    std::vector<float> body;// closest point of the polygon in each sector, without the margin
+    std::vector<float> rotations[2], translations[2];// counterclockwise/forward, clockwise/backward
+    std::vector<float> closest;
+
+    // current laser
+    std::vector<float> beam_cos, beam_sin;
+    int scan_nb_beams;
+    float scan_angle_min, scan_angle_increment;
+    std::vector<float> padded_ranges, distance;
+    std::vector<int> sector;
+
+int nb_vertices() const { return config.polygon.size() / 2; }
+float vertex_x(int i) const { return config.polygon[2 * ( i % nb_vertices() )]; }
+float vertex_y(int i) const { return config.polygon[2 * ( i % nb_vertices() ) + 1]; }
+
+// the segment is sampled: each sample extends the sectors that its neighbourhood of sample_spacing / 2 can reach
+// (inner: the table keeps the closest point of the segment, without the margin)
+void add_segment(std::vector<float>& table, float x0, float y0, float x1, float y1, bool inner = false) const {
+
+    int nb = std::max(1, (int)ceil(hypot(x1 - x0, y1 - y0) / sample_spacing));
+    const int n = config.nb_sectors;
+    for (int loop=0; loop<=nb; loop++) {
+        float x = x0 + ( x1 - x0 ) * loop / nb, y = y0 + ( y1 - y0 ) * loop / nb;
+        float r = hypot(x, y);
+        float extent = inner ? r - sample_spacing / 2 : r + sample_spacing / 2 + config.margin;
+        if ( r < sample_spacing ) {
+            // around the centre of rotation: every sector
+            for (int b=0; b<n; b++)
+                table[b] = inner ? std::min(table[b], extent) : std::max(table[b], extent);
+            continue;
+        }
+        float a = atan2(y, x) + M_PI;
+        float da = asin(sample_spacing / ( 2 * r ));// r >= sample_spacing
+        int first = (int)floor(( a - da ) / sector_width), last = (int)floor(( a + da ) / sector_width);
+        for (int b=first; b<=last; b++) {
+            int s = ( b % n + n ) % n;
+            table[s] = inner ? std::min(table[s], extent) : std::max(table[s], extent);
+        }
+    }
+
+}
+
+bool collides(const float* table) const {
+
+    using namespace simd;
+    float4 hit(0.0f);
+    for (int b=0; b<config.nb_sectors; b+=4)
+        hit = hit | ( load(&closest[b]) < load(&table[b]) );
+    return movemask(hit) != 0;
+
+}
+
+// the tables grow with k: the first table in collision is found by dichotomy
+int free_motion(const std::vector<float>& tables, int nb_tables) const {
+
+    int free = 0, blocked = nb_tables + 1;
+    while ( blocked - free > 1 ) {
+        int k = ( free + blocked ) / 2;
+        if ( collides(&tables[k * config.nb_sectors]) )
+            blocked = k;
+        else
+            free = k;
+    }
+    return free;
+
+}
+
+};
+
+#endif
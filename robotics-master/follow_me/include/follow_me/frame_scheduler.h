@@ -0,0 +1,163 @@
+// scheduling of the frames of a node that processes scans with a deadline
+// - a frame is the processing of the newest scan received; the scans that arrive while the node is busy replace
+//   the pending one and are counted as dropped, as the scans lost before reaching the node (gap between two stamps
+//   larger than the period of the laser)
+// - each frame is tagged with the age of its scan (time of the processing - stamp of the scan); a frame is
+//   . skipped if its scan is older than stale_age
+//   . degraded (no visualization, no tracing) if its scan is older than degrade_age or if the previous frame
+//     has overrun its deadline
+//   . processed normally otherwise
+// - an overrun is a frame whose processing time (wall time, whatever the clock of the stamps) is longer than the deadline
+// the ages of the last window_size frames give the percentiles
+
+#ifndef FOLLOW_ME_FRAME_SCHEDULER_H
+#define FOLLOW_ME_FRAME_SCHEDULER_H
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <vector>
+
+enum frame_decision { frame_full, frame_degraded, frame_skipped };
+
+struct scheduler_config {
+
+    double deadline;// s, processing time allowed for a frame
+    double degrade_age;// s
+    double stale_age;// s
+    int window_size;// frames used for the percentiles of the age
+
+};
+
+// "input_wait" is the longest time a scan may wait for the other inputs of the node before it can be processed (see
+// input_sync.h): a scan that arrives just after a wakeup of the node and waits for them is processed at the wakeup that
+// follows the wait, period + input_wait after its stamp, without the node being late
+inline scheduler_config default_scheduler_config(double period, double input_wait = 0) {
+
+    scheduler_config c;
+    c.deadline = period;
+    c.degrade_age = period + input_wait;
+    c.stale_age = 3 * period + input_wait;
+    c.window_size = 512;
+    return c;
+
+}
+
+class frame_scheduler {
+public:
+
+    scheduler_config config;
+
+    // counters
+    long nb_received;// scans received
+    long nb_dropped;// scans never processed: replaced by a newer one or lost before reaching the node
+    long nb_frames;// frames processed, normally or degraded
+    long nb_degraded;
+    long nb_skipped;// frames not processed, their scan was too old
+    long nb_overruns;
+    double last_age, last_processing_time;// s
+    double max_processing_time;// s
+
+frame_scheduler(const scheduler_config& c = default_scheduler_config(0.1)) {
+
+    config = c;
+    nb_received = nb_dropped = nb_frames = nb_degraded = nb_skipped = nb_overruns = 0;
+    last_age = last_processing_time = max_processing_time = 0;
+    pending = false;
+    previous_stamp = -1;
+    overrun = false;
+    ages.assign(std::max(1, config.window_size), 0);
+    sorted.assign(ages.size(), 0);
+    nb_ages = 0;
+
+}
+
+// a new scan is available; scan_period is the time between two scans of the laser (0 if unknown)
+void scan_received(double stamp, double scan_period) {
+
+    nb_received++;
+    if ( pending )
+        nb_dropped++;
+    if ( ( previous_stamp >= 0 ) && ( scan_period > 0 ) ) {
+        long lost = lround(( stamp - previous_stamp ) / scan_period) - 1;
+        if ( lost > 0 )
+            nb_dropped += lost;
+    }
+    previous_stamp = stamp;
+    pending = true;
+
+}
+
+bool has_pending_scan() const { return pending; }
+
+// the newest scan, stamped at stamp, is taken at time now (clock of the stamps)
+frame_decision begin_frame(double now, double stamp) {
+
+    pending = false;
+    last_age = now - stamp;
+    ages[nb_ages % ages.size()] = last_age;
+    nb_ages++;
+
+    if ( last_age > config.stale_age ) {
+        nb_skipped++;
+        return frame_skipped;
+    }
+
+    frame_start = std::chrono::steady_clock::now();
+    nb_frames++;
+    if ( overrun || ( last_age > config.degrade_age ) ) {
+        nb_degraded++;
+        return frame_degraded;
+    }
+    return frame_full;
+
+}
+
+// the frame started by begin_frame() is finished
+void end_frame() {
+
+    last_processing_time = std::chrono::duration<double>(std::chrono::steady_clock::now() - frame_start).count();
+    max_processing_time = std::max(max_processing_time, last_processing_time);
+    overrun = last_processing_time > config.deadline;
+    if ( overrun )
+        nb_overruns++;
+
+}
+
+// percentile (in [0, 100]) of the age of the scans of the last frames
+double age_percentile(double percentile) {
+
+    const int nb = std::min<long>(nb_ages, ages.size());
+    if ( !nb )
+        return 0;
+    std::copy(ages.begin(), ages.begin() + nb, sorted.begin());
+    int rank = std::min(nb - 1, std::max(0, (int)ceil(percentile / 100 * nb) - 1));
+    std::nth_element(sorted.begin(), sorted.begin() + rank, sorted.begin() + nb);
+    return sorted[rank];
+
+}
+
+// one line summary of the counters
+void summary(char* text, int size) {
+
+    snprintf(text, size, "%ld scans received, %ld dropped, %ld frames (%ld degraded), %ld skipped, %ld overruns, processing max %.1f ms, age p50 %.1f ms p90 %.1f ms p99 %.1f ms",
+             nb_received, nb_dropped, nb_frames, nb_degraded, nb_skipped, nb_overruns, max_processing_time * 1000, age_percentile(50) * 1000,
+             age_percentile(90) * 1000, age_percentile(99) * 1000);
+
+}
+
+private:
+
+    bool pending;// a scan has been received and not processed yet
+    double previous_stamp;
+    std::chrono::steady_clock::time_point frame_start;
+    bool overrun;// the previous frame has overrun its deadline
+
+    // ages of the last frames (circular buffer) and storage for the percentiles
+    std::vector<double> ages, sorted;
+    long nb_ages;
+
+};
+
+#endif
@@ -0,0 +1,226 @@
+// geometry of the plane shared by the nodes of follow_me
+// - normalize_angle(): angle in [-M_PI, M_PI], constexpr (usable in the tables computed at compile time); the angles
+//   of the nodes are usually at most a few turns away, so a loop is cheaper than remainder(); beyond
+//   normalize_angle_turns turns, the whole turns are removed at once (in double, remainder() is not constexpr) so
+//   that a wrong angle (a bad yaw of the odometry) costs a bounded time
+// - squared_distance(), point_distance(): between two points of any type with members x and y (geometry_msgs::Point,
+//   detector_point, ...), taken by reference and computed in float
+// - frame_transform: pose of a child frame in its parent frame (laser in base, base in odom) with its cos and sin
+//   computed once; to_parent() and to_child() move a point between the two frames, compose() chains the frames
+// - batch versions on point sets stored as structure of arrays (x[], y[]): squared distances to a point, closest
+//   point, change of frame, 4 points at a time (see simd.h). The 4 points of an iteration are loaded before the
+//   results are stored, which a loop over the points cannot do when the output may alias the input: gcc -O2 does not
+//   vectorize such a loop, and vectorizes it at -O3 only, where closest_point() still keeps its 4 independent
+//   minimums. With FOLLOW_ME_NO_SIMD, the batch versions are as fast only if the compiler vectorizes the loops over
+//   the 4 lanes of simd.h (see geometry_benchmark.cpp)
+
+#ifndef FOLLOW_ME_GEOMETRY_H
+#define FOLLOW_ME_GEOMETRY_H
+
+#include <cmath>
+#include "follow_me/simd.h"
+
+#define normalize_angle_turns 4// beyond this number of turns, removing the whole turns at once is cheaper than the loop
+#define normalize_angle_max_turns 4.0e18// below 2^62 turns, the whole turns fit in a long long
+
+// an infinite or nan angle is returned unchanged
+template <class T>
+constexpr T normalize_angle(T a) {
+
+    // inf - inf and nan - nan are nan (std::isfinite is not constexpr)
+    if ( !( a - a == 0 ) )
+        return a;
+    if ( ( a > T(normalize_angle_turns * 2 * M_PI) ) || ( a < T(-normalize_angle_turns * 2 * M_PI) ) ) {
+        // a fraction of a turn is not meaningful beyond normalize_angle_max_turns turns: 0
+        const double turns = a / ( 2 * M_PI );
+        if ( ( turns > normalize_angle_max_turns ) || ( turns < -normalize_angle_max_turns ) )
+            return T(0);
+        a = T(a - (double)(long long)turns * ( 2 * M_PI ));
+    }
+    while ( a > T(M_PI) )
+        a -= T(2 * M_PI);
+    while ( a < T(-M_PI) )
+        a += T(2 * M_PI);
+    return a;
+
+}
+
+static_assert(( normalize_angle(100.0) > -M_PI ) && ( normalize_angle(100.0) < M_PI ), "normalize_angle() is evaluated at compile time");
+
+// a - b in [-M_PI, M_PI]
+template <class T>
+constexpr T angle_difference(T a, T b) { return normalize_angle(a - b); }
+
+template <class P, class Q>
+inline float squared_distance(const P& a, const Q& b) {
+
+    float dx = a.x - b.x, dy = a.y - b.y;
+    return dx * dx + dy * dy;
+
+}
+
+template <class P, class Q>
+inline float point_distance(const P& a, const Q& b) { return sqrt(squared_distance(a, b)); }
+
+struct frame_transform {
+
+    float x, y;// origin of the child frame in the parent frame
+    float theta;// orientation of the child frame in the parent frame
+    float c, s;// cos and sin of theta
+
+};
+
+inline frame_transform make_frame_transform(float x, float y, float theta) {
+
+    frame_transform t;
+    t.x = x;
+    t.y = y;
+    t.theta = normalize_angle(theta);
+    t.c = cos(theta);
+    t.s = sin(theta);
+    return t;
+
+}
+
+// the point "p" of the child frame in the parent frame (the other members of p are kept)
+template <class P>
+inline P to_parent(const frame_transform& t, P p) {
+
+    float x = p.x, y = p.y;
+    p.x = t.x + t.c * x - t.s * y;
+    p.y = t.y + t.s * x + t.c * y;
+    return p;
+
+}
+
+// the point "p" of the parent frame in the child frame
+template <class P>
+inline P to_child(const frame_transform& t, P p) {
+
+    float x = p.x - t.x, y = p.y - t.y;
+    p.x = t.c * x + t.s * y;
+    p.y = t.c * y - t.s * x;
+    return p;
+
+}
+
+// the child frame of "child" in the parent frame of "parent" (for instance laser in base, then base in odom)
+inline frame_transform compose(const frame_transform& parent, const frame_transform& child) {
+
+    frame_transform t;
+    t.x = parent.x + parent.c * child.x - parent.s * child.y;
+    t.y = parent.y + parent.s * child.x + parent.c * child.y;
+    t.theta = normalize_angle(parent.theta + child.theta);
+    t.c = parent.c * child.c - parent.s * child.s;
+    t.s = parent.s * child.c + parent.c * child.s;
+    return t;
+
+}
+
+// the parent frame in the child frame
+inline frame_transform inverse(const frame_transform& t) {
+
+    frame_transform i;
+    i.x = -t.c * t.x - t.s * t.y;
+    i.y = t.s * t.x - t.c * t.y;
+    i.theta = -t.theta;
+    i.c = t.c;
+    i.s = -t.s;
+    return i;
+
+}
+
+// squared distances of the points to (px, py)
+inline void squared_distances(const float* x, const float* y, int nb, float px, float py, float* d2) {
+
+    using namespace simd;
+    const float4 vx(px), vy(py);
+    int loop = 0;
+    for (; loop+4<=nb; loop+=4) {
+        float4 dx = load(&x[loop]) - vx, dy = load(&y[loop]) - vy;
+        store(&d2[loop], dx * dx + dy * dy);
+    }
+    for (; loop<nb; loop++)
+        d2[loop] = ( x[loop] - px ) * ( x[loop] - px ) + ( y[loop] - py ) * ( y[loop] - py );
+
+}
+
+// index of the point closest to (px, py), the first one if several are at the same distance; -1 without point
+inline int closest_point(const float* x, const float* y, int nb, float px, float py, float& d2) {
+
+    using namespace simd;
+    int best = -1;
+    d2 = INFINITY;
+    int loop = 0;
+    if ( nb >= 4 ) {
+        // each lane keeps its closest point, the index in float (exact below 2^24 points)
+        const float4 vx(px), vy(py), step(4.0f);
+        float4 best_d2(INFINITY), best_index(-1.0f);
+        const float first[4] = { 0, 1, 2, 3 };
+        float4 index = load(first);
+        for (; loop+4<=nb; loop+=4, index=index+step) {
+            float4 dx = load(&x[loop]) - vx, dy = load(&y[loop]) - vy;
+            float4 d = dx * dx + dy * dy;
+            float4 closer = d < best_d2;
+            best_d2 = select(closer, d, best_d2);
+            best_index = select(closer, index, best_index);
+        }
+        float lane_d2[4], lane_index[4];
+        store(lane_d2, best_d2);
+        store(lane_index, best_index);
+        for (int lane=0; lane<4; lane++)
+            if ( ( lane_index[lane] >= 0 ) && ( ( lane_d2[lane] < d2 ) || ( ( lane_d2[lane] == d2 ) && ( lane_index[lane] < best ) ) ) ) {
+                d2 = lane_d2[lane];
+                best = (int)lane_index[lane];
+            }
+    }
+    for (; loop<nb; loop++) {
+        float d = ( x[loop] - px ) * ( x[loop] - px ) + ( y[loop] - py ) * ( y[loop] - py );
+        if ( d < d2 ) {
+            d2 = d;
+            best = loop;
+        }
+    }
+    return best;
+
+}
+
+// the points of the child frame in the parent frame; "out_x" and "out_y" can be "x" and "y"
+inline void to_parent(const frame_transform& t, const float* x, const float* y, int nb, float* out_x, float* out_y) {
+
+    using namespace simd;
+    const float4 tx(t.x), ty(t.y), c(t.c), s(t.s);
+    int loop = 0;
+    for (; loop+4<=nb; loop+=4) {
+        float4 px = load(&x[loop]), py = load(&y[loop]);
+        store(&out_x[loop], tx + c * px - s * py);
+        store(&out_y[loop], ty + s * px + c * py);
+    }
+    for (; loop<nb; loop++) {
+        float px = x[loop], py = y[loop];
+        out_x[loop] = t.x + t.c * px - t.s * py;
+        out_y[loop] = t.y + t.s * px + t.c * py;
+    }
+
+}
+
+// the points of the parent frame in the child frame
+inline void to_child(const frame_transform& t, const float* x, const float* y, int nb, float* out_x, float* out_y) {
+
+    using namespace simd;
+    const float4 tx(t.x), ty(t.y), c(t.c), s(t.s);
+    int loop = 0;
+    for (; loop+4<=nb; loop+=4) {
+        float4 px = load(&x[loop]) - tx, py = load(&y[loop]) - ty;
+        store(&out_x[loop], c * px + s * py);
+        store(&out_y[loop], c * py - s * px);
+    }
+    for (; loop<nb; loop++) {
+        float px = x[loop] - t.x, py = y[loop] - t.y;
+        out_x[loop] = t.c * px + t.s * py;
+        out_y[loop] = t.c * py - t.s * px;
+    }
+
+}
+
+#endif
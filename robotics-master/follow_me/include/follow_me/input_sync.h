@@ -0,0 +1,153 @@
+// synchronization of the inputs of a node with the stamps of its scans
+// the odometry and the transitions of the motion state are stored in small timestamped ring buffers, so that each
+// scan is processed with the state of the robot at its header.stamp instead of the state received last:
+// - pose_at() interpolates the odometry at the stamp of the scan (extrapolates with the speeds a little after the last sample)
+// - moving_at() gives the motion state at the stamp: the last transition whose "since" is before the stamp
+// - ready() tells if the state at the stamp is known: odometry has been received after the stamp, or the scan
+//   has waited more than max_wait
+
+#ifndef FOLLOW_ME_INPUT_SYNC_H
+#define FOLLOW_ME_INPUT_SYNC_H
+
+#include <cmath>
+#include "follow_me/scan_log.h"
+
+// the last N samples, sorted by stamp: a sample older than the newest one is ignored
+template <class T, int N>
+class stamped_ring {
+public:
+
+stamped_ring() { clear(); }
+
+void clear() {
+
+    nb = 0;
+    next = 0;
+
+}
+
+bool push(double stamp, const T& value) {
+
+    if ( nb && ( stamp < newest_stamp() ) )
+        return false;
+    stamps[next] = stamp;
+    values[next] = value;
+    next = ( next + 1 ) % N;
+    if ( nb < N )
+        nb++;
+    return true;
+
+}
+
+int size() const { return nb; }
+bool empty() const { return !nb; }
+
+// sample i, from the oldest (0) to the newest (size() - 1)
+double stamp(int i) const { return stamps[index(i)]; }
+const T& value(int i) const { return values[index(i)]; }
+
+double newest_stamp() const { return stamp(nb - 1); }
+double oldest_stamp() const { return stamp(0); }
+
+// the newest sample stamped at or before "s", -1 if none
+int find(double s) const {
+
+    for (int i=nb-1; i>=0; i--)
+        if ( stamp(i) <= s )
+            return i;
+    return -1;
+
+}
+
+private:
+
+    double stamps[N];
+    T values[N];
+    int nb, next;
+
+int index(int i) const { return ( next - nb + i + N ) % N; }
+
+};
+
+class input_sync {
+public:
+
+    double max_wait;// s, a scan is processed with the latest state if the state at its stamp is still unknown after max_wait
+    double max_extrapolation;// s, after the last odometry sample
+
+input_sync() {
+
+    max_wait = 0.1;
+    max_extrapolation = 0.1;
+
+}
+
+void add_odom(const log_pose& pose) { odom.push(pose.stamp, pose); }
+
+// a transition of the motion state, the new state holds from "since"
+void add_motion(double since, bool moving) { motion.push(since, moving); }
+
+bool has_odom() const { return !odom.empty(); }
+
+// the state of the robot at "stamp" is known, or the scan has waited enough: at "now", the scan can be processed
+bool ready(double stamp, double now) const {
+
+    if ( has_odom() && ( odom.newest_stamp() >= stamp ) )
+        return true;
+    return now - stamp > max_wait;
+
+}
+
+// pose of the robot at "stamp", false if it cannot be computed from the samples stored
+bool pose_at(double stamp, log_pose& result) const {
+
+    if ( odom.empty() || ( stamp < odom.oldest_stamp() ) )
+        return false;
+
+    int low = odom.find(stamp);
+    if ( low == odom.size() - 1 ) {
+        // after the last sample: extrapolation with its speeds
+        const log_pose& a = odom.value(low);
+        double dt = stamp - a.stamp;
+        if ( dt > max_extrapolation )
+            return false;
+        result = a;
+        result.stamp = stamp;
+        result.x = a.x + a.linear_speed * cos(a.yaw) * dt;
+        result.y = a.y + a.linear_speed * sin(a.yaw) * dt;
+        result.yaw = a.yaw + a.angular_speed * dt;
+        return true;
+    }
+
+    const log_pose& a = odom.value(low);
+    const log_pose& b = odom.value(low + 1);
+    float t = ( b.stamp > a.stamp ) ? ( stamp - a.stamp ) / ( b.stamp - a.stamp ) : 0;
+    float dyaw = angle_difference(b.yaw, a.yaw);
+
+    result = a;
+    result.stamp = stamp;
+    result.x = a.x + t * ( b.x - a.x );
+    result.y = a.y + t * ( b.y - a.y );
+    result.yaw = a.yaw + t * dyaw;
+    result.linear_speed = a.linear_speed + t * ( b.linear_speed - a.linear_speed );
+    result.angular_speed = a.angular_speed + t * ( b.angular_speed - a.angular_speed );
+    return true;
+
+}
+
+// motion state at "stamp": before the first transition received, the robot is considered as moving
+bool moving_at(double stamp) const {
+
+    int i = motion.find(stamp);
+    return ( i < 0 ) || motion.value(i);
+
+}
+
+private:
+
+    stamped_ring<log_pose, 128> odom;
+    stamped_ring<bool, 16> motion;
+
+};
+
+#endif
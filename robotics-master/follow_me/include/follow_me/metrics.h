@@ -0,0 +1,342 @@
+// metrics of the nodes (counters, gauges, histograms) exposed in the text format of prometheus
+// - the metrics are updated from the hot paths with relaxed atomics: no lock, no allocation, no system call
+// - they are created at the start of the node in a registry of fixed capacity, that owns them; several metrics can
+//   share a name with different labels (e.g. the transitions of decision_node to each state)
+// - metrics_server serves the registry on a unix socket and/or a localhost tcp port from its own thread, blocked in
+//   accept() while nobody scrapes: the text is built only when a scrape arrives (any request on the socket, e.g.
+//   curl --unix-socket /tmp/follow_me_decision.metrics http://localhost/metrics)
+// - the rates (scans, cmd_vel) are given by the counters: rate(follow_me_cmd_vel_total[10s]) in prometheus
+// the values read by a scrape are each consistent, not the set of values (a histogram may be one update ahead of its sum)
+
+#ifndef FOLLOW_ME_METRICS_H
+#define FOLLOW_ME_METRICS_H
+
+#include <arpa/inet.h>
+#include <atomic>
+#include <cstdio>
+#include <cstring>
+#include <netinet/in.h>
+#include <stdint.h>
+#include <string>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <sys/un.h>
+#include <thread>
+#include <unistd.h>
+
+#define max_metrics 64
+#define max_histograms 8
+#define max_buckets 12
+
+class metric_counter {
+public:
+
+metric_counter() : value(0) {}
+
+void add(uint64_t n = 1) { value.fetch_add(n, std::memory_order_relaxed); }
+uint64_t get() const { return value.load(std::memory_order_relaxed); }
+
+private:
+
+    std::atomic<uint64_t> value;
+
+};
+
+class metric_gauge {
+public:
+
+metric_gauge() : value(0) {}
+
+void set(double v) { value.store(v, std::memory_order_relaxed); }
+double get() const { return value.load(std::memory_order_relaxed); }
+
+private:
+
+    std::atomic<double> value;
+
+};
+
+// cumulative histogram: the bounds are given at the creation, in increasing order
+class metric_histogram {
+public:
+
+    int nb_bounds;
+    double bounds[max_buckets];
+
+metric_histogram() : sum(0), count(0) {
+
+    nb_bounds = 0;
+    for (int loop=0; loop<=max_buckets; loop++)
+        buckets[loop].store(0, std::memory_order_relaxed);
+
+}
+
+void observe(double v) {
+
+    int b = 0;
+    while ( ( b < nb_bounds ) && ( v > bounds[b] ) )
+        b++;
+    buckets[b].fetch_add(1, std::memory_order_relaxed);
+    count.fetch_add(1, std::memory_order_relaxed);
+    // one writer per metric in the nodes: the loop does not spin
+    double s = sum.load(std::memory_order_relaxed);
+    while ( !sum.compare_exchange_weak(s, s + v, std::memory_order_relaxed) );
+
+}
+
+uint64_t bucket(int b) const { return buckets[b].load(std::memory_order_relaxed); }// b = nb_bounds: above the last bound
+uint64_t get_count() const { return count.load(std::memory_order_relaxed); }
+double get_sum() const { return sum.load(std::memory_order_relaxed); }
+
+private:
+
+    std::atomic<uint64_t> buckets[max_buckets + 1];
+    std::atomic<double> sum;
+    std::atomic<uint64_t> count;
+
+};
+
+enum metric_type { metric_type_counter, metric_type_gauge, metric_type_histogram };
+
+class metrics_registry {
+public:
+
+metrics_registry() {
+
+    nb_entries = nb_counters = nb_gauges = nb_histograms = 0;
+
+}
+
+// the name, help and labels (e.g. "state=\"rotation\"") are string literals; 0 if the registry is full
+metric_counter* counter(const char* name, const char* help, const char* labels = "") {
+
+    if ( ( nb_counters == max_metrics ) || !add_entry(name, help, labels, metric_type_counter, nb_counters) )
+        return 0;
+    return &counters[nb_counters++];
+
+}
+
+metric_gauge* gauge(const char* name, const char* help, const char* labels = "") {
+
+    if ( ( nb_gauges == max_metrics ) || !add_entry(name, help, labels, metric_type_gauge, nb_gauges) )
+        return 0;
+    return &gauges[nb_gauges++];
+
+}
+
+metric_histogram* histogram(const char* name, const char* help, const double* bounds, int nb_bounds, const char* labels = "") {
+
+    if ( ( nb_histograms == max_histograms ) || ( nb_bounds > max_buckets ) || !add_entry(name, help, labels, metric_type_histogram, nb_histograms) )
+        return 0;
+    metric_histogram& h = histograms[nb_histograms++];
+    h.nb_bounds = nb_bounds;
+    for (int loop=0; loop<nb_bounds; loop++)
+        h.bounds[loop] = bounds[loop];
+    return &h;
+
+}
+
+// text exposition format of prometheus
+void render(std::string& text) const {
+
+    text.clear();
+    char line[256];
+    for (int loop=0; loop<nb_entries; loop++) {
+        const entry& e = entries[loop];
+        bool first = true;
+        for (int previous=0; previous<loop; previous++)
+            if ( !strcmp(entries[previous].name, e.name) )
+                first = false;
+        if ( first ) {
+            static const char* types[] = { "counter", "gauge", "histogram" };
+            snprintf(line, sizeof(line), "# HELP %s %s\n# TYPE %s %s\n", e.name, e.help, e.name, types[e.type]);
+            text += line;
+        }
+
+        const char* open = *e.labels ? "{" : "";
+        const char* close = *e.labels ? "}" : "";
+        if ( e.type == metric_type_counter )
+            snprintf(line, sizeof(line), "%s%s%s%s %llu\n", e.name, open, e.labels, close, (unsigned long long)counters[e.index].get());
+        else if ( e.type == metric_type_gauge )
+            snprintf(line, sizeof(line), "%s%s%s%s %.9g\n", e.name, open, e.labels, close, gauges[e.index].get());
+        else {
+            const metric_histogram& h = histograms[e.index];
+            const char* comma = *e.labels ? "," : "";
+            uint64_t cumulated = 0;
+            for (int b=0; b<=h.nb_bounds; b++) {
+                cumulated += h.bucket(b);
+                char bound[32];
+                if ( b < h.nb_bounds )
+                    snprintf(bound, sizeof(bound), "%.9g", h.bounds[b]);
+                else
+                    snprintf(bound, sizeof(bound), "+Inf");
+                snprintf(line, sizeof(line), "%s_bucket{%s%sle=\"%s\"} %llu\n", e.name, e.labels, comma, bound, (unsigned long long)cumulated);
+                text += line;
+            }
+            snprintf(line, sizeof(line), "%s_sum%s%s%s %.9g\n%s_count%s%s%s %llu\n", e.name, open, e.labels, close, h.get_sum(),
+                     e.name, open, e.labels, close, (unsigned long long)cumulated);
+        }
+        text += line;
+    }
+
+}
+
+private:
+
+    struct entry {
+
+        const char* name;
+        const char* help;
+        const char* labels;
+        metric_type type;
+        int index;
+
+    };
+
+    entry entries[2 * max_metrics + max_histograms];
+    int nb_entries;
+    metric_counter counters[max_metrics];
+    metric_gauge gauges[max_metrics];
+    metric_histogram histograms[max_histograms];
+    int nb_counters, nb_gauges, nb_histograms;
+
+bool add_entry(const char* name, const char* help, const char* labels, metric_type type, int index) {
+
+    if ( nb_entries == (int)( sizeof(entries) / sizeof(entries[0]) ) )
+        return false;
+    entry& e = entries[nb_entries++];
+    e.name = name;
+    e.help = help;
+    e.labels = labels;
+    e.type = type;
+    e.index = index;
+    return true;
+
+}
+
+};
+
+// serves a registry in its own thread; a scrape is any connection: the request is read and ignored, the answer is
+// an http response with the metrics
+class metrics_server {
+public:
+
+metrics_server(const metrics_registry& r) : registry(r), running(false) {
+
+    for (int loop=0; loop<2; loop++)
+        fds[loop] = -1;
+
+}
+
+~metrics_server() { stop(); }
+
+// socket_path: unix socket ("" for none), port: tcp port on 127.0.0.1 (0 for none); false if a socket cannot be opened
+bool start(const std::string& socket_path, int port) {
+
+    bool ok = true;
+    if ( !socket_path.empty() ) {
+        fds[0] = socket(AF_UNIX, SOCK_STREAM, 0);
+        sockaddr_un address;
+        memset(&address, 0, sizeof(address));
+        address.sun_family = AF_UNIX;
+        strncpy(address.sun_path, socket_path.c_str(), sizeof(address.sun_path) - 1);
+        unlink(address.sun_path);// left by a previous run
+        if ( ( fds[0] < 0 ) || bind(fds[0], (sockaddr*)&address, sizeof(address)) || listen(fds[0], 4) ) {
+            close_socket(0);
+            ok = false;
+        }
+        else
+            path = address.sun_path;
+    }
+    if ( port > 0 ) {
+        fds[1] = socket(AF_INET, SOCK_STREAM, 0);
+        int reuse = 1;
+        sockaddr_in address;
+        memset(&address, 0, sizeof(address));
+        address.sin_family = AF_INET;
+        address.sin_port = htons(port);
+        address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        if ( ( fds[1] < 0 ) || setsockopt(fds[1], SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse)) ||
+             bind(fds[1], (sockaddr*)&address, sizeof(address)) || listen(fds[1], 4) ) {
+            close_socket(1);
+            ok = false;
+        }
+    }
+
+    running = true;
+    for (int loop=0; loop<2; loop++)
+        if ( fds[loop] >= 0 )
+            threads[loop] = std::thread(&metrics_server::serve, this, fds[loop]);
+    return ok;
+
+}
+
+void stop() {
+
+    running = false;
+    for (int loop=0; loop<2; loop++) {
+        if ( fds[loop] >= 0 )
+            shutdown(fds[loop], SHUT_RDWR);// wakes up accept()
+        if ( threads[loop].joinable() )
+            threads[loop].join();
+        close_socket(loop);
+    }
+    if ( !path.empty() ) {
+        unlink(path.c_str());
+        path.clear();
+    }
+
+}
+
+private:
+
+    const metrics_registry& registry;
+    std::atomic<bool> running;
+    int fds[2];// unix, tcp
+    std::thread threads[2];
+    std::string path;
+
+void close_socket(int s) {
+
+    if ( fds[s] >= 0 )
+        close(fds[s]);
+    fds[s] = -1;
+
+}
+
+void serve(int fd) {
+
+    std::string text, response;
+    while ( running ) {
+        int client = accept(fd, 0, 0);
+        if ( client < 0 ) {
+            if ( !running )
+                break;
+            continue;
+        }
+        // the request is not parsed, a client that sends nothing is given up after the timeout
+        timeval timeout = { 1, 0 };
+        setsockopt(client, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+        char request[1024];
+        if ( recv(client, request, sizeof(request), 0) >= 0 ) {
+            registry.render(text);
+            char header[128];
+            snprintf(header, sizeof(header), "HTTP/1.0 200 OK\r\nContent-Type: text/plain; version=0.0.4\r\nContent-Length: %i\r\n\r\n", (int)text.size());
+            response = header;
+            response += text;
+            size_t sent = 0;
+            while ( sent < response.size() ) {
+                ssize_t n = send(client, response.data() + sent, response.size() - sent, MSG_NOSIGNAL);
+                if ( n <= 0 )
+                    break;
+                sent += n;
+            }
+        }
+        close(client);
+    }
+
+}
+
+};
+
+#endif
@@ -0,0 +1,164 @@
+// motion state of the robot estimated from its odometry, used by robot_moving_node and robot_moving_benchmark
+// the robot is stopped when all the odometry samples received during "stop_delay" seconds are quiet:
+// - its speeds are lower than the speed thresholds
+// - its pose has changed less than the noise thresholds since the previous sample, except for the first sample: its
+//   change of pose covers the end of the braking
+// it is moving again as soon as a speed is higher than twice the threshold (hysteresis)
+// or as soon as its pose has drifted more than the moving thresholds from the pose where it stopped
+// optionally, two consecutive scans must also be similar for the robot to be stopped
+// the stamps are in seconds; the estimator does not depend on ROS
+
+#ifndef FOLLOW_ME_MOTION_ESTIMATOR_H
+#define FOLLOW_ME_MOTION_ESTIMATOR_H
+
+#include <cmath>
+#include <vector>
+#include "follow_me/geometry.h"
+
+struct motion_estimator_config {
+
+    float stop_delay;// s
+    float linear_speed_threshold;// m/s
+    float angular_speed_threshold;// rad/s
+    float position_noise;// m
+    float orientation_noise;// rad
+    float moving_distance;// m
+    float moving_angle;// rad
+
+    bool use_scan;
+    float scan_threshold;// m, a beam has changed if its range changed more than this distance
+    float scan_changed_max;// the scene is static if less than this proportion of beams has changed (a walking person changes some beams)
+
+};
+
+inline motion_estimator_config default_motion_estimator_config() {
+
+    motion_estimator_config c;
+    c.stop_delay = 0.04;
+    c.linear_speed_threshold = 0.01;
+    c.angular_speed_threshold = 0.02;
+    c.position_noise = 0.002;
+    c.orientation_noise = 0.003;
+    c.moving_distance = 0.02;
+    c.moving_angle = 0.03;
+    c.use_scan = false;
+    c.scan_threshold = 0.05;
+    c.scan_changed_max = 0.3;
+    return c;
+
+}
+
+struct motion_pose {
+
+    float x, y, yaw;
+
+};
+
+class motion_estimator {
+public:
+
+    motion_estimator_config config;
+
+    bool moving;
+    double since;// s, stamp of the first sample of the current state
+
+motion_estimator(const motion_estimator_config& c = default_motion_estimator_config()) {
+
+    config = c;
+    moving = true;
+    since = 0;
+    quiet = false;
+    quiet_since = 0;
+    init_odom = false;
+    scan_static = !config.use_scan;
+
+}
+
+// returns true when the sample changes the state (and for the first sample, that gives the initial state)
+bool update_odom(double stamp, float x, float y, float yaw, float linear_speed, float angular_speed) {
+
+    const motion_pose pose = { x, y, yaw };
+    linear_speed = fabs(linear_speed);
+    angular_speed = fabs(angular_speed);
+
+    if ( !init_odom ) {
+        init_odom = true;
+        previous_pose = pose;
+        since = stamp;
+        return true;
+    }
+
+    float delta_position = point_distance(pose, previous_pose);
+    float delta_orientation = fabs(angle_difference(yaw, previous_pose.yaw));
+    previous_pose = pose;
+
+    if ( moving ) {
+        bool sample_slow = ( linear_speed < config.linear_speed_threshold ) && ( angular_speed < config.angular_speed_threshold );
+        bool sample_still = ( delta_position < config.position_noise ) && ( delta_orientation < config.orientation_noise );
+
+        // a slow sample that has moved since the previous one starts a new quiet period
+        if ( !sample_slow )
+            quiet = false;
+        else
+            if ( !quiet || !sample_still ) {
+                quiet = true;
+                quiet_since = stamp;
+            }
+
+        if ( quiet && scan_static && ( stamp - quiet_since >= config.stop_delay ) ) {
+            moving = false;
+            since = quiet_since;
+            stopped_pose = pose;
+            return true;
+        }
+    }
+    else {
+        // hysteresis: we need a clear motion to leave the stopped state
+        bool sample_moving = ( linear_speed > 2 * config.linear_speed_threshold ) || ( angular_speed > 2 * config.angular_speed_threshold ) ||
+                             ( point_distance(pose, stopped_pose) > config.moving_distance ) ||
+                             ( fabs(angle_difference(yaw, stopped_pose.yaw)) > config.moving_angle );
+
+        if ( sample_moving ) {
+            moving = true;
+            quiet = false;
+            since = stamp;
+            return true;
+        }
+    }
+    return false;
+
+}
+
+// scan-to-scan stationarity: most of the beams must be unchanged
+void update_scan(const float* ranges, int nb, float range_min, float range_max) {
+
+    if ( (int)previous_ranges.size() == nb ) {
+        int nb_changed = 0, nb_valid = 0;
+        for (int loop=0; loop<nb; loop++) {
+            float r = ranges[loop];
+            if ( ( r > range_min ) && ( r < range_max ) ) {
+                nb_valid++;
+                if ( fabs(r - previous_ranges[loop]) > config.scan_threshold )
+                    nb_changed++;
+            }
+        }
+        scan_static = ( nb_valid > 0 ) && ( nb_changed < config.scan_changed_max * nb_valid );
+    }
+    previous_ranges.assign(ranges, ranges + nb);
+
+}
+
+private:
+
+    motion_pose previous_pose;
+    motion_pose stopped_pose;// where the robot stopped
+    bool init_odom;
+    bool quiet;// to check if the previous samples are quiet
+    double quiet_since;// s, stamp of the first sample of the current quiet period
+
+    std::vector<float> previous_ranges;
+    bool scan_static;
+
+};
+
+#endif
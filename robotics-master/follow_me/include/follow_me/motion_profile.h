@@ -0,0 +1,177 @@
+// time-optimal velocity profiles for a rest-to-rest motion (translation or rotation)
+// with a maximum velocity, acceleration and jerk:
+// - jerk > 0: S-curve profile (7 segments, the acceleration is continuous)
+// - jerk <= 0: trapezoidal profile (3 segments, the acceleration jumps)
+
+#ifndef FOLLOW_ME_MOTION_PROFILE_H
+#define FOLLOW_ME_MOTION_PROFILE_H
+
+#include <cmath>
+
+class motion_profile {
+private:
+
+    // the profile is made of 7 segments of constant jerk:
+    // increasing acceleration, constant acceleration, decreasing acceleration, constant velocity,
+    // increasing deceleration, constant deceleration, decreasing deceleration
+    // for a trapezoidal profile, the segments with a jerk have a null duration
+    static const int nb_segments = 7;
+
+    float sign;// direction of the motion: we plan for a positive distance
+    float segment_start[nb_segments + 1];// time at the beginning of each segment
+    float segment_jerk[nb_segments];
+    float segment_acc[nb_segments], segment_vel[nb_segments], segment_pos[nb_segments];// state at the beginning of each segment
+
+    float peak_velocity, peak_acceleration;
+
+public:
+
+motion_profile() {
+
+    plan(0, 1, 1, 0);
+
+}
+
+// plan the motion of "distance" (m or rad) with the given limits
+void plan(float distance, float max_velocity, float max_acceleration, float max_jerk) {
+
+    sign = ( distance < 0 ) ? -1 : 1;
+    float d = fabs(distance);
+
+    float tj, ta, tv;// duration of a jerk segment, of the acceleration phase and of the constant velocity phase
+    float jerk = 0;
+
+    if ( max_jerk > 0 ) {
+        // S-curve: we first assume that both the max velocity and the max acceleration are reached
+        jerk = max_jerk;
+        if ( max_velocity * max_jerk < max_acceleration * max_acceleration ) {
+            tj = sqrt(max_velocity / max_jerk);
+            ta = 2 * tj;
+        }
+        else {
+            tj = max_acceleration / max_jerk;
+            ta = tj + max_velocity / max_acceleration;
+        }
+        // the distance covered during the acceleration and deceleration phases is max_velocity * ta
+        tv = d / max_velocity - ta;
+
+        if ( tv < 0 ) {
+            // the max velocity is not reached
+            tv = 0;
+            tj = max_acceleration / max_jerk;
+            ta = tj / 2 + sqrt(tj * tj / 4 + d / max_acceleration);
+            if ( ta < 2 * tj ) {
+                // the max acceleration is not reached either
+                tj = cbrt(d / (2 * max_jerk));
+                ta = 2 * tj;
+            }
+        }
+        peak_acceleration = jerk * tj;
+        peak_velocity = peak_acceleration * ( ta - tj );
+    }
+    else {
+        // trapezoidal profile
+        tj = 0;
+        if ( max_velocity * max_velocity / max_acceleration < d ) {
+            ta = max_velocity / max_acceleration;
+            tv = ( d - max_velocity * ta ) / max_velocity;
+        }
+        else {
+            // triangular profile: the max velocity is not reached
+            ta = sqrt(d / max_acceleration);
+            tv = 0;
+        }
+        peak_acceleration = max_acceleration;
+        peak_velocity = max_acceleration * ta;
+    }
+
+    float duration[nb_segments] = { tj, ta - 2 * tj, tj, tv, tj, ta - 2 * tj, tj };
+    float jerks[nb_segments] = { jerk, 0, -jerk, 0, -jerk, 0, jerk };
+    float acc_start[nb_segments] = { 0, peak_acceleration, peak_acceleration, 0, 0, -peak_acceleration, -peak_acceleration };
+
+    // integration of the state at the beginning of each segment
+    float t = 0, pos = 0, vel = 0;
+    for (int loop=0; loop<nb_segments; loop++) {
+        float dt = duration[loop];
+        if ( dt < 0 )
+            dt = 0;// rounding errors
+        segment_start[loop] = t;
+        segment_jerk[loop] = jerks[loop];
+        segment_acc[loop] = acc_start[loop];
+        segment_vel[loop] = vel;
+        segment_pos[loop] = pos;
+
+        pos += vel * dt + acc_start[loop] * dt * dt / 2 + jerks[loop] * dt * dt * dt / 6;
+        vel += acc_start[loop] * dt + jerks[loop] * dt * dt / 2;
+        t += dt;
+    }
+    segment_start[nb_segments] = t;
+
+}
+
+// total duration of the motion (s)
+float duration() const {
+
+    return segment_start[nb_segments];
+
+}
+
+float max_velocity_reached() const {
+
+    return sign * peak_velocity;
+
+}
+
+// state of the reference at time t (s) since the beginning of the motion
+void sample(float t, float& position, float& velocity, float& acceleration) const {
+
+    if ( t >= duration() ) {
+        position = sign * ( segment_pos[nb_segments-1] + end_of_last_segment() );
+        velocity = 0;
+        acceleration = 0;
+        return;
+    }
+    if ( t < 0 )
+        t = 0;
+
+    int loop = 0;
+    while ( ( loop < nb_segments - 1 ) && ( t >= segment_start[loop+1] ) )
+        loop++;
+
+    float dt = t - segment_start[loop];
+    position = sign * ( segment_pos[loop] + segment_vel[loop] * dt + segment_acc[loop] * dt * dt / 2 + segment_jerk[loop] * dt * dt * dt / 6 );
+    velocity = sign * ( segment_vel[loop] + segment_acc[loop] * dt + segment_jerk[loop] * dt * dt / 2 );
+    acceleration = sign * ( segment_acc[loop] + segment_jerk[loop] * dt );
+
+}
+
+float position(float t) const {
+
+    float p, v, a;
+    sample(t, p, v, a);
+    return p;
+
+}
+
+float velocity(float t) const {
+
+    float p, v, a;
+    sample(t, p, v, a);
+    return v;
+
+}
+
+private:
+
+// distance covered during the last segment
+float end_of_last_segment() const {
+
+    float dt = segment_start[nb_segments] - segment_start[nb_segments-1];
+    int last = nb_segments - 1;
+    return segment_vel[last] * dt + segment_acc[last] * dt * dt / 2 + segment_jerk[last] * dt * dt * dt / 6;
+
+}
+
+};
+
+#endif
@@ -0,0 +1,279 @@
+// denoising of the ranges of a scan before the detection of motion (see detector_core.h), in this order:
+// - the invalid ranges (not in ]range_min, range_max[, nan) are set to range_max, as the detector does
+// - median of median_window consecutive beams: removes the single-beam dropouts and spikes and smooths the noise
+//   along the surfaces, without moving the edges. The windows of 3 to range_filter_median_max beams are selection
+//   networks of min/max computed 4 beams at a time (see simd.h); larger windows are rejected by
+//   range_filter_config_valid()
+// - veiling points: at the edge of an object, a beam that hits both the object and the background returns a range in
+//   between (mixed pixel), and forms a cluster of its own. A hit is a veiling point when the line to one of its
+//   neighbours that is closer to the laser makes an angle below veiling_angle with the beam; it takes the range of
+//   its neighbour of closest range, so that it joins the object or the background
+// - isolated returns: a run of at most isolated_beams beams whose ranges differ by more than isolated_distance from
+//   the beams on both sides, while these agree with each other, takes the mean range of these two beams
+// each step is disabled by 0 (by 1 for the median); range_filter_preset() gives the configuration of a laser
+
+#ifndef FOLLOW_ME_RANGE_FILTER_H
+#define FOLLOW_ME_RANGE_FILTER_H
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <vector>
+#include "follow_me/simd.h"
+
+#define range_filter_padding 8// beams copied from the first and last ones on each side of the scan, above isolated_beams and median_window / 2
+#define range_filter_median_max 9// beams, largest window of the median
+
+struct range_filter_config {
+
+    bool enabled;
+    int median_window;// beams, odd, 1: no median
+    float veiling_angle;// rad, 0: the veiling points are kept
+    int isolated_beams;// longest run of beams rejected as an isolated return, 0: none
+    float isolated_distance;// m
+
+};
+
+inline range_filter_config default_range_filter_config() {
+
+    range_filter_config c;
+    c.enabled = false;
+    c.median_window = 3;
+    c.veiling_angle = 10 * M_PI / 180;
+    c.isolated_beams = 1;
+    c.isolated_distance = 0.2;// cluster_threshold of the detector
+    return c;
+
+}
+
+// configuration for a laser, by the name of the version of the detector (see detector_core.h); the runs of 2 beams
+// rejected as isolated returns are smaller than leg_size_min over the whole range of these lasers (below 16 m for
+// the 2048 beams one)
+inline range_filter_config range_filter_preset(const char* laser) {
+
+    range_filter_config c = default_range_filter_config();
+    c.enabled = true;
+    if ( !strcmp(laser, "hokuyo_urg_726") )
+        c.isolated_beams = 2;
+    else
+        if ( !strcmp(laser, "lidar_1440") || !strcmp(laser, "lidar_2048") ) {
+            // dense lasers: an object of the size of a leg covers more beams
+            c.median_window = 5;
+            c.isolated_beams = 2;
+        }
+    return c;
+
+}
+
+// the median window is odd and has a network; the isolated runs fit in the padding
+inline bool range_filter_config_valid(const range_filter_config& c) {
+
+    return ( c.median_window >= 1 ) && ( c.median_window <= range_filter_median_max ) && ( c.median_window % 2 == 1 ) &&
+           ( c.isolated_beams >= 0 ) && ( c.isolated_beams < range_filter_padding );
+
+}
+
+class range_filter {
+public:
+
+    range_filter_config config;
+    int nb_veiling, nb_isolated;// hits moved by the last apply()
+
+range_filter(const range_filter_config& c = default_range_filter_config()) {
+
+    config = c;
+    nb_veiling = nb_isolated = 0;
+
+}
+
+// the filtered ranges, valid until the next call; "ranges" itself when the filter is disabled
+const float* apply(const float* ranges, int nb, float angle_increment, float range_min, float range_max) {
+
+    nb_veiling = nb_isolated = 0;
+    if ( !config.enabled || ( nb <= 0 ) )
+        return ranges;
+
+    // the buffers are padded so that the loops work 4 beams at a time up to the end of the scan, and the
+    // neighbours of the first and last beams exist
+    const int size = ( ( nb + 3 ) & ~3 ) + 2 * range_filter_padding;
+    if ( (int)first.size() < size ) {
+        first.resize(size);
+        second.resize(size);
+    }
+    float* source = &first[range_filter_padding];
+    float* destination = &second[range_filter_padding];
+
+    sanitize(ranges, source, nb, range_min, range_max);
+    pad(source, nb);
+    if ( config.median_window > 1 ) {
+        median(source, destination, nb);
+        std::swap(source, destination);
+        pad(source, nb);
+    }
+    if ( config.veiling_angle > 0 ) {
+        nb_veiling = veiling(source, destination, nb, angle_increment);
+        std::swap(source, destination);
+        pad(source, nb);
+    }
+    for (int run=1; run<=std::min(config.isolated_beams, range_filter_padding - 1); run++) {
+        nb_isolated += isolated(source, destination, nb, run);
+        std::swap(source, destination);
+        pad(source, nb);
+    }
+    return source;
+
+}
+
+private:
+
+    std::vector<float> first, second;
+
+// the beams before the scan take the range of the first one, the beams after it the range of the last one
+static void pad(float* r, int nb) {
+
+    const int end = ( ( nb + 3 ) & ~3 ) + range_filter_padding;
+    for (int loop=-range_filter_padding; loop<0; loop++)
+        r[loop] = r[0];
+    for (int loop=nb; loop<end; loop++)
+        r[loop] = r[nb-1];
+
+}
+
+static void sanitize(const float* ranges, float* r, int nb, float range_min, float range_max) {
+
+    using namespace simd;
+    const float4 low(range_min), high(range_max);
+    int loop = 0;
+    for (; loop+4<=nb; loop+=4) {
+        float4 x = load(&ranges[loop]);
+        store(&r[loop], select(( x < high ) & ( low < x ), x, high));
+    }
+    for (; loop<nb; loop++)
+        r[loop] = ( ( ranges[loop] < range_max ) && ( ranges[loop] > range_min ) ) ? ranges[loop] : range_max;
+
+}
+
+static simd::float4 median3(simd::float4 a, simd::float4 b, simd::float4 c) {
+
+    return simd::max(simd::min(a, b), simd::min(simd::max(a, b), c));
+
+}
+
+// a becomes the min, b the max
+static void sort2(simd::float4& a, simd::float4& b) {
+
+    const simd::float4 low = simd::min(a, b);
+    b = simd::max(a, b);
+    a = low;
+
+}
+
+// median of 7 values, 13 exchanges (the compiler drops the min or the max that are not used)
+static simd::float4 median7(simd::float4 p0, simd::float4 p1, simd::float4 p2, simd::float4 p3, simd::float4 p4, simd::float4 p5, simd::float4 p6) {
+
+    sort2(p0, p5); sort2(p0, p3); sort2(p1, p6); sort2(p2, p4); sort2(p0, p1); sort2(p3, p5); sort2(p2, p6);
+    sort2(p2, p3); sort2(p3, p6); sort2(p4, p5); sort2(p1, p4); sort2(p1, p3); sort2(p3, p4);
+    return p3;
+
+}
+
+// median of 9 values, 19 exchanges
+static simd::float4 median9(simd::float4 p0, simd::float4 p1, simd::float4 p2, simd::float4 p3, simd::float4 p4, simd::float4 p5, simd::float4 p6,
+                            simd::float4 p7, simd::float4 p8) {
+
+    sort2(p1, p2); sort2(p4, p5); sort2(p7, p8); sort2(p0, p1); sort2(p3, p4); sort2(p6, p7); sort2(p1, p2);
+    sort2(p4, p5); sort2(p7, p8); sort2(p0, p3); sort2(p5, p8); sort2(p4, p7); sort2(p3, p6); sort2(p1, p4);
+    sort2(p2, p5); sort2(p4, p7); sort2(p4, p2); sort2(p6, p4); sort2(p4, p2);
+    return p4;
+
+}
+
+void median(const float* r, float* m, int nb) const {
+
+    using namespace simd;
+    const int half = std::min(config.median_window, range_filter_median_max) / 2;
+    if ( half == 1 )
+        for (int loop=0; loop<nb; loop+=4)
+            store(&m[loop], median3(load(&r[loop-1]), load(&r[loop]), load(&r[loop+1])));
+    else
+        if ( half == 2 )
+            for (int loop=0; loop<nb; loop+=4) {
+                float4 a = load(&r[loop-2]), b = load(&r[loop-1]), c = load(&r[loop+1]), d = load(&r[loop+2]);
+                // the median of 5 is the median of the middle beam and of the 2nd and 4th values of the 4 others
+                store(&m[loop], median3(load(&r[loop]), max(min(a, b), min(c, d)), min(max(a, b), max(c, d))));
+            }
+    else
+        if ( half == 3 )
+            for (int loop=0; loop<nb; loop+=4)
+                store(&m[loop], median7(load(&r[loop-3]), load(&r[loop-2]), load(&r[loop-1]), load(&r[loop]), load(&r[loop+1]), load(&r[loop+2]),
+                                        load(&r[loop+3])));
+    else
+        for (int loop=0; loop<nb; loop+=4)
+            store(&m[loop], median9(load(&r[loop-4]), load(&r[loop-3]), load(&r[loop-2]), load(&r[loop-1]), load(&r[loop]), load(&r[loop+1]),
+                                    load(&r[loop+2]), load(&r[loop+3]), load(&r[loop+4])));
+
+}
+
+// the angle between the beam and the line from the hit to a neighbour closer to the laser is below veiling_angle
+// when the distance of the neighbour to the beam, r' sin(increment), is below tan(veiling_angle) times its distance
+// along the beam, r - r' cos(increment)
+int veiling(const float* r, float* v, int nb, float angle_increment) const {
+
+    using namespace simd;
+    const float4 s(fabs(sin(angle_increment))), c(cos(angle_increment)), t(tan(config.veiling_angle));
+    int count = 0;
+    for (int loop=0; loop<nb; loop+=4) {
+        float4 x = load(&r[loop]), previous = load(&r[loop-1]), next = load(&r[loop+1]);
+        float4 behind_previous = ( previous < x ) & ( previous * s < t * ( x - previous * c ) );
+        float4 behind_next = ( next < x ) & ( next * s < t * ( x - next * c ) );
+        float4 veiled = behind_previous | behind_next;
+        float4 closest = select(abs(x - previous) < abs(x - next), previous, next);
+        store(&v[loop], select(veiled, closest, x));
+        int mask = movemask(veiled);
+        if ( loop + 4 > nb )
+            mask &= ( 1 << ( nb - loop ) ) - 1;
+        count += __builtin_popcount(mask);
+    }
+    return count;
+
+}
+
+// the runs of "run" beams starting at each beam
+int isolated(const float* r, float* f, int nb, int run) const {
+
+    using namespace simd;
+    const float4 distance(config.isolated_distance), half(0.5f);
+    memcpy(f, r, nb * sizeof(float));
+    int count = 0;
+    for (int loop=0; loop<nb; loop+=4) {
+        float4 before = load(&r[loop-1]), after = load(&r[loop+run]);
+        float4 outlier = abs(before - after) < distance;
+        for (int beam=0; beam<run; beam++) {
+            float4 x = load(&r[loop+beam]);
+            outlier = outlier & ( distance < abs(x - before) ) & ( distance < abs(x - after) );
+        }
+        int mask = movemask(outlier);
+        if ( loop + run > nb )
+            mask = 0;
+        else
+            if ( loop + 4 + run > nb )
+                mask &= ( 1 << ( nb - run + 1 - loop ) ) - 1;
+        if ( !mask )
+            continue;
+        // rare: the runs are written beam by beam
+        float mean[4];
+        store(mean, ( before + after ) * half);
+        for (int lane=0; lane<4; lane++)
+            if ( mask & ( 1 << lane ) ) {
+                for (int beam=0; beam<run; beam++)
+                    f[loop+lane+beam] = mean[lane];
+                count += run;
+            }
+    }
+    return count;
+
+}
+
+};
+
+#endif
@@ -0,0 +1,332 @@
+// real-time mode of the control loops (rotation_node, translation_node), so that their period does not depend on the
+// load of the detector on the same cpus
+// - lock_memory(): all the pages of the process are locked in ram (no page fault in the loop), malloc does not give
+//   memory back to the system, and the stack of the loop is touched once
+// - set_fifo_priority(): the calling thread runs under SCHED_FIFO (needs CAP_SYS_NICE or an rtprio limit); the
+//   threads created before keep their policy
+// - periodic_timer: absolute deadlines on CLOCK_MONOTONIC (no drift), and the latency of each wakeup after its
+//   deadline, also measured when the loop sleeps with ros::Rate
+// - jitter_histogram: the latencies of the wakeups with a 1 us resolution, reported as cyclictest does
+//   (min, current, average, max) plus the 99% and 99.9% percentiles
+// - realtime_log: the lines of the loop are formatted in a preallocated ring (single producer, single consumer,
+//   without lock) and written by a thread of normal priority; the lines that do not fit are counted and dropped.
+//   Without start(), the lines are written directly by the caller
+
+#ifndef FOLLOW_ME_REALTIME_H
+#define FOLLOW_ME_REALTIME_H
+
+#include <algorithm>
+#include <alloca.h>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cmath>
+#include <cstdarg>
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+#include <functional>
+#include <malloc.h>
+#include <pthread.h>
+#include <sched.h>
+#include <sys/mman.h>
+#include <thread>
+#include <vector>
+
+#define max_latency_us 100000// us, the latencies above are counted in the last bucket of jitter_histogram
+#define log_line_size 256
+
+struct realtime_config {
+
+    bool enabled;
+    int priority;// SCHED_FIFO, 1 to 99
+    int cpu;// cpu of the loop, -1 for any
+    int stack_size;// bytes of the stack touched before the loop
+
+};
+
+inline realtime_config default_realtime_config() {
+
+    realtime_config c;
+    c.enabled = false;
+    c.priority = 80;// above the interrupts threads of PREEMPT_RT (50)
+    c.cpu = -1;
+    c.stack_size = 256 * 1024;
+    return c;
+
+}
+
+// false with errno set if the memory cannot be locked
+inline bool lock_memory(int stack_size) {
+
+    mallopt(M_TRIM_THRESHOLD, -1);
+    mallopt(M_MMAP_MAX, 0);
+    if ( mlockall(MCL_CURRENT | MCL_FUTURE) )
+        return false;
+    volatile char* stack = (volatile char*)alloca(stack_size);
+    for (int loop=0; loop<stack_size; loop+=4096)
+        stack[loop] = 0;
+    return true;
+
+}
+
+// false with errno set if the policy is refused
+inline bool set_fifo_priority(int priority) {
+
+    sched_param param;
+    memset(&param, 0, sizeof(param));
+    param.sched_priority = std::max(sched_get_priority_min(SCHED_FIFO), std::min(sched_get_priority_max(SCHED_FIFO), priority));
+    int result = pthread_setschedparam(pthread_self(), SCHED_FIFO, &param);
+    errno = result;
+    return !result;
+
+}
+
+// false with errno set if the cpu cannot be used
+inline bool set_cpu(int cpu) {
+
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    int result = pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+    errno = result;
+    return !result;
+
+}
+
+class periodic_timer {
+public:
+
+    long nb_overruns;// wakeups later than a whole period: the deadlines are taken again from the wakeup
+
+periodic_timer(double period_s) {
+
+    period = (long)( period_s * 1e9 );
+    nb_overruns = 0;
+    start();
+
+}
+
+// the first deadline is one period from now
+void start() {
+
+    clock_gettime(CLOCK_MONOTONIC, &next);
+    advance(next, period);
+
+}
+
+// sleeps until the next deadline, returns the latency of the wakeup (s)
+double sleep() {
+
+    while ( clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &next, 0) == EINTR );
+    return observe();
+
+}
+
+// latency (s) of the current time after the deadline, which is moved to the next period (when the loop sleeps
+// by other means); 0 if the deadline has not been reached yet
+double observe() {
+
+    timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    long latency = ( now.tv_sec - next.tv_sec ) * 1000000000L + ( now.tv_nsec - next.tv_nsec );
+    if ( latency > period ) {
+        nb_overruns++;
+        next = now;
+    }
+    advance(next, period);
+    return std::max(0L, latency) * 1e-9;
+
+}
+
+private:
+
+    long period;// ns
+    timespec next;
+
+static void advance(timespec& t, long ns) {
+
+    t.tv_nsec += ns;
+    while ( t.tv_nsec >= 1000000000L ) {
+        t.tv_nsec -= 1000000000L;
+        t.tv_sec++;
+    }
+
+}
+
+};
+
+class jitter_histogram {
+public:
+
+jitter_histogram() : buckets(max_latency_us + 1, 0) {
+
+    reset();
+
+}
+
+void reset() {
+
+    std::fill(buckets.begin(), buckets.end(), 0);
+    nb = 0;
+    sum = 0;
+    minimum = max_latency_us;
+    maximum = current = 0;
+
+}
+
+void add(double latency) {
+
+    long us = std::min((long)max_latency_us, (long)( latency * 1e6 + 0.5 ));
+    buckets[us]++;
+    nb++;
+    sum += us;
+    minimum = std::min(minimum, us);
+    maximum = std::max(maximum, us);
+    current = us;
+
+}
+
+long count() const { return nb; }
+long max() const { return maximum; }
+
+// latency (us) below which "fraction" of the wakeups are
+long percentile(double fraction) const {
+
+    long target = (long)ceil(fraction * nb), seen = 0;
+    for (int us=0; us<=max_latency_us; us++) {
+        seen += buckets[us];
+        if ( seen >= target )
+            return us;
+    }
+    return max_latency_us;
+
+}
+
+// one line as cyclictest, the latencies in us
+void report(char* text, size_t size) const {
+
+    snprintf(text, size, "C:%8li Min:%6li Act:%6li Avg:%6li Max:%6li P99:%6li P99.9:%6li", nb, nb ? minimum : 0, current,
+             nb ? sum / nb : 0, maximum, percentile(0.99), percentile(0.999));
+
+}
+
+private:
+
+    std::vector<long> buckets;// 1 us each
+    long nb, sum;
+    long minimum, maximum, current;
+
+};
+
+class realtime_log {
+public:
+
+    enum level { info_level, warn_level };
+
+    std::atomic<long> nb_dropped;
+
+// "sink" writes a line (ROS_INFO, ROS_WARN in a node); it is called by the drain thread once started
+// nb_lines: size of the ring, a power of 2
+realtime_log(const std::function<void(int, const char*)>& sink, int nb_lines = 256) : nb_dropped(0), write(sink), lines(nb_lines), head(0), tail(0), running(false) {}
+
+~realtime_log() {
+
+    stop();
+
+}
+
+// the following lines go through the ring
+void start() {
+
+    if ( running )
+        return;
+    running = true;
+    drain_thread = std::thread(&realtime_log::drain, this);
+
+}
+
+// the lines still in the ring are written
+void stop() {
+
+    if ( !running )
+        return;
+    running = false;
+    drain_thread.join();
+
+}
+
+void info(const char* format, ...) __attribute__((format(printf, 2, 3))) {
+
+    va_list arguments;
+    va_start(arguments, format);
+    push(info_level, format, arguments);
+    va_end(arguments);
+
+}
+
+void warn(const char* format, ...) __attribute__((format(printf, 2, 3))) {
+
+    va_list arguments;
+    va_start(arguments, format);
+    push(warn_level, format, arguments);
+    va_end(arguments);
+
+}
+
+private:
+
+    struct log_line {
+
+        int level;
+        char text[log_line_size];
+
+    };
+
+    std::function<void(int, const char*)> write;
+    std::vector<log_line> lines;
+    std::atomic<unsigned> head;// next line written by the producer
+    std::atomic<unsigned> tail;// next line read by the drain thread
+    std::atomic<bool> running;
+    std::thread drain_thread;
+
+void push(int level, const char* format, va_list arguments) {
+
+    if ( !running ) {
+        char text[log_line_size];
+        vsnprintf(text, sizeof(text), format, arguments);
+        write(level, text);
+        return;
+    }
+    unsigned h = head.load(std::memory_order_relaxed);
+    if ( h - tail.load(std::memory_order_acquire) >= lines.size() ) {
+        nb_dropped.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+    log_line& line = lines[h % lines.size()];
+    line.level = level;
+    vsnprintf(line.text, sizeof(line.text), format, arguments);
+    head.store(h + 1, std::memory_order_release);
+
+}
+
+void drain() {
+
+    while ( true ) {
+        bool stopping = !running;
+        unsigned t = tail.load(std::memory_order_relaxed);
+        unsigned h = head.load(std::memory_order_acquire);
+        for (; t!=h; t++) {
+            write(lines[t % lines.size()].level, lines[t % lines.size()].text);
+            tail.store(t + 1, std::memory_order_release);
+        }
+        if ( stopping )
+            return;
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+
+}
+
+};
+
+#endif
@@ -0,0 +1,585 @@
+// compact transport of the scans and of the markers of the detector, for the monitoring of robair over a slow link
+// scans:
+// - the ranges are quantized to uint16 millimetres, 0 for an invalid range (out of [range_min, range_max], nan, inf)
+// - a keyframe sends all the beams and becomes the background of the encoder and of the decoder
+// - the other frames only send the beams that differ from the background by more than static_tolerance: the runs of
+//   static beams are sent as their length, the decoder takes them from its background (error <= static_tolerance)
+// - motion compensation: when the laser turns, the background is compared shifted by the number of beams that the
+//   laser has turned since the keyframe. The encoder predicts the shift from the last two frames, and searches it up
+//   to max_rotation from the shift of the last frame when the prediction leaves many more dynamic beams (on a sample
+//   of the beams, then refined on all the beams); the shift is sent in the frame
+// - the dynamic beams are sent as the difference with the previous beam reconstructed by the decoder (zigzag varint:
+//   1 byte for a difference of less than 64 mm, 2 bytes below 8 m)
+// - a keyframe is sent every keyframe_period frames (a decoder that has lost a keyframe recovers), when the geometry
+//   of the scan changes, or when more than max_dynamic_ratio of the beams are dynamic (robot moving)
+// - the quantization, the comparison with the background and the dequantization are SIMD (see simd.h)
+// markers (POINTS and LINE_STRIP of the detector):
+// - the colours are indexed in a palette, the points are sent as runs of the same colour of centimetre differences
+//   with the previous point (zigzag varints), z is dropped
+// the header of the frames is written in the byte order of the host (robair and its monitors are little-endian)
+
+#ifndef FOLLOW_ME_SCAN_CODEC_H
+#define FOLLOW_ME_SCAN_CODEC_H
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include "follow_me/simd.h"
+
+#define scan_codec_magic 0x53// 'S'
+#define marker_codec_magic 0x4d// 'M'
+#define scan_codec_header_size 24
+#define scan_codec_shift_samples 64// beams compared for the search of the shift of the background
+
+struct scan_codec_config {
+
+    int keyframe_period;// frames
+    int static_tolerance;// mm
+    float max_dynamic_ratio;// of the beams, above it the frame is sent as a keyframe
+    float max_rotation;// rad, largest rotation of the laser between two frames for the motion compensation, 0: none
+
+};
+
+inline scan_codec_config default_scan_codec_config() {
+
+    scan_codec_config c;
+    c.keyframe_period = 50;
+    c.static_tolerance = 30;// 3 standard deviations of the noise of the hokuyo
+    c.max_dynamic_ratio = 0.5;
+    c.max_rotation = 0.1;// 1 rad/s at 10 hz
+    return c;
+
+}
+
+namespace scan_codec {
+
+inline uint32_t zigzag(int v) { return ( (uint32_t)v << 1 ) ^ (uint32_t)( v >> 31 ); }
+inline int unzigzag(uint32_t v) { return (int)( v >> 1 ) ^ -(int)( v & 1 ); }
+
+inline uint8_t* put_varint(uint8_t* p, uint32_t v) {
+
+    while ( v >= 0x80 ) {
+        *p++ = ( v & 0x7f ) | 0x80;
+        v >>= 7;
+    }
+    *p++ = v;
+    return p;
+
+}
+
+// false if the stream ends before the varint
+inline bool get_varint(const uint8_t*& p, const uint8_t* end, uint32_t& v) {
+
+    v = 0;
+    for (int shift=0; shift<35; shift+=7) {
+        if ( p >= end )
+            return false;
+        uint8_t b = *p++;
+        v |= (uint32_t)( b & 0x7f ) << shift;
+        if ( !( b & 0x80 ) )
+            return true;
+    }
+    return false;
+
+}
+
+// ranges in m to uint16 mm, 0 if invalid
+inline void quantize(const float* ranges, int nb, float range_min, float range_max, uint16_t* q) {
+
+    using namespace simd;
+    const float4 low(range_min), high(range_max), scale(1000.0f), half(0.5f), one(1.0f), top(65535.0f), zero(0.0f);
+    int loop = 0;
+    for (; loop+4<=nb; loop+=4) {
+        float4 r = load(ranges + loop);
+        float4 valid = ( r > low ) & ( r < high );// false for nan
+        float4 mm = max(min(r * scale + half, top), one);
+        store(q + loop, to_int(select(valid, mm, zero)));
+    }
+    for (; loop<nb; loop++) {
+        float r = ranges[loop];
+        q[loop] = ( r > range_min ) && ( r < range_max ) ? (uint16_t)std::max(std::min(r * 1000.0f + 0.5f, 65535.0f), 1.0f) : 0;
+    }
+
+}
+
+// uint16 mm to ranges in m, +inf for an invalid range (REP 117)
+inline void dequantize(const uint16_t* q, int nb, float* ranges) {
+
+    using namespace simd;
+    const float inf = std::numeric_limits<float>::infinity();
+    const float4 scale(0.001f), half(0.5f), infinite(inf);
+    int loop = 0;
+    for (; loop+4<=nb; loop+=4) {
+        float4 mm = to_float(load(q + loop));
+        store(ranges + loop, select(mm < half, infinite, mm * scale));
+    }
+    for (; loop<nb; loop++)
+        ranges[loop] = q[loop] ? q[loop] * 0.001f : inf;
+
+}
+
+// statics[i] = 1 if the beam i differs from the background by at most tolerance mm; returns the number of dynamic beams
+inline int static_mask(const uint16_t* q, const uint16_t* background, int nb, int tolerance, uint8_t* statics) {
+
+    using namespace simd;
+    const float4 t((float)tolerance);
+    int nb_static = 0;
+    int loop = 0;
+    for (; loop+4<=nb; loop+=4) {
+        float4 d = abs(to_float(load(q + loop) - load(background + loop)));
+        int m = movemask(d <= t);
+        statics[loop] = m & 1;
+        statics[loop + 1] = ( m >> 1 ) & 1;
+        statics[loop + 2] = ( m >> 2 ) & 1;
+        statics[loop + 3] = ( m >> 3 ) & 1;
+        nb_static += statics[loop] + statics[loop + 1] + statics[loop + 2] + statics[loop + 3];
+    }
+    for (; loop<nb; loop++) {
+        statics[loop] = abs((int)q[loop] - (int)background[loop]) <= tolerance;
+        nb_static += statics[loop];
+    }
+    return nb - nb_static;
+
+}
+
+// static_mask() against the background shifted by "shift" beams: the beam i is compared with background[i - shift],
+// the beams without a beam of the background are dynamic
+inline int shifted_static_mask(const uint16_t* q, const uint16_t* background, int nb, int shift, int tolerance, uint8_t* statics) {
+
+    const int first = std::min(nb, std::max(0, shift)), last = std::max(first, std::min(nb, nb + shift));
+    std::fill(statics, statics + first, 0);
+    std::fill(statics + last, statics + nb, 0);
+    return nb - ( last - first ) + static_mask(q + first, background + first - shift, last - first, tolerance, statics + first);
+
+}
+
+// size in bytes of a serialized sensor_msgs/LaserScan, to compare with the encoded frames
+inline size_t laser_scan_size(int nb_ranges, int nb_intensities, const std::string& frame_id) {
+
+    return 16 + frame_id.size() + 7 * 4 + 4 + 4 * nb_ranges + 4 + 4 * nb_intensities;
+
+}
+
+// size in bytes of a serialized visualization_msgs/Marker with empty text and mesh
+inline size_t marker_size(int nb_points, int nb_colors, const std::string& frame_id, const std::string& ns) {
+
+    return 154 + frame_id.size() + ns.size() + 24 * nb_points + 16 * nb_colors;
+
+}
+
+}
+
+struct scan_frame {
+
+    float angle_min, angle_increment, range_min, range_max;
+    bool keyframe;
+    std::vector<float> ranges;
+
+};
+
+class scan_encoder {
+public:
+
+    scan_codec_config config;
+
+    long nb_frames, nb_keyframes;
+    int nb_dynamic;// beams sent in the last frame
+    int shift;// beams, of the background for the last frame
+
+scan_encoder(const scan_codec_config& c = default_scan_codec_config()) {
+
+    config = c;
+    nb_frames = nb_keyframes = 0;
+    nb_dynamic = 0;
+    shift = shift_step = 0;
+    key_angle_min = key_angle_increment = key_range_min = key_range_max = 0;
+    key_id = 0;
+    frames_since_key = 0;
+    force_keyframe = true;
+
+}
+
+// the next frame is a keyframe (a decoder has been started)
+void request_keyframe() { force_keyframe = true; }
+
+// encodes the scan in "out", returns its size in bytes
+size_t encode(const float* ranges, int nb, float angle_min, float angle_increment, float range_min, float range_max, std::vector<uint8_t>& out) {
+
+    // the storage is sized to the largest scan received (never empty) and reused from frame to frame
+    if ( (int)quantized.size() <= nb ) {
+        quantized.resize(nb + 1);
+        statics.resize(nb + 1);
+    }
+    scan_codec::quantize(ranges, nb, range_min, range_max, &quantized[0]);
+
+    bool keyframe = force_keyframe || !nb || ( frames_since_key >= config.keyframe_period ) || ( (int)background.size() != nb ) ||
+                    ( angle_min != key_angle_min ) || ( angle_increment != key_angle_increment ) ||
+                    ( range_min != key_range_min ) || ( range_max != key_range_max );
+    if ( !keyframe ) {
+        int previous_shift = shift;
+        shift = find_shift(nb, angle_increment);
+        shift_step = shift - previous_shift;
+        keyframe = nb_dynamic > config.max_dynamic_ratio * nb;
+    }
+    if ( keyframe ) {
+        background.assign(quantized.begin(), quantized.begin() + nb);
+        std::fill(statics.begin(), statics.begin() + nb, 0);
+        nb_dynamic = nb;
+        shift = shift_step = 0;
+        key_angle_min = angle_min;
+        key_angle_increment = angle_increment;
+        key_range_min = range_min;
+        key_range_max = range_max;
+        key_id++;
+        frames_since_key = 0;
+        force_keyframe = false;
+        nb_keyframes++;
+    }
+    frames_since_key++;
+    nb_frames++;
+
+    // worst case: one token and one 3 bytes value per beam
+    out.resize(scan_codec_header_size + 6 * nb + 8);
+    uint8_t* w = &out[0];
+    w[0] = scan_codec_magic;
+    w[1] = keyframe;
+    w[2] = key_id;
+    w[3] = shift != 0;// the shift follows the header
+    uint32_t n = nb;
+    float geometry[4] = { angle_min, angle_increment, range_min, range_max };
+    memcpy(w + 4, &n, 4);
+    memcpy(w + 8, geometry, 16);
+    w += scan_codec_header_size;
+    if ( shift )
+        w = scan_codec::put_varint(w, scan_codec::zigzag(shift));
+
+    const uint16_t* q = &quantized[0];
+    const uint8_t* s = &statics[0];
+    int previous = 0;// previous beam reconstructed by the decoder
+    int start = 0;
+    while ( start < nb ) {
+        int end = start + 1;
+        while ( ( end < nb ) && ( s[end] == s[start] ) )
+            end++;
+        if ( s[start] ) {
+            w = scan_codec::put_varint(w, ( end - start ) << 1);
+            previous = background[end - 1 - shift];
+        }
+        else {
+            w = scan_codec::put_varint(w, ( ( end - start ) << 1 ) | 1);
+            for (int loop=start; loop<end; loop++) {
+                w = scan_codec::put_varint(w, scan_codec::zigzag(q[loop] - previous));
+                previous = q[loop];
+            }
+        }
+        start = end;
+    }
+    out.resize(w - &out[0]);
+    return out.size();
+
+}
+
+private:
+
+    std::vector<uint16_t> quantized, background;
+    std::vector<uint8_t> statics;
+    float key_angle_min, key_angle_increment, key_range_min, key_range_max;// geometry of the background
+    uint8_t key_id;
+    int frames_since_key;
+    bool force_keyframe;
+    int shift_step;// beams, change of the shift at the last frame
+
+// shift of the background for the quantized scan, sets statics and nb_dynamic
+// the shift predicted with the last step is kept when its dynamic beams are not much more than at the last frame;
+// otherwise the shifts up to max_rotation from the shift of the last frame are compared on scan_codec_shift_samples
+// valid beams, and the best one is refined on all the beams
+int find_shift(int nb, float angle_increment) {
+
+    const uint16_t* q = &quantized[0];
+    const uint16_t* b = &background[0];
+    const int max_step = std::min(nb - 1, (int)( config.max_rotation / fabs(angle_increment) ));
+    const int predicted = std::max(-nb + 1, std::min(nb - 1, shift + shift_step));
+    const int last_dynamic = frames_since_key > 1 ? nb_dynamic : 0;// all the beams are sent in a keyframe
+    nb_dynamic = scan_codec::shifted_static_mask(q, b, nb, predicted, config.static_tolerance, &statics[0]);
+    if ( ( max_step <= 0 ) || ( nb_dynamic <= last_dynamic + last_dynamic / 4 + nb / 64 ) )
+        return predicted;
+
+    int samples[scan_codec_shift_samples], nb_samples = 0;
+    for (int loop=0; loop<scan_codec_shift_samples; loop++) {
+        int i = ( 2 * loop + 1 ) * nb / ( 2 * scan_codec_shift_samples );
+        if ( q[i] )
+            samples[nb_samples++] = i;
+    }
+    int best = predicted, best_count = -1;
+    for (int s=std::max(-nb + 1, shift - max_step); s<=std::min(nb - 1, shift + max_step); s++) {
+        int count = 0;
+        for (int loop=0; loop<nb_samples; loop++) {
+            int i = samples[loop];
+            count += ( i - s >= 0 ) && ( i - s < nb ) && ( abs((int)q[i] - (int)b[i - s]) <= config.static_tolerance );
+        }
+        if ( count > best_count ) {
+            best = s;
+            best_count = count;
+        }
+    }
+
+    // refinement; the predicted shift is replaced only if the best one leaves 1/8 less dynamic beams (the neighbouring
+    // shifts of a dense laser leave almost the same beams when it is stopped), the statics of the shift kept are
+    // computed last
+    const int predicted_dynamic = nb_dynamic;
+    int refined = best, refined_dynamic = nb + 1;
+    for (int s=best-1; s<=best+1; s++) {
+        int d = scan_codec::shifted_static_mask(q, b, nb, s, config.static_tolerance, &statics[0]);
+        if ( d < refined_dynamic ) {
+            refined = s;
+            refined_dynamic = d;
+        }
+    }
+    if ( refined_dynamic >= predicted_dynamic - predicted_dynamic / 8 )
+        refined = predicted;
+    nb_dynamic = scan_codec::shifted_static_mask(q, b, nb, refined, config.static_tolerance, &statics[0]);
+    return refined;
+
+}
+
+};
+
+class scan_decoder {
+public:
+
+    long nb_frames;// decoded
+    long nb_rejected;// malformed, or waiting for a keyframe
+
+scan_decoder() {
+
+    nb_frames = nb_rejected = 0;
+    has_background = false;
+    key_id = 0;
+
+}
+
+// false if the frame is malformed or if its keyframe has not been received
+bool decode(const uint8_t* data, size_t size, scan_frame& frame) {
+
+    if ( !decode_frame(data, size, frame) ) {
+        nb_rejected++;
+        return false;
+    }
+    nb_frames++;
+    return true;
+
+}
+
+private:
+
+    std::vector<uint16_t> quantized, background;
+    bool has_background;
+    uint8_t key_id;
+
+bool decode_frame(const uint8_t* data, size_t size, scan_frame& frame) {
+
+    if ( ( size < scan_codec_header_size ) || ( data[0] != scan_codec_magic ) )
+        return false;
+    uint32_t nb;
+    float geometry[4];
+    memcpy(&nb, data + 4, 4);
+    memcpy(geometry, data + 8, 16);
+    frame.keyframe = data[1] & 1;
+    frame.angle_min = geometry[0];
+    frame.angle_increment = geometry[1];
+    frame.range_min = geometry[2];
+    frame.range_max = geometry[3];
+    if ( nb > 1000000 )
+        return false;
+    if ( !frame.keyframe && ( !has_background || ( data[2] != key_id ) || ( background.size() != nb ) ) )
+        return false;
+
+    quantized.resize(nb);
+    const uint8_t* p = data + scan_codec_header_size;
+    const uint8_t* end = data + size;
+    int shift = 0;// of the background
+    if ( data[3] & 1 ) {
+        uint32_t v;
+        if ( frame.keyframe || !scan_codec::get_varint(p, end, v) )
+            return false;
+        shift = scan_codec::unzigzag(v);
+    }
+    int previous = 0;
+    uint32_t start = 0;
+    while ( start < nb ) {
+        uint32_t token;
+        if ( !scan_codec::get_varint(p, end, token) )
+            return false;
+        uint32_t length = token >> 1;
+        if ( !length || ( length > nb - start ) )
+            return false;
+        if ( !( token & 1 ) ) {
+            if ( frame.keyframe || ( (int64_t)start - shift < 0 ) || ( (int64_t)start + length - shift > nb ) )
+                return false;
+            memcpy(&quantized[start], &background[start - shift], length * sizeof(uint16_t));
+            previous = background[start + length - 1 - shift];
+        }
+        else
+            for (uint32_t loop=start; loop<start+length; loop++) {
+                uint32_t v;
+                if ( !scan_codec::get_varint(p, end, v) )
+                    return false;
+                previous += scan_codec::unzigzag(v);
+                if ( ( previous < 0 ) || ( previous > 65535 ) )
+                    return false;
+                quantized[loop] = previous;
+            }
+        start += length;
+    }
+
+    if ( frame.keyframe ) {
+        background = quantized;
+        key_id = data[2];
+        has_background = true;
+    }
+    frame.ranges.resize(nb);
+    if ( nb )
+        scan_codec::dequantize(&quantized[0], nb, &frame.ranges[0]);
+    return true;
+
+}
+
+};
+
+// the points of a marker, the colours packed as 0xRRGGBBAA
+struct compact_marker {
+
+    int id, type;
+    float scale_x, scale_y;// m
+    uint32_t color;// of the marker, used by the points without colour
+    std::vector<float> x, y;// m
+    std::vector<uint32_t> colors;// empty, or one per point
+
+};
+
+inline uint32_t pack_color(float r, float g, float b, float a) {
+
+    return ( (uint32_t)lround(std::min(std::max(r, 0.0f), 1.0f) * 255) << 24 ) | ( (uint32_t)lround(std::min(std::max(g, 0.0f), 1.0f) * 255) << 16 ) |
+           ( (uint32_t)lround(std::min(std::max(b, 0.0f), 1.0f) * 255) << 8 ) | (uint32_t)lround(std::min(std::max(a, 0.0f), 1.0f) * 255);
+
+}
+
+inline float color_channel(uint32_t color, int channel) { return ( ( color >> ( 24 - 8 * channel ) ) & 0xff ) / 255.0f; }
+
+// index of the colour c in the palette, added if needed; -1 if the palette is full
+inline int palette_index(uint32_t* palette, int& nb_colors, uint32_t c) {
+
+    for (int loop=0; loop<nb_colors; loop++)
+        if ( palette[loop] == c )
+            return loop;
+    if ( nb_colors == 255 )
+        return -1;
+    palette[nb_colors] = c;
+    return nb_colors++;
+
+}
+
+// encodes the marker in "out", returns its size in bytes (0 if it has more than 255 colours)
+inline size_t encode_marker(const compact_marker& m, std::vector<uint8_t>& out) {
+
+    const int nb = m.x.size();
+    uint32_t palette[255];
+    int nb_colors = 1;
+    palette[0] = m.color;
+    for (int loop=0; loop<(int)m.colors.size(); loop++)
+        if ( ( !loop || ( m.colors[loop] != m.colors[loop - 1] ) ) && ( palette_index(palette, nb_colors, m.colors[loop]) < 0 ) )
+            return 0;
+
+    // worst case: one run and two 5 bytes differences per point
+    out.resize(16 + 4 * nb_colors + 5 + 16 * nb);
+    uint8_t* w = &out[0];
+    *w++ = marker_codec_magic;
+    *w++ = m.type;
+    w = scan_codec::put_varint(w, scan_codec::zigzag(m.id));
+    w = scan_codec::put_varint(w, lround(m.scale_x * 1000));
+    w = scan_codec::put_varint(w, lround(m.scale_y * 1000));
+    *w++ = nb_colors;
+    memcpy(w, palette, 4 * nb_colors);
+    w += 4 * nb_colors;
+
+    w = scan_codec::put_varint(w, nb);
+    int previous_x = 0, previous_y = 0;
+    int start = 0;
+    while ( start < nb ) {
+        uint32_t c = m.colors.empty() ? m.color : m.colors[start];
+        int end = start + 1;
+        while ( ( end < nb ) && ( m.colors.empty() || ( m.colors[end] == c ) ) )
+            end++;
+        w = scan_codec::put_varint(w, end - start);
+        *w++ = palette_index(palette, nb_colors, c);
+        for (int loop=start; loop<end; loop++) {
+            int x = lround(m.x[loop] * 100), y = lround(m.y[loop] * 100);
+            w = scan_codec::put_varint(w, scan_codec::zigzag(x - previous_x));
+            w = scan_codec::put_varint(w, scan_codec::zigzag(y - previous_y));
+            previous_x = x;
+            previous_y = y;
+        }
+        start = end;
+    }
+    out.resize(w - &out[0]);
+    return out.size();
+
+}
+
+// false if the data is malformed
+inline bool decode_marker(const uint8_t* data, size_t size, compact_marker& m) {
+
+    const uint8_t* p = data;
+    const uint8_t* end = data + size;
+    uint32_t v, sx, sy;
+    if ( ( size < 3 ) || ( data[0] != marker_codec_magic ) )
+        return false;
+    m.type = data[1];
+    p += 2;
+    if ( !scan_codec::get_varint(p, end, v) || !scan_codec::get_varint(p, end, sx) || !scan_codec::get_varint(p, end, sy) || ( p >= end ) )
+        return false;
+    m.id = scan_codec::unzigzag(v);
+    m.scale_x = sx * 0.001f;
+    m.scale_y = sy * 0.001f;
+
+    int nb_colors = *p++;
+    if ( !nb_colors || ( end - p < 4 * nb_colors ) )
+        return false;
+    uint32_t palette[255];
+    memcpy(palette, p, 4 * nb_colors);
+    p += 4 * nb_colors;
+    m.color = palette[0];
+
+    uint32_t nb;
+    if ( !scan_codec::get_varint(p, end, nb) || ( nb > size * 4 ) )
+        return false;
+    m.x.resize(nb);
+    m.y.resize(nb);
+    m.colors.resize(nb);
+    int x = 0, y = 0;
+    uint32_t start = 0;
+    while ( start < nb ) {
+        uint32_t length, dx, dy;
+        if ( !scan_codec::get_varint(p, end, length) || !length || ( length > nb - start ) || ( p >= end ) || ( *p >= nb_colors ) )
+            return false;
+        uint32_t c = palette[*p++];
+        for (uint32_t loop=start; loop<start+length; loop++) {
+            if ( !scan_codec::get_varint(p, end, dx) || !scan_codec::get_varint(p, end, dy) )
+                return false;
+            x += scan_codec::unzigzag(dx);
+            y += scan_codec::unzigzag(dy);
+            m.x[loop] = x * 0.01f;
+            m.y[loop] = y * 0.01f;
+            m.colors[loop] = c;
+        }
+        start += length;
+    }
+    return true;
+
+}
+
+#endif
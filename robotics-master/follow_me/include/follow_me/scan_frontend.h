@@ -0,0 +1,215 @@
+// front-end of the detector: choice of the beams processed by the detection of motion and the clustering
+// - range-dependent angular decimation: two consecutive hits at range r are r * angle_increment apart, so a dense
+//   laser gives far more hits than needed on close objects. A beam at range r is kept on a grid of step 2^k, the
+//   largest power of 2 with 2^k * r * angle_increment <= decimation_spacing: beam i is kept when 2^k divides i. The
+//   test only needs the range of the beam itself, so a far object behind the edge of a close one keeps its fine step
+// - region of interest: an angular sector and a range limit (roi_range); the beams outside it are not processed, and
+//   the clustering does not join two kept hits across beams out of the region of interest
+// - deadline: when the processing time of a scan approaches the deadline, the range limit is tightened (down to
+//   roi_range_min); it is relaxed again, up to roi_range, when the processing time is well below the deadline
+// the mask of the kept beams is computed 4 beams at a time (see simd.h), and the beams are compacted into "selected"
+// with the default configuration, all the beams are kept
+
+#ifndef FOLLOW_ME_SCAN_FRONTEND_H
+#define FOLLOW_ME_SCAN_FRONTEND_H
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+#include "follow_me/simd.h"
+
+struct frontend_config {
+
+    float decimation_spacing;// m, 0: no decimation
+
+    // region of interest
+    float roi_range;// m, 0: range_max
+    float roi_angle_min, roi_angle_max;// rad, the whole scan if roi_angle_min >= roi_angle_max
+
+    // adaptation of the range of the region of interest to the processing time
+    double deadline;// s, 0: no adaptation
+    float tighten_ratio;// the range is tightened when the processing time is above tighten_ratio * deadline
+    float relax_ratio;// and relaxed when it is below relax_ratio * deadline
+    float tighten_factor, relax_factor;// applied to the range at each scan
+    float roi_range_min;// m
+
+};
+
+inline frontend_config default_frontend_config() {
+
+    frontend_config c;
+    c.decimation_spacing = 0;
+    c.roi_range = 0;
+    c.roi_angle_min = 0;
+    c.roi_angle_max = 0;
+    c.deadline = 0;
+    c.tighten_ratio = 0.8;
+    c.relax_ratio = 0.5;
+    c.tighten_factor = 0.9;
+    c.relax_factor = 1.05;
+    c.roi_range_min = 2;
+    return c;
+
+}
+
+class scan_frontend {
+public:
+
+    frontend_config config;
+
+    // beams kept for the current scan: the first nb_selected elements, with break_before set when beams out of the
+    // region of interest lie between a kept beam and the previous one
+    // the storage has the size of the scan and is reused from scan to scan
+    std::vector<int> selected;
+    std::vector<unsigned char> break_before;
+    int nb_selected;
+
+    float current_range;// m, range of the region of interest after the adaptation to the deadline
+    int nb_tightened;// scans after which the range has been tightened
+
+scan_frontend(const frontend_config& c = default_frontend_config()) {
+
+    config = c;
+    current_range = 0;
+    nb_tightened = 0;
+    nb_selected = 0;
+
+}
+
+// when the front-end is not active, all the beams are kept and the detector uses its full resolution loops
+bool active() const {
+
+    return ( config.decimation_spacing > 0 ) || ( config.roi_range > 0 ) || ( config.roi_angle_min < config.roi_angle_max ) || ( config.deadline > 0 );
+
+}
+
+// choice of the beams of a scan; range[] is already limited to [range_min, range_max]
+void select(const float* range, int nb, float angle_min, float angle_increment, float range_max) {
+
+    using namespace simd;
+
+    nb_selected = 0;
+    if ( nb <= 0 )
+        return;
+
+    const float roi_range = config.roi_range > 0 ? std::min(config.roi_range, range_max) : range_max;
+    if ( ( config.deadline <= 0 ) || ( current_range <= 0 ) || ( current_range > roi_range ) )
+        current_range = roi_range;
+    // without region of interest on the range, the beams without hit (at range_max) are kept
+    const float limit = current_range < range_max ? current_range : INFINITY;
+
+    if ( (int)selected.size() < nb + 4 ) {
+        // append() writes 4 beams at a time
+        selected.resize(nb + 4);
+        break_before.resize(nb + 4);
+    }
+    if ( (int)grid_factor.size() != nb )
+        build_grid(nb);
+
+    // angular sector
+    int first = 0, last = nb;
+    if ( ( config.roi_angle_min < config.roi_angle_max ) && ( angle_increment != 0 ) ) {
+        float a = ( config.roi_angle_min - angle_min ) / angle_increment, b = ( config.roi_angle_max - angle_min ) / angle_increment;
+        if ( a > b )
+            std::swap(a, b);
+        first = std::max(0, (int)ceil(a));
+        last = std::min(nb, (int)floor(b) + 1);
+    }
+
+    if ( ( config.decimation_spacing <= 0 ) && ( limit == INFINITY ) ) {
+        // angular sector only
+        for (int loop=first; loop<last; loop++) {
+            selected[nb_selected] = loop;
+            break_before[nb_selected++] = 0;
+        }
+        return;
+    }
+
+    // beam i is kept when range[i] * grid_factor[i] > decimation_spacing / angle_increment
+    const float4 grid_threshold(config.decimation_spacing / fabs(angle_increment)), range_limit(limit);
+    bool masked = false;// beams out of the region of interest since the last kept beam
+    int* kept = &selected[0];
+    unsigned char* kept_break = &break_before[0];
+    int n = 0;
+    int loop = first;
+    for (; loop+4<=last; loop+=4) {
+        const float4 r = load(range + loop), roi = r < range_limit;
+        const int in_roi = movemask(roi);
+        const int keep = movemask(( r * load(&grid_factor[loop]) > grid_threshold ) & roi);
+        if ( in_roi == 15 )
+            n = append(kept, kept_break, n, loop, keep, masked);
+        else
+            if ( !keep )
+                masked = true;
+        else
+            for (int lane=0; lane<4; lane++)
+                if ( keep & ( 1 << lane ) )
+                    n = append(kept, kept_break, n, loop + lane, 1, masked);
+                else
+                    masked |= !( in_roi & ( 1 << lane ) );
+    }
+    for (; loop<last; loop++)
+        if ( range[loop] < limit ) {
+            if ( range[loop] * grid_factor[loop] > config.decimation_spacing / fabs(angle_increment) )
+                n = append(kept, kept_break, n, loop, 1, masked);
+        }
+        else
+            masked = true;
+    nb_selected = n;
+
+}
+
+// adaptation of the range of the region of interest to the processing time of the last scan
+void adapt(double processing_time) {
+
+    if ( config.deadline <= 0 )
+        return;
+
+    if ( processing_time > config.tighten_ratio * config.deadline ) {
+        current_range = std::max(config.roi_range_min, current_range * config.tighten_factor);
+        nb_tightened++;
+    }
+    else if ( processing_time < config.relax_ratio * config.deadline )
+        current_range *= config.relax_factor;// not above roi_range, see select()
+
+}
+
+private:
+
+    // 2^(k+1) for a beam whose index is divisible by 2^k and not by 2^(k+1) (a large value for the beam 0, always kept)
+    std::vector<float> grid_factor;
+
+void build_grid(int nb) {
+
+    grid_factor.resize(nb);
+    grid_factor[0] = 1e30f;
+    for (int loop=1; loop<nb; loop++) {
+        float factor = 2;
+        for (int i=loop; !( i & 1 ); i>>=1)
+            factor *= 2;
+        grid_factor[loop] = factor;
+    }
+
+}
+
+// the kept beams among the 4 from "hit" (bits of "keep") are stored in order from kept[n]: the 4 slots are written,
+// and the number of kept beams is returned
+static int append(int* kept, unsigned char* kept_break, int n, int hit, int keep, bool& masked) {
+
+    static const int lanes[16][4] = { { 0, 0, 0, 0 }, { 0, 0, 0, 0 }, { 1, 0, 0, 0 }, { 0, 1, 0, 0 }, { 2, 0, 0, 0 }, { 0, 2, 0, 0 },
+                                      { 1, 2, 0, 0 }, { 0, 1, 2, 0 }, { 3, 0, 0, 0 }, { 0, 3, 0, 0 }, { 1, 3, 0, 0 }, { 0, 1, 3, 0 },
+                                      { 2, 3, 0, 0 }, { 0, 2, 3, 0 }, { 1, 2, 3, 0 }, { 0, 1, 2, 3 } };
+    static const int count[16] = { 0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4 };
+    if ( !keep )
+        return n;
+    simd::store(kept + n, simd::int4(hit) + simd::load(lanes[keep]));
+    kept_break[n] = masked;
+    kept_break[n + 1] = kept_break[n + 2] = kept_break[n + 3] = 0;
+    masked = false;
+    return n + count[keep];
+
+}
+
+};
+
+#endif
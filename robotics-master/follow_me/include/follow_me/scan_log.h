@@ -0,0 +1,222 @@
+// text log of laser scans and odometry, used by the offline benchmarks and tools
+// one record per line:
+//   scan <stamp> <angle_min> <angle_increment> <range_min> <range_max> <nb_beams> <range_0> ... <range_n-1>
+//   odom <stamp> <x> <y> <yaw> <linear_speed> <angular_speed>
+//   truth <stamp> <x> <y> <yaw>            (pose given by a simulator, optional)
+//   person <stamp> <x> <y>                 (label: a moving person in the frame of the laser, at the stamp of a scan)
+// a log is labeled if it has at least one person record: then every scan without person record has no moving person
+// the lines starting with '#' are comments, unknown records are ignored
+
+#ifndef FOLLOW_ME_SCAN_LOG_H
+#define FOLLOW_ME_SCAN_LOG_H
+
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+#include "follow_me/geometry.h"
+
+struct log_scan {
+
+    double stamp;
+    float angle_min, angle_increment;
+    float range_min, range_max;
+    std::vector<float> ranges;
+
+};
+
+struct log_pose {
+
+    double stamp;
+    float x, y, yaw;
+    float linear_speed, angular_speed;
+
+};
+
+struct log_person {
+
+    double stamp;// of the scan
+    float x, y;// m, in the frame of the laser
+
+};
+
+class scan_log {
+public:
+
+    std::vector<log_scan> scans;
+    std::vector<log_pose> odom;
+    std::vector<log_pose> truth;
+    std::vector<log_person> persons;// sorted by stamp
+
+bool load(const char* filename) {
+
+    FILE* f = fopen(filename, "r");
+    if ( !f )
+        return false;
+
+    std::string line;
+    char buffer[4096];
+    while ( fgets(buffer, sizeof(buffer), f) ) {
+        line += buffer;
+        if ( line.empty() || ( line[line.size()-1] != '\n' && !feof(f) ) )
+            continue;// the line is longer than the buffer
+        parse(line.c_str());
+        line.clear();
+    }
+    if ( !line.empty() )
+        parse(line.c_str());
+
+    fclose(f);
+    return true;
+
+}
+
+bool save(const char* filename) const {
+
+    FILE* f = fopen(filename, "w");
+    if ( !f )
+        return false;
+    fprintf(f, "# follow_me scan log\n");
+    for (size_t loop=0; loop<odom.size(); loop++)
+        write_odom(f, odom[loop]);
+    for (size_t loop=0; loop<truth.size(); loop++)
+        write_truth(f, truth[loop]);
+    for (size_t loop=0; loop<scans.size(); loop++)
+        write_scan(f, scans[loop]);
+    for (size_t loop=0; loop<persons.size(); loop++)
+        write_person(f, persons[loop]);
+    fclose(f);
+    return true;
+
+}
+
+static void write_scan(FILE* f, const log_scan& s) {
+
+    fprintf(f, "scan %.6f %f %f %f %f %i", s.stamp, s.angle_min, s.angle_increment, s.range_min, s.range_max, (int)s.ranges.size());
+    for (size_t loop=0; loop<s.ranges.size(); loop++)
+        fprintf(f, " %.4f", s.ranges[loop]);
+    fprintf(f, "\n");
+
+}
+
+static void write_odom(FILE* f, const log_pose& p) {
+
+    fprintf(f, "odom %.6f %f %f %f %f %f\n", p.stamp, p.x, p.y, p.yaw, p.linear_speed, p.angular_speed);
+
+}
+
+static void write_truth(FILE* f, const log_pose& p) {
+
+    fprintf(f, "truth %.6f %f %f %f\n", p.stamp, p.x, p.y, p.yaw);
+
+}
+
+static void write_person(FILE* f, const log_person& p) {
+
+    fprintf(f, "person %.6f %f %f\n", p.stamp, p.x, p.y);
+
+}
+
+bool labeled() const { return !persons.empty(); }
+
+// labels of the scan taken at "stamp": [first, last) in persons
+void persons_at(double stamp, size_t& first, size_t& last) const {
+
+    const double tolerance = 1e-6;// s, the stamps are written with 6 decimals
+    size_t low = 0, high = persons.size();
+    while ( low < high ) {
+        size_t middle = ( low + high ) / 2;
+        if ( persons[middle].stamp < stamp - tolerance )
+            low = middle + 1;
+        else
+            high = middle;
+    }
+    first = last = low;
+    while ( ( last < persons.size() ) && ( persons[last].stamp <= stamp + tolerance ) )
+        last++;
+
+}
+
+// pose of the list "poses" (sorted by stamp) interpolated at "stamp", false if out of range
+static bool interpolate(const std::vector<log_pose>& poses, double stamp, log_pose& result) {
+
+    if ( poses.empty() || ( stamp < poses.front().stamp ) || ( stamp > poses.back().stamp ) )
+        return false;
+
+    size_t low = 0, high = poses.size() - 1;
+    while ( high - low > 1 ) {
+        size_t middle = ( low + high ) / 2;
+        if ( poses[middle].stamp <= stamp )
+            low = middle;
+        else
+            high = middle;
+    }
+
+    const log_pose& a = poses[low];
+    const log_pose& b = poses[high];
+    float t = ( b.stamp > a.stamp ) ? ( stamp - a.stamp ) / ( b.stamp - a.stamp ) : 0;
+    float dyaw = angle_difference(b.yaw, a.yaw);
+
+    result = a;
+    result.stamp = stamp;
+    result.x = a.x + t * ( b.x - a.x );
+    result.y = a.y + t * ( b.y - a.y );
+    result.yaw = a.yaw + t * dyaw;
+    return true;
+
+}
+
+private:
+
+void parse(const char* line) {
+
+    char type[16];
+    int offset;
+    if ( sscanf(line, "%15s%n", type, &offset) != 1 || type[0] == '#' )
+        return;
+    line += offset;
+
+    if ( !strcmp(type, "scan") ) {
+        log_scan s;
+        int nb_beams;
+        if ( sscanf(line, "%lf %f %f %f %f %i%n", &s.stamp, &s.angle_min, &s.angle_increment, &s.range_min, &s.range_max, &nb_beams, &offset) != 6 )
+            return;
+        line += offset;
+        // a malformed line is ignored before any allocation: each range takes at least 2 characters (" 0"); a scan
+        // without beam is ignored too, as by the nodes
+        if ( ( nb_beams <= 0 ) || ( nb_beams > (int)strlen(line) / 2 ) )
+            return;
+        s.ranges.resize(nb_beams);
+        for (int loop=0; loop<nb_beams; loop++) {
+            if ( sscanf(line, "%f%n", &s.ranges[loop], &offset) != 1 )
+                return;
+            line += offset;
+        }
+        scans.push_back(s);
+    }
+    else
+        if ( !strcmp(type, "odom") ) {
+            log_pose p;
+            if ( sscanf(line, "%lf %f %f %f %f %f", &p.stamp, &p.x, &p.y, &p.yaw, &p.linear_speed, &p.angular_speed) == 6 )
+                odom.push_back(p);
+        }
+    else
+        if ( !strcmp(type, "truth") ) {
+            log_pose p;
+            p.linear_speed = p.angular_speed = 0;
+            if ( sscanf(line, "%lf %f %f %f", &p.stamp, &p.x, &p.y, &p.yaw) == 4 )
+                truth.push_back(p);
+        }
+    else
+        if ( !strcmp(type, "person") ) {
+            log_person p;
+            if ( sscanf(line, "%lf %f %f", &p.stamp, &p.x, &p.y) == 3 )
+                persons.push_back(p);
+        }
+
+}
+
+};
+
+#endif
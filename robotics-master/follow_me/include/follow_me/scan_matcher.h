@@ -0,0 +1,389 @@
+// incremental scan-to-scan matcher: point-to-line ICP with a projective correspondence search
+// - the reference scan is stored as one line segment per beam (between the hit of the beam and the hit of the next one)
+// - each point of the current scan, transformed by the current estimate, is projected on the beams of the reference
+//   scan with its angle: the segment of that beam is its correspondence (no search over the points)
+// - the residuals and the normal equations of Gauss-Newton are computed 4 points at a time (see simd.h)
+// the points are stored as structure of arrays
+
+#ifndef FOLLOW_ME_SCAN_MATCHER_H
+#define FOLLOW_ME_SCAN_MATCHER_H
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+#include "follow_me/geometry.h"
+#include "follow_me/simd.h"
+
+// 2d pose (or rigid transformation) x, y, theta
+struct pose2d {
+
+    float x, y, theta;
+
+};
+
+inline pose2d make_pose(float x, float y, float theta) {
+
+    pose2d p = { x, y, theta };
+    return p;
+
+}
+
+// a then b (b expressed in the frame of a)
+inline pose2d compose(const pose2d& a, const pose2d& b) {
+
+    float c = cos(a.theta), s = sin(a.theta);
+    return make_pose(a.x + c * b.x - s * b.y, a.y + s * b.x + c * b.y, normalize_angle(a.theta + b.theta));
+
+}
+
+inline pose2d inverse(const pose2d& a) {
+
+    float c = cos(a.theta), s = sin(a.theta);
+    return make_pose(-c * a.x - s * a.y, s * a.x - c * a.y, -a.theta);
+
+}
+
+// b expressed in the frame of a
+inline pose2d between(const pose2d& a, const pose2d& b) {
+
+    return compose(inverse(a), b);
+
+}
+
+struct scan_matcher_config {
+
+    int max_iterations;
+    float max_correspondence_distance;// at the first iteration
+    float min_correspondence_distance;// the distance is divided by 2 at each iteration down to this distance
+    float max_segment_length;// two consecutive hits farther than this distance do not form a line
+    float min_correspondence_ratio;// the match fails if less than this proportion of the points has a correspondence
+    float convergence;// the iterations stop when the update is smaller than this (m and rad)
+
+};
+
+inline scan_matcher_config default_scan_matcher_config() {
+
+    scan_matcher_config c;
+    c.max_iterations = 20;
+    c.max_correspondence_distance = 0.4;
+    c.min_correspondence_distance = 0.05;
+    c.max_segment_length = 0.3;
+    c.min_correspondence_ratio = 0.3;
+    c.convergence = 1e-4;
+    return c;
+
+}
+
+struct scan_match_result {
+
+    pose2d pose;// pose of the current scan in the frame of the reference scan
+    int nb_iterations;
+    int nb_correspondences;
+    float mean_residual;// m
+    bool success;
+
+};
+
+class scan_matcher {
+private:
+
+    scan_matcher_config config;
+
+    // reference scan: one line per beam, n.p = d, with a weight of 1 if the line is valid, 0 otherwise
+    int reference_nb_beams;
+    float reference_angle_min, reference_inverse_increment;
+    std::vector<float> line_nx, line_ny, line_d, line_weight;
+
+    // current scan: the valid hits, padded to a multiple of 4 with points of null weight
+    int nb_points;
+    std::vector<float> point_x, point_y, point_weight;
+
+public:
+
+scan_matcher(const scan_matcher_config& c = default_scan_matcher_config()) : config(c), reference_nb_beams(0), nb_points(0) {
+}
+
+bool has_reference() const {
+
+    return reference_nb_beams > 1;
+
+}
+
+void set_reference(const float* ranges, int nb_beams, float angle_min, float angle_increment, float range_min, float range_max) {
+
+    reference_nb_beams = nb_beams;
+    reference_angle_min = angle_min;
+    reference_inverse_increment = 1 / angle_increment;
+
+    // the tables are padded so that the gathers at index nb_beams - 1 are valid
+    line_nx.assign(nb_beams + 1, 0);
+    line_ny.assign(nb_beams + 1, 0);
+    line_d.assign(nb_beams + 1, 0);
+    line_weight.assign(nb_beams + 1, 0);
+
+    float previous_x = 0, previous_y = 0;
+    bool previous_valid = false;
+    float beam_angle = angle_min;
+    for (int loop=0; loop<nb_beams; loop++, beam_angle += angle_increment) {
+        float r = ranges[loop];
+        bool valid = ( r > range_min ) && ( r < range_max );
+        float x = r * cos(beam_angle);
+        float y = r * sin(beam_angle);
+
+        // the line of the previous beam goes from its hit to the hit of the current beam
+        if ( valid && previous_valid ) {
+            float dx = x - previous_x, dy = y - previous_y;
+            float length = sqrt(dx * dx + dy * dy);
+            if ( ( length > 1e-4 ) && ( length < config.max_segment_length ) ) {
+                line_nx[loop-1] = -dy / length;
+                line_ny[loop-1] = dx / length;
+                line_d[loop-1] = line_nx[loop-1] * previous_x + line_ny[loop-1] * previous_y;
+                line_weight[loop-1] = 1;
+            }
+        }
+
+        previous_x = x;
+        previous_y = y;
+        previous_valid = valid;
+    }
+
+}
+
+// pose of the scan "ranges" in the frame of the reference scan, starting from "guess"
+scan_match_result match(const float* ranges, int nb_beams, float angle_min, float angle_increment, float range_min, float range_max, const pose2d& guess) {
+
+    load_points(ranges, nb_beams, angle_min, angle_increment, range_min, range_max);
+
+    scan_match_result result;
+    result.pose = guess;
+    result.nb_iterations = 0;
+    result.nb_correspondences = 0;
+    result.mean_residual = 0;
+    result.success = false;
+
+    if ( !has_reference() || ( nb_points == 0 ) )
+        return result;
+
+    int nb_valid = 0;
+    for (int loop=0; loop<nb_points; loop++)
+        nb_valid += ( point_weight[loop] > 0 );
+
+    float max_distance = config.max_correspondence_distance;
+    for (int iteration=0; iteration<config.max_iterations; iteration++) {
+        float h[6], b[3], residual_sum;
+        int nb_correspondences;
+        normal_equations(result.pose, max_distance, h, b, residual_sum, nb_correspondences);
+
+        result.nb_iterations = iteration + 1;
+        result.nb_correspondences = nb_correspondences;
+        result.mean_residual = nb_correspondences ? residual_sum / nb_correspondences : 0;
+
+        if ( nb_correspondences < 3 )
+            return result;
+
+        // small damping for the degenerate cases (long corridors)
+        float damping = 1e-6 * nb_correspondences;
+        float delta[3];
+        if ( !solve(h[0] + damping, h[1], h[2], h[3] + damping, h[4], h[5] + damping, -b[0], -b[1], -b[2], delta) )
+            return result;
+
+        result.pose.x += delta[0];
+        result.pose.y += delta[1];
+        result.pose.theta += delta[2];
+
+        bool converged = ( fabs(delta[0]) < config.convergence ) && ( fabs(delta[1]) < config.convergence ) && ( fabs(delta[2]) < config.convergence );
+        if ( converged && ( max_distance <= config.min_correspondence_distance ) )
+            break;
+        if ( converged || ( iteration > 2 ) )
+            max_distance = std::max(config.min_correspondence_distance, max_distance / 2);
+    }
+
+    result.success = ( result.nb_correspondences >= config.min_correspondence_ratio * nb_valid );
+    return result;
+
+}
+
+private:
+
+void load_points(const float* ranges, int nb_beams, float angle_min, float angle_increment, float range_min, float range_max) {
+
+    point_x.resize(nb_beams + 3);
+    point_y.resize(nb_beams + 3);
+    point_weight.resize(nb_beams + 3);
+
+    nb_points = 0;
+    float beam_angle = angle_min;
+    for (int loop=0; loop<nb_beams; loop++, beam_angle += angle_increment)
+        if ( ( ranges[loop] > range_min ) && ( ranges[loop] < range_max ) ) {
+            point_x[nb_points] = ranges[loop] * cos(beam_angle);
+            point_y[nb_points] = ranges[loop] * sin(beam_angle);
+            point_weight[nb_points] = 1;
+            nb_points++;
+        }
+
+    while ( nb_points & 3 ) {
+        point_x[nb_points] = 0;
+        point_y[nb_points] = 0;
+        point_weight[nb_points] = 0;
+        nb_points++;
+    }
+
+}
+
+// normal equations H.delta = -b of the point-to-line residuals for the pose "p"
+// h: upper triangle of H (h00, h01, h02, h11, h12, h22)
+void normal_equations(const pose2d& p, float max_distance, float* h, float* b, float& residual_sum, int& nb_correspondences) const {
+
+    using namespace simd;
+
+    const float4 zero(0.0f);
+    const float4 c(cos(p.theta)), s(sin(p.theta));
+    const float4 tx(p.x), ty(p.y);
+    const float4 angle_min(reference_angle_min), inverse_increment(reference_inverse_increment);
+    const float4 last_line((float)( reference_nb_beams - 1 ));
+    const float4 full_turn(2 * M_PI * reference_inverse_increment);
+    const float4 distance(max_distance);
+    const int4 max_index(reference_nb_beams - 1), min_index(0);
+
+    float4 h00 = zero, h01 = zero, h02 = zero, h11 = zero, h12 = zero, h22 = zero;
+    float4 b0 = zero, b1 = zero, b2 = zero;
+    float4 residuals = zero, count = zero;
+
+    for (int loop=0; loop<nb_points; loop+=4) {
+        float4 x = load(&point_x[loop]);
+        float4 y = load(&point_y[loop]);
+        float4 w = load(&point_weight[loop]);
+
+        // the point in the frame of the reference scan
+        float4 rx = c * x - s * y + tx;
+        float4 ry = s * x + c * y + ty;
+
+        // projection on the beams of the reference scan
+        float4 beam = ( fast_atan2(ry, rx) - angle_min ) * inverse_increment;
+        beam = select(beam < zero, beam + full_turn, beam);// lasers with angle_min >= 0
+        float4 in_range = ( zero <= beam ) & ( beam < last_line );
+        int4 index = max(min_index, min(max_index, to_int(beam)));
+
+        float4 nx = gather(&line_nx[0], index);
+        float4 ny = gather(&line_ny[0], index);
+        float4 d = gather(&line_d[0], index);
+        float4 lw = gather(&line_weight[0], index);
+
+        float4 r = nx * rx + ny * ry - d;
+        float4 accepted = in_range & ( abs(r) < distance );
+        w = select(accepted, w * lw, zero);
+
+        // jacobian of the residual with respect to (x, y, theta)
+        float4 j2 = ny * ( rx - tx ) - nx * ( ry - ty );
+
+        float4 wnx = w * nx, wny = w * ny, wj2 = w * j2;
+        h00 = h00 + wnx * nx;
+        h01 = h01 + wnx * ny;
+        h02 = h02 + wnx * j2;
+        h11 = h11 + wny * ny;
+        h12 = h12 + wny * j2;
+        h22 = h22 + wj2 * j2;
+        b0 = b0 + wnx * r;
+        b1 = b1 + wny * r;
+        b2 = b2 + wj2 * r;
+        residuals = residuals + w * abs(r);
+        count = count + w;
+    }
+
+    h[0] = sum(h00);
+    h[1] = sum(h01);
+    h[2] = sum(h02);
+    h[3] = sum(h11);
+    h[4] = sum(h12);
+    h[5] = sum(h22);
+    b[0] = sum(b0);
+    b[1] = sum(b1);
+    b[2] = sum(b2);
+    residual_sum = sum(residuals);
+    nb_correspondences = (int)( sum(count) + 0.5f );
+
+}
+
+static float sum(simd::float4 a) {
+
+    float v[4];
+    simd::store(v, a);
+    return ( v[0] + v[1] ) + ( v[2] + v[3] );
+
+}
+
+// solve the symmetric 3x3 system with the Cramer's rule
+static bool solve(float a00, float a01, float a02, float a11, float a12, float a22, float b0, float b1, float b2, float* x) {
+
+    double det = a00 * ( a11 * a22 - a12 * a12 ) - a01 * ( a01 * a22 - a12 * a02 ) + a02 * ( a01 * a12 - a11 * a02 );
+    if ( fabs(det) < 1e-12 )
+        return false;
+
+    x[0] = ( b0 * ( a11 * a22 - a12 * a12 ) - a01 * ( b1 * a22 - a12 * b2 ) + a02 * ( b1 * a12 - a11 * b2 ) ) / det;
+    x[1] = ( a00 * ( b1 * a22 - a12 * b2 ) - b0 * ( a01 * a22 - a12 * a02 ) + a02 * ( a01 * b2 - b1 * a02 ) ) / det;
+    x[2] = ( a00 * ( a11 * b2 - b1 * a12 ) - a01 * ( a01 * b2 - b1 * a02 ) + b0 * ( a01 * a12 - a11 * a02 ) ) / det;
+    return true;
+
+}
+
+};
+
+// odometry corrected by scan matching: each scan is matched against the last keyframe, starting from the motion
+// given by the wheel odometry since that keyframe; a new keyframe is taken when the robot has moved enough
+class scan_odometry {
+private:
+
+    scan_matcher matcher;
+    float keyframe_distance, keyframe_angle;
+
+    bool init;
+    pose2d keyframe_pose;// corrected pose of the keyframe
+    pose2d keyframe_odom;// odometry at the keyframe
+
+public:
+
+    scan_match_result last_match;
+    int nb_failures;
+
+scan_odometry(float distance = 0.2, float angle = 0.2, const scan_matcher_config& c = default_scan_matcher_config())
+    : matcher(c), keyframe_distance(distance), keyframe_angle(angle), init(false), nb_failures(0) {
+}
+
+// corrected pose of the robot when the scan was acquired, "odom" being the wheel odometry at that time
+pose2d update(const float* ranges, int nb_beams, float angle_min, float angle_increment, float range_min, float range_max, const pose2d& odom) {
+
+    if ( !init ) {
+        init = true;
+        keyframe_pose = odom;
+        keyframe_odom = odom;
+        matcher.set_reference(ranges, nb_beams, angle_min, angle_increment, range_min, range_max);
+        last_match.pose = make_pose(0, 0, 0);
+        last_match.success = true;
+        return odom;
+    }
+
+    pose2d guess = between(keyframe_odom, odom);
+    last_match = matcher.match(ranges, nb_beams, angle_min, angle_increment, range_min, range_max, guess);
+
+    pose2d relative = guess;
+    if ( last_match.success )
+        relative = last_match.pose;
+    else
+        nb_failures++;
+
+    pose2d pose = compose(keyframe_pose, relative);
+
+    // new keyframe: the robot has moved enough, or the keyframe cannot be matched anymore
+    if ( !last_match.success || ( sqrt(relative.x * relative.x + relative.y * relative.y) > keyframe_distance ) || ( fabs(relative.theta) > keyframe_angle ) ) {
+        keyframe_pose = pose;
+        keyframe_odom = odom;
+        matcher.set_reference(ranges, nb_beams, angle_min, angle_increment, range_min, range_max);
+    }
+
+    return pose;
+
+}
+
+};
+
+#endif
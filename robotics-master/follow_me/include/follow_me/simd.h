@@ -0,0 +1,161 @@
+// minimal 4-lane float/int vectors used by the SIMD kernels of follow_me
+// SSE2 is used when available (x86), otherwise a portable scalar version is compiled
+// the kernels are written once with these types: no intrinsics outside this file
+
+#ifndef FOLLOW_ME_SIMD_H
+#define FOLLOW_ME_SIMD_H
+
+#include <cmath>
+#include <stdint.h>
+
+#if defined(__SSE2__) && !defined(FOLLOW_ME_NO_SIMD)
+#include <emmintrin.h>
+#define FOLLOW_ME_SSE2 1
+#endif
+
+namespace simd {
+
+#ifdef FOLLOW_ME_SSE2
+
+struct float4 {
+    __m128 v;
+    float4() {}
+    float4(__m128 x) : v(x) {}
+    explicit float4(float x) : v(_mm_set1_ps(x)) {}
+};
+
+struct int4 {
+    __m128i v;
+    int4() {}
+    int4(__m128i x) : v(x) {}
+    explicit int4(int x) : v(_mm_set1_epi32(x)) {}
+};
+
+inline float4 load(const float* p) { return _mm_loadu_ps(p); }
+inline void store(float* p, float4 a) { _mm_storeu_ps(p, a.v); }
+inline int4 load(const int* p) { return _mm_loadu_si128((const __m128i*)p); }
+inline void store(int* p, int4 a) { _mm_storeu_si128((__m128i*)p, a.v); }
+// 4 values in [0, 65535] stored as uint16 (SSE2 has no unsigned pack: the values are shifted to the signed range)
+inline int4 load(const uint16_t* p) { return _mm_unpacklo_epi16(_mm_loadl_epi64((const __m128i*)p), _mm_setzero_si128()); }
+inline void store(uint16_t* p, int4 a) {
+    __m128i b = _mm_sub_epi32(a.v, _mm_set1_epi32(32768));
+    b = _mm_xor_si128(_mm_packs_epi32(b, b), _mm_set1_epi16((short)0x8000));
+    _mm_storel_epi64((__m128i*)p, b);
+}
+
+inline float4 operator+(float4 a, float4 b) { return _mm_add_ps(a.v, b.v); }
+inline float4 operator-(float4 a, float4 b) { return _mm_sub_ps(a.v, b.v); }
+inline float4 operator*(float4 a, float4 b) { return _mm_mul_ps(a.v, b.v); }
+inline float4 operator/(float4 a, float4 b) { return _mm_div_ps(a.v, b.v); }
+inline float4 min(float4 a, float4 b) { return _mm_min_ps(a.v, b.v); }
+inline float4 max(float4 a, float4 b) { return _mm_max_ps(a.v, b.v); }
+inline float4 sqrt(float4 a) { return _mm_sqrt_ps(a.v); }
+inline float4 abs(float4 a) { return _mm_andnot_ps(_mm_set1_ps(-0.0f), a.v); }
+
+// comparisons return a mask: all bits set in the lanes where the comparison is true
+inline float4 operator<(float4 a, float4 b) { return _mm_cmplt_ps(a.v, b.v); }
+inline float4 operator>(float4 a, float4 b) { return _mm_cmpgt_ps(a.v, b.v); }
+inline float4 operator<=(float4 a, float4 b) { return _mm_cmple_ps(a.v, b.v); }
+inline float4 operator&(float4 a, float4 b) { return _mm_and_ps(a.v, b.v); }
+inline float4 operator|(float4 a, float4 b) { return _mm_or_ps(a.v, b.v); }
+// mask ? a : b
+inline float4 select(float4 mask, float4 a, float4 b) { return _mm_or_ps(_mm_and_ps(mask.v, a.v), _mm_andnot_ps(mask.v, b.v)); }
+// one bit per lane
+inline int movemask(float4 mask) { return _mm_movemask_ps(mask.v); }
+
+inline int4 operator+(int4 a, int4 b) { return _mm_add_epi32(a.v, b.v); }
+inline int4 operator-(int4 a, int4 b) { return _mm_sub_epi32(a.v, b.v); }
+inline int4 mullo(int4 a, int b) {
+    // SSE2 has no 32 bits mullo: the factors used here are small and positive
+    __m128i even = _mm_mul_epu32(a.v, _mm_set1_epi32(b));
+    __m128i odd = _mm_mul_epu32(_mm_srli_si128(a.v, 4), _mm_set1_epi32(b));
+    return _mm_unpacklo_epi32(_mm_shuffle_epi32(even, _MM_SHUFFLE(0, 0, 2, 0)), _mm_shuffle_epi32(odd, _MM_SHUFFLE(0, 0, 2, 0)));
+}
+inline int4 min(int4 a, int4 b) { __m128i m = _mm_cmplt_epi32(a.v, b.v); return _mm_or_si128(_mm_and_si128(m, a.v), _mm_andnot_si128(m, b.v)); }
+inline int4 max(int4 a, int4 b) { __m128i m = _mm_cmpgt_epi32(a.v, b.v); return _mm_or_si128(_mm_and_si128(m, a.v), _mm_andnot_si128(m, b.v)); }
+
+// conversions: truncation toward 0
+inline int4 to_int(float4 a) { return _mm_cvttps_epi32(a.v); }
+inline float4 to_float(int4 a) { return _mm_cvtepi32_ps(a.v); }
+
+#else
+
+struct float4 {
+    float v[4];
+    float4() {}
+    explicit float4(float x) { v[0] = v[1] = v[2] = v[3] = x; }
+};
+
+struct int4 {
+    int v[4];
+    int4() {}
+    explicit int4(int x) { v[0] = v[1] = v[2] = v[3] = x; }
+};
+
+#define FOLLOW_ME_LANES(type, expr) type r; for (int i=0; i<4; i++) r.v[i] = expr; return r;
+
+inline float4 load(const float* p) { FOLLOW_ME_LANES(float4, p[i]) }
+inline void store(float* p, float4 a) { for (int i=0; i<4; i++) p[i] = a.v[i]; }
+inline int4 load(const int* p) { FOLLOW_ME_LANES(int4, p[i]) }
+inline void store(int* p, int4 a) { for (int i=0; i<4; i++) p[i] = a.v[i]; }
+inline int4 load(const uint16_t* p) { FOLLOW_ME_LANES(int4, p[i]) }
+inline void store(uint16_t* p, int4 a) { for (int i=0; i<4; i++) p[i] = (uint16_t)a.v[i]; }
+
+inline float4 operator+(float4 a, float4 b) { FOLLOW_ME_LANES(float4, a.v[i] + b.v[i]) }
+inline float4 operator-(float4 a, float4 b) { FOLLOW_ME_LANES(float4, a.v[i] - b.v[i]) }
+inline float4 operator*(float4 a, float4 b) { FOLLOW_ME_LANES(float4, a.v[i] * b.v[i]) }
+inline float4 operator/(float4 a, float4 b) { FOLLOW_ME_LANES(float4, a.v[i] / b.v[i]) }
+inline float4 min(float4 a, float4 b) { FOLLOW_ME_LANES(float4, a.v[i] < b.v[i] ? a.v[i] : b.v[i]) }
+inline float4 max(float4 a, float4 b) { FOLLOW_ME_LANES(float4, a.v[i] > b.v[i] ? a.v[i] : b.v[i]) }
+inline float4 sqrt(float4 a) { FOLLOW_ME_LANES(float4, std::sqrt(a.v[i])) }
+inline float4 abs(float4 a) { FOLLOW_ME_LANES(float4, std::fabs(a.v[i])) }
+
+// the masks of the scalar version are 1.0 (true) or 0.0 (false)
+inline float4 operator<(float4 a, float4 b) { FOLLOW_ME_LANES(float4, a.v[i] < b.v[i] ? 1.0f : 0.0f) }
+inline float4 operator>(float4 a, float4 b) { FOLLOW_ME_LANES(float4, a.v[i] > b.v[i] ? 1.0f : 0.0f) }
+inline float4 operator<=(float4 a, float4 b) { FOLLOW_ME_LANES(float4, a.v[i] <= b.v[i] ? 1.0f : 0.0f) }
+inline float4 operator&(float4 a, float4 b) { FOLLOW_ME_LANES(float4, ( a.v[i] != 0 && b.v[i] != 0 ) ? 1.0f : 0.0f) }
+inline float4 operator|(float4 a, float4 b) { FOLLOW_ME_LANES(float4, ( a.v[i] != 0 || b.v[i] != 0 ) ? 1.0f : 0.0f) }
+inline float4 select(float4 mask, float4 a, float4 b) { FOLLOW_ME_LANES(float4, mask.v[i] != 0 ? a.v[i] : b.v[i]) }
+inline int movemask(float4 mask) { int r = 0; for (int i=0; i<4; i++) if ( mask.v[i] != 0 ) r |= 1 << i; return r; }
+
+inline int4 operator+(int4 a, int4 b) { FOLLOW_ME_LANES(int4, a.v[i] + b.v[i]) }
+inline int4 operator-(int4 a, int4 b) { FOLLOW_ME_LANES(int4, a.v[i] - b.v[i]) }
+inline int4 mullo(int4 a, int b) { FOLLOW_ME_LANES(int4, a.v[i] * b) }
+inline int4 min(int4 a, int4 b) { FOLLOW_ME_LANES(int4, a.v[i] < b.v[i] ? a.v[i] : b.v[i]) }
+inline int4 max(int4 a, int4 b) { FOLLOW_ME_LANES(int4, a.v[i] > b.v[i] ? a.v[i] : b.v[i]) }
+
+inline int4 to_int(float4 a) { FOLLOW_ME_LANES(int4, (int)a.v[i]) }
+inline float4 to_float(int4 a) { FOLLOW_ME_LANES(float4, (float)a.v[i]) }
+
+#undef FOLLOW_ME_LANES
+
+#endif
+
+// atan2 approximated by a polynomial (max error about 1e-5 rad)
+inline float4 fast_atan2(float4 y, float4 x) {
+
+    const float4 zero(0.0f);
+    float4 ax = abs(x), ay = abs(y);
+    float4 a = min(ax, ay) / ( max(ax, ay) + float4(1e-30f) );
+    float4 s = a * a;
+    float4 r = ( ( float4(-0.0464964749f) * s + float4(0.15931422f) ) * s - float4(0.327622764f) ) * s * a + a;
+    r = select(ax < ay, float4(1.57079637f) - r, r);
+    r = select(x < zero, float4(3.14159274f) - r, r);
+    return select(y < zero, zero - r, r);
+
+}
+
+// gather of 4 values of a table
+inline float4 gather(const float* table, int4 index) {
+
+    int i[4];
+    store(i, index);
+    float r[4] = { table[i[0]], table[i[1]], table[i[2]], table[i[3]] };
+    return load(r);
+
+}
+
+}
+
+#endif
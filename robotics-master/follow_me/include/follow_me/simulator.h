@@ -0,0 +1,539 @@
+// headless 2D simulator: a polygonal world, walking people and a differential-drive robot with a laser
+// it does not depend on ROS: simulator_node publishes its output, the benchmarks and the tools use it directly
+//
+// world file: one element per line, the lines starting with '#' are comments
+//   wall <x1> <y1> <x2> <y2>
+//   polygon <x1> <y1> <x2> <y2> ... <xn> <yn>            (closed)
+//   box <x> <y> <half_width> <half_height>
+//   robot <x> <y> <theta>
+//   person <speed> <loop> <x1> <y1> <wait1> ... <xn> <yn> <waitn>
+// a person walks at <speed> from waypoint to waypoint and waits <wait> seconds at each of them;
+// with <loop> = 1 it goes back to the first waypoint after the last one, otherwise it stays at the last one
+
+#ifndef FOLLOW_ME_SIMULATOR_H
+#define FOLLOW_ME_SIMULATOR_H
+
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <stdint.h>
+#include <vector>
+#include "follow_me/geometry.h"
+#include "follow_me/simd.h"
+
+struct sim_segment {
+
+    float x1, y1, x2, y2;
+
+};
+
+struct sim_waypoint {
+
+    float x, y;
+    float wait;// s
+
+};
+
+struct sim_person {
+
+    std::vector<sim_waypoint> waypoints;
+    float speed;// m/s
+    bool loop;
+
+    // state
+    float x, y, heading;
+    int next_waypoint;
+    float waiting;// s already spent at the current waypoint
+    float phase;// of the gait
+    bool walking;
+
+};
+
+struct sim_config {
+
+    // laser, at the center of the robot
+    int nb_beams;
+    float angle_min, angle_max;
+    float range_min, range_max;
+    float range_noise;// m, standard deviation
+
+    // robot
+    float robot_radius;
+    float max_linear_acceleration, max_angular_acceleration;
+    float command_timeout;// s, the robot stops if it does not receive any command
+    float odom_linear_error, odom_angular_error;// relative error of the odometry (0.02 = the odometry overestimates by 2%)
+
+    // legs of the people
+    float leg_radius;
+    float legs_distance;// between the centers of the legs
+    float stride;// m, length of a step
+
+    uint32_t seed;
+
+};
+
+// the Hokuyo URG-04LX of robair (see hokuyo_urg_traits in detector_core.h), a robot of the size of robair
+inline sim_config default_sim_config() {
+
+    sim_config c;
+    c.nb_beams = 726;
+    c.angle_min = -2.356194;
+    c.angle_max = 2.092350;
+    c.range_min = 0.02;
+    c.range_max = 5.6;
+    c.range_noise = 0.01;
+    c.robot_radius = 0.25;
+    c.max_linear_acceleration = 1.0;
+    c.max_angular_acceleration = 3.0;
+    c.command_timeout = 0.5;
+    c.odom_linear_error = 0;
+    c.odom_angular_error = 0;
+    c.leg_radius = 0.06;
+    c.legs_distance = 0.25;
+    c.stride = 0.6;
+    c.seed = 1;
+    return c;
+
+}
+
+class simulator {
+public:
+
+    sim_config config;
+
+    std::vector<sim_segment> walls;
+    std::vector<sim_person> people;
+
+    // true pose and speeds of the robot
+    float x, y, theta;
+    float linear_speed, angular_speed;
+    // pose integrated by the odometry
+    float odom_x, odom_y, odom_theta;
+
+    double time;// s, simulated time
+    int nb_collisions;// steps during which the robot was stopped by a wall or a person
+
+simulator(const sim_config& c = default_sim_config()) {
+
+    config = c;
+    time = 0;
+    nb_collisions = 0;
+    random_state = config.seed ? config.seed : 1;
+    command_linear = command_angular = 0;
+    command_stamp = -1e9;
+    set_robot(0, 0, 0);
+    set_beams();
+
+}
+
+void set_robot(float rx, float ry, float rtheta) {
+
+    x = odom_x = rx;
+    y = odom_y = ry;
+    theta = odom_theta = rtheta;
+    linear_speed = angular_speed = 0;
+
+}
+
+void add_wall(float x1, float y1, float x2, float y2) {
+
+    sim_segment s = { x1, y1, x2, y2 };
+    walls.push_back(s);
+
+}
+
+void add_box(float cx, float cy, float half_width, float half_height) {
+
+    add_wall(cx - half_width, cy - half_height, cx + half_width, cy - half_height);
+    add_wall(cx + half_width, cy - half_height, cx + half_width, cy + half_height);
+    add_wall(cx + half_width, cy + half_height, cx - half_width, cy + half_height);
+    add_wall(cx - half_width, cy + half_height, cx - half_width, cy - half_height);
+
+}
+
+void add_person(const std::vector<sim_waypoint>& waypoints, float speed, bool loop) {
+
+    if ( waypoints.empty() )
+        return;
+
+    sim_person p;
+    p.waypoints = waypoints;
+    p.speed = speed;
+    p.loop = loop;
+    p.x = waypoints[0].x;
+    p.y = waypoints[0].y;
+    p.heading = 0;
+    if ( waypoints.size() > 1 )
+        p.heading = atan2(waypoints[1].y - p.y, waypoints[1].x - p.x);
+    p.next_waypoint = waypoints.size() > 1 ? 1 : 0;
+    p.waiting = 0;
+    p.phase = 0;
+    p.walking = false;
+    people.push_back(p);
+
+}
+
+// a 10m x 8m room with some furniture and one person walking a loop in front of the robot
+void default_world() {
+
+    walls.clear();
+    people.clear();
+    add_box(0, 0, 5, 4);
+    add_box(3, 2.5, 0.3, 0.3);
+    add_box(-3, -2.5, 0.4, 0.2);
+    add_box(-3.5, 2.8, 0.25, 0.25);
+    set_robot(-2, 0, 0);
+
+    sim_waypoint w[4] = { { 0, 0, 3 }, { 2, 1, 1 }, { 1, -2, 2 }, { -0.5, -1, 0 } };
+    add_person(std::vector<sim_waypoint>(w, w + 4), 0.8, true);
+
+}
+
+bool load(const char* filename) {
+
+    FILE* f = fopen(filename, "r");
+    if ( !f )
+        return false;
+
+    walls.clear();
+    people.clear();
+    char line[4096];
+    while ( fgets(line, sizeof(line), f) )
+        parse(line);
+
+    fclose(f);
+    return true;
+
+}
+
+// command received from cmd_vel at the current time
+void set_command(float linear, float angular) {
+
+    command_linear = linear;
+    command_angular = angular;
+    command_stamp = time;
+
+}
+
+// advance the simulation of dt seconds
+void step(float dt) {
+
+    move_robot(dt);
+    for (size_t loop=0; loop<people.size(); loop++)
+        move_person(people[loop], dt);
+    time += dt;
+
+}
+
+// centers of the two legs of a person: they oscillate along the heading when the person walks
+void legs(const sim_person& p, float* legs_x, float* legs_y) const {
+
+    float c = cos(p.heading), s = sin(p.heading);
+    float swing = p.walking ? 0.25f * config.stride * sin(p.phase) : 0;
+    float side = config.legs_distance / 2;
+
+    legs_x[0] = p.x + swing * c - side * s;
+    legs_y[0] = p.y + swing * s + side * c;
+    legs_x[1] = p.x - swing * c + side * s;
+    legs_y[1] = p.y - swing * s - side * c;
+
+}
+
+// scan from the true pose of the robot: "ranges" must have config.nb_beams elements
+void scan(float* ranges) {
+
+    if ( (int)beam_cos.size() != padded_size(config.nb_beams) )
+        set_beams();
+    int nb = beam_cos.size();
+
+    // direction of the beams in the world frame
+    float c = cos(theta), s = sin(theta);
+    direction_x.resize(nb);
+    direction_y.resize(nb);
+    scan_ranges.resize(nb);
+    for (int loop=0; loop<nb; loop++) {
+        direction_x[loop] = c * beam_cos[loop] - s * beam_sin[loop];
+        direction_y[loop] = s * beam_cos[loop] + c * beam_sin[loop];
+        scan_ranges[loop] = config.range_max;
+    }
+
+    for (size_t loop=0; loop<walls.size(); loop++)
+        cast_segment(walls[loop].x1 - x, walls[loop].y1 - y, walls[loop].x2 - x, walls[loop].y2 - y);
+
+    for (size_t loop=0; loop<people.size(); loop++) {
+        float legs_x[2], legs_y[2];
+        legs(people[loop], legs_x, legs_y);
+        for (int leg=0; leg<2; leg++)
+            cast_circle(legs_x[leg] - x, legs_y[leg] - y, config.leg_radius);
+    }
+
+    for (int loop=0; loop<config.nb_beams; loop++) {
+        float r = scan_ranges[loop];
+        if ( r < config.range_max ) {
+            r += config.range_noise * gaussian();
+            if ( r >= config.range_max )
+                r = config.range_max;
+            if ( r < config.range_min )
+                r = config.range_min;
+        }
+        ranges[loop] = r;
+    }
+
+}
+
+float angle_increment() const { return ( config.angle_max - config.angle_min ) / ( config.nb_beams - 1 ); }
+
+private:
+
+    float command_linear, command_angular;
+    double command_stamp;
+    uint32_t random_state;
+
+    // angle of the beams in the frame of the robot, padded to a multiple of 4
+    std::vector<float> beam_cos, beam_sin;
+    std::vector<float> direction_x, direction_y, scan_ranges;
+
+static int padded_size(int n) { return ( n + 3 ) & ~3; }
+
+void set_beams() {
+
+    int nb = padded_size(config.nb_beams);
+    beam_cos.resize(nb);
+    beam_sin.resize(nb);
+    float increment = angle_increment();
+    for (int loop=0; loop<nb; loop++) {
+        float a = config.angle_min + loop * increment;
+        beam_cos[loop] = cos(a);
+        beam_sin[loop] = sin(a);
+    }
+
+}
+
+// intersection of all the beams with a segment given in the frame of the laser (translation only)
+void cast_segment(float x1, float y1, float x2, float y2) {
+
+    // the segment is too far to be seen
+    float ex = x2 - x1, ey = y2 - y1;
+    float length2 = ex * ex + ey * ey;
+    float t = length2 > 0 ? -( x1 * ex + y1 * ey ) / length2 : 0;
+    t = t < 0 ? 0 : ( t > 1 ? 1 : t );
+    float px = x1 + t * ex, py = y1 + t * ey;
+    if ( px * px + py * py > config.range_max * config.range_max )
+        return;
+
+    const simd::float4 zero(0.0f), one(1.0f), epsilon(1e-9f);
+    const simd::float4 ax(x1), ay(y1), vx(ex), vy(ey);
+    const simd::float4 numerator_t = ax * vy - ay * vx;
+    int nb = beam_cos.size();
+    for (int loop=0; loop<nb; loop+=4) {
+        simd::float4 dx = simd::load(&direction_x[loop]);
+        simd::float4 dy = simd::load(&direction_y[loop]);
+        simd::float4 best = simd::load(&scan_ranges[loop]);
+
+        simd::float4 denominator = dx * vy - dy * vx;
+        simd::float4 valid = epsilon < simd::abs(denominator);
+        simd::float4 inverse = one / simd::select(valid, denominator, one);
+        simd::float4 range = numerator_t * inverse;
+        simd::float4 u = ( ax * dy - ay * dx ) * inverse;
+
+        valid = valid & ( zero < range ) & ( range < best ) & ( zero <= u ) & ( u <= one );
+        simd::store(&scan_ranges[loop], simd::select(valid, range, best));
+    }
+
+}
+
+// intersection of all the beams with a circle given in the frame of the laser
+void cast_circle(float cx, float cy, float radius) {
+
+    float c = cx * cx + cy * cy - radius * radius;
+    if ( ( c < 0 ) || ( sqrt(cx * cx + cy * cy) - radius > config.range_max ) )
+        return;// the laser is inside the circle or the circle is too far
+
+    const simd::float4 zero(0.0f), vc(c), vx(cx), vy(cy);
+    int nb = beam_cos.size();
+    for (int loop=0; loop<nb; loop+=4) {
+        simd::float4 dx = simd::load(&direction_x[loop]);
+        simd::float4 dy = simd::load(&direction_y[loop]);
+        simd::float4 best = simd::load(&scan_ranges[loop]);
+
+        simd::float4 b = dx * vx + dy * vy;
+        simd::float4 discriminant = b * b - vc;
+        simd::float4 range = b - simd::sqrt(simd::max(discriminant, zero));
+
+        simd::float4 valid = ( zero < discriminant ) & ( zero < range ) & ( range < best );
+        simd::store(&scan_ranges[loop], simd::select(valid, range, best));
+    }
+
+}
+
+void move_robot(float dt) {
+
+    // the commands are followed with limited accelerations
+    float target_linear = 0, target_angular = 0;
+    if ( time - command_stamp <= config.command_timeout ) {
+        target_linear = command_linear;
+        target_angular = command_angular;
+    }
+    linear_speed = approach(linear_speed, target_linear, config.max_linear_acceleration * dt);
+    angular_speed = approach(angular_speed, target_angular, config.max_angular_acceleration * dt);
+
+    // unicycle model
+    float new_theta = theta + angular_speed * dt;
+    float middle = theta + angular_speed * dt / 2;
+    float new_x = x + linear_speed * dt * cos(middle);
+    float new_y = y + linear_speed * dt * sin(middle);
+
+    if ( ( linear_speed != 0 ) && collides(new_x, new_y) ) {
+        // the robot is blocked: it can still rotate
+        nb_collisions++;
+        linear_speed = 0;
+        new_x = x;
+        new_y = y;
+    }
+    x = new_x;
+    y = new_y;
+    theta = normalize_angle(new_theta);
+
+    // the odometry integrates the measured speeds
+    float odom_linear = linear_speed * ( 1 + config.odom_linear_error );
+    float odom_angular = angular_speed * ( 1 + config.odom_angular_error );
+    float odom_middle = odom_theta + odom_angular * dt / 2;
+    odom_x += odom_linear * dt * cos(odom_middle);
+    odom_y += odom_linear * dt * sin(odom_middle);
+    odom_theta = normalize_angle(odom_theta + odom_angular * dt);
+
+}
+
+void move_person(sim_person& p, float dt) {
+
+    p.walking = false;
+    if ( p.waypoints.size() < 2 )
+        return;
+
+    const sim_waypoint& target = p.waypoints[p.next_waypoint];
+    float dx = target.x - p.x, dy = target.y - p.y;
+    float distance = sqrt(dx * dx + dy * dy);
+
+    if ( distance < 1e-3 ) {
+        // at the waypoint: wait, then go to the next one
+        bool last = ( p.next_waypoint == (int)p.waypoints.size() - 1 );
+        if ( last && !p.loop )
+            return;
+        p.waiting += dt;
+        if ( p.waiting >= target.wait ) {
+            p.waiting = 0;
+            p.next_waypoint = ( p.next_waypoint + 1 ) % p.waypoints.size();
+        }
+        return;
+    }
+
+    float move = p.speed * dt;
+    if ( move > distance )
+        move = distance;
+    p.heading = atan2(dy, dx);
+    p.x += move * dx / distance;
+    p.y += move * dy / distance;
+    // one period of the gait every two steps
+    p.phase += M_PI * move / config.stride;
+    p.walking = true;
+
+}
+
+// the robot, at (px, py), overlaps a wall or a leg
+bool collides(float px, float py) const {
+
+    float r2 = config.robot_radius * config.robot_radius;
+    for (size_t loop=0; loop<walls.size(); loop++) {
+        const sim_segment& s = walls[loop];
+        float ex = s.x2 - s.x1, ey = s.y2 - s.y1;
+        float length2 = ex * ex + ey * ey;
+        float t = length2 > 0 ? ( ( px - s.x1 ) * ex + ( py - s.y1 ) * ey ) / length2 : 0;
+        t = t < 0 ? 0 : ( t > 1 ? 1 : t );
+        float qx = s.x1 + t * ex - px, qy = s.y1 + t * ey - py;
+        if ( qx * qx + qy * qy < r2 )
+            return true;
+    }
+
+    float r = config.robot_radius + config.leg_radius;
+    for (size_t loop=0; loop<people.size(); loop++) {
+        float legs_x[2], legs_y[2];
+        legs(people[loop], legs_x, legs_y);
+        for (int leg=0; leg<2; leg++)
+            if ( ( legs_x[leg] - px ) * ( legs_x[leg] - px ) + ( legs_y[leg] - py ) * ( legs_y[leg] - py ) < r * r )
+                return true;
+    }
+    return false;
+
+}
+
+static float approach(float value, float target, float max_change) {
+
+    if ( target > value + max_change )
+        return value + max_change;
+    if ( target < value - max_change )
+        return value - max_change;
+    return target;
+
+}
+
+// xorshift generator: the runs are reproducible for a given seed
+float uniform() {
+
+    random_state ^= random_state << 13;
+    random_state ^= random_state >> 17;
+    random_state ^= random_state << 5;
+    return ( random_state & 0xffffff ) / 16777216.0f;
+
+}
+
+// approximated by the sum of 4 uniform variables
+float gaussian() {
+
+    return ( uniform() + uniform() + uniform() + uniform() - 2 ) * 1.7320508f;
+
+}
+
+void parse(const char* line) {
+
+    char type[16];
+    int offset;
+    if ( sscanf(line, "%15s%n", type, &offset) != 1 || type[0] == '#' )
+        return;
+    line += offset;
+
+    std::vector<float> values;
+    float value;
+    while ( sscanf(line, "%f%n", &value, &offset) == 1 ) {
+        values.push_back(value);
+        line += offset;
+    }
+
+    if ( !strcmp(type, "wall") && values.size() == 4 )
+        add_wall(values[0], values[1], values[2], values[3]);
+    else
+        if ( !strcmp(type, "polygon") && values.size() >= 4 ) {
+            int nb = values.size() / 2;
+            for (int loop=0; loop<nb; loop++)
+                add_wall(values[2*loop], values[2*loop+1], values[2*((loop+1)%nb)], values[2*((loop+1)%nb)+1]);
+        }
+    else
+        if ( !strcmp(type, "box") && values.size() == 4 )
+            add_box(values[0], values[1], values[2], values[3]);
+    else
+        if ( !strcmp(type, "robot") && values.size() == 3 )
+            set_robot(values[0], values[1], values[2]);
+    else
+        if ( !strcmp(type, "person") && values.size() >= 5 ) {
+            std::vector<sim_waypoint> waypoints;
+            for (size_t loop=2; loop+2<values.size(); loop+=3) {
+                sim_waypoint w = { values[loop], values[loop+1], values[loop+2] };
+                waypoints.push_back(w);
+            }
+            add_person(waypoints, values[0], values[1] != 0);
+        }
+
+}
+
+};
+
+#endif
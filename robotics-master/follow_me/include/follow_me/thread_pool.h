@@ -0,0 +1,131 @@
+// fixed pool of worker threads to split a loop over independent items
+// the calling thread takes part in the work, so a pool of 0 workers runs the loop sequentially
+
+#ifndef FOLLOW_ME_THREAD_POOL_H
+#define FOLLOW_ME_THREAD_POOL_H
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+class thread_pool {
+private:
+
+    std::vector<std::thread> workers;
+
+    std::mutex mutex;
+    std::condition_variable work_available, work_finished;
+
+    // current job: the items [0, nb_items) are processed by chunks of "chunk" items
+    const std::function<void(int, int)>* job;
+    int nb_items, chunk;
+    std::atomic<int> next_item;
+    int nb_busy;// number of workers still processing the current job
+    unsigned generation;// incremented for each new job
+    bool stop;
+
+public:
+
+explicit thread_pool(int nb_workers = -1) : job(0), nb_items(0), chunk(1), next_item(0), nb_busy(0), generation(0), stop(false) {
+
+    // by default, one worker per core, the calling thread being one of them
+    if ( nb_workers < 0 ) {
+        nb_workers = std::thread::hardware_concurrency();
+        nb_workers = ( nb_workers > 1 ) ? nb_workers - 1 : 0;
+    }
+    for (int loop=0; loop<nb_workers; loop++)
+        workers.push_back(std::thread(&thread_pool::worker, this));
+
+}
+
+~thread_pool() {
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stop = true;
+    }
+    work_available.notify_all();
+    for (size_t loop=0; loop<workers.size(); loop++)
+        workers[loop].join();
+
+}
+
+int size() const {
+
+    return workers.size() + 1;
+
+}
+
+// call fn(begin, end) on consecutive ranges of at most "chunk_size" items until [0, nb) is covered
+// returns when all the items have been processed
+void parallel_for(int nb, int chunk_size, const std::function<void(int, int)>& fn) {
+
+    if ( nb <= 0 )
+        return;
+    if ( workers.empty() || ( nb <= chunk_size ) ) {
+        fn(0, nb);
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        job = &fn;
+        nb_items = nb;
+        chunk = chunk_size;
+        next_item = 0;
+        nb_busy = workers.size();
+        generation++;
+    }
+    work_available.notify_all();
+
+    process(fn, nb, chunk_size);
+
+    std::unique_lock<std::mutex> lock(mutex);
+    while ( nb_busy )
+        work_finished.wait(lock);
+    job = 0;
+
+}
+
+private:
+
+void process(const std::function<void(int, int)>& fn, int nb, int chunk_size) {
+
+    for (int begin = next_item.fetch_add(chunk_size); begin < nb; begin = next_item.fetch_add(chunk_size))
+        fn(begin, ( begin + chunk_size < nb ) ? begin + chunk_size : nb);
+
+}
+
+void worker() {
+
+    unsigned seen = 0;
+    while ( true ) {
+        const std::function<void(int, int)>* fn;
+        int nb, chunk_size;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            while ( !stop && ( generation == seen ) )
+                work_available.wait(lock);
+            if ( stop )
+                return;
+            seen = generation;
+            fn = job;
+            nb = nb_items;
+            chunk_size = chunk;
+        }
+
+        process(*fn, nb, chunk_size);
+
+        std::lock_guard<std::mutex> lock(mutex);
+        if ( --nb_busy == 0 )
+            work_finished.notify_one();
+    }
+
+}
+
+};
+
+#endif
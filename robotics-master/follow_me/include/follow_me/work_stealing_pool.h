@@ -0,0 +1,173 @@
+// fixed pool of worker threads for independent tasks of uneven cost (see thread_pool.h for the loops of equal items)
+// - the tasks [0, nb) are dealt in consecutive blocks, one queue per thread: a thread takes the tasks of its own
+//   queue in order, then steals the last tasks of the queue of another thread when its own queue is empty
+// - each task is given the index of the thread that runs it, so that the caller can keep its state per thread
+// the calling thread takes part in the work (thread 0), so a pool of 0 workers runs the tasks sequentially
+
+#ifndef FOLLOW_ME_WORK_STEALING_POOL_H
+#define FOLLOW_ME_WORK_STEALING_POOL_H
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+class work_stealing_pool {
+private:
+
+    struct task_queue {
+
+        std::mutex mutex;
+        std::deque<int> tasks;
+
+    };
+
+    std::vector<std::thread> workers;
+    std::vector<std::unique_ptr<task_queue> > queues;// one per thread, the caller first
+
+    std::mutex mutex;
+    std::condition_variable work_available, work_finished;
+
+    const std::function<void(int, int)>* job;
+    int nb_busy;// number of workers still processing the current job
+    unsigned generation;// incremented for each new job
+    bool stop;
+
+public:
+
+    std::atomic<long> nb_steals;// tasks run by another thread than the one they were dealt to, since the creation
+
+explicit work_stealing_pool(int nb_workers = -1) : job(0), nb_busy(0), generation(0), stop(false), nb_steals(0) {
+
+    // by default, one worker per core, the calling thread being one of them
+    if ( nb_workers < 0 ) {
+        nb_workers = std::thread::hardware_concurrency();
+        nb_workers = ( nb_workers > 1 ) ? nb_workers - 1 : 0;
+    }
+    for (int loop=0; loop<=nb_workers; loop++)
+        queues.push_back(std::unique_ptr<task_queue>(new task_queue));
+    for (int loop=0; loop<nb_workers; loop++)
+        workers.push_back(std::thread(&work_stealing_pool::worker, this, loop + 1));
+
+}
+
+~work_stealing_pool() {
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stop = true;
+    }
+    work_available.notify_all();
+    for (size_t loop=0; loop<workers.size(); loop++)
+        workers[loop].join();
+
+}
+
+int size() const {
+
+    return workers.size() + 1;
+
+}
+
+// call fn(task, thread) for each task of [0, nb), thread in [0, size()) being the thread that runs it
+// returns when all the tasks have been processed
+void run(int nb, const std::function<void(int, int)>& fn) {
+
+    if ( nb <= 0 )
+        return;
+    if ( workers.empty() ) {
+        for (int loop=0; loop<nb; loop++)
+            fn(loop, 0);
+        return;
+    }
+
+    const int nb_threads = size();
+    for (int t=0; t<nb_threads; t++) {
+        std::lock_guard<std::mutex> lock(queues[t]->mutex);
+        for (int loop=(long)nb*t/nb_threads; loop<(long)nb*(t+1)/nb_threads; loop++)
+            queues[t]->tasks.push_back(loop);
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        job = &fn;
+        nb_busy = workers.size();
+        generation++;
+    }
+    work_available.notify_all();
+
+    process(fn, 0);
+
+    std::unique_lock<std::mutex> lock(mutex);
+    while ( nb_busy )
+        work_finished.wait(lock);
+    job = 0;
+
+}
+
+private:
+
+// the next task of the thread: the first one of its queue, else the last one of another queue; -1 when all are empty
+// (no task is added during a job, so an empty round means that the job is over for this thread)
+int next_task(int self) {
+
+    {
+        std::lock_guard<std::mutex> lock(queues[self]->mutex);
+        if ( !queues[self]->tasks.empty() ) {
+            int task = queues[self]->tasks.front();
+            queues[self]->tasks.pop_front();
+            return task;
+        }
+    }
+    for (size_t loop=1; loop<queues.size(); loop++) {
+        task_queue& victim = *queues[( self + loop ) % queues.size()];
+        std::lock_guard<std::mutex> lock(victim.mutex);
+        if ( !victim.tasks.empty() ) {
+            int task = victim.tasks.back();
+            victim.tasks.pop_back();
+            nb_steals++;
+            return task;
+        }
+    }
+    return -1;
+
+}
+
+void process(const std::function<void(int, int)>& fn, int self) {
+
+    for (int task = next_task(self); task >= 0; task = next_task(self))
+        fn(task, self);
+
+}
+
+void worker(int self) {
+
+    unsigned seen = 0;
+    while ( true ) {
+        const std::function<void(int, int)>* fn;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            while ( !stop && ( generation == seen ) )
+                work_available.wait(lock);
+            if ( stop )
+                return;
+            seen = generation;
+            fn = job;
+        }
+
+        process(*fn, self);
+
+        std::lock_guard<std::mutex> lock(mutex);
+        if ( --nb_busy == 0 )
+            work_finished.notify_one();
+    }
+
+}
+
+};
+
+#endif
@@ -0,0 +1,193 @@
+// chase distance of the follow cycle of decision_node, with and without the translation re-aimed after the rotation
+// usage: chase_benchmark [world...]
+// the walks of the persons of each world (the default world of the simulator if none) are replayed; the follow cycle
+// of robair is modeled: the robot stops, stores the background, the detector (10 hz) measures the position of the
+// walking person, decision_node sends a rotation then a translation performed with the motion profiles of the
+// rotation and translation nodes. When the rotation is done, the robot stops again: with re-aim, decision_node waits
+// up to reaim_wait for a new goal and the translation goes to its projection on the new heading. The chase distance is
+// the distance between the goal reached by the robot and the position of the person when the robot arrives
+// the mean and max chase distances are reported for each world, then over the cycles of all the worlds: a world with
+// a few cycles (straight.world, corridor.world) says little on its own
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <random>
+#include "follow_me/motion_profile.h"
+#include "follow_me/simulator.h"
+
+#define walk_duration 600// s
+#define time_step 0.01// s
+#define scan_period 0.1// s, of the detector
+#define detection_latency 0.1// s, from the scan to the reception of the goal by decision_node
+#define position_noise 0.03// m, of the detection
+#define max_range 5// m
+#define manoeuvre_delay 0.2// s, before each manoeuvre starts (transmission of the command, decision_node period)
+#define reaim_wait 0.6// s, as decision_node
+
+// limits of the rotation and translation nodes (see rotation_node.cpp and translation_node.cpp)
+float rotation_duration(float angle) {
+
+    motion_profile p;
+    p.plan(angle, 1.0, 1.5, 6.0);
+    return p.duration();
+
+}
+
+float translation_duration(float distance) {
+
+    motion_profile p;
+    p.plan(distance, 0.5, 0.5, 2.0);
+    return p.duration();
+
+}
+
+struct chase_result {
+
+    int nb_cycles;
+    double chase_distance;// m, sum over the cycles
+    double max_chase_distance;// m
+    double time;// s, spent in the cycles
+
+};
+
+class walk_replay {
+public:
+
+    simulator sim;
+    float robot_x, robot_y, robot_theta;
+    double time;
+
+walk_replay(const char* world) {
+
+    if ( !world || !sim.load(world) )
+        sim.default_world();
+    robot_x = sim.x;
+    robot_y = sim.y;
+    robot_theta = sim.theta;
+    time = 0;
+
+}
+
+// the persons walk during dt, the simulated robot is not used
+void wait(double dt) {
+
+    for (double t=0; t<dt; t+=time_step)
+        sim.step(time_step);
+    time += dt;
+
+}
+
+// position of the followed person in the frame of the robot, false if it cannot be detected
+bool person(float& x, float& y) {
+
+    const sim_person& p = sim.people[0];
+    float dx = p.x - robot_x, dy = p.y - robot_y;
+    x = dx * cos(robot_theta) + dy * sin(robot_theta);
+    y = -dx * sin(robot_theta) + dy * cos(robot_theta);
+    return p.walking && ( sqrt(x * x + y * y) < max_range );
+
+}
+
+// the robot is stopped: the first scan is the background, then the detector measures the person during at most
+// "wait" seconds (until the end of the walk if wait < 0)
+bool detect(double wait, std::mt19937& generator, std::normal_distribution<float>& noise, float& x, float& y) {
+
+    this->wait(scan_period);
+    for (double waited=0; ( time < walk_duration ) && ( ( wait < 0 ) || ( waited < wait - 1e-6 ) ); waited+=scan_period) {
+        this->wait(scan_period);
+        if ( person(x, y) ) {
+            x += noise(generator);
+            y += noise(generator);
+            this->wait(detection_latency);
+            return true;
+        }
+    }
+    return false;
+
+}
+
+};
+
+chase_result run(const char* world, bool reaim) {
+
+    walk_replay replay(world);
+    std::mt19937 generator(1);
+    std::normal_distribution<float> noise(0, position_noise);
+
+    chase_result result;
+    result.nb_cycles = 0;
+    result.chase_distance = result.max_chase_distance = result.time = 0;
+    if ( replay.sim.people.empty() )
+        return result;
+
+    while ( replay.time < walk_duration ) {
+        double cycle_start = replay.time;
+        float gx, gy;
+        if ( !replay.detect(-1, generator, noise, gx, gy) )
+            break;
+        float rotation = atan2(gy, gx);
+        float translation = sqrt(gx * gx + gy * gy);
+
+        // rotation, then translation along the new heading
+        replay.wait(manoeuvre_delay + rotation_duration(rotation));
+        replay.robot_theta += rotation;
+        float x, y;
+        if ( reaim && replay.detect(reaim_wait, generator, noise, x, y) )
+            translation = std::max(x, 0.0f);
+        replay.wait(manoeuvre_delay + translation_duration(translation));
+
+        float goal_x = replay.robot_x + translation * cos(replay.robot_theta);
+        float goal_y = replay.robot_y + translation * sin(replay.robot_theta);
+        const sim_person& p = replay.sim.people[0];
+        float chase = sqrt(( p.x - goal_x ) * ( p.x - goal_x ) + ( p.y - goal_y ) * ( p.y - goal_y ));
+        replay.robot_x = goal_x;
+        replay.robot_y = goal_y;
+
+        result.nb_cycles++;
+        result.chase_distance += chase;
+        result.max_chase_distance = std::max(result.max_chase_distance, (double)chase);
+        result.time += replay.time - cycle_start;
+    }
+    return result;
+
+}
+
+void report(const char* name, const chase_result& r) {
+
+    printf("  %-14s %6i cycles, %5.2f s per cycle, chase distance: mean %.3f m, max %.3f m\n", name, r.nb_cycles,
+           r.nb_cycles ? r.time / r.nb_cycles : 0, r.nb_cycles ? r.chase_distance / r.nb_cycles : 0, r.max_chase_distance);
+
+}
+
+// sum of the cycles of all the worlds: a world with few cycles weighs as much as its cycles, not as much as a world
+void add(chase_result& total, const chase_result& r) {
+
+    total.nb_cycles += r.nb_cycles;
+    total.chase_distance += r.chase_distance;
+    total.max_chase_distance = std::max(total.max_chase_distance, r.max_chase_distance);
+    total.time += r.time;
+
+}
+
+int main(int argc, char** argv) {
+
+    int nb_worlds = argc > 1 ? argc - 1 : 1;
+    chase_result without_total = { 0, 0, 0, 0 }, with_total = { 0, 0, 0, 0 };
+    for (int w=0; w<nb_worlds; w++) {
+        const char* world = argc > 1 ? argv[w + 1] : 0;
+        printf("%s\n", world ? world : "default world");
+        chase_result without = run(world, false);
+        chase_result with = run(world, true);
+        report("no re-aim", without);
+        report("re-aim", with);
+        add(without_total, without);
+        add(with_total, with);
+    }
+    printf("all the cycles\n");
+    report("no re-aim", without_total);
+    report("re-aim", with_total);
+
+    return 0;
+
+}
@@ -0,0 +1,120 @@
+// full versus incremental clustering of the detector core (see detector_core.h)
+// a run of the simulator is recorded (robot stopped, one person walking) with and without the noise of the ranges,
+// then processed by two detectors, incremental off and on: the cuts tested (beams where a new cluster may start), the
+// distances computed for the size of the clusters and the time per scan are reported, and the clusters (ids included),
+// moving legs and moving persons of both must be identical on every scan
+// with noise, the ranges move within the tolerance: the cuts are only tested around the walking person and where the
+// range difference is close to cluster_threshold, but the size of every cluster is computed again (its polyline has moved)
+
+#include <chrono>
+#include <cstdio>
+#include <vector>
+#include "follow_me/detector_core.h"
+#include "follow_me/simulator.h"
+
+#define nb_scans 300
+#define nb_runs 20
+
+struct run_result {
+
+    double time;// s per scan, of detect()
+    double cuts;// tested per scan
+    double distances;// computed per scan
+    std::vector<std::vector<detector_cluster> > clusters;
+    std::vector<std::vector<int> > legs;
+    std::vector<std::vector<detector_point> > persons;
+
+};
+
+run_result run(bool incremental, const std::vector<std::vector<float> >& scans, const sim_config& config, float angle_increment) {
+
+    run_result result;
+    result.time = result.cuts = result.distances = 0;
+    result.clusters.resize(scans.size());
+    result.legs.resize(scans.size());
+    result.persons.resize(scans.size());
+    for (int r=0; r<nb_runs; r++) {
+        detector_pipeline* detector = make_detector_pipeline(config.nb_beams, config.angle_min, angle_increment);
+        detector->incremental = incremental;
+        for (size_t loop=0; loop<scans.size(); loop++) {
+            detector->set_scan(&scans[loop][0], scans[loop].size(), config.angle_min, angle_increment, config.range_min, config.range_max);
+            if ( !loop )
+                detector->store_background();
+            detector->detect();
+            result.time += detector->processing_time;
+            if ( !r ) {
+                result.cuts += detector->nb_cuts_tested;
+                result.distances += detector->nb_distances;
+                result.clusters[loop] = detector->clusters;
+                result.legs[loop] = detector->moving_legs;
+                result.persons[loop] = detector->moving_persons;
+            }
+        }
+        delete detector;
+    }
+    result.time /= nb_runs * scans.size();
+    result.cuts /= scans.size();
+    result.distances /= scans.size();
+    return result;
+
+}
+
+bool same_cluster(const detector_cluster& a, const detector_cluster& b) {
+
+    return ( a.start == b.start ) && ( a.end == b.end ) && ( a.size == b.size ) && ( a.middle.x == b.middle.x ) && ( a.middle.y == b.middle.y ) &&
+           ( a.dynamic == b.dynamic ) && ( a.id == b.id );
+
+}
+
+bool identical(const run_result& a, const run_result& b) {
+
+    for (size_t loop=0; loop<a.clusters.size(); loop++) {
+        if ( ( a.clusters[loop].size() != b.clusters[loop].size() ) || ( a.legs[loop] != b.legs[loop] ) || ( a.persons[loop].size() != b.persons[loop].size() ) )
+            return false;
+        for (size_t c=0; c<a.clusters[loop].size(); c++)
+            if ( !same_cluster(a.clusters[loop][c], b.clusters[loop][c]) )
+                return false;
+        for (size_t p=0; p<a.persons[loop].size(); p++)
+            if ( ( a.persons[loop][p].x != b.persons[loop][p].x ) || ( a.persons[loop][p].y != b.persons[loop][p].y ) )
+                return false;
+    }
+    return true;
+
+}
+
+void compare(const char* name, float range_noise, int nb_beams) {
+
+    sim_config config = default_sim_config();
+    config.range_noise = range_noise;
+    config.nb_beams = nb_beams;
+    simulator sim(config);
+    sim.default_world();
+    std::vector<std::vector<float> > scans(nb_scans, std::vector<float>(config.nb_beams));
+    for (int loop=0; loop<nb_scans; loop++) {
+        sim.scan(&scans[loop][0]);
+        sim.step(0.1);
+    }
+
+    run_result full = run(false, scans, config, sim.angle_increment());
+    run_result incremental = run(true, scans, config, sim.angle_increment());
+    printf("%-14s %8.1f %8.1f %6.1fx %8.1f %8.1f %8.2f %8.2f %6.2fx %s\n", name, full.cuts, incremental.cuts, incremental.cuts > 0 ? full.cuts / incremental.cuts : 0.0,
+           full.distances, incremental.distances, full.time * 1e6, incremental.time * 1e6, incremental.time > 0 ? full.time / incremental.time : 0.0,
+           identical(full, incremental) ? "identical" : "DIFFERENT");
+
+}
+
+int main() {
+
+    // the laser of robair, and the same field of view with 2048 beams (generic version of the core)
+    const int nb_beams[2] = { default_sim_config().nb_beams, 2048 };
+    for (int loop=0; loop<2; loop++) {
+        printf("%i beams, robot stopped, one person walking; per scan: cuts tested, distances computed, time of detect() in us\n", nb_beams[loop]);
+        printf("%-14s %8s %8s %7s %8s %8s %8s %8s %7s %s\n", "range noise", "cuts", "incr.", "less", "dist.", "incr.", "time", "incr.", "faster", "results");
+        compare("none", 0, nb_beams[loop]);
+        compare("1 cm", 0.01, nb_beams[loop]);
+        compare("2 cm", 0.02, nb_beams[loop]);
+        printf("\n");
+    }
+    return 0;
+
+}
@@ -0,0 +1,346 @@
+// arbitration of the different cmd_vel sources with a safety stop driven directly by the laser
+// each source publishes on its own topic, the multiplexer forwards the active source with the highest priority on cmd_vel
+
+#include "ros/ros.h"
+#include "ros/time.h"
+#include <geometry_msgs/Twist.h>
+#include "sensor_msgs/LaserScan.h"
+#include "std_msgs/String.h"
+#include <cmath>
+#include <string>
+// counters of the commands, exposed to prometheus (see metrics.h)
+#include "follow_me/metrics.h"
+
+#define nb_sources 4
+
+// the multiplexer runs at 100hz: a command received on a source is forwarded at the latest 10ms later
+#define mux_frequency 100
+
+float robair_size = 0.25;// half width of the corridor checked in front of the robot
+float safety_stop_distance = 0.3;// an obstacle closer than this distance in the corridor stops any forward motion
+float max_linear_acceleration = 1.0;// m/s^2
+float max_angular_acceleration = 3.0;// rad/s^2
+float max_latency = 0.02;// expected upper bound (s) of the latency added by the multiplexer
+std::string metrics_socket = "/tmp/follow_me_cmd_vel_mux.metrics";// "" for none
+int metrics_port = 0;// localhost tcp port of the metrics, 0 for none
+
+using namespace std;
+
+// a source of cmd_vel: the source with the highest priority that has published during the last "timeout" seconds is forwarded
+struct cmd_vel_source {
+
+    const char* topic;
+    int priority;
+    float timeout;
+
+    geometry_msgs::Twist twist;
+    ros::Time stamp;// when the last command of this source has been received
+    bool active;
+    bool forwarded;// to check if the last command has already been sent to the mobile robot
+
+};
+
+class cmd_vel_mux {
+private:
+
+    ros::NodeHandle n;
+
+    // communication with the different sources
+    ros::Subscriber sub_source[nb_sources];
+    cmd_vel_source source[nb_sources];
+    int current_source;// the source that is currently forwarded, -1 if none
+
+    // communication with the laser for the safety stop
+    ros::Subscriber sub_scan;
+    bool safety_stop;
+
+    // communication with the mobile robot
+    ros::Publisher pub_cmd_vel;
+    geometry_msgs::Twist cmd_vel;// last command sent to the mobile robot
+    ros::Time cmd_vel_stamp;
+
+    // to measure the latency added by the multiplexer
+    int nb_latency;
+    double latency_sum, latency_max;
+    int nb_stop_latency;
+    double stop_latency_sum, stop_latency_max;
+    ros::Time last_report;
+
+    // metrics: the rates are computed by prometheus from the counters
+    metrics_registry metrics;
+    metrics_server metrics_endpoint;
+    metric_counter* cmd_vel_sent;
+    metric_counter* commands_received[nb_sources];
+    metric_counter* safety_stops;
+    metric_histogram* command_latency;
+
+    // communication with flight_recorder: the safety stops are recorded
+    ros::Publisher pub_flight_recorder_trigger;
+
+public:
+
+cmd_vel_mux() : metrics_endpoint(metrics) {
+
+    // the teleoperation always has the priority over the autonomous behaviours
+    init_source(0, "teleop_cmd_vel", 3, 0.5);
+    init_source(1, "rotation_cmd_vel", 2, 0.3);
+    init_source(2, "translation_cmd_vel", 2, 0.3);
+    init_source(3, "planner_cmd_vel", 2, 0.3);
+
+    sub_source[0] = n.subscribe("teleop_cmd_vel", 1, &cmd_vel_mux::teleopCallback, this, ros::TransportHints().tcpNoDelay());
+    sub_source[1] = n.subscribe("rotation_cmd_vel", 1, &cmd_vel_mux::rotationCallback, this, ros::TransportHints().tcpNoDelay());
+    sub_source[2] = n.subscribe("translation_cmd_vel", 1, &cmd_vel_mux::translationCallback, this, ros::TransportHints().tcpNoDelay());
+    sub_source[3] = n.subscribe("planner_cmd_vel", 1, &cmd_vel_mux::plannerCallback, this, ros::TransportHints().tcpNoDelay());
+    current_source = -1;
+
+    sub_scan = n.subscribe("scan", 1, &cmd_vel_mux::scanCallback, this, ros::TransportHints().tcpNoDelay());
+    safety_stop = false;
+
+    pub_cmd_vel = n.advertise<geometry_msgs::Twist>("cmd_vel", 1);
+    pub_flight_recorder_trigger = n.advertise<std_msgs::String>("flight_recorder_trigger", 1);
+    cmd_vel_stamp = ros::Time::now();
+
+    nb_latency = 0;
+    latency_sum = latency_max = 0;
+    nb_stop_latency = 0;
+    stop_latency_sum = stop_latency_max = 0;
+    last_report = ros::Time::now();
+
+    cmd_vel_sent = metrics.counter("follow_me_cmd_vel_total", "commands sent on cmd_vel");
+    commands_received[0] = metrics.counter("follow_me_cmd_vel_source_total", "commands received from each source", "source=\"teleop\"");
+    commands_received[1] = metrics.counter("follow_me_cmd_vel_source_total", "commands received from each source", "source=\"rotation\"");
+    commands_received[2] = metrics.counter("follow_me_cmd_vel_source_total", "commands received from each source", "source=\"translation\"");
+    commands_received[3] = metrics.counter("follow_me_cmd_vel_source_total", "commands received from each source", "source=\"planner\"");
+    safety_stops = metrics.counter("follow_me_safety_stops_total", "safety stops triggered by the laser");
+    const double latency_bounds[] = { 0.001, 0.002, 0.005, 0.01, 0.02, 0.05, 0.1 };
+    command_latency = metrics.histogram("follow_me_cmd_vel_latency_seconds", "latency added by the multiplexer", latency_bounds, 7);
+    if ( !metrics_endpoint.start(metrics_socket, metrics_port) )
+        ROS_WARN("(cmd_vel_mux) cannot serve the metrics on %s / port %i", metrics_socket.c_str(), metrics_port);
+
+    //INFINTE LOOP TO COLLECT THE COMMANDS AND FORWARD THEM
+    ros::Rate r(mux_frequency);
+    while (ros::ok()) {
+        ros::spinOnce();//each callback is called once to collect new commands and new laser data
+        update();
+        r.sleep();
+    }
+
+}
+
+void init_source(int index, const char* topic, int priority, float timeout) {
+
+    source[index].topic = topic;
+    source[index].priority = priority;
+    source[index].timeout = timeout;
+    source[index].active = false;
+    source[index].forwarded = true;
+
+}
+
+//UPDATE: arbitration between the sources
+/*//////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////*/
+void update() {
+
+    ros::Time now = ros::Time::now();
+
+    // we select the active source with the highest priority
+    // for two sources with the same priority, the most recent one wins: a stale zero twist cannot hide a live command
+    int selected = -1;
+    for (int loop=0; loop<nb_sources; loop++) {
+        if ( source[loop].active && ( ( now - source[loop].stamp ).toSec() > source[loop].timeout ) ) {
+            ROS_INFO("(cmd_vel_mux) %s timed out", source[loop].topic);
+            source[loop].active = false;
+        }
+        if ( source[loop].active )
+            if ( ( selected == -1 ) || ( source[loop].priority > source[selected].priority ) ||
+                 ( ( source[loop].priority == source[selected].priority ) && ( source[loop].stamp > source[selected].stamp ) ) )
+                selected = loop;
+    }
+
+    if ( selected != current_source ) {
+        if ( selected == -1 )
+            ROS_INFO("(cmd_vel_mux) no active source: the robot is stopped");
+        else
+            ROS_INFO("(cmd_vel_mux) %s (priority %i) is forwarded", source[selected].topic, source[selected].priority);
+        current_source = selected;
+    }
+
+    // without any active source the robot has to stop
+    geometry_msgs::Twist target;
+    if ( selected != -1 )
+        target = source[selected].twist;
+
+    publish_cmd_vel(target, now);
+
+    // latency between the reception of a new command and its forwarding
+    if ( ( selected != -1 ) && !source[selected].forwarded ) {
+        source[selected].forwarded = true;
+        double latency = ( ros::Time::now() - source[selected].stamp ).toSec();
+        nb_latency++;
+        latency_sum += latency;
+        command_latency->observe(latency);
+        if ( latency > latency_max )
+            latency_max = latency;
+    }
+
+    // every 5s, we display the latency added by the multiplexer
+    if ( ( now - last_report ).toSec() > 5 ) {
+        if ( nb_latency )
+            ROS_INFO("(cmd_vel_mux) command latency: mean %f ms, max %f ms", latency_sum/nb_latency*1000, latency_max*1000);
+        if ( nb_stop_latency )
+            ROS_INFO("(cmd_vel_mux) safety stop latency: mean %f ms, max %f ms", stop_latency_sum/nb_stop_latency*1000, stop_latency_max*1000);
+        if ( latency_max > max_latency )
+            ROS_WARN("(cmd_vel_mux) command latency %f ms is higher than the bound %f ms", latency_max*1000, max_latency*1000);
+
+        nb_latency = 0;
+        latency_sum = latency_max = 0;
+        nb_stop_latency = 0;
+        stop_latency_sum = stop_latency_max = 0;
+        last_report = now;
+    }
+
+}// update
+
+// send the target to the mobile robot, limiting the accelerations and applying the safety stop
+void publish_cmd_vel(const geometry_msgs::Twist& target, const ros::Time& now) {
+
+    float dt = ( now - cmd_vel_stamp ).toSec();
+    if ( dt > 1.0 / mux_frequency * 5 )
+        dt = 1.0 / mux_frequency;// the first command after a long idle period must not jump
+
+    cmd_vel.linear.x = limit_acceleration(cmd_vel.linear.x, target.linear.x, max_linear_acceleration * dt);
+    cmd_vel.linear.y = 0;
+    cmd_vel.linear.z = 0;
+    cmd_vel.angular.x = 0;
+    cmd_vel.angular.y = 0;
+    cmd_vel.angular.z = limit_acceleration(cmd_vel.angular.z, target.angular.z, max_angular_acceleration * dt);
+
+    // the safety stop is not subject to the acceleration limits
+    if ( safety_stop && ( cmd_vel.linear.x > 0 ) )
+        cmd_vel.linear.x = 0;
+
+    pub_cmd_vel.publish(cmd_vel);
+    cmd_vel_sent->add();
+    cmd_vel_stamp = now;
+
+}
+
+float limit_acceleration(float current, float target, float max_delta) {
+
+    if ( target > current + max_delta )
+        return current + max_delta;
+    if ( target < current - max_delta )
+        return current - max_delta;
+    return target;
+
+}
+
+//CALLBACKS
+/*//////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////*/
+void store_source(int index, const geometry_msgs::Twist::ConstPtr& twist) {
+
+    source[index].twist = *twist;
+    source[index].stamp = ros::Time::now();
+    source[index].forwarded = false;
+    commands_received[index]->add();
+    if ( !source[index].active )
+        ROS_INFO("(cmd_vel_mux) %s is active", source[index].topic);
+    source[index].active = true;
+
+}
+
+void teleopCallback(const geometry_msgs::Twist::ConstPtr& twist) {
+
+    store_source(0, twist);
+
+}
+
+void rotationCallback(const geometry_msgs::Twist::ConstPtr& twist) {
+
+    store_source(1, twist);
+
+}
+
+void translationCallback(const geometry_msgs::Twist::ConstPtr& twist) {
+
+    store_source(2, twist);
+
+}
+
+void plannerCallback(const geometry_msgs::Twist::ConstPtr& twist) {
+
+    store_source(3, twist);
+
+}
+
+void scanCallback(const sensor_msgs::LaserScan::ConstPtr& scan) {
+// fast path of the safety stop: the scan is checked as soon as it is received
+// and the robot is stopped without waiting for the obstacle_detection_node or the motion nodes
+
+    bool obstacle = false;
+    float beam_angle = scan->angle_min;
+    for (int loop=0; loop < (int)scan->ranges.size() && !obstacle; loop++, beam_angle += scan->angle_increment) {
+        float r = scan->ranges[loop];
+        if ( ( r > scan->range_min ) && ( r < scan->range_max ) && ( r < safety_stop_distance + robair_size ) ) {
+            float x = r * cos(beam_angle);
+            float y = r * sin(beam_angle);
+            obstacle = ( x > 0 ) && ( x < safety_stop_distance ) && ( fabs(y) < robair_size );
+        }
+    }
+
+    if ( obstacle != safety_stop ) {
+        if ( obstacle ) {
+            ROS_WARN("(cmd_vel_mux) safety stop: obstacle closer than %f m", safety_stop_distance);
+            safety_stops->add();
+            std_msgs::String msg;
+            msg.data = "safety_stop";
+            pub_flight_recorder_trigger.publish(msg);
+        }
+        else
+            ROS_INFO("(cmd_vel_mux) safety stop released");
+    }
+    safety_stop = obstacle;
+
+    // the robot is stopped right now, within the scan period, without waiting for the next update
+    if ( safety_stop && ( cmd_vel.linear.x > 0 ) ) {
+        cmd_vel.linear.x = 0;
+        pub_cmd_vel.publish(cmd_vel);
+        cmd_vel_sent->add();
+
+        // latency between the acquisition of the scan and the stop command
+        double latency = ( ros::Time::now() - scan->header.stamp ).toSec();
+        nb_stop_latency++;
+        stop_latency_sum += latency;
+        if ( latency > stop_latency_max )
+            stop_latency_max = latency;
+    }
+
+}//scanCallback
+
+};
+
+int main(int argc, char **argv){
+
+    ros::init(argc, argv, "cmd_vel_mux");
+
+    ROS_INFO("(cmd_vel_mux) PARAMETERS");
+
+    ros::param::get("/cmd_vel_mux_node/robot_size", robair_size);
+    ros::param::get("/cmd_vel_mux_node/safety_stop_distance", safety_stop_distance);
+    ros::param::get("/cmd_vel_mux_node/max_linear_acceleration", max_linear_acceleration);
+    ros::param::get("/cmd_vel_mux_node/max_angular_acceleration", max_angular_acceleration);
+    ros::param::get("/cmd_vel_mux_node/max_latency", max_latency);
+    ROS_INFO("(cmd_vel_mux) robot_size: %f, safety_stop_distance: %f", robair_size, safety_stop_distance);
+    ROS_INFO("(cmd_vel_mux) max_linear_acceleration: %f, max_angular_acceleration: %f", max_linear_acceleration, max_angular_acceleration);
+    ros::param::get("/cmd_vel_mux_node/metrics_socket", metrics_socket);
+    ros::param::get("/cmd_vel_mux_node/metrics_port", metrics_port);
+    ROS_INFO("(cmd_vel_mux) metrics_socket: %s, metrics_port: %i", metrics_socket.c_str(), metrics_port);
+
+    cmd_vel_mux bsObject;
+
+    ros::spin();
+
+    return 0;
+}
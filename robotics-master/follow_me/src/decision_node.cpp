@@ -5,9 +5,19 @@
 #include "nav_msgs/Odometry.h"
 #include "std_msgs/String.h"
 #include "std_msgs/Float32.h"
+#include <algorithm>
 #include <cmath>
 #include <tf/transform_datatypes.h>
 
+// transitions of the state machine and goals, exposed to prometheus (see metrics.h)
+#include "follow_me/metrics.h"
+// distances, angles and changes of frame (see geometry.h)
+#include "follow_me/geometry.h"
+
+float reaim_wait = 0.6;// s, after the rotation, we wait at most this time for a new goal to aim the translation at (0: none, see chase_benchmark.cpp)
+std::string metrics_socket = "/tmp/follow_me_decision.metrics";// "" for none
+int metrics_port = 0;// localhost tcp port of the metrics, 0 for none
+
 class decision {
 private:
 
@@ -37,12 +47,22 @@ private:
     geometry_msgs::Point goal_to_reach;
     geometry_msgs::Point goal_reached;
 
+    geometry_msgs::Point goal_aimed;// where the translation goes, in the frame of the robot before the rotation
+    ros::Time rotation_end;// when /rotation_done was received, zero when we do not wait for a new goal
+
     int state;
     bool display_state;
 
+    metrics_registry metrics;
+    metrics_server metrics_endpoint;
+    metric_counter* transitions[4];// to each state (1: waiting for a goal, 2: rotation, 3: translation)
+    metric_counter* goals_reached;
+    metric_gauge* current_state;
+    metric_gauge* reaim_offset;// m, between the goal planned before the rotation and the goal aimed after it
+
 public:
 
-decision() {
+decision() : metrics_endpoint(metrics) {
 
     // communication with moving_persons_detector or person_tracker
     pub_goal_reached = n.advertise<geometry_msgs::Point>("goal_reached", 1);
@@ -62,6 +82,17 @@ decision() {
     new_rotation_done = false;
     new_translation_done = false;
 
+    transitions[0] = 0;
+    transitions[1] = metrics.counter("follow_me_decision_transitions_total", "transitions of the state machine to each state", "state=\"waiting_goal\"");
+    transitions[2] = metrics.counter("follow_me_decision_transitions_total", "transitions of the state machine to each state", "state=\"rotation\"");
+    transitions[3] = metrics.counter("follow_me_decision_transitions_total", "transitions of the state machine to each state", "state=\"translation\"");
+    goals_reached = metrics.counter("follow_me_decision_goals_reached_total", "goals reached");
+    current_state = metrics.gauge("follow_me_decision_state", "state of the state machine (1: waiting for a goal, 2: rotation, 3: translation)");
+    reaim_offset = metrics.gauge("follow_me_decision_reaim_meters", "distance between the goal planned before the rotation and the goal aimed after it");
+    current_state->set(state);
+    if ( !metrics_endpoint.start(metrics_socket, metrics_port) )
+        ROS_WARN("(decision_node) cannot serve the metrics on %s / port %i", metrics_socket.c_str(), metrics_port);
+
     //INFINTE LOOP TO COLLECT LASER DATA AND PROCESS THEM
     ros::Rate r(10);// this node will work at 10hz
     while (ros::ok()) {
@@ -90,7 +121,7 @@ void update() {
 
         // we have a rotation and a translation to perform
         // we compute the /translation_to_do
-        translation_to_do = sqrt( ( goal_to_reach.x * goal_to_reach.x ) + ( goal_to_reach.y * goal_to_reach.y ) );
+        translation_to_do = point_distance(goal_to_reach, geometry_msgs::Point());// the robot is at the origin
 
         if ( translation_to_do ) {
             //we compute the /rotation_to_do
@@ -106,7 +137,7 @@ void update() {
             //to complete
             msg_rotation_to_do.data = rotation_to_do;
             pub_rotation_to_do.publish(msg_rotation_to_do);
-            state = 2;
+            set_state(2);
 
         }
         else {
@@ -123,15 +154,38 @@ void update() {
     if ( ( new_rotation_done ) && ( state == 2 ) ) {
         ROS_INFO("(decision_node) /rotation_done : %f", rotation_done*180/M_PI);
         new_rotation_done = false;
+        // the goals received during the rotation were measured while the robot was turning
+        new_goal_to_reach = false;
+        rotation_end = ros::Time::now();
+    }
+
+    if ( ( state == 2 ) && !rotation_end.isZero() ) {
+        bool reaim = new_goal_to_reach;
+        if ( !reaim && ( ( ros::Time::now() - rotation_end ).toSec() < reaim_wait ) )
+            return;
 
+        rotation_end = ros::Time();
+        new_goal_to_reach = false;
         display_state = false;
+        geometry_msgs::Point planned;
+        planned.x = translation_to_do * cos(rotation_done);
+        planned.y = translation_to_do * sin(rotation_done);
+        if ( reaim ) {
+            // the new goal is in the frame of the robot after the rotation
+            translation_to_do = std::max(0.0, goal_to_reach.x);
+            ROS_INFO("(decision_node) translation re-aimed at the goal (%f, %f)", goal_to_reach.x, goal_to_reach.y);
+        }
+        goal_aimed.x = translation_to_do * cos(rotation_done);
+        goal_aimed.y = translation_to_do * sin(rotation_done);
+        reaim_offset->set(point_distance(goal_aimed, planned));
+
         //the rotation_to_do is done so we perform the translation_to_do
         ROS_INFO("(decision_node) /translation_to_do: %f", translation_to_do);
         std_msgs::Float32 msg_translation_to_do;
         //to complete
         msg_translation_to_do.data = translation_to_do;
         pub_translation_to_do.publish(msg_translation_to_do);
-        state = 3;
+        set_state(3);
 
     }
 
@@ -145,11 +199,12 @@ void update() {
         geometry_msgs::Point msg_goal_reached;
         ROS_INFO("(decision_node) /goal_reached (%f, %f)", msg_goal_reached.x, msg_goal_reached.y);
         //to complete
-        msg_goal_reached.x = goal_to_reach.x;
-        msg_goal_reached.y = goal_to_reach.y;
+        msg_goal_reached.x = goal_aimed.x;
+        msg_goal_reached.y = goal_aimed.y;
         msg_goal_reached.z = 0;
         pub_goal_reached.publish(msg_goal_reached);
-        state = 1;
+        goals_reached->add();
+        set_state(1);
         new_goal_to_reach = false;
 
         ROS_INFO(" ");
@@ -158,6 +213,14 @@ void update() {
 
 }// update
 
+void set_state(int s) {
+
+    state = s;
+    transitions[s]->add();
+    current_state->set(s);
+
+}
+
 //CALLBACKS
 /*//////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 //////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////*/
@@ -186,13 +249,6 @@ void translation_doneCallback(const std_msgs::Float32::ConstPtr& r) {
 
 }
 
-// Distance between two points
-float distancePoints(geometry_msgs::Point pa, geometry_msgs::Point pb) {
-
-    return sqrt(pow((pa.x-pb.x),2.0) + pow((pa.y-pb.y),2.0));
-
-}
-
 };
 
 int main(int argc, char **argv){
@@ -200,6 +256,12 @@ int main(int argc, char **argv){
     ROS_INFO("(decision_node) waiting for a /goal_to_reach");
     ros::init(argc, argv, "decision");
 
+    ros::param::get("/decision_node/reaim_wait", reaim_wait);
+    ROS_INFO("(decision_node) reaim_wait: %f", reaim_wait);
+    ros::param::get("/decision_node/metrics_socket", metrics_socket);
+    ros::param::get("/decision_node/metrics_port", metrics_port);
+    ROS_INFO("(decision_node) metrics_socket: %s, metrics_port: %i", metrics_socket.c_str(), metrics_port);
+
     decision bsObject;
 
     ros::spin();
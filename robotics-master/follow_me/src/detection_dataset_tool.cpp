@@ -0,0 +1,142 @@
+// creation of the labeled datasets of the detection of moving persons (see detection_dataset.h)
+// usage:
+//   detection_dataset_tool convert <log> <dataset> [annotations]   a log of scan_logger_node (see scan_log.h), labeled
+//                                                                   by its person records and/or by the annotations
+//   detection_dataset_tool generate <dataset>                       a run of the simulator: robot stopped then turning,
+//                                                                   two persons walking, labeled by the simulator
+//   detection_dataset_tool info <dataset>
+
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+#include "follow_me/detection_dataset.h"
+#include "follow_me/geometry.h"
+#include "follow_me/simulator.h"
+
+#define nb_generated_frames 600
+#define generated_turn_start 400// frame where the robot starts to turn
+#define generated_turn_end 450
+
+// the moving persons of the simulator (walking, in the field of view and in range) in the frame of the laser
+void label(const simulator& sim, double stamp, std::vector<log_person>& persons) {
+
+    const frame_transform laser = make_frame_transform(sim.x, sim.y, sim.theta);
+    for (size_t loop=0; loop<sim.people.size(); loop++) {
+        const sim_person& p = sim.people[loop];
+        if ( !p.walking )
+            continue;
+        log_person l;
+        l.stamp = stamp;
+        l.x = p.x;
+        l.y = p.y;
+        l = to_child(laser, l);
+        float a = atan2(l.y, l.x);
+        if ( ( a >= sim.config.angle_min ) && ( a <= sim.config.angle_max ) && ( hypot(l.x, l.y) < sim.config.range_max ) )
+            persons.push_back(l);
+    }
+
+}
+
+void generate(detection_dataset& dataset) {
+
+    sim_config config = default_sim_config();
+    simulator sim(config);
+    sim.default_world();
+    sim_waypoint w[3] = { { -1, 2.5, 1 }, { 1.5, 2.5, 0 }, { 0.5, -0.5, 2 } };
+    sim.add_person(std::vector<sim_waypoint>(w, w + 3), 1.0, true);
+
+    dataset.frames.resize(nb_generated_frames);
+    for (int loop=0; loop<nb_generated_frames; loop++) {
+        dataset_frame& d = dataset.frames[loop];
+        d.scan.stamp = sim.time;
+        d.scan.angle_min = config.angle_min;
+        d.scan.angle_increment = sim.angle_increment();
+        d.scan.range_min = config.range_min;
+        d.scan.range_max = config.range_max;
+        d.scan.ranges.resize(config.nb_beams);
+        sim.scan(&d.scan.ranges[0]);
+        d.robot_moving = ( fabs(sim.linear_speed) > dataset_moving_speed ) || ( fabs(sim.angular_speed) > dataset_moving_speed );
+        d.labeled = true;
+        label(sim, d.scan.stamp, d.persons);
+        if ( ( loop >= generated_turn_start ) && ( loop < generated_turn_end ) )
+            sim.set_command(0, 0.5);
+        sim.step(0.1);
+    }
+
+}
+
+long file_size(const char* filename) {
+
+    FILE* f = fopen(filename, "rb");
+    if ( !f )
+        return -1;
+    fseek(f, 0, SEEK_END);
+    long size = ftell(f);
+    fclose(f);
+    return size;
+
+}
+
+void info(const char* filename, const detection_dataset& dataset) {
+
+    long nb_beams = 0, nb_persons = 0, nb_moving = 0;
+    for (size_t loop=0; loop<dataset.frames.size(); loop++) {
+        nb_beams += dataset.frames[loop].scan.ranges.size();
+        nb_persons += dataset.frames[loop].persons.size();
+        nb_moving += dataset.frames[loop].robot_moving;
+    }
+    long size = file_size(filename);
+    printf("%s: %i frames (%li robot moving), %i labeled, %li labels, %li bytes (%.2f bytes per beam)\n", filename, (int)dataset.frames.size(),
+           nb_moving, dataset.nb_labeled(), nb_persons, size, nb_beams ? (double)size / nb_beams : 0.0);
+
+}
+
+int main(int argc, char** argv) {
+
+    detection_dataset dataset;
+    if ( ( argc >= 4 ) && !strcmp(argv[1], "convert") ) {
+        scan_log log;
+        if ( !log.load(argv[2]) ) {
+            printf("cannot read %s\n", argv[2]);
+            return 1;
+        }
+        dataset.import_log(log);
+        if ( argc >= 5 ) {
+            int nb_ignored;
+            int nb_imported = dataset.import_annotations(argv[4], nb_ignored);
+            if ( nb_imported < 0 ) {
+                printf("cannot read %s\n", argv[4]);
+                return 1;
+            }
+            printf("%s: %i annotations imported, %i ignored (malformed or without scan)\n", argv[4], nb_imported, nb_ignored);
+        }
+        if ( !dataset.nb_labeled() )
+            printf("warning: no frame is labeled, the dataset cannot be scored\n");
+    }
+    else
+        if ( ( argc >= 3 ) && !strcmp(argv[1], "generate") )
+            generate(dataset);
+    else
+        if ( ( argc >= 3 ) && !strcmp(argv[1], "info") ) {
+            if ( !dataset.load(argv[2]) ) {
+                printf("cannot read %s\n", argv[2]);
+                return 1;
+            }
+            info(argv[2], dataset);
+            return 0;
+        }
+    else {
+        printf("usage: %s convert <log> <dataset> [annotations] | generate <dataset> | info <dataset>\n", argv[0]);
+        return 1;
+    }
+
+    const char* output = !strcmp(argv[1], "convert") ? argv[3] : argv[2];
+    if ( !dataset.save(output) ) {
+        printf("cannot write %s\n", output);
+        return 1;
+    }
+    info(output, dataset);
+    return 0;
+
+}
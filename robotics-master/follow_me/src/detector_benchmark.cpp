@@ -0,0 +1,99 @@
+// specialized versus generic versions of the detector core (see detector_core.h)
+// for each known laser, a run of the simulator is recorded (robot stopped, one person walking), then both versions
+// process the same scans: the time per scan is measured and the results must be identical
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <vector>
+#include "follow_me/detector_core.h"
+#include "follow_me/simulator.h"
+
+const int nb_scans = 300;
+const int nb_runs = 20;
+
+struct run_result {
+
+    double time;// s per scan
+    int nb_clusters, nb_persons;
+    float goal_x, goal_y;
+
+};
+
+run_result run(detector_pipeline& detector, const std::vector<std::vector<float> >& scans, float angle_min, float angle_increment, float range_min, float range_max) {
+
+    run_result result;
+    result.nb_clusters = result.nb_persons = 0;
+    result.goal_x = result.goal_y = 0;
+
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    for (int r=0; r<nb_runs; r++)
+        for (size_t loop=0; loop<scans.size(); loop++) {
+            detector.set_scan(&scans[loop][0], scans[loop].size(), angle_min, angle_increment, range_min, range_max);
+            if ( !loop )
+                detector.store_background();
+            detector.detect();
+            if ( !r ) {
+                result.nb_clusters += detector.clusters.size();
+                result.nb_persons += detector.moving_persons.size();
+                if ( !detector.moving_persons.empty() ) {
+                    result.goal_x = detector.goal_to_reach.x;
+                    result.goal_y = detector.goal_to_reach.y;
+                }
+            }
+        }
+    result.time = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count() / ( nb_runs * scans.size() );
+    return result;
+
+}
+
+template <class Traits>
+void compare() {
+
+    const int nb = Traits::nb_beams;
+    const float angle_min = Traits::angle_min, angle_increment = Traits::angle_increment;
+    const float range_min = Traits::range_min, range_max = Traits::range_max;
+
+    sim_config config = default_sim_config();
+    config.nb_beams = nb;
+    config.angle_min = angle_min;
+    config.angle_max = angle_min + ( nb - 1 ) * angle_increment;
+    config.range_min = range_min;
+    config.range_max = range_max;
+    simulator sim(config);
+    sim.default_world();
+
+    std::vector<std::vector<float> > scans(nb_scans, std::vector<float>(nb));
+    for (int loop=0; loop<nb_scans; loop++) {
+        sim.scan(&scans[loop][0]);
+        sim.step(0.1);
+    }
+
+    detector_core<Traits> specialized;
+    detector_core<generic_laser_traits> generic;
+    run_result s = run(specialized, scans, angle_min, angle_increment, range_min, range_max);
+    run_result g = run(generic, scans, angle_min, angle_increment, range_min, range_max);
+
+    bool same = ( s.nb_clusters == g.nb_clusters ) && ( s.nb_persons == g.nb_persons ) && ( fabs(s.goal_x - g.goal_x) < 1e-4 ) && ( fabs(s.goal_y - g.goal_y) < 1e-4 );
+    printf("%-16s %5i beams: specialized %6.2f us, generic %6.2f us per scan (x%.2f), %i persons detected, results %s\n", Traits::name, nb, s.time * 1e6,
+           g.time * 1e6, g.time / s.time, s.nb_persons, same ? "identical" : "DIFFERENT");
+
+}
+
+int main() {
+
+    compare<hokuyo_urg_traits>();
+    compare<lidar_1440_traits>();
+    compare<lidar_2048_traits>();
+
+    // the choice of the version from the scan
+    detector_pipeline* d = make_detector_pipeline(726, -2.356194, 0.006136);
+    printf("726 beams from -2.356194 rad by 0.006136 rad: %s version\n", d->name());
+    delete d;
+    d = make_detector_pipeline(1081, -2.356194, 0.004363);
+    printf("1081 beams from -2.356194 rad by 0.004363 rad: %s version\n", d->name());
+    delete d;
+
+    return 0;
+
+}
@@ -0,0 +1,134 @@
+// accuracy and throughput of the detector core (default thresholds) on labeled datasets, in one run
+// usage: detector_evaluation <dataset> [...] [-baseline <file>]
+// - accuracy (see detection_evaluation.h): precision, recall, mean localization error of the persons detected
+// - throughput: frames per second of set_scan + detect over the frames processed, the best of nb_runs runs
+// with a baseline: the results are compared with it, the exit status is 1 if one of them has regressed by more than
+// the tolerances below; the baseline is written if it does not exist yet (first run on a reference version)
+
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+#include "follow_me/detection_evaluation.h"
+
+#define nb_runs 5
+#define accuracy_tolerance 0.01// of precision and recall
+#define error_tolerance 0.01// m
+#define throughput_tolerance 0.1// relative, the throughput depends on the load of the machine
+
+typedef std::chrono::steady_clock benchmark_clock;
+
+double seconds_since(benchmark_clock::time_point start) {
+
+    return std::chrono::duration<double>(benchmark_clock::now() - start).count();
+
+}
+
+struct evaluation_result {
+
+    float precision, recall, error;// error in m
+    double fps;
+
+};
+
+evaluation_result run(const char* filename, const detection_dataset& dataset) {
+
+    const detector_params params = traits_detector_params<default_detector_thresholds>();
+    detection_score score = empty_detection_score();
+    double best_time = 0;
+    for (int r=0; r<nb_runs; r++) {
+        detection_score s = empty_detection_score();
+        benchmark_clock::time_point start = benchmark_clock::now();
+        evaluate(params, dataset, s);
+        double time = seconds_since(start);
+        if ( !r || ( time < best_time ) )
+            best_time = time;
+        score = s;// the accuracy is the same at each run
+    }
+
+    evaluation_result result;
+    result.precision = score.precision();
+    result.recall = score.recall();
+    result.error = score.mean_error();
+    result.fps = best_time > 0 ? score.nb_frames / best_time : 0;
+    printf("%-28s %7li %7li %7.3f %7.3f %7.3f %7.1f %9.0f %8.1f\n", filename, score.nb_frames, score.nb_scored, result.precision, result.recall,
+           score.f1(), result.error * 100, result.fps, score.latency() * 1e6);
+    return result;
+
+}
+
+bool regressed(const char* name, double value, double reference, double tolerance, bool higher_is_better) {
+
+    bool worse = higher_is_better ? ( value < reference - tolerance ) : ( value > reference + tolerance );
+    if ( worse )
+        printf("REGRESSION of %s: %g, baseline %g\n", name, value, reference);
+    return worse;
+
+}
+
+int main(int argc, char** argv) {
+
+    const char* baseline = 0;
+    std::vector<const char*> files;
+    for (int loop=1; loop<argc; loop++)
+        if ( !strcmp(argv[loop], "-baseline") && ( loop + 1 < argc ) )
+            baseline = argv[++loop];
+        else
+            files.push_back(argv[loop]);
+    if ( files.empty() ) {
+        printf("usage: %s <dataset> [...] [-baseline <file>]\n", argv[0]);
+        return 1;
+    }
+
+    printf("%-28s %7s %7s %7s %7s %7s %7s %9s %8s\n", "dataset", "frames", "scored", "precis", "recall", "f1", "err cm", "fps", "us/scan");
+    std::vector<evaluation_result> results;
+    for (size_t loop=0; loop<files.size(); loop++) {
+        detection_dataset dataset;
+        if ( !dataset.load(files[loop]) ) {
+            printf("cannot read %s\n", files[loop]);
+            return 1;
+        }
+        if ( !dataset.nb_labeled() ) {
+            printf("%s has no labeled frame\n", files[loop]);
+            return 1;
+        }
+        results.push_back(run(files[loop], dataset));
+    }
+    if ( !baseline )
+        return 0;
+
+    FILE* f = fopen(baseline, "r");
+    if ( !f ) {
+        f = fopen(baseline, "w");
+        if ( !f ) {
+            printf("cannot write %s\n", baseline);
+            return 1;
+        }
+        fprintf(f, "# precision recall error fps, per dataset\n");
+        for (size_t loop=0; loop<results.size(); loop++)
+            fprintf(f, "%f %f %f %f\n", results[loop].precision, results[loop].recall, results[loop].error, results[loop].fps);
+        fclose(f);
+        printf("baseline written in %s\n", baseline);
+        return 0;
+    }
+
+    char line[256];
+    size_t index = 0;
+    bool regression = false;
+    while ( fgets(line, sizeof(line), f) && ( index < results.size() ) ) {
+        evaluation_result b;
+        if ( ( line[0] == '#' ) || ( sscanf(line, "%f %f %f %lf", &b.precision, &b.recall, &b.error, &b.fps) != 4 ) )
+            continue;
+        const evaluation_result& r = results[index++];
+        regression |= regressed("precision", r.precision, b.precision, accuracy_tolerance, true);
+        regression |= regressed("recall", r.recall, b.recall, accuracy_tolerance, true);
+        regression |= regressed("localization error", r.error, b.error, error_tolerance, false);
+        regression |= regressed("frames per second", r.fps, b.fps, throughput_tolerance * b.fps, true);
+    }
+    fclose(f);
+    if ( index < results.size() )
+        printf("the baseline %s has %i results for %i datasets\n", baseline, (int)index, (int)results.size());
+    printf("%s\n", regression ? "regression against the baseline" : "no regression against the baseline");
+    return regression ? 1 : 0;
+
+}
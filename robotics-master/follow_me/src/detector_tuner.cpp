@@ -0,0 +1,143 @@
+// offline tuning of the thresholds of the detector core (see detector_core.h) against labeled datasets
+// (see detection_dataset.h, created by detection_dataset_tool)
+// usage: detector_tuner <dataset> [...]
+// - each combination of the grid of thresholds is scored on all the datasets with its own detector (see
+//   detection_evaluation.h), the combinations are run in parallel on all the cores (see work_stealing_pool.h: their
+//   cost depends on the number of clusters)
+// - the latency is the mean processing time of a scan, measured while all the cores are busy
+// - output: the Pareto front of the combinations (no other combination has a better precision, recall and latency)
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <vector>
+#include "follow_me/detection_evaluation.h"
+#include "follow_me/work_stealing_pool.h"
+
+typedef std::chrono::steady_clock benchmark_clock;
+
+double seconds_since(benchmark_clock::time_point start) {
+
+    return std::chrono::duration<double>(benchmark_clock::now() - start).count();
+
+}
+
+struct tuning_result {
+
+    detector_params params;
+    detection_score score;
+
+};
+
+// a dominates b: as good on the three criteria and better on one of them
+bool dominates(const detection_score& a, const detection_score& b) {
+
+    bool as_good = ( a.precision() >= b.precision() ) && ( a.recall() >= b.recall() ) && ( a.latency() <= b.latency() );
+    bool better = ( a.precision() > b.precision() ) || ( a.recall() > b.recall() ) || ( a.latency() < b.latency() );
+    return as_good && better;
+
+}
+
+bool by_recall(const tuning_result& a, const tuning_result& b) {
+
+    if ( a.score.recall() != b.score.recall() )
+        return a.score.recall() > b.score.recall();
+    return a.score.precision() > b.score.precision();
+
+}
+
+void print(const char* name, const tuning_result& r) {
+
+    const detection_score& s = r.score;
+    printf("%-8s %7.2f %7.2f %7.2f %7.2f %7.2f %5i %7.2f %7.2f %7.3f %7.1f %8.1f\n", name, r.params.cluster_threshold, r.params.detection_threshold,
+           r.params.leg_size_min, r.params.leg_size_max, r.params.legs_distance_max, r.params.dynamic_threshold, s.precision(), s.recall(), s.f1(),
+           s.mean_error() * 100, s.latency() * 1e6);
+
+}
+
+int main(int argc, char** argv) {
+
+    std::vector<detection_dataset> datasets;
+    for (int loop=1; loop<argc; loop++) {
+        detection_dataset dataset;
+        if ( !dataset.load(argv[loop]) ) {
+            printf("cannot read %s\n", argv[loop]);
+            return 1;
+        }
+        if ( !dataset.nb_labeled() ) {
+            printf("%s has no labeled frame: it cannot be scored\n", argv[loop]);
+            return 1;
+        }
+        printf("dataset %s: %i frames, %i labeled\n", argv[loop], (int)dataset.frames.size(), dataset.nb_labeled());
+        datasets.push_back(dataset);
+    }
+    if ( datasets.empty() ) {
+        printf("usage: %s <dataset> [...]\n", argv[0]);
+        return 1;
+    }
+
+    // the grid of thresholds, around the default ones
+    const float cluster_thresholds[] = { 0.1, 0.15, 0.2, 0.25, 0.3 };
+    const float detection_thresholds[] = { 0.1, 0.15, 0.2, 0.3 };
+    const int dynamic_thresholds[] = { 50, 65, 75, 85 };
+    const float leg_sizes_min[] = { 0.02, 0.05, 0.08 };
+    const float leg_sizes_max[] = { 0.2, 0.25, 0.35 };
+    const float legs_distances_max[] = { 0.5, 0.7, 0.9 };
+    std::vector<tuning_result> results;
+    for (int c=0; c<5; c++)
+        for (int d=0; d<4; d++)
+            for (int y=0; y<4; y++)
+                for (int smin=0; smin<3; smin++)
+                    for (int smax=0; smax<3; smax++)
+                        for (int l=0; l<3; l++) {
+                            tuning_result r;
+                            r.params.cluster_threshold = cluster_thresholds[c];
+                            r.params.detection_threshold = detection_thresholds[d];
+                            r.params.dynamic_threshold = dynamic_thresholds[y];
+                            r.params.leg_size_min = leg_sizes_min[smin];
+                            r.params.leg_size_max = leg_sizes_max[smax];
+                            r.params.legs_distance_max = legs_distances_max[l];
+                            r.score = empty_detection_score();
+                            results.push_back(r);
+                        }
+
+    work_stealing_pool pool;
+    std::vector<int> tasks_per_thread(pool.size(), 0);
+    benchmark_clock::time_point start = benchmark_clock::now();
+    pool.run(results.size(), [&](int task, int thread) {
+        for (size_t loop=0; loop<datasets.size(); loop++)
+            evaluate(results[task].params, datasets[loop], results[task].score);
+        tasks_per_thread[thread]++;
+    });
+    double elapsed = seconds_since(start);
+    printf("%i combinations in %.2f s on %i threads (%li tasks stolen, tasks per thread:", (int)results.size(), elapsed, pool.size(),
+           pool.nb_steals.load());
+    for (size_t loop=0; loop<tasks_per_thread.size(); loop++)
+        printf(" %i", tasks_per_thread[loop]);
+    printf(")\n\n");
+
+    std::vector<tuning_result> front;
+    for (size_t a=0; a<results.size(); a++) {
+        bool dominated = false;
+        for (size_t b=0; ( b < results.size() ) && !dominated; b++)
+            dominated = dominates(results[b].score, results[a].score);
+        if ( !dominated )
+            front.push_back(results[a]);
+    }
+    std::sort(front.begin(), front.end(), by_recall);
+
+    printf("%-8s %7s %7s %7s %7s %7s %5s %7s %7s %7s %7s %8s\n", "", "cluster", "detect", "leg min", "leg max", "legs", "dyn%", "precis",
+           "recall", "f1", "err cm", "us/scan");
+    tuning_result reference;
+    reference.params = traits_detector_params<default_detector_thresholds>();
+    reference.score = empty_detection_score();
+    for (size_t loop=0; loop<datasets.size(); loop++)
+        evaluate(reference.params, datasets[loop], reference.score);
+    print("default", reference);
+    printf("Pareto front (%i combinations):\n", (int)front.size());
+    for (size_t loop=0; loop<front.size(); loop++)
+        print("", front[loop]);
+
+    return 0;
+
+}
@@ -0,0 +1,174 @@
+// build time of the distance field (see distance_field.h) per scan at 5 cm and 2.5 cm, on an 8 m grid centred on the
+// robot, for a robot stopped with one person walking (the follow cycle of robair) and for a robot turning
+// - full: the whole grid is transformed at each scan
+// - columns kept: only the columns where a cell has changed are transformed again, all the rows are transformed;
+//   checked identical to the full rebuild
+// - chamfer: the two passes chamfer transform used before by the local planner, and its max error (cm) over the grid
+//   and where the clearance is below 1 m (max_clearance of the local planner)
+// then the cost of a clearance + gradient lookup at random positions
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+#include "follow_me/distance_field.h"
+#include "follow_me/simulator.h"
+
+#define nb_scans 200
+#define grid_extent 8.0
+#define nb_lookups 1000000
+
+typedef std::chrono::steady_clock benchmark_clock;
+
+double seconds_since(benchmark_clock::time_point start) {
+
+    return std::chrono::duration<double>(benchmark_clock::now() - start).count();
+
+}
+
+// previous clearance grid of dwa_planner.h: 3x3 chamfer distance, forward then backward pass
+void chamfer(const float* x, const float* y, int nb_points, int size, float resolution, std::vector<float>& distance) {
+
+    const float half_extent = size * resolution / 2;
+    const float infinity = 2 * size * resolution;
+    distance.assign(size * size, infinity);
+    for (int loop=0; loop<nb_points; loop++) {
+        int ix = (int)floor(( x[loop] + half_extent ) / resolution);
+        int iy = (int)floor(( y[loop] + half_extent ) / resolution);
+        if ( ( ix >= 0 ) && ( ix < size ) && ( iy >= 0 ) && ( iy < size ) )
+            distance[iy * size + ix] = 0;
+    }
+    const float straight = resolution, diagonal = resolution * sqrtf(2);
+    for (int iy=0; iy<size; iy++)
+        for (int ix=0; ix<size; ix++) {
+            float d = distance[iy * size + ix];
+            if ( ix > 0 )
+                d = std::min(d, distance[iy * size + ix - 1] + straight);
+            if ( iy > 0 ) {
+                d = std::min(d, distance[( iy - 1 ) * size + ix] + straight);
+                if ( ix > 0 )
+                    d = std::min(d, distance[( iy - 1 ) * size + ix - 1] + diagonal);
+                if ( ix < size - 1 )
+                    d = std::min(d, distance[( iy - 1 ) * size + ix + 1] + diagonal);
+            }
+            distance[iy * size + ix] = d;
+        }
+    for (int iy=size-1; iy>=0; iy--)
+        for (int ix=size-1; ix>=0; ix--) {
+            float d = distance[iy * size + ix];
+            if ( ix < size - 1 )
+                d = std::min(d, distance[iy * size + ix + 1] + straight);
+            if ( iy < size - 1 ) {
+                d = std::min(d, distance[( iy + 1 ) * size + ix] + straight);
+                if ( ix < size - 1 )
+                    d = std::min(d, distance[( iy + 1 ) * size + ix + 1] + diagonal);
+                if ( ix > 0 )
+                    d = std::min(d, distance[( iy + 1 ) * size + ix - 1] + diagonal);
+            }
+            distance[iy * size + ix] = d;
+        }
+
+}
+
+// hits of the simulated scans in the robot frame
+void record(bool turning, std::vector<std::vector<float> >& hits_x, std::vector<std::vector<float> >& hits_y) {
+
+    sim_config config = default_sim_config();
+    simulator sim(config);
+    sim.default_world();
+    std::vector<float> ranges(config.nb_beams);
+    hits_x.resize(nb_scans);
+    hits_y.resize(nb_scans);
+    for (int loop=0; loop<nb_scans; loop++) {
+        sim.scan(&ranges[0]);
+        for (int b=0; b<config.nb_beams; b++)
+            if ( ( ranges[b] > config.range_min ) && ( ranges[b] < config.range_max ) ) {
+                float a = config.angle_min + b * sim.angle_increment();
+                hits_x[loop].push_back(ranges[b] * cos(a));
+                hits_y[loop].push_back(ranges[b] * sin(a));
+            }
+        if ( turning )
+            sim.set_command(0, 0.5);
+        sim.step(0.1);
+    }
+
+}
+
+void run(const char* name, float resolution, const std::vector<std::vector<float> >& hits_x, const std::vector<std::vector<float> >& hits_y) {
+
+    distance_field full(grid_extent, resolution), incremental(grid_extent, resolution);
+    const int size = full.cells_per_side();
+    std::vector<float> reference;
+    double full_time = 0, incremental_time = 0, chamfer_time = 0, chamfer_error = 0, chamfer_near_error = 0;
+    long nb_columns = 0;
+    bool identical = true;
+    for (int loop=0; loop<nb_scans; loop++) {
+        const float* x = hits_x[loop].empty() ? 0 : &hits_x[loop][0];
+        const float* y = hits_y[loop].empty() ? 0 : &hits_y[loop][0];
+        const int nb = hits_x[loop].size();
+
+        benchmark_clock::time_point start = benchmark_clock::now();
+        full.invalidate();
+        full.build(x, y, nb);
+        full_time += seconds_since(start);
+
+        start = benchmark_clock::now();
+        incremental.build(x, y, nb);
+        incremental_time += seconds_since(start);
+        nb_columns += incremental.nb_columns_updated;
+
+        start = benchmark_clock::now();
+        chamfer(x, y, nb, size, resolution, reference);
+        chamfer_time += seconds_since(start);
+
+        for (int cell=0; cell<size*size; cell++) {
+            if ( full.data()[cell] != incremental.data()[cell] )
+                identical = false;
+            double error = fabs(reference[cell] - full.data()[cell]);
+            chamfer_error = std::max(chamfer_error, error);
+            if ( full.data()[cell] < 1 )
+                chamfer_near_error = std::max(chamfer_near_error, error);
+        }
+    }
+
+    printf("%-22s %5.1f %6i %10.1f %10.1f %8.0f %10.1f %8.1f %8.1f %s\n", name, resolution * 100, size, full_time / nb_scans * 1e6,
+           incremental_time / nb_scans * 1e6, (double)nb_columns / nb_scans, chamfer_time / nb_scans * 1e6, chamfer_error * 100,
+           chamfer_near_error * 100, identical ? "" : "columns kept differs from full");
+
+}
+
+int main() {
+
+    std::vector<std::vector<float> > stopped_x, stopped_y, turning_x, turning_y;
+    record(false, stopped_x, stopped_y);
+    record(true, turning_x, turning_y);
+
+    printf("build per scan (us), columns transformed per scan when the columns are kept, chamfer max error (cm)\n");
+    printf("%-22s %5s %6s %10s %10s %8s %10s %8s %8s\n", "run", "cm", "cells", "full", "col. kept", "columns", "chamfer", "err cm", "<1m cm");
+    const float resolutions[2] = { 0.05, 0.025 };
+    for (int r=0; r<2; r++) {
+        run("robot stopped", resolutions[r], stopped_x, stopped_y);
+        run("robot turning", resolutions[r], turning_x, turning_y);
+    }
+
+    // lookups at random positions of the grid
+    distance_field field(grid_extent, 0.05);
+    field.build(&stopped_x[0][0], &stopped_y[0][0], stopped_x[0].size());
+    std::vector<float> positions(2 * 4096);
+    for (size_t loop=0; loop<positions.size(); loop++)
+        positions[loop] = ( rand() / (float)RAND_MAX - 0.5f ) * grid_extent;
+    double sum = 0;
+    benchmark_clock::time_point start = benchmark_clock::now();
+    for (int loop=0; loop<nb_lookups; loop++) {
+        int p = 2 * ( loop & 4095 );
+        float gx, gy;
+        field.gradient(positions[p], positions[p + 1], gx, gy);
+        sum += field.at(positions[p], positions[p + 1]) + gx + gy;
+    }
+    printf("\nclearance + gradient lookup: %.1f ns (checksum %g)\n", seconds_since(start) / nb_lookups * 1e9, sum);
+
+    return 0;
+
+}
@@ -0,0 +1,191 @@
+// time of a cycle of the local planner (see dwa_planner.h) on simulated scans, without ROS
+// the scans are recorded in the default world of the simulator, the robot driving slowly and turning; at each scan, the
+// distance field is built from the hits (8 m grid at 5 cm, as local_planner_node) and the planner selects a (v, w)
+// toward a goal 2 m ahead, starting from the (v, w) selected at the previous scan
+// - scalar: the samples are simulated and scored one by one, without the distance field lookups 4 by 4 (reference)
+// - simd: dwa_planner on the calling thread only
+// - simd + pool: dwa_planner on a pool of one thread per core, as local_planner_node
+// the (v, w) selected by the scalar and the simd versions are compared; the default 32 x 64 samples are also compared
+// with 16 x 32 and 64 x 128 samples. The cycle (grid + plan) must stay below 50 ms for the planner to run at 20 hz
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <vector>
+#include "follow_me/distance_field.h"
+#include "follow_me/dwa_planner.h"
+#include "follow_me/simulator.h"
+#include "follow_me/thread_pool.h"
+
+#define nb_scans 100
+#define grid_extent 8.0
+#define grid_resolution 0.05
+#define planner_period 0.05// s, local_planner_node runs at 20 hz
+
+typedef std::chrono::steady_clock benchmark_clock;
+
+double seconds_since(benchmark_clock::time_point start) {
+
+    return std::chrono::duration<double>(benchmark_clock::now() - start).count();
+
+}
+
+struct plan_result {
+
+    bool admissible;
+    float speed, rotation_speed;
+
+};
+
+// hits of the simulated scans in the robot frame, the robot driving slowly and turning
+void record(std::vector<std::vector<float> >& hits_x, std::vector<std::vector<float> >& hits_y) {
+
+    sim_config config = default_sim_config();
+    simulator sim(config);
+    sim.default_world();
+    std::vector<float> ranges(config.nb_beams);
+    hits_x.resize(nb_scans);
+    hits_y.resize(nb_scans);
+    for (int loop=0; loop<nb_scans; loop++) {
+        sim.scan(&ranges[0]);
+        for (int b=0; b<config.nb_beams; b++)
+            if ( ( ranges[b] > config.range_min ) && ( ranges[b] < config.range_max ) ) {
+                float a = config.angle_min + b * sim.angle_increment();
+                hits_x[loop].push_back(ranges[b] * cos(a));
+                hits_y[loop].push_back(ranges[b] * sin(a));
+            }
+        sim.set_command(0.2, 0.3);
+        sim.step(0.1);
+    }
+
+}
+
+// the same sampling, simulation and score as dwa_planner, one sample at a time
+plan_result plan_scalar(const dwa_config& config, const distance_field& grid, float current_speed, float current_rotation_speed, float goal_x, float goal_y) {
+
+    float dv = config.max_acceleration * config.control_period;
+    float dw = config.max_rotation_acceleration * config.control_period;
+    float v_min = std::max(config.min_speed, current_speed - dv);
+    float v_max = std::min(config.max_speed, current_speed + dv);
+    float w_min = std::max(-config.max_rotation_speed, current_rotation_speed - dw);
+    float w_max = std::min(config.max_rotation_speed, current_rotation_speed + dw);
+
+    const float step = config.horizon / config.nb_steps;
+    const int size = grid.cells_per_side();
+    const float inverse_resolution = 1.0f / grid.cell_size(), offset = -grid.origin();
+
+    plan_result best = { false, 0, 0 };
+    float best_score = 0;
+    for (int loop_v=0; loop_v<config.nb_speed_samples; loop_v++) {
+        float v = v_min + ( v_max - v_min ) * loop_v / std::max(1, config.nb_speed_samples - 1);
+        for (int loop_w=0; loop_w<config.nb_rotation_samples; loop_w++) {
+            float w = w_min + ( w_max - w_min ) * loop_w / std::max(1, config.nb_rotation_samples - 1);
+            float cw = cos(w * step), sw = sin(w * step);
+
+            float x = 0, y = 0, c = 1, s = 0, clearance = 1e6f;
+            for (int k=0; k<config.nb_steps; k++) {
+                float cm = c * cw - s * sw;
+                float sm = s * cw + c * sw;
+                x += v * step * ( c + cm ) * 0.5f;
+                y += v * step * ( s + sm ) * 0.5f;
+                c = cm;
+                s = sm;
+                int ix = std::max(0, std::min(size - 1, (int)( ( x + offset ) * inverse_resolution )));
+                int iy = std::max(0, std::min(size - 1, (int)( ( y + offset ) * inverse_resolution )));
+                clearance = std::min(clearance, grid.data()[iy * size + ix]);
+            }
+
+            float margin = clearance - config.robot_radius;
+            if ( ( margin <= 0 ) || ( v * v / ( 2 * config.max_acceleration ) >= margin ) )
+                continue;
+            float dx = goal_x - x, dy = goal_y - y;
+            float heading_score = ( ( dx * c + dy * s ) / sqrt(dx * dx + dy * dy + 1e-6f) + 1 ) * 0.5f;
+            float score = config.weight_heading * heading_score + config.weight_clearance * std::min(margin, config.max_clearance) / config.max_clearance +
+                          config.weight_velocity * v / config.max_speed;
+            if ( !best.admissible || ( score > best_score ) ) {
+                best.admissible = true;
+                best.speed = v;
+                best.rotation_speed = w;
+                best_score = score;
+            }
+        }
+    }
+    return best;
+
+}
+
+// the selected speeds are the same if they are the same sample (the scores may differ in the last bits)
+bool same_choice(const dwa_config& config, const plan_result& a, const plan_result& b) {
+
+    if ( a.admissible != b.admissible )
+        return false;
+    float tolerance_v = ( config.max_acceleration * config.control_period ) / config.nb_speed_samples;
+    float tolerance_w = ( config.max_rotation_acceleration * config.control_period ) / config.nb_rotation_samples;
+    return !a.admissible || ( ( fabs(a.speed - b.speed) < tolerance_v ) && ( fabs(a.rotation_speed - b.rotation_speed) < tolerance_w ) );
+
+}
+
+void run(int nb_speed_samples, int nb_rotation_samples, thread_pool& pool, const std::vector<std::vector<float> >& hits_x, const std::vector<std::vector<float> >& hits_y) {
+
+    dwa_config config = default_dwa_config();
+    config.nb_speed_samples = nb_speed_samples;
+    config.nb_rotation_samples = nb_rotation_samples;
+    dwa_planner single(config), parallel(config, &pool);
+    distance_field grid(grid_extent, grid_resolution);
+
+    double grid_time = 0, scalar_time = 0, single_time = 0, parallel_time = 0, parallel_max = 0;
+    int nb_same = 0, nb_admissible = 0;
+    float speed = 0.2, rotation_speed = 0;
+    for (int loop=0; loop<nb_scans; loop++) {
+        benchmark_clock::time_point start = benchmark_clock::now();
+        grid.build(hits_x[loop].empty() ? 0 : &hits_x[loop][0], hits_y[loop].empty() ? 0 : &hits_y[loop][0], hits_x[loop].size());
+        grid_time += seconds_since(start);
+
+        const float goal_x = 2, goal_y = 0.5;
+        start = benchmark_clock::now();
+        plan_result scalar = plan_scalar(config, grid, speed, rotation_speed, goal_x, goal_y);
+        scalar_time += seconds_since(start);
+
+        plan_result simd_result, pool_result;
+        float clearance;
+        start = benchmark_clock::now();
+        simd_result.admissible = single.plan(grid, speed, rotation_speed, goal_x, goal_y, simd_result.speed, simd_result.rotation_speed, clearance);
+        single_time += seconds_since(start);
+
+        start = benchmark_clock::now();
+        pool_result.admissible = parallel.plan(grid, speed, rotation_speed, goal_x, goal_y, pool_result.speed, pool_result.rotation_speed, clearance);
+        double t = seconds_since(start);
+        parallel_time += t;
+        parallel_max = std::max(parallel_max, t);
+
+        nb_same += same_choice(config, scalar, simd_result) && same_choice(config, simd_result, pool_result);
+        nb_admissible += pool_result.admissible;
+        // the robot follows the selected speeds
+        speed = pool_result.speed;
+        rotation_speed = pool_result.rotation_speed;
+    }
+
+    char samples[32];
+    snprintf(samples, sizeof(samples), "%i x %i", nb_speed_samples, nb_rotation_samples);
+    const double cycle_max = grid_time / nb_scans + parallel_max;
+    printf("%-10s %7i %9.3f %9.3f %9.3f %9.3f %9.3f %6.0f%% %6i/%i%s\n", samples, single.number_of_samples(), grid_time / nb_scans * 1e3, scalar_time / nb_scans * 1e3,
+           single_time / nb_scans * 1e3, parallel_time / nb_scans * 1e3, cycle_max * 1e3, 100.0 * nb_admissible / nb_scans, nb_same, nb_scans,
+           cycle_max < planner_period ? "" : " slower than 20 hz");
+
+}
+
+int main() {
+
+    std::vector<std::vector<float> > hits_x, hits_y;
+    record(hits_x, hits_y);
+    thread_pool pool;
+
+    printf("%i simulated scans, %i threads in the pool, times per cycle in ms (cycle: grid + max of simd + pool)\n", nb_scans, pool.size());
+    printf("%-10s %7s %9s %9s %9s %9s %9s %7s %8s\n", "samples", "arcs", "grid", "scalar", "simd", "simd+pool", "cycle max", "admis.", "same");
+    run(16, 32, pool, hits_x, hits_y);
+    run(32, 64, pool, hits_x, hits_y);
+    run(64, 128, pool, hits_x, hits_y);
+    return 0;
+
+}
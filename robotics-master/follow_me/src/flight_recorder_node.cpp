@@ -0,0 +1,138 @@
+// flight recorder of follow_me (see flight_recorder.h): the last seconds of scan, odom, goal_to_reach and cmd_vel are
+// kept in memory and written in a log of the format of scan_log.h when
+// - decision_node publishes goal_reached
+// - a node publishes a reason on flight_recorder_trigger (obstacle stop of translation_node, safety stop of
+//   cmd_vel_mux, saturation of the PID of rotation_node and translation_node)
+// - the service dump_flight_recorder is called (rosservice call /dump_flight_recorder)
+// parameters: /flight_recorder_node/duration (s), max_beams, post_trigger (s), min_interval (s), directory
+
+#include "ros/ros.h"
+#include "sensor_msgs/LaserScan.h"
+#include "nav_msgs/Odometry.h"
+#include "geometry_msgs/Point.h"
+#include <geometry_msgs/Twist.h>
+#include "std_msgs/String.h"
+#include "std_srvs/Empty.h"
+#include <tf/transform_datatypes.h>
+#include "follow_me/flight_recorder.h"
+
+recorder_config recording = default_recorder_config();
+
+class flight_recorder_node {
+private:
+
+    ros::NodeHandle n;
+
+    ros::Subscriber sub_scan;
+    ros::Subscriber sub_odometry;
+    ros::Subscriber sub_goal_to_reach;
+    ros::Subscriber sub_cmd_vel;
+    ros::Subscriber sub_goal_reached;
+    ros::Subscriber sub_trigger;
+    ros::ServiceServer service_dump;
+
+    flight_recorder recorder;
+
+public:
+
+flight_recorder_node() : recorder(recording) {
+
+    // the queues are large: the recorder must not miss the messages that precede an event
+    sub_scan = n.subscribe("scan", 10, &flight_recorder_node::scanCallback, this);
+    sub_odometry = n.subscribe("odom", 100, &flight_recorder_node::odomCallback, this);
+    sub_goal_to_reach = n.subscribe("goal_to_reach", 10, &flight_recorder_node::goal_to_reachCallback, this);
+    sub_cmd_vel = n.subscribe("cmd_vel", 100, &flight_recorder_node::cmd_velCallback, this);
+    sub_goal_reached = n.subscribe("goal_reached", 10, &flight_recorder_node::goal_reachedCallback, this);
+    sub_trigger = n.subscribe("flight_recorder_trigger", 10, &flight_recorder_node::triggerCallback, this);
+    service_dump = n.advertiseService("dump_flight_recorder", &flight_recorder_node::dumpCallback, this);
+
+    ros::spin();
+
+    ROS_INFO("(flight_recorder) %li triggers, %li dropped, %li dumps written, %li failed", recorder.nb_triggers, recorder.nb_dropped,
+             recorder.nb_dumps.load(), recorder.nb_failed.load());
+
+}
+
+//CALLBACKS
+/*//////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////*/
+void scanCallback(const sensor_msgs::LaserScan::ConstPtr& scan) {
+
+    if ( !scan->ranges.empty() )
+        recorder.record_scan(scan->header.stamp.toSec(), &scan->ranges[0], scan->ranges.size(), scan->angle_min, scan->angle_increment,
+                             scan->range_min, scan->range_max);
+
+}
+
+void odomCallback(const nav_msgs::Odometry::ConstPtr& o) {
+
+    log_pose p;
+    p.stamp = o->header.stamp.toSec();
+    p.x = o->pose.pose.position.x;
+    p.y = o->pose.pose.position.y;
+    p.yaw = tf::getYaw(o->pose.pose.orientation);
+    p.linear_speed = o->twist.twist.linear.x;
+    p.angular_speed = o->twist.twist.angular.z;
+    recorder.record_odom(p);
+
+}
+
+// the goals and the commands have no stamp: they are stamped at their reception
+void goal_to_reachCallback(const geometry_msgs::Point::ConstPtr& g) {
+
+    recorder.record_goal(ros::Time::now().toSec(), g->x, g->y);
+
+}
+
+void cmd_velCallback(const geometry_msgs::Twist::ConstPtr& twist) {
+
+    recorder.record_cmd_vel(ros::Time::now().toSec(), twist->linear.x, twist->angular.z);
+
+}
+
+void goal_reachedCallback(const geometry_msgs::Point::ConstPtr& g) {
+
+    trigger("goal_reached");
+
+}
+
+void triggerCallback(const std_msgs::String::ConstPtr& reason) {
+
+    trigger(reason->data.c_str());
+
+}
+
+bool dumpCallback(std_srvs::Empty::Request& request, std_srvs::Empty::Response& response) {
+
+    trigger("manual");
+    return true;
+
+}
+
+void trigger(const char* reason) {
+
+    if ( recorder.trigger(ros::Time::now().toSec(), reason) )
+        ROS_INFO("(flight_recorder) %s: the last %f s are written in %s in %f s", reason, recording.duration, recording.directory.c_str(), recording.post_trigger);
+    else
+        ROS_INFO("(flight_recorder) %s: dropped, a dump is in progress or too recent", reason);
+
+}
+
+};
+
+int main(int argc, char **argv){
+
+    ros::init(argc, argv, "flight_recorder");
+
+    ros::param::get("/flight_recorder_node/duration", recording.duration);
+    ros::param::get("/flight_recorder_node/max_beams", recording.max_beams);
+    ros::param::get("/flight_recorder_node/post_trigger", recording.post_trigger);
+    ros::param::get("/flight_recorder_node/min_interval", recording.min_interval);
+    ros::param::get("/flight_recorder_node/directory", recording.directory);
+    ROS_INFO("(flight_recorder) duration: %f s, max_beams: %i, post_trigger: %f s, min_interval: %f s, directory: %s", recording.duration,
+             recording.max_beams, recording.post_trigger, recording.min_interval, recording.directory.c_str());
+
+    flight_recorder_node bsObject;
+
+    return 0;
+}
@@ -0,0 +1,387 @@
+// scorecard of a follow_me run in the simulator (see simulator_node.cpp and launch/scenario.launch)
+// it observes the nodes during "duration" seconds of simulated time, then writes a json scorecard and stops the run:
+// - detection: time of the first /goal_to_reach, from the start and from the first step of a person
+// - localization: distance between each /goal_to_reach and the closest true person
+// - goals: number of /goal_reached, time from a /goal_to_reach to its /goal_reached, distance of the robot to the goal at /goal_reached
+// - tracking: distance between the robot and the followed person (the first one of the scenario), error to follow_distance
+// - waiting: time during which the robot is really stopped while /robot_moving still says it is moving
+// - cpu time of each node (read in /proc) and number of messages of each topic
+// the keys of the scorecard are stable: two runs can be compared with any json tool
+
+#include "ros/ros.h"
+#include "ros/time.h"
+#include "sensor_msgs/LaserScan.h"
+#include "nav_msgs/Odometry.h"
+#include "geometry_msgs/Twist.h"
+#include "geometry_msgs/Point.h"
+#include "geometry_msgs/PoseArray.h"
+#include "std_msgs/Float32.h"
+#include "std_msgs/Bool.h"
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <dirent.h>
+#include <string>
+#include <sstream>
+#include <vector>
+#include <unistd.h>
+#include <tf/transform_datatypes.h>
+// distances and changes of frame (see geometry.h)
+#include "follow_me/geometry.h"
+
+std::string scenario = "default";
+std::string scorecard_file = "follow_me_scorecard.json";
+float duration = 60;// s of simulated time
+float follow_distance = 0.5;// m, distance at which the robot should stay behind the person
+std::string nodes = "simulator_node robot_moving_node moving_person_detector_node obstacle_detection_node decision_node rotation_node translation_node local_planner_node cmd_vel_mux_node";
+
+#define stopped_linear_speed 0.01// m/s
+#define stopped_angular_speed 0.02// rad/s
+
+using namespace std;
+
+enum { topic_scan, topic_odom, topic_cmd_vel, topic_goal_to_reach, topic_goal_reached, topic_rotation_to_do, topic_rotation_done,
+       topic_translation_to_do, topic_translation_done, topic_robot_moving, topic_closest_obstacle, nb_topics };
+const char* topic_names[nb_topics] = { "scan", "odom", "cmd_vel", "goal_to_reach", "goal_reached", "rotation_to_do", "rotation_done",
+                                       "translation_to_do", "translation_done", "robot_moving", "closest_obstacle" };
+
+// running statistics of a metric
+struct statistic {
+
+    int nb;
+    double sum, sum2, max;
+
+statistic() : nb(0), sum(0), sum2(0), max(0) {}
+
+void add(double value) {
+
+    if ( !nb || value > max )
+        max = value;
+    nb++;
+    sum += value;
+    sum2 += value * value;
+
+}
+
+double mean() const { return nb ? sum / nb : 0; }
+double rms() const { return nb ? sqrt(sum2 / nb) : 0; }
+
+};
+
+class follow_harness {
+private:
+
+    ros::NodeHandle n;
+
+    ros::Subscriber sub_truth;
+    ros::Subscriber sub_people_truth;
+    ros::Subscriber sub[nb_topics];
+    int counts[nb_topics];
+
+    // true state of the robot and of the people
+    bool init_truth;
+    float robot_x, robot_y, robot_theta;
+    float robot_linear_speed, robot_angular_speed;
+    vector<geometry_msgs::Point> people;
+    vector<geometry_msgs::Point> people_start;
+
+    // state of the follow_me nodes
+    bool robot_moving;
+    bool goal_pending;
+    geometry_msgs::Point goal;// in the world frame
+    ros::Time goal_stamp;
+
+    // metrics
+    ros::Time start, last_update;
+    double first_walk_time, first_goal_time, first_goal_reached_time;
+    statistic localization_error, goal_cycle, goal_reached_error;
+    statistic person_distance, tracking_error;
+    double min_person_distance;
+    double time_stopped, time_waiting_robot_moving;
+
+    ros::WallTime wall_start;
+
+public:
+
+follow_harness() {
+
+    sub_truth = n.subscribe("truth", 10, &follow_harness::truthCallback, this);
+    sub_people_truth = n.subscribe("people_truth", 10, &follow_harness::people_truthCallback, this);
+
+    sub[topic_scan] = n.subscribe(topic_names[topic_scan], 10, &follow_harness::scanCallback, this);
+    sub[topic_odom] = n.subscribe(topic_names[topic_odom], 10, &follow_harness::odomCallback, this);
+    sub[topic_cmd_vel] = n.subscribe(topic_names[topic_cmd_vel], 10, &follow_harness::cmd_velCallback, this);
+    sub[topic_goal_to_reach] = n.subscribe(topic_names[topic_goal_to_reach], 10, &follow_harness::goal_to_reachCallback, this);
+    sub[topic_goal_reached] = n.subscribe(topic_names[topic_goal_reached], 10, &follow_harness::goal_reachedCallback, this);
+    sub[topic_rotation_to_do] = n.subscribe(topic_names[topic_rotation_to_do], 10, &follow_harness::rotation_to_doCallback, this);
+    sub[topic_rotation_done] = n.subscribe(topic_names[topic_rotation_done], 10, &follow_harness::rotation_doneCallback, this);
+    sub[topic_translation_to_do] = n.subscribe(topic_names[topic_translation_to_do], 10, &follow_harness::translation_to_doCallback, this);
+    sub[topic_translation_done] = n.subscribe(topic_names[topic_translation_done], 10, &follow_harness::translation_doneCallback, this);
+    sub[topic_robot_moving] = n.subscribe(topic_names[topic_robot_moving], 10, &follow_harness::robot_movingCallback, this);
+    sub[topic_closest_obstacle] = n.subscribe(topic_names[topic_closest_obstacle], 10, &follow_harness::closest_obstacleCallback, this);
+    for (int loop=0; loop<nb_topics; loop++)
+        counts[loop] = 0;
+
+    init_truth = false;
+    robot_moving = true;
+    goal_pending = false;
+    first_walk_time = first_goal_time = first_goal_reached_time = -1;
+    min_person_distance = -1;
+    time_stopped = time_waiting_robot_moving = 0;
+
+    // the simulated time starts with the first /clock of the simulator
+    while ( ros::ok() && ros::Time::now().isZero() )
+        ros::WallDuration(0.01).sleep();
+    start = last_update = ros::Time::now();
+    wall_start = ros::WallTime::now();
+    ROS_INFO("(follow_harness) scenario %s: %f s of simulated time", scenario.c_str(), duration);
+
+    ros::Rate r(50);// this node will work at 50hz of simulated time
+    while ( ros::ok() && ( ( ros::Time::now() - start ).toSec() < duration ) ) {
+        ros::spinOnce();
+        update();
+        r.sleep();
+    }
+
+    write_scorecard();
+    ros::shutdown();
+
+}
+
+//UPDATE: tracking and waiting metrics, sampled at 50hz of simulated time
+/*//////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////*/
+void update() {
+
+    ros::Time now = ros::Time::now();
+    double dt = ( now - last_update ).toSec();
+    last_update = now;
+    if ( !init_truth )
+        return;
+
+    if ( ( first_walk_time < 0 ) && !people.empty() && ( point_distance(people[0], people_start[0]) > 0.05 ) )
+        first_walk_time = elapsed(now);
+
+    bool stopped = ( fabs(robot_linear_speed) < stopped_linear_speed ) && ( fabs(robot_angular_speed) < stopped_angular_speed );
+    if ( stopped ) {
+        time_stopped += dt;
+        if ( robot_moving )
+            time_waiting_robot_moving += dt;
+    }
+
+    // tracking starts with the first goal: before, nobody has been detected
+    if ( ( first_goal_time >= 0 ) && !people.empty() ) {
+        geometry_msgs::Point robot;
+        robot.x = robot_x;
+        robot.y = robot_y;
+        double d = point_distance(people[0], robot);
+        person_distance.add(d);
+        tracking_error.add(fabs(d - follow_distance));
+        if ( ( min_person_distance < 0 ) || ( d < min_person_distance ) )
+            min_person_distance = d;
+    }
+
+}
+
+//CALLBACKS
+/*//////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////*/
+void truthCallback(const nav_msgs::Odometry::ConstPtr& o) {
+
+    init_truth = true;
+    robot_x = o->pose.pose.position.x;
+    robot_y = o->pose.pose.position.y;
+    robot_theta = tf::getYaw(o->pose.pose.orientation);
+    robot_linear_speed = o->twist.twist.linear.x;
+    robot_angular_speed = o->twist.twist.angular.z;
+
+}
+
+void people_truthCallback(const geometry_msgs::PoseArray::ConstPtr& p) {
+
+    people.resize(p->poses.size());
+    for (size_t loop=0; loop<p->poses.size(); loop++)
+        people[loop] = p->poses[loop].position;
+    if ( people_start.size() != people.size() )
+        people_start = people;
+
+}
+
+void goal_to_reachCallback(const geometry_msgs::Point::ConstPtr& g) {
+// the goal is given in the frame of the laser: it is moved to the world frame with the true pose of the robot
+
+    counts[topic_goal_to_reach]++;
+    if ( !init_truth )
+        return;
+
+    ros::Time now = ros::Time::now();
+    if ( first_goal_time < 0 ) {
+        first_goal_time = elapsed(now);
+        ROS_INFO("(follow_harness) first goal after %f s", first_goal_time);
+    }
+
+    goal = to_parent(make_frame_transform(robot_x, robot_y, robot_theta), *g);
+    goal.z = 0;
+    goal_pending = true;
+    goal_stamp = now;
+
+    if ( !people.empty() ) {
+        float closest = point_distance(goal, people[0]);
+        for (size_t loop=1; loop<people.size(); loop++)
+            closest = min(closest, point_distance(goal, people[loop]));
+        localization_error.add(closest);
+    }
+
+}
+
+void goal_reachedCallback(const geometry_msgs::Point::ConstPtr& g) {
+
+    counts[topic_goal_reached]++;
+    ros::Time now = ros::Time::now();
+    if ( first_goal_reached_time < 0 )
+        first_goal_reached_time = elapsed(now);
+
+    if ( goal_pending ) {
+        goal_pending = false;
+        goal_cycle.add(( now - goal_stamp ).toSec());
+        geometry_msgs::Point robot;
+        robot.x = robot_x;
+        robot.y = robot_y;
+        goal_reached_error.add(point_distance(robot, goal));
+    }
+
+}
+
+void robot_movingCallback(const std_msgs::Bool::ConstPtr& state) {
+
+    counts[topic_robot_moving]++;
+    robot_moving = state->data;
+
+}
+
+void scanCallback(const sensor_msgs::LaserScan::ConstPtr& scan) { counts[topic_scan]++; }
+void odomCallback(const nav_msgs::Odometry::ConstPtr& o) { counts[topic_odom]++; }
+void cmd_velCallback(const geometry_msgs::Twist::ConstPtr& cmd) { counts[topic_cmd_vel]++; }
+void rotation_to_doCallback(const std_msgs::Float32::ConstPtr& a) { counts[topic_rotation_to_do]++; }
+void rotation_doneCallback(const std_msgs::Float32::ConstPtr& a) { counts[topic_rotation_done]++; }
+void translation_to_doCallback(const std_msgs::Float32::ConstPtr& r) { counts[topic_translation_to_do]++; }
+void translation_doneCallback(const std_msgs::Float32::ConstPtr& r) { counts[topic_translation_done]++; }
+void closest_obstacleCallback(const geometry_msgs::Point::ConstPtr& o) { counts[topic_closest_obstacle]++; }
+
+double elapsed(const ros::Time& t) {
+
+    return ( t - start ).toSec();
+
+}
+
+// cpu time (user + system) of the first process whose executable is "name", -1 if it is not running
+double cpu_time(const string& name) {
+
+    DIR* proc = opendir("/proc");
+    if ( !proc )
+        return -1;
+
+    double result = -1;
+    struct dirent* entry;
+    while ( ( result < 0 ) && ( entry = readdir(proc) ) ) {
+        if ( ( entry->d_name[0] < '0' ) || ( entry->d_name[0] > '9' ) )
+            continue;
+
+        // the first argument of the command line is the executable
+        string path = string("/proc/") + entry->d_name;
+        char command[1024] = "";
+        FILE* f = fopen(( path + "/cmdline" ).c_str(), "r");
+        if ( !f )
+            continue;
+        size_t length = fread(command, 1, sizeof(command) - 1, f);
+        fclose(f);
+        command[length] = 0;
+        const char* executable = strrchr(command, '/');
+        executable = executable ? executable + 1 : command;
+        if ( name != executable )
+            continue;
+
+        // fields 14 and 15 of /proc/<pid>/stat, after the command name in parentheses
+        f = fopen(( path + "/stat" ).c_str(), "r");
+        if ( !f )
+            continue;
+        char stat[1024];
+        length = fread(stat, 1, sizeof(stat) - 1, f);
+        fclose(f);
+        stat[length] = 0;
+        const char* fields = strrchr(stat, ')');
+        unsigned long utime, stime;
+        if ( fields && sscanf(fields + 2, "%*c %*d %*d %*d %*d %*d %*u %*u %*u %*u %*u %lu %lu", &utime, &stime) == 2 )
+            result = (double)( utime + stime ) / sysconf(_SC_CLK_TCK);
+    }
+    closedir(proc);
+    return result;
+
+}
+
+void write_scorecard() {
+
+    double simulated = elapsed(ros::Time::now());
+    double wall = ( ros::WallTime::now() - wall_start ).toSec();
+
+    FILE* f = fopen(scorecard_file.c_str(), "w");
+    if ( !f ) {
+        ROS_ERROR("(follow_harness) cannot write %s", scorecard_file.c_str());
+        return;
+    }
+
+    fprintf(f, "{\n");
+    fprintf(f, "  \"scenario\": \"%s\",\n", scenario.c_str());
+    fprintf(f, "  \"simulated_time\": %.3f,\n", simulated);
+    fprintf(f, "  \"wall_time\": %.3f,\n", wall);
+    fprintf(f, "  \"first_walk_time\": %.3f,\n", first_walk_time);
+    fprintf(f, "  \"first_goal_time\": %.3f,\n", first_goal_time);
+    fprintf(f, "  \"first_goal_delay\": %.3f,\n", ( first_goal_time >= 0 ) && ( first_walk_time >= 0 ) ? first_goal_time - first_walk_time : -1);
+    fprintf(f, "  \"first_goal_reached_time\": %.3f,\n", first_goal_reached_time);
+    fprintf(f, "  \"goal_localization_error\": { \"nb\": %i, \"mean\": %.4f, \"max\": %.4f },\n", localization_error.nb, localization_error.mean(), localization_error.max);
+    fprintf(f, "  \"goal_cycle_time\": { \"nb\": %i, \"mean\": %.4f, \"max\": %.4f },\n", goal_cycle.nb, goal_cycle.mean(), goal_cycle.max);
+    fprintf(f, "  \"goal_reached_error\": { \"nb\": %i, \"mean\": %.4f, \"max\": %.4f },\n", goal_reached_error.nb, goal_reached_error.mean(), goal_reached_error.max);
+    fprintf(f, "  \"person_distance\": { \"mean\": %.4f, \"min\": %.4f, \"max\": %.4f },\n", person_distance.mean(), min_person_distance, person_distance.max);
+    fprintf(f, "  \"tracking_error\": { \"follow_distance\": %.3f, \"mean\": %.4f, \"rms\": %.4f, \"max\": %.4f },\n", follow_distance, tracking_error.mean(), tracking_error.rms(), tracking_error.max);
+    fprintf(f, "  \"time_stopped\": %.3f,\n", time_stopped);
+    fprintf(f, "  \"time_waiting_robot_moving\": %.3f,\n", time_waiting_robot_moving);
+
+    fprintf(f, "  \"cpu\": {");
+    istringstream names(nodes);
+    string name;
+    bool first = true;
+    while ( names >> name ) {
+        double cpu = cpu_time(name);
+        fprintf(f, "%s\n    \"%s\": { \"seconds\": %.3f, \"per_simulated_second\": %.5f }", first ? "" : ",", name.c_str(), cpu, cpu >= 0 && simulated > 0 ? cpu / simulated : -1);
+        first = false;
+    }
+    fprintf(f, "\n  },\n");
+
+    fprintf(f, "  \"messages\": {");
+    for (int loop=0; loop<nb_topics; loop++)
+        fprintf(f, "%s\n    \"%s\": %i", loop ? "," : "", topic_names[loop], counts[loop]);
+    fprintf(f, "\n  }\n");
+    fprintf(f, "}\n");
+    fclose(f);
+
+    ROS_INFO("(follow_harness) scorecard written in %s: first goal %f s, %i goals reached, tracking error %f m (rms)", scorecard_file.c_str(), first_goal_time,
+             counts[topic_goal_reached], tracking_error.rms());
+
+}
+
+};
+
+int main(int argc, char **argv){
+
+    ros::init(argc, argv, "follow_harness");
+
+    ros::param::get("/follow_harness_node/scenario", scenario);
+    ros::param::get("/follow_harness_node/scorecard", scorecard_file);
+    ros::param::get("/follow_harness_node/duration", duration);
+    ros::param::get("/follow_harness_node/follow_distance", follow_distance);
+    ros::param::get("/follow_harness_node/nodes", nodes);
+
+    follow_harness bsObject;
+
+    return 0;
+}
@@ -0,0 +1,156 @@
+// frames degraded by the wait for the odometry in moving_person_detector_node (see frame_scheduler.h and input_sync.h)
+// the timing of the node is simulated without ROS: the laser publishes a scan every scan_period, the odometry every
+// odom_period, each message reaches the node after a latency; the loop of the node wakes up every node_period (the
+// clocks of the laser and of the node drift, so that all the phases are seen), takes the messages received, and
+// processes the newest scan once input_sync is ready for its stamp (odometry received after the stamp, or max_wait
+// elapsed). A scan that waits for the odometry is processed at a later wakeup, unless a newer scan replaces it first:
+// the node polls every input_poll while a scan waits, or only wakes up at its period without polling
+// for each latency of the odometry, the scans processed, the frames degraded and skipped and the percentiles of the
+// age of the scans are reported:
+// - at 10 hz, with a degrade_age of one period: the age of a scan that waits for the odometry is above it
+// - at 10 hz, with the default of default_scheduler_config(), which accounts for the wait
+// - with the polling and the default degrade_age, as moving_person_detector_node
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <vector>
+#include "follow_me/frame_scheduler.h"
+#include "follow_me/input_sync.h"
+
+#define simulated_duration 600// s
+#define scan_period 0.1// s, of the laser
+#define odom_period 0.05// s
+#define node_period 0.1002// s, the clock of the node drifts from the clock of the laser
+#define scan_latency 0.01// s, plus up to scan_latency of jitter
+#define wakeup_jitter 0.003// s, of the loop of the node
+#define input_poll 0.01// s, as moving_person_detector_node
+
+// random numbers of the benchmark, the same from run to run
+uint32_t random_state = 12345;
+
+float uniform() {
+
+    random_state = random_state * 1664525u + 1013904223u;
+    return ( random_state >> 8 ) * ( 1.0f / 16777216.0f );
+
+}
+
+struct message {
+
+    double stamp, arrival;// s
+
+};
+
+bool arrives_before(const message& a, const message& b) {
+
+    return a.arrival < b.arrival;
+
+}
+
+struct scheduling_result {
+
+    long scans, frames, degraded, skipped;
+    double p50, p90, p99, max_age;// s
+
+};
+
+scheduling_result simulate(const scheduler_config& config, double odom_latency, bool poll) {
+
+    random_state = 12345;
+    frame_scheduler scheduler(config);
+    input_sync inputs;
+
+    // the messages, with the time they reach the node
+    std::vector<message> scans, odoms;
+    for (double t=0.013; t<simulated_duration; t+=scan_period) {
+        message m = { t, t + scan_latency * ( 1 + uniform() ) };
+        scans.push_back(m);
+    }
+    for (double t=0; t<simulated_duration; t+=odom_period) {
+        message m = { t, t + odom_latency * ( 0.5 + uniform() ) };
+        odoms.push_back(m);
+    }
+    std::sort(odoms.begin(), odoms.end(), arrives_before);
+
+    std::vector<double> ages;
+    size_t next_scan = 0, next_odom = 0;
+    double last_stamp = 0, wakeup = 0, next_period = node_period;
+    double max_age = 0;
+    bool waiting = false;
+    while ( true ) {
+        // ros::Rate::sleep() at the period, or a short sleep while a scan waits for the odometry
+        if ( poll && waiting )
+            wakeup += input_poll;
+        else {
+            while ( next_period <= wakeup )
+                next_period += node_period;
+            wakeup = next_period;
+        }
+        wakeup += wakeup_jitter * uniform();
+        if ( wakeup > simulated_duration )
+            break;
+        // ros::spinOnce(): the callbacks of the messages received
+        for (; ( next_scan < scans.size() ) && ( scans[next_scan].arrival <= wakeup ); next_scan++) {
+            scheduler.scan_received(scans[next_scan].stamp, scan_period);
+            last_stamp = scans[next_scan].stamp;
+        }
+        for (; ( next_odom < odoms.size() ) && ( odoms[next_odom].arrival <= wakeup ); next_odom++) {
+            log_pose p = log_pose();
+            p.stamp = odoms[next_odom].stamp;
+            inputs.add_odom(p);
+        }
+        // update()
+        waiting = scheduler.has_pending_scan() && !inputs.ready(last_stamp, wakeup);
+        if ( !scheduler.has_pending_scan() || waiting )
+            continue;
+        frame_decision decision = scheduler.begin_frame(wakeup, last_stamp);
+        if ( decision != frame_skipped )
+            scheduler.end_frame();
+        ages.push_back(scheduler.last_age);
+        max_age = std::max(max_age, scheduler.last_age);
+    }
+
+    scheduling_result r;
+    r.scans = scans.size();
+    r.frames = scheduler.nb_frames;
+    r.degraded = scheduler.nb_degraded;
+    r.skipped = scheduler.nb_skipped;
+    std::sort(ages.begin(), ages.end());
+    r.p50 = ages[ages.size() / 2];
+    r.p90 = ages[ages.size() * 9 / 10];
+    r.p99 = ages[ages.size() * 99 / 100];
+    r.max_age = max_age;
+    return r;
+
+}
+
+void report(const char* name, double odom_latency, const scheduler_config& config, bool poll) {
+
+    scheduling_result r = simulate(config, odom_latency, poll);
+    printf("%-20s %8.0f %8.0f %8.1f %8.1f %8.1f %7.1f %7.1f %7.1f %7.1f\n", name, odom_latency * 1000, config.degrade_age * 1000, 100.0 * r.frames / r.scans,
+           100.0 * r.degraded / std::max(1L, r.frames), 100.0 * r.skipped / std::max(1L, r.frames + r.skipped), r.p50 * 1000, r.p90 * 1000, r.p99 * 1000,
+           r.max_age * 1000);
+
+}
+
+int main() {
+
+    const double node_wait = input_sync().max_wait;
+    printf("%.0f s simulated, scans every %.0f ms, odometry every %.0f ms, loop every %.1f ms, input_sync max_wait %.0f ms\n", (double)simulated_duration,
+           scan_period * 1000, odom_period * 1000, node_period * 1000, node_wait * 1000);
+    printf("%-20s %8s %8s %8s %8s %8s %7s %7s %7s %7s\n", "node", "odom ms", "degr. ms", "frames %", "degr. %", "skip. %", "p50 ms", "p90 ms", "p99 ms",
+           "max ms");
+
+    // the latency of the odometry is uniform in [0.5, 1.5] times its value
+    const double latencies[] = { 0.005, 0.02, 0.05, 0.1, 0.3 };
+    for (size_t loop=0; loop<sizeof(latencies)/sizeof(latencies[0]); loop++) {
+        scheduler_config one_period = default_scheduler_config(0.1);
+        one_period.degrade_age = 0.1;
+        report("10 hz, one period", latencies[loop], one_period, false);
+        report("10 hz, default", latencies[loop], default_scheduler_config(0.1, node_wait), false);
+        report("poll, default", latencies[loop], default_scheduler_config(0.1, node_wait), true);
+    }
+    return 0;
+
+}
@@ -0,0 +1,228 @@
+// accuracy versus cpu of the front-end of the detector (see scan_frontend.h)
+// usage: frontend_benchmark [log]
+// - with a log (see scan_log.h), its scans are used
+// - without a log, a run of the simulator is recorded with a dense laser (16000 beams): robot stopped, one person walking
+// the reference is the position of the person given by the simulator, or the detector at full resolution for a log;
+// for each configuration of the front-end, the time per scan, the number of beams processed, the persons of the
+// reference found (at less than match_distance) and missed, the false detections and the error on the goal are reported
+// the configurations are run in turn nb_runs times, and the time of a scan is its smallest time: the speed of a busy
+// machine changes from run to run
+// the deadlines are fractions of the time of the full resolution, measured by a first run
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <vector>
+#include "follow_me/detector_core.h"
+#include "follow_me/geometry.h"
+#include "follow_me/scan_log.h"
+#include "follow_me/simulator.h"
+
+#define match_distance 0.3// m
+#define nb_runs 10
+
+struct frame_result {
+
+    std::vector<detector_point> persons;
+    bool has_goal;
+    detector_point goal;
+
+};
+
+struct run_result {
+
+    std::vector<double> best;// s, smallest time of each scan
+    double time;// s per scan
+    double beams;// processed per scan
+    float roi_range;// m, range of the region of interest at the end of the run
+    std::vector<frame_result> frames;
+
+};
+
+// one run of the detector on all the scans; the detections and the beams processed are kept from the first run
+void run(const scan_log& log, const frontend_config& config, run_result& result) {
+
+    const bool first = result.best.empty();
+    if ( first ) {
+        result.best.assign(log.scans.size(), 1e9);
+        result.frames.resize(log.scans.size());
+        result.beams = 0;
+    }
+    detector_pipeline* detector = 0;
+    for (size_t loop=0; loop<log.scans.size(); loop++) {
+        const log_scan& s = log.scans[loop];
+        const int nb = s.ranges.size();
+        if ( !detector || !detector->accepts(nb, s.angle_min, s.angle_increment) ) {
+            delete detector;
+            detector = make_detector_pipeline(nb, s.angle_min, s.angle_increment);
+            detector->frontend.config = config;
+        }
+        detector->set_scan(&s.ranges[0], nb, s.angle_min, s.angle_increment, s.range_min, s.range_max);
+        if ( !loop )
+            detector->store_background();
+        detector->detect();
+        result.best[loop] = std::min(result.best[loop], detector->processing_time);
+        if ( first ) {
+            frame_result& f = result.frames[loop];
+            f.persons = detector->moving_persons;
+            f.has_goal = !detector->moving_persons.empty();
+            f.goal = detector->goal_to_reach;
+            result.beams += detector->frontend.active() ? detector->frontend.nb_selected : nb;
+        }
+    }
+    result.roi_range = detector ? detector->frontend.current_range : 0;
+    delete detector;
+
+    double total = 0;
+    for (size_t loop=0; loop<result.best.size(); loop++)
+        total += result.best[loop];
+    result.time = total / log.scans.size();
+    if ( first )
+        result.beams /= log.scans.size();
+
+}
+
+bool close_to_one_of(const detector_point& p, const std::vector<detector_point>& persons) {
+
+    for (size_t loop=0; loop<persons.size(); loop++)
+        if ( point_distance(p, persons[loop]) < match_distance )
+            return true;
+    return false;
+
+}
+
+void report(const char* name, const std::vector<frame_result>& reference, double reference_time, const run_result& r) {
+
+    int found = 0, missed = 0, false_detections = 0, nb_goals = 0;
+    double goal_error = 0;
+    for (size_t loop=0; loop<r.frames.size(); loop++) {
+        const frame_result& ref = reference[loop];
+        const frame_result& f = r.frames[loop];
+        for (size_t p=0; p<ref.persons.size(); p++)
+            if ( close_to_one_of(ref.persons[p], f.persons) )
+                found++;
+            else
+                missed++;
+        for (size_t p=0; p<f.persons.size(); p++)
+            if ( !close_to_one_of(f.persons[p], ref.persons) )
+                false_detections++;
+        if ( ref.has_goal && f.has_goal ) {
+            goal_error += point_distance(ref.goal, f.goal);
+            nb_goals++;
+        }
+    }
+
+    float recall = found + missed ? (float)found / ( found + missed ) * 100 : 100;
+    printf("%-28s %9.1f %9.0f %7.2f %8.1f %7i %7i %10.3f %8.2f\n", name, r.time * 1e6, r.beams, reference_time / r.time, recall, missed, false_detections,
+           nb_goals ? goal_error / nb_goals : 0, r.roi_range);
+
+}
+
+int main(int argc, char** argv) {
+
+    scan_log log;
+    std::vector<frame_result> truth;
+    if ( argc > 1 ) {
+        if ( !log.load(argv[1]) ) {
+            printf("cannot read %s\n", argv[1]);
+            return 1;
+        }
+        printf("log %s: %i scans\n", argv[1], (int)log.scans.size());
+    }
+    else {
+        sim_config config = default_sim_config();
+        config.nb_beams = 16000;
+        simulator sim(config);
+        sim.default_world();
+        for (int loop=0; loop<300; loop++) {
+            log_scan s;
+            s.stamp = sim.time;
+            s.angle_min = config.angle_min;
+            s.angle_increment = sim.angle_increment();
+            s.range_min = config.range_min;
+            s.range_max = config.range_max;
+            s.ranges.resize(config.nb_beams);
+            sim.scan(&s.ranges[0]);
+            log.scans.push_back(s);
+
+            // the persons in the frame of the laser
+            frame_result t;
+            for (size_t p=0; p<sim.people.size(); p++) {
+                detector_point person;
+                person.x = sim.people[p].x;
+                person.y = sim.people[p].y;
+                person = to_child(make_frame_transform(sim.x, sim.y, sim.theta), person);
+                t.persons.push_back(person);
+                t.goal = person;
+            }
+            t.has_goal = !t.persons.empty();
+            truth.push_back(t);
+            sim.step(0.1);
+        }
+        printf("simulated run: %i scans of %i beams\n", (int)log.scans.size(), config.nb_beams);
+    }
+    if ( log.scans.empty() )
+        return 1;
+
+    struct configuration {
+
+        char name[64];
+        frontend_config config;
+        run_result result;
+
+    };
+    std::vector<configuration> configs;
+    configuration c;
+    c.config = default_frontend_config();
+    snprintf(c.name, sizeof(c.name), "full resolution");
+    configs.push_back(c);
+
+    const float spacings[] = { 0.01, 0.02, 0.04, 0.08 };
+    for (int loop=0; loop<4; loop++) {
+        c.config = default_frontend_config();
+        c.config.decimation_spacing = spacings[loop];
+        snprintf(c.name, sizeof(c.name), "decimation %.0f cm", spacings[loop] * 100);
+        configs.push_back(c);
+    }
+
+    c.config = default_frontend_config();
+    c.config.roi_range = 4;
+    snprintf(c.name, sizeof(c.name), "roi 4 m");
+    configs.push_back(c);
+    c.config.decimation_spacing = 0.02;
+    snprintf(c.name, sizeof(c.name), "roi 4 m + decimation 2 cm");
+    configs.push_back(c);
+
+    c.config = default_frontend_config();
+    c.config.roi_angle_min = -M_PI / 3;
+    c.config.roi_angle_max = M_PI / 3;
+    snprintf(c.name, sizeof(c.name), "roi -60..60 deg");
+    configs.push_back(c);
+
+    // the deadlines tighten the range of the region of interest until they are met
+    run_result calibration;
+    run(log, default_frontend_config(), calibration);
+    const double full_time = calibration.time;
+    c.config = default_frontend_config();
+    c.config.deadline = full_time / 2;
+    snprintf(c.name, sizeof(c.name), "deadline %.0f us", c.config.deadline * 1e6);
+    configs.push_back(c);
+    c.config.decimation_spacing = 0.02;
+    c.config.deadline = full_time / 4;
+    snprintf(c.name, sizeof(c.name), "deadline %.0f us + 2 cm", c.config.deadline * 1e6);
+    configs.push_back(c);
+
+    for (int r=0; r<nb_runs; r++)
+        for (size_t loop=0; loop<configs.size(); loop++)
+            run(log, configs[loop].config, configs[loop].result);
+
+    if ( truth.empty() )
+        truth = configs[0].result.frames;
+    printf("%-28s %9s %9s %7s %8s %7s %7s %10s %8s\n", "front-end", "us/scan", "beams", "speedup", "recall%", "missed", "false", "goal err m", "roi m");
+    for (size_t loop=0; loop<configs.size(); loop++)
+        report(configs[loop].name, truth, configs[0].result.time, configs[loop].result);
+
+    return 0;
+
+}
@@ -0,0 +1,255 @@
+// batch versions of geometry.h (4 points at a time, see simd.h) against the same computations point by point
+// - squared distances of a set of points to a point, closest point, change of frame (to the parent and to the child)
+// - the point sets are the hits of a scan (726 to 2048 points, in the frame of the laser) as structure of arrays
+// - normalize_angle() is compared with atan2(sin(a), cos(a)), on angles of a few turns, and with remainder() on angles
+//   of up to 1000 turns (the whole turns are removed at once)
+// the results of both versions are compared: identical for the distances and the closest point, within 1e-5 m for the
+// changes of frame (the compiler may contract the point by point version into fused multiply-adds)
+// the gain of the batch versions comes from the 4 points loaded at each iteration before the results are stored; with
+// FOLLOW_ME_NO_SIMD, it depends on the vectorization of the loops over the 4 lanes by the compiler: compare the build
+// with -fno-tree-vectorize, where the SSE2 version keeps its gain and the scalar lanes are several times slower than the
+// point by point version, and with -O3, where the point by point loops are vectorized too
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <vector>
+#include "follow_me/geometry.h"
+
+#define nb_runs 20000
+#define nb_angles 100000
+
+typedef std::chrono::steady_clock benchmark_clock;
+
+double seconds_since(benchmark_clock::time_point start) {
+
+    return std::chrono::duration<double>(benchmark_clock::now() - start).count();
+
+}
+
+// random numbers of the benchmark, the same from run to run
+uint32_t random_state = 12345;
+
+float uniform() {
+
+    random_state = random_state * 1664525u + 1013904223u;
+    return ( random_state >> 8 ) * ( 1.0f / 16777216.0f );
+
+}
+
+struct point_set {
+
+    std::vector<float> x, y;
+
+};
+
+// the hits of a laser of nb beams over 270 degrees, at 0.5 to 5.5 m
+point_set make_point_set(int nb) {
+
+    point_set p;
+    p.x.resize(nb);
+    p.y.resize(nb);
+    for (int loop=0; loop<nb; loop++) {
+        float a = -3 * M_PI / 4 + loop * ( 3 * M_PI / 2 ) / nb, r = 0.5f + 5 * uniform();
+        p.x[loop] = r * cos(a);
+        p.y[loop] = r * sin(a);
+    }
+    return p;
+
+}
+
+// the results are read so that the compiler keeps them
+volatile float sink;
+
+void squared_distances_scalar(const float* x, const float* y, int nb, float px, float py, float* d2) {
+
+    for (int loop=0; loop<nb; loop++)
+        d2[loop] = ( x[loop] - px ) * ( x[loop] - px ) + ( y[loop] - py ) * ( y[loop] - py );
+
+}
+
+int closest_point_scalar(const float* x, const float* y, int nb, float px, float py, float& d2) {
+
+    int best = -1;
+    d2 = INFINITY;
+    for (int loop=0; loop<nb; loop++) {
+        float d = ( x[loop] - px ) * ( x[loop] - px ) + ( y[loop] - py ) * ( y[loop] - py );
+        if ( d < d2 ) {
+            d2 = d;
+            best = loop;
+        }
+    }
+    return best;
+
+}
+
+struct point {
+
+    float x, y;
+
+};
+
+void to_parent_scalar(const frame_transform& t, const float* x, const float* y, int nb, float* out_x, float* out_y) {
+
+    for (int loop=0; loop<nb; loop++) {
+        point p = { x[loop], y[loop] };
+        p = to_parent(t, p);
+        out_x[loop] = p.x;
+        out_y[loop] = p.y;
+    }
+
+}
+
+void to_child_scalar(const frame_transform& t, const float* x, const float* y, int nb, float* out_x, float* out_y) {
+
+    for (int loop=0; loop<nb; loop++) {
+        point p = { x[loop], y[loop] };
+        p = to_child(t, p);
+        out_x[loop] = p.x;
+        out_y[loop] = p.y;
+    }
+
+}
+
+float max_difference(const std::vector<float>& a, const std::vector<float>& b) {
+
+    float m = 0;
+    for (size_t loop=0; loop<a.size(); loop++)
+        m = std::max(m, (float)fabs(a[loop] - b[loop]));
+    return m;
+
+}
+
+void print(const char* name, int nb, double scalar, double batch, const char* result) {
+
+    printf("%-18s %5i points: %6.2f -> %6.2f ns per point (x%.2f), %s\n", name, nb, scalar * 1e9, batch * 1e9, batch > 0 ? scalar / batch : 0.0, result);
+
+}
+
+void compare(int nb) {
+
+    const point_set p = make_point_set(nb);
+    const float px = 1.2f, py = -0.4f;
+    // the laser in the base, the base in odom
+    const frame_transform odom = compose(make_frame_transform(3.5f, -1.25f, 2.9f), make_frame_transform(0.1f, 0, 0));
+    std::vector<float> scalar_x(nb), scalar_y(nb), batch_x(nb), batch_y(nb);
+    const double per_point = 1.0 / ( (double)nb_runs * nb );
+
+    benchmark_clock::time_point start = benchmark_clock::now();
+    for (int r=0; r<nb_runs; r++) {
+        squared_distances_scalar(&p.x[0], &p.y[0], nb, px, py + r * 1e-6f, &scalar_x[0]);
+        sink = scalar_x[r % nb];
+    }
+    double scalar = seconds_since(start) * per_point;
+    start = benchmark_clock::now();
+    for (int r=0; r<nb_runs; r++) {
+        squared_distances(&p.x[0], &p.y[0], nb, px, py + r * 1e-6f, &batch_x[0]);
+        sink = batch_x[r % nb];
+    }
+    print("squared_distances", nb, scalar, seconds_since(start) * per_point, scalar_x == batch_x ? "identical" : "DIFFERENT");
+
+    start = benchmark_clock::now();
+    std::vector<int> scalar_best(nb_runs);
+    for (int r=0; r<nb_runs; r++) {
+        float d2;
+        scalar_best[r] = closest_point_scalar(&p.x[0], &p.y[0], nb, p.x[r % nb], p.y[r % nb] + 0.05f, d2);
+        sink = d2;
+    }
+    scalar = seconds_since(start) * per_point;
+    start = benchmark_clock::now();
+    std::vector<int> batch_best(nb_runs);
+    for (int r=0; r<nb_runs; r++) {
+        float d2;
+        batch_best[r] = closest_point(&p.x[0], &p.y[0], nb, p.x[r % nb], p.y[r % nb] + 0.05f, d2);
+        sink = d2;
+    }
+    print("closest_point", nb, scalar, seconds_since(start) * per_point, scalar_best == batch_best ? "identical" : "DIFFERENT");
+
+    char result[64];
+    start = benchmark_clock::now();
+    for (int r=0; r<nb_runs; r++) {
+        to_parent_scalar(odom, &p.x[0], &p.y[0], nb, &scalar_x[0], &scalar_y[0]);
+        sink = scalar_x[r % nb];
+    }
+    scalar = seconds_since(start) * per_point;
+    start = benchmark_clock::now();
+    for (int r=0; r<nb_runs; r++) {
+        to_parent(odom, &p.x[0], &p.y[0], nb, &batch_x[0], &batch_y[0]);
+        sink = batch_x[r % nb];
+    }
+    float difference = std::max(max_difference(scalar_x, batch_x), max_difference(scalar_y, batch_y));
+    snprintf(result, sizeof(result), "%s (%.1e m)", difference < 1e-5 ? "same" : "DIFFERENT", difference);
+    print("to_parent", nb, scalar, seconds_since(start) * per_point, result);
+
+    // back to the laser: the points of the set are found again
+    const std::vector<float> odom_x = batch_x, odom_y = batch_y;
+    start = benchmark_clock::now();
+    for (int r=0; r<nb_runs; r++) {
+        to_child_scalar(odom, &odom_x[0], &odom_y[0], nb, &scalar_x[0], &scalar_y[0]);
+        sink = scalar_x[r % nb];
+    }
+    scalar = seconds_since(start) * per_point;
+    start = benchmark_clock::now();
+    for (int r=0; r<nb_runs; r++) {
+        to_child(odom, &odom_x[0], &odom_y[0], nb, &batch_x[0], &batch_y[0]);
+        sink = batch_x[r % nb];
+    }
+    difference = std::max(max_difference(scalar_x, batch_x), max_difference(scalar_y, batch_y));
+    float round_trip = std::max(max_difference(p.x, batch_x), max_difference(p.y, batch_y));
+    snprintf(result, sizeof(result), "%s (%.1e m, round trip %.1e m)", difference < 1e-5 ? "same" : "DIFFERENT", difference, round_trip);
+    print("to_child", nb, scalar, seconds_since(start) * per_point, result);
+
+}
+
+void compare_angles() {
+
+    std::vector<float> a(nb_angles);
+    for (int loop=0; loop<nb_angles; loop++)
+        a[loop] = ( uniform() - 0.5f ) * 6 * 2 * M_PI;
+
+    float difference = 0, sum = 0;
+    benchmark_clock::time_point start = benchmark_clock::now();
+    for (int loop=0; loop<nb_angles; loop++)
+        sum += atan2(sin(a[loop]), cos(a[loop]));
+    double reference = seconds_since(start) / nb_angles;
+    sink = sum;
+    sum = 0;
+    start = benchmark_clock::now();
+    for (int loop=0; loop<nb_angles; loop++)
+        sum += normalize_angle(a[loop]);
+    double normalized = seconds_since(start) / nb_angles;
+    sink = sum;
+    for (int loop=0; loop<nb_angles; loop++) {
+        // -M_PI and M_PI are the same angle: the difference is taken modulo 2 M_PI
+        difference = std::max(difference, (float)fabs(angle_difference(normalize_angle(a[loop]), (float)atan2(sin(a[loop]), cos(a[loop])))));
+    }
+    printf("%-18s %5i angles: %6.2f -> %6.2f ns per angle (x%.2f) against atan2(sin, cos), %s (%.1e rad)\n", "normalize_angle", nb_angles,
+           reference * 1e9, normalized * 1e9, normalized > 0 ? reference / normalized : 0.0, difference < 1e-5 ? "same" : "DIFFERENT", difference);
+
+    // far angles, in double
+    double far_difference = 0;
+    for (int loop=0; loop<nb_angles; loop++) {
+        double b = ( uniform() - 0.5 ) * 2000 * 2 * M_PI;
+        far_difference = std::max(far_difference, fabs(angle_difference(normalize_angle(b), std::remainder(b, 2 * M_PI))));
+    }
+    printf("%-18s %5i angles of up to 1000 turns against remainder(), %s (%.1e rad)\n", "normalize_angle", nb_angles, far_difference < 1e-9 ? "same" : "DIFFERENT",
+           far_difference);
+
+}
+
+int main() {
+
+#ifdef FOLLOW_ME_SSE2
+    printf("batch versions with SSE2\n");
+#else
+    printf("batch versions with the scalar lanes of simd.h\n");
+#endif
+    // hokuyo_urg_726, lidar_1440 and lidar_2048 of the detector core (see detector_core.h), and a size that is not a multiple of 4
+    const int sizes[] = { 726, 1440, 2048, 1001 };
+    for (size_t loop=0; loop<sizeof(sizes)/sizeof(sizes[0]); loop++)
+        compare(sizes[loop]);
+    compare_angles();
+    return 0;
+
+}
@@ -0,0 +1,111 @@
+// latency of the wakeups of a control loop (see realtime.h), reported as cyclictest does
+// the loop runs at 1 khz for nb_cycles cycles and writes one line per cycle (to /dev/null), as the PID of
+// rotation_node and translation_node; it is measured:
+// - idle: no load, normal scheduling, the lines written by the loop
+// - loaded: one thread per cpu runs the detector core on simulated scans without pause (the detector of robair)
+// - loaded, real-time: memory locked, SCHED_FIFO, the lines written by the thread of realtime_log
+// the real-time run needs CAP_SYS_NICE (or an rtprio limit) and a memlock limit: it is reported as refused otherwise
+
+#include <atomic>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <thread>
+#include <vector>
+#include "follow_me/detector_core.h"
+#include "follow_me/realtime.h"
+#include "follow_me/simulator.h"
+
+#define nb_cycles 5000
+#define cycle_period 0.001// s
+#define nb_load_scans 100
+
+std::atomic<bool> loaded(false);
+
+// the detector core on a recorded run until the end of the measure
+void load(const std::vector<std::vector<float> >* scans, float angle_min, float angle_increment, float range_min, float range_max) {
+
+    const std::vector<std::vector<float> >& s = *scans;
+    detector_pipeline* detector = make_detector_pipeline(s[0].size(), angle_min, angle_increment);
+    for (size_t loop=0; loaded; loop=( loop + 1 ) % s.size()) {
+        detector->set_scan(&s[loop][0], s[loop].size(), angle_min, angle_increment, range_min, range_max);
+        if ( !loop )
+            detector->store_background();
+        detector->detect();
+    }
+    delete detector;
+
+}
+
+void measure(const char* name, bool realtime, FILE* output) {
+
+    realtime_log log([output](int, const char* text) { fprintf(output, "%s\n", text); });
+    if ( realtime ) {
+        log.start();
+        bool locked = lock_memory(default_realtime_config().stack_size);
+        int lock_error = errno;
+        if ( !set_fifo_priority(default_realtime_config().priority) ) {
+            printf("%-22s SCHED_FIFO refused: %s\n", name, strerror(errno));
+            return;
+        }
+        if ( !locked )
+            printf("%-22s (memory not locked: %s)\n", name, strerror(lock_error));
+    }
+
+    periodic_timer timer(cycle_period);
+    jitter_histogram jitter;
+    float error = 0, integral = 0;
+    for (int loop=0; loop<nb_cycles; loop++) {
+        jitter.add(timer.sleep());
+        error = 0.5f * error + 0.001f * ( loop % 7 );
+        integral += error;
+        log.info("(benchmark) error: %f, error_integral: %f -> speed: %f", error, integral, 0.5f * error);
+    }
+    log.stop();
+
+    char text[256];
+    jitter.report(text, sizeof(text));
+    printf("%-22s %s (us), %li overruns, %li lines dropped\n", name, text, timer.nb_overruns, log.nb_dropped.load());
+
+    if ( realtime ) {
+        sched_param param;
+        memset(&param, 0, sizeof(param));
+        pthread_setschedparam(pthread_self(), SCHED_OTHER, &param);
+    }
+
+}
+
+int main() {
+
+    FILE* output = fopen("/dev/null", "w");
+    if ( !output )
+        return 1;
+
+    sim_config config = default_sim_config();
+    simulator sim(config);
+    sim.default_world();
+    std::vector<std::vector<float> > scans(nb_load_scans, std::vector<float>(config.nb_beams));
+    for (int loop=0; loop<nb_load_scans; loop++) {
+        sim.scan(&scans[loop][0]);
+        sim.step(0.1);
+    }
+
+    printf("%i cycles of %.0f us\n", nb_cycles, cycle_period * 1e6);
+    measure("idle", false, output);
+
+    loaded = true;
+    std::vector<std::thread> threads;
+    int nb_threads = std::max(1u, std::thread::hardware_concurrency());
+    for (int loop=0; loop<nb_threads; loop++)
+        threads.push_back(std::thread(load, &scans, config.angle_min, sim.angle_increment(), config.range_min, config.range_max));
+    measure("loaded", false, output);
+    measure("loaded, real-time", true, output);
+    loaded = false;
+    for (size_t loop=0; loop<threads.size(); loop++)
+        threads[loop].join();
+    printf("(%i threads of load)\n", nb_threads);
+
+    fclose(output);
+    return 0;
+
+}
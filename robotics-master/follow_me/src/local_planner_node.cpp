@@ -0,0 +1,244 @@
+// local planner: drives the robot to a /local_goal around the obstacles with the Dynamic Window Approach
+// the translation_node hands over the end of its translation to this node when an obstacle blocks the way
+
+#include "ros/ros.h"
+#include "ros/time.h"
+#include <geometry_msgs/Twist.h>
+#include "geometry_msgs/Point.h"
+#include "sensor_msgs/LaserScan.h"
+#include "nav_msgs/Odometry.h"
+#include "std_msgs/Bool.h"
+#include <cmath>
+#include <vector>
+#include <tf/transform_datatypes.h>
+#include "follow_me/dwa_planner.h"
+// distances, angles and changes of frame (see geometry.h)
+#include "follow_me/geometry.h"
+
+#define planner_frequency 20
+
+float goal_tolerance = 0.15;// the local goal is reached when the robot is closer than this distance
+float give_up_time = 3.0;// if no admissible arc is found during this time (s), the local goal is abandoned
+float max_duration = 30.0;// max duration (s) to reach a local goal
+
+using namespace std;
+
+class local_planner {
+private:
+
+    ros::NodeHandle n;
+
+    // communication with the laser
+    ros::Subscriber sub_scan;
+    std::vector<float> hit_x, hit_y;
+    distance_field grid;
+    bool init_laser;//to check if the grid has been built from a recent scan
+
+    // communication with odometry
+    ros::Subscriber sub_odometry;
+    float position_x, position_y, orientation;
+    float current_speed, current_rotation_speed;
+    bool init_odom;
+
+    // communication with translation_node
+    ros::Subscriber sub_local_goal;
+    ros::Publisher pub_local_goal_done;
+    bool goal_active;
+    geometry_msgs::Point goal;// in the odom frame
+    ros::Time goal_start, last_admissible;
+
+    // communication with cmd_vel_mux
+    ros::Publisher pub_cmd_vel;
+
+    thread_pool pool;
+    dwa_planner planner;
+
+    // to measure the processing time of the planner
+    int nb_plan;
+    double plan_time_sum, plan_time_max, build_time_sum;
+    ros::Time last_report;
+
+public:
+
+local_planner() : grid(8.0, 0.05), planner(default_dwa_config(), &pool) {
+
+    sub_scan = n.subscribe("scan", 1, &local_planner::scanCallback, this);
+    sub_odometry = n.subscribe("odom", 1, &local_planner::odomCallback, this);
+    sub_local_goal = n.subscribe("local_goal", 1, &local_planner::local_goalCallback, this);
+
+    pub_local_goal_done = n.advertise<std_msgs::Bool>("local_goal_done", 1);
+    pub_cmd_vel = n.advertise<geometry_msgs::Twist>("planner_cmd_vel", 1);
+
+    init_laser = false;
+    init_odom = false;
+    goal_active = false;
+
+    nb_plan = 0;
+    plan_time_sum = plan_time_max = build_time_sum = 0;
+    last_report = ros::Time::now();
+
+    ROS_INFO("(local_planner) %i samples per cycle on %i threads", default_dwa_config().nb_speed_samples * default_dwa_config().nb_rotation_samples, pool.size());
+
+    //INFINTE LOOP TO COLLECT LASER DATA AND PROCESS THEM
+    ros::Rate r(planner_frequency);
+    while (ros::ok()) {
+        ros::spinOnce();
+        update();
+        r.sleep();
+    }
+
+}
+
+//UPDATE: main processing
+/*//////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////*/
+void update() {
+
+    if ( !goal_active || !init_laser || !init_odom )
+        return;
+
+    ros::Time now = ros::Time::now();
+
+    // the goal in the current frame of the robot
+    const geometry_msgs::Point goal_robot = to_child(make_frame_transform(position_x, position_y, orientation), goal);
+    const float goal_x_robot = goal_robot.x, goal_y_robot = goal_robot.y;
+    float goal_distance = point_distance(goal_robot, geometry_msgs::Point());
+
+    if ( goal_distance < goal_tolerance ) {
+        ROS_INFO("(local_planner) local goal reached");
+        end_goal(true);
+        return;
+    }
+    if ( ( now - goal_start ).toSec() > max_duration ) {
+        ROS_WARN("(local_planner) local goal not reached after %f s", max_duration);
+        end_goal(false);
+        return;
+    }
+
+    float speed, rotation_speed, clearance;
+    ros::WallTime start = ros::WallTime::now();
+    bool admissible = planner.plan(grid, current_speed, current_rotation_speed, goal_x_robot, goal_y_robot, speed, rotation_speed, clearance);
+    double plan_time = ( ros::WallTime::now() - start ).toSec();
+
+    nb_plan++;
+    plan_time_sum += plan_time;
+    if ( plan_time > plan_time_max )
+        plan_time_max = plan_time;
+
+    if ( admissible )
+        last_admissible = now;
+    else
+        if ( ( now - last_admissible ).toSec() > give_up_time ) {
+            ROS_WARN("(local_planner) no admissible trajectory: local goal abandoned");
+            end_goal(false);
+            return;
+        }
+
+    // we slow down when approaching the goal
+    float max_speed = sqrt(2 * planner.parameters().max_acceleration * goal_distance);
+    if ( speed > max_speed )
+        speed = max_speed;
+
+    geometry_msgs::Twist twist;
+    twist.linear.x = speed;
+    twist.angular.z = rotation_speed;
+    pub_cmd_vel.publish(twist);
+
+    if ( ( now - last_report ).toSec() > 5 ) {
+        ROS_INFO("(local_planner) planning time: mean %f ms, max %f ms, grid %f ms", plan_time_sum/nb_plan*1000, plan_time_max*1000, build_time_sum/nb_plan*1000);
+        if ( plan_time_max > 1.0 / planner_frequency )
+            ROS_WARN("(local_planner) planning is slower than %i hz", planner_frequency);
+        nb_plan = 0;
+        plan_time_sum = plan_time_max = build_time_sum = 0;
+        last_report = now;
+    }
+
+}// update
+
+void end_goal(bool reached) {
+
+    goal_active = false;
+
+    geometry_msgs::Twist twist;
+    pub_cmd_vel.publish(twist);
+
+    std_msgs::Bool msg_done;
+    msg_done.data = reached;
+    pub_local_goal_done.publish(msg_done);
+
+}
+
+//CALLBACKS
+/*//////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////*/
+void scanCallback(const sensor_msgs::LaserScan::ConstPtr& scan) {
+
+    // the distance field is only needed while a local goal is active
+    if ( !goal_active )
+        return;
+
+    ros::WallTime start = ros::WallTime::now();
+
+    hit_x.clear();
+    hit_y.clear();
+    float beam_angle = scan->angle_min;
+    for (int loop=0; loop < (int)scan->ranges.size(); loop++, beam_angle += scan->angle_increment)
+        if ( ( scan->ranges[loop] < scan->range_max ) && ( scan->ranges[loop] > scan->range_min ) ) {
+            hit_x.push_back(scan->ranges[loop] * cos(beam_angle));
+            hit_y.push_back(scan->ranges[loop] * sin(beam_angle));
+        }
+
+    grid.build(hit_x.empty() ? 0 : &hit_x[0], hit_y.empty() ? 0 : &hit_y[0], hit_x.size());
+
+    build_time_sum += ( ros::WallTime::now() - start ).toSec();
+    init_laser = true;
+
+}//scanCallback
+
+void odomCallback(const nav_msgs::Odometry::ConstPtr& o) {
+
+    init_odom = true;
+    position_x = o->pose.pose.position.x;
+    position_y = o->pose.pose.position.y;
+    orientation = tf::getYaw(o->pose.pose.orientation);
+    current_speed = o->twist.twist.linear.x;
+    current_rotation_speed = o->twist.twist.angular.z;
+
+}
+
+void local_goalCallback(const geometry_msgs::Point::ConstPtr& g) {
+// the local goal is expressed in the frame of the robot when it is received
+
+    if ( !init_odom ) {
+        ROS_WARN("(local_planner) local goal received before odometry: ignored");
+        std_msgs::Bool msg_done;
+        msg_done.data = false;
+        pub_local_goal_done.publish(msg_done);
+        return;
+    }
+
+    goal = to_parent(make_frame_transform(position_x, position_y, orientation), *g);
+    goal_active = true;
+    init_laser = false;// we wait for a distance field built from a scan received after the goal
+    goal_start = ros::Time::now();
+    last_admissible = goal_start;
+    ROS_INFO("(local_planner) local goal: (%f, %f) -> (%f, %f) in odom", g->x, g->y, goal.x, goal.y);
+
+}
+
+};
+
+int main(int argc, char **argv){
+
+    ros::init(argc, argv, "local_planner");
+
+    ros::param::get("/local_planner_node/goal_tolerance", goal_tolerance);
+    ros::param::get("/local_planner_node/give_up_time", give_up_time);
+    ROS_INFO("(local_planner) goal_tolerance: %f, give_up_time: %f", goal_tolerance, give_up_time);
+
+    local_planner bsObject;
+
+    ros::spin();
+
+    return 0;
+}
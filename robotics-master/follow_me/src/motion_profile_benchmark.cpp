@@ -0,0 +1,120 @@
+// simulated benchmark: completion time of a translation/rotation with the former proportional controller
+// and with the tracking of a trapezoidal or S-curve profile, for the same limits
+// the robot is simulated as a velocity-controlled base that cannot exceed the max velocity and acceleration
+
+#include <cstdio>
+#include <cmath>
+#include "follow_me/motion_profile.h"
+
+#define control_period 0.1// the motion nodes run at 10hz
+#define simulation_step 0.001
+#define max_simulated_time 60
+
+#define kp 0.5
+
+struct limits {
+
+    const char* name;
+    float max_velocity, max_acceleration, max_jerk;
+    float tolerance;// translation_error or rotation_error
+
+};
+
+// the simulated base applies the command with a bounded acceleration
+float apply_command(float velocity, float command, const limits& l, float dt) {
+
+    if ( command > l.max_velocity )
+        command = l.max_velocity;
+    if ( command < -l.max_velocity )
+        command = -l.max_velocity;
+
+    float max_delta = l.max_acceleration * dt;
+    if ( command > velocity + max_delta )
+        return velocity + max_delta;
+    if ( command < velocity - max_delta )
+        return velocity - max_delta;
+    return command;
+
+}
+
+// former controller: command = kp * error
+float run_proportional(float distance, const limits& l, float& final_error) {
+
+    float position = 0, velocity = 0, command = 0;
+    float next_control = 0;
+    for (float t = 0; t < max_simulated_time; t += simulation_step) {
+        if ( t >= next_control ) {
+            next_control += control_period;
+            float error = distance - position;
+            if ( fabs(error) <= l.tolerance ) {
+                final_error = error;
+                return t;
+            }
+            command = kp * error;
+        }
+        velocity = apply_command(velocity, command, l, simulation_step);
+        position += velocity * simulation_step;
+    }
+    final_error = distance - position;
+    return max_simulated_time;
+
+}
+
+// tracking of the profile: command = reference velocity + kp * tracking error
+float run_profile(float distance, const limits& l, float max_jerk, float& final_error) {
+
+    motion_profile profile;
+    profile.plan(distance, l.max_velocity, l.max_acceleration, max_jerk);
+
+    float position = 0, velocity = 0, command = 0;
+    float next_control = 0;
+    for (float t = 0; t < max_simulated_time; t += simulation_step) {
+        if ( t >= next_control ) {
+            next_control += control_period;
+            float error = distance - position;
+            if ( ( t >= profile.duration() ) && ( fabs(error) <= l.tolerance ) ) {
+                final_error = error;
+                return t;
+            }
+            // the reference is taken at the middle of the next control period
+            float reference = profile.position(t + control_period / 2);
+            command = profile.velocity(t + control_period / 2) + kp * ( reference - position );
+        }
+        velocity = apply_command(velocity, command, l, simulation_step);
+        position += velocity * simulation_step;
+    }
+    final_error = distance - position;
+    return max_simulated_time;
+
+}
+
+int main() {
+
+    limits translation_limits = { "translation (m)", 0.5, 0.5, 2.0, 0.1 };
+    limits rotation_limits = { "rotation (rad)", 1.0, 1.5, 6.0, 0.2 };
+
+    float translations[] = { 0.5, 1.0, 2.0, 3.0, 5.0 };
+    float rotations[] = { M_PI / 6, M_PI / 2, M_PI };
+
+    const limits* all_limits[] = { &translation_limits, &rotation_limits };
+    const float* all_distances[] = { translations, rotations };
+    int nb_distances[] = { 5, 3 };
+
+    for (int loop=0; loop<2; loop++) {
+        const limits& l = *all_limits[loop];
+        printf("%s: vmax %.2f, amax %.2f, jmax %.2f\n", l.name, l.max_velocity, l.max_acceleration, l.max_jerk);
+        printf("%10s | %18s | %18s | %18s\n", "distance", "proportional (s)", "trapezoidal (s)", "s-curve (s)");
+        for (int loop_distance=0; loop_distance<nb_distances[loop]; loop_distance++) {
+            float d = all_distances[loop][loop_distance];
+            float error_p, error_t, error_s;
+            float time_p = run_proportional(d, l, error_p);
+            float time_t = run_profile(d, l, 0, error_t);
+            float time_s = run_profile(d, l, l.max_jerk, error_s);
+            printf("%10.3f | %7.2f (e=%+.3f) | %7.2f (e=%+.3f) | %7.2f (e=%+.3f)\n", d, time_p, error_p, time_t, error_t, time_s, error_s);
+        }
+        printf("\n");
+    }
+
+    return 0;
+
+}
@@ -8,21 +8,51 @@
 #include "geometry_msgs/Point.h"
 #include "std_msgs/ColorRGBA.h"
 #include <cmath>
-#include "std_msgs/Bool.h"
-
-//used for clustering
-#define cluster_threshold 0.2 //threshold for clustering
-
-//used for detection of motion
-#define detection_threshold 0.2 //threshold for motion detection
-#define dynamic_threshold 75 //to decide if a cluster is static or dynamic
-
-//used for detection of moving legs
-#define leg_size_min 0.05
-#define leg_size_max 0.25
-
-//used for detection of moving persons
-#define legs_distance_max 0.7
+#include <vector>
+#include "nav_msgs/Odometry.h"
+#include <tf/transform_datatypes.h>
+#include "follow_me/MotionState.h"
+
+// the processing (detection of motion, clustering, detection of moving legs and moving persons) is done by
+// a version of detector_core specialized for the laser, or by the generic one (see detector_core.h)
+#include "follow_me/detector_core.h"
+// a frame is the processing of the newest scan, it is skipped or degraded when the node is behind (see frame_scheduler.h)
+#include "follow_me/frame_scheduler.h"
+// each scan is processed with the motion state and the pose of the robot at its stamp (see input_sync.h)
+#include "follow_me/input_sync.h"
+// counters of the frames and of the detections, exposed to prometheus (see metrics.h)
+#include "follow_me/metrics.h"
+// distances, angles and changes of frame (see geometry.h)
+#include "follow_me/geometry.h"
+
+// beams processed by the detector: decimation and deadline (see scan_frontend.h)
+frontend_config frontend = default_frontend_config();
+
+// the clustering only tests the cuts around the beams whose range has moved since the previous scan (see
+// detector_core.h): as many clusters as a full clustering, for less work when the robot is stopped
+bool incremental_clustering = false;
+
+// denoising of the ranges before the detection of motion (see range_filter.h): the preset of the laser, each value
+// not negative replaces the one of the preset
+bool filter_ranges = false;
+int filter_median_window = -1;
+float filter_veiling_angle = -1;// rad
+int filter_isolated_beams = -1;
+float filter_isolated_distance = -1;// m
+
+// this node runs at 10 hz, and a scan may wait up to the max_wait of input_sync for the odometry at its stamp
+scheduler_config scheduling = default_scheduler_config(0.1, input_sync().max_wait);
+// s, while the newest scan waits for the odometry, the loop wakes up at this period instead of 10 hz, so that the scan
+// is processed before the next one replaces it (0: 10 hz only, see frame_scheduling_benchmark.cpp)
+double input_poll = 0.01;
+
+// the background is stored again when the pose of the robot has drifted more than these thresholds, even if
+// robot_moving_node has not seen any motion
+float background_distance = 0.02;// m
+float background_angle = 0.03;// rad
+
+std::string metrics_socket = "/tmp/follow_me_moving_person_detector.metrics";// "" for none
+int metrics_port = 0;// localhost tcp port of the metrics, 0 for none
 
 using namespace std;
 
@@ -32,49 +62,36 @@ private:
     ros::NodeHandle n;
 
     ros::Subscriber sub_scan;
-    ros::Subscriber sub_robot_moving;
+    ros::Subscriber sub_motion_state;
+    ros::Subscriber sub_odometry;
 
     ros::Publisher pub_moving_persons_detector;
     ros::Publisher pub_moving_persons_detector_marker;
 
-    // to store, process and display laserdata
-    int nb_beams;
+    // to store and process laserdata
+    // the newest scan is kept and converted only when a frame processes it
+    sensor_msgs::LaserScan::ConstPtr last_scan;
+    detector_pipeline* detector;
+    frame_scheduler scheduler;
+    bool tracing;// textual and graphical display of the results, turned off when the frame is degraded
     float range_min, range_max;
-    float angle_min, angle_max, angle_inc;
-    float range[1000];
-    geometry_msgs::Point current_scan[1000];
-
-    //to perform detection of motion
-    float background[1000];//to store the background
-    bool dynamic[1000];//to store if the current is dynamic or not
-
-    //to perform clustering
-    int nb_cluster;// number of cluster
-    int cluster[1000]; //to store for each hit, the cluster it belongs to
-    float cluster_size[1000];// to store the size of each cluster
-    geometry_msgs::Point cluster_middle[1000];// to store the middle of each cluster
-    int cluster_dynamic[1000];// to store the percentage of the cluster that is dynamic
-    int cluster_start[1000], cluster_end[1000];
-
-    //to perform detection of moving legs and to store them
-    int nb_moving_legs_detected;
-    geometry_msgs::Point moving_leg_detected[1000];// to store the middle of each moving leg
-
-    //to perform detection of moving person and store them
-    int nb_moving_persons_detected;
-    geometry_msgs::Point moving_persons_detected[1000];// to store the middle of each moving person
+    float angle_min, angle_max;
 
     //to store the goal to reach that we will be published
     geometry_msgs::Point goal_to_reach;
 
     // GRAPHICAL DISPLAY
-    int nb_pts;
-    geometry_msgs::Point display[2000];
-    std_msgs::ColorRGBA colors[2000];
+    // the number of points depends on the scan: the storage grows when needed and is reused from scan to scan
+    std::vector<geometry_msgs::Point> display;
+    std::vector<std_msgs::ColorRGBA> colors;
 
-    //to check if the robot is moving or not
-    bool previous_robot_moving;
+    //to check if the robot is moving or not when the scan is taken
+    bool previous_robot_moving;// for the previous scan processed
     bool current_robot_moving;
+    input_sync inputs;
+    bool waiting_inputs;// the newest scan waits for the odometry at its stamp
+    log_pose scan_pose, background_pose;// pose of the robot when the current scan and the background were taken
+    bool scan_pose_valid, background_pose_valid;
 
     bool init_laser;//to check if new data of laser is available or not
     bool init_robot;//to check if new data of robot_moving is available or not
@@ -82,30 +99,73 @@ private:
     bool display_laser;
     bool display_robot;
 
+    metrics_registry metrics;
+    metrics_server metrics_endpoint;
+    metric_counter* scans_received;
+    metric_counter* scans_dropped;
+    metric_counter* frames[3];// full, degraded, skipped
+    metric_counter* overruns;
+    metric_counter* legs_detected;
+    metric_counter* persons_detected;
+    metric_counter* backgrounds;
+    metric_gauge* scan_age;// s
+    metric_histogram* clusters_per_frame;
+    metric_histogram* processing_time;// s, of the detector
+
 public:
 
-moving_persons_detector() {
+moving_persons_detector() : metrics_endpoint(metrics) {
 
     sub_scan = n.subscribe("scan", 1, &moving_persons_detector::scanCallback, this);
-    sub_robot_moving = n.subscribe("robot_moving", 1, &moving_persons_detector::robot_movingCallback, this);
+    sub_motion_state = n.subscribe("motion_state", 10, &moving_persons_detector::motion_stateCallback, this);
+    sub_odometry = n.subscribe("odom", 50, &moving_persons_detector::odomCallback, this);
 
     pub_moving_persons_detector_marker = n.advertise<visualization_msgs::Marker>("moving_person_detector", 1); // Preparing a topic to publish our results. This will be used by the visualization tool rviz
     pub_moving_persons_detector = n.advertise<geometry_msgs::Point>("goal_to_reach", 1);     // Preparing a topic to publish the goal to reach.
 
-    current_robot_moving = true;
+    detector = 0;
+    scheduler = frame_scheduler(scheduling);
+    tracing = true;
+    current_robot_moving = previous_robot_moving = true;
+    scan_pose_valid = background_pose_valid = false;
+    waiting_inputs = false;
     init_laser = false;
     init_robot = false;
     display_laser = false;
     display_robot = false;
 
+    scans_received = metrics.counter("follow_me_detector_scans_total", "scans received by the detector");
+    scans_dropped = metrics.counter("follow_me_detector_dropped_scans_total", "scans never processed");
+    frames[frame_full] = metrics.counter("follow_me_detector_frames_total", "frames of the detector", "mode=\"full\"");
+    frames[frame_degraded] = metrics.counter("follow_me_detector_frames_total", "frames of the detector", "mode=\"degraded\"");
+    frames[frame_skipped] = metrics.counter("follow_me_detector_frames_total", "frames of the detector", "mode=\"skipped\"");
+    overruns = metrics.counter("follow_me_detector_overruns_total", "frames longer than their deadline");
+    legs_detected = metrics.counter("follow_me_detector_legs_total", "moving legs detected");
+    persons_detected = metrics.counter("follow_me_detector_persons_total", "moving persons detected");
+    backgrounds = metrics.counter("follow_me_detector_backgrounds_total", "backgrounds stored");
+    scan_age = metrics.gauge("follow_me_detector_scan_age_seconds", "age of the scan of the last frame");
+    const double cluster_bounds[] = { 2, 5, 10, 20, 40, 80, 160 };
+    clusters_per_frame = metrics.histogram("follow_me_detector_clusters", "clusters per frame", cluster_bounds, 7);
+    const double time_bounds[] = { 0.0005, 0.001, 0.002, 0.005, 0.01, 0.02, 0.05, 0.1 };
+    processing_time = metrics.histogram("follow_me_detector_processing_seconds", "processing time of the detector per frame", time_bounds, 8);
+    if ( !metrics_endpoint.start(metrics_socket, metrics_port) )
+        ROS_WARN("(moving_person_detector) cannot serve the metrics on %s / port %i", metrics_socket.c_str(), metrics_port);
+
     //INFINTE LOOP TO COLLECT LASER DATA AND PROCESS THEM
     ros::Rate r(10);// this node will run at 10hz
     while (ros::ok()) {
         ros::spinOnce();//each callback is called once to collect new data: laser + robot_moving
         update();//processing of data
-        r.sleep();//we wait if the processing (ie, callback+update) has taken less than 0.1s (ie, 10 hz)
+        if ( waiting_inputs && ( input_poll > 0 ) )
+            ros::Duration(input_poll).sleep();//we check again soon if the odometry of the newest scan has arrived
+        else
+            r.sleep();//we wait if the processing (ie, callback+update) has taken less than 0.1s (ie, 10 hz)
     }
 
+    char text[512];
+    scheduler.summary(text, sizeof(text));
+    ROS_INFO("(moving_person_detector) %s", text);
+
 }
 
 //UPDATE: main processing of laser data and robot_moving
@@ -113,38 +173,86 @@ moving_persons_detector() {
 //////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////*/
 void update() {
 
+    waiting_inputs = false;
+
     // we wait for new data of the laser and of the robot_moving_node to perform laser processing
     if ( init_laser && init_robot ) {
-        nb_pts = 0;
 
-        ROS_INFO("\n");
-        ROS_INFO("New data of laser received");
-        ROS_INFO("New data of robot_moving received");
+        // a frame is processed for each new scan, the newest one
+        if ( !scheduler.has_pending_scan() )
+            return;
+        // and with the state of the robot at its stamp: we wait for the odometry of this time
+        double stamp = last_scan->header.stamp.toSec();
+        if ( !inputs.ready(stamp, ros::Time::now().toSec()) ) {
+            waiting_inputs = true;
+            return;
+        }
+        frame_decision decision = scheduler.begin_frame(ros::Time::now().toSec(), stamp);
+        frames[decision]->add();
+        scan_age->set(scheduler.last_age);
+        if ( decision == frame_skipped ) {
+            ROS_WARN("(moving_person_detector) scan of %f ms ago skipped", scheduler.last_age * 1000);
+            return;
+        }
+        tracing = decision == frame_full;
+        set_scan();
+        current_robot_moving = inputs.moving_at(stamp);
+        scan_pose_valid = inputs.pose_at(stamp, scan_pose);
+
+        if ( tracing ) {
+            ROS_INFO("\n");
+            ROS_INFO("New data of laser received");
+            ROS_INFO("New data of robot_moving received");
+        }
 
-        nb_pts = 0;
+        display.clear();
+        colors.clear();
         //if the robot is not moving then we can perform moving persons detection
         if ( !current_robot_moving ) {
 
-            ROS_INFO("robot is not moving");
-                // if the robot was moving previously and now it is not moving now then we store the background
-            if ( previous_robot_moving && !current_robot_moving )
+            if ( tracing )
+                ROS_INFO("robot is not moving");
+            // if the robot was moving when the previous scan was taken and it is not moving now then we store the background
+            if ( previous_robot_moving || background_drifted() )
                 store_background();
 
-            //we search for moving persons in 4 steps
-            detect_motion();//to classify each hit of the laser as dynamic or not
-            perform_clustering();//to perform clustering
-            detect_moving_legs();//to detect moving legs using cluster
-            detect_moving_persons();//to detect moving_persons using moving legs detected
-
-            //graphical display of the results
-            populateMarkerTopic();
+            //we search for moving persons in 4 steps: detection of motion, clustering, detection of moving legs and of moving persons
+            detector->detect();
+            clusters_per_frame->observe(detector->clusters.size());
+            processing_time->observe(detector->processing_time);
+            legs_detected->add(detector->moving_legs.size());
+            persons_detected->add(detector->moving_persons.size());
+            if ( tracing ) {
+                if ( detector->frontend.active() )
+                    ROS_INFO("%i beams processed in %f ms, region of interest: %f m", detector->frontend.nb_selected, detector->processing_time * 1000, detector->frontend.current_range);
+                display_clusters();
+                display_moving_legs();
+                display_moving_persons();
+
+                //graphical display of the results
+                populateMarkerTopic();
+            }
 
             //to publish the goal_to_reach
-            if ( nb_moving_persons_detected )
+            if ( !detector->moving_persons.empty() ) {
+                goal_to_reach.x = detector->goal_to_reach.x;
+                goal_to_reach.y = detector->goal_to_reach.y;
+                goal_to_reach.z = 0;
                 pub_moving_persons_detector.publish(goal_to_reach);
+            }
         }
-        else
+        else if ( tracing )
             ROS_INFO("robot is moving");
+        previous_robot_moving = current_robot_moving;
+
+        long overruns_before = scheduler.nb_overruns;
+        scheduler.end_frame();
+        overruns->add(scheduler.nb_overruns - overruns_before);
+        if ( scheduler.nb_frames % 100 == 0 ) {
+            char text[512];
+            scheduler.summary(text, sizeof(text));
+            ROS_INFO("(moving_person_detector) %s", text);
+        }
     }
     else {
         if ( !display_laser && !init_laser ) {
@@ -174,345 +282,185 @@ void store_background() {
 // store all the hits of the laser in the background table
 
     ROS_INFO("storing background");
-
-    for (int loop=0; loop<nb_beams; loop++)
-        background[loop] = range[loop];
-
+    detector->store_background();
+    backgrounds->add();
+    background_pose = scan_pose;
+    background_pose_valid = scan_pose_valid;
     ROS_INFO("background stored");
 
-}//init_background
+}//store_background
 
-void detect_motion() {
+// the robot has moved since the background was taken, without a transition of its motion state
+bool background_drifted() {
 
-    ROS_INFO("detecting motion");
+    if ( !background_pose_valid || !scan_pose_valid )
+        return false;
 
-    for (int loop=0; loop<nb_beams; loop++ ){//loop over all the hits
-        //if the difference between ( the background and the current value ) is higher than "detection_threshold"
-        float diff  = background[loop] - range[loop];
-        if (diff < 0)
-            diff = -diff;
-        if (diff > detection_threshold)
-            dynamic[loop] = 1;//the current hit is dynamic
-        else
-            dynamic[loop] = 0;//else its static
-    }
-    
-    ROS_INFO("motion detected");
+    float dyaw = angle_difference(scan_pose.yaw, background_pose.yaw);
+    bool drifted = ( point_distance(scan_pose, background_pose) > background_distance ) || ( fabs(dyaw) > background_angle );
+    if ( drifted )
+        ROS_INFO("robot has drifted since the background was stored: (%f, %f, %f)", scan_pose.x - background_pose.x, scan_pose.y - background_pose.y, dyaw*180/M_PI);
+    return drifted;
 
-}//detect_motion
+}//background_drifted
 
-// CLUSTERING
+// DISPLAY OF THE RESULTS
 /*//////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 //////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////*/
-void perform_clustering() {
-//store in the table cluster, the cluster of each hit of the laser
-//if the distance between the previous hit and the current one is lower than "cluster_threshold"
-//then the current hit belongs to the current cluster
-//else we start a new cluster with the current hit and end the current cluster
-
-    ROS_INFO("performing clustering");
-
-    nb_cluster = 0;//to count the number of cluster
-
-    //initialization of the first cluster
-    cluster_start[0] = 0;// the first hit is the start of the first cluster
-    cluster[0] = 0;// the first hit belongs to the first cluster
-    int nb_dynamic = 0;// to count the number of hits of the current cluster that are dynamic
-
-    //graphical display of the start of the current cluster in green
-    display[nb_pts].x = current_scan[cluster_start[nb_cluster]].x;
-    display[nb_pts].y = current_scan[cluster_start[nb_cluster]].y;
-    display[nb_pts].z = current_scan[cluster_start[nb_cluster]].z;
-
-    colors[nb_pts].r = 0;
-    colors[nb_pts].g = 1;
-    colors[nb_pts].b = 0;
-    colors[nb_pts].a = 1.0;
-    nb_pts++;
-
-    if(dynamic[0] == 1)
-        nb_dynamic++;
-
-    for( int loop=1; loop<nb_beams; loop++ ){//loop over all the hits
-
-        float diff = range[loop-1] - range[loop];
-        if (diff < 0)
-            diff = -diff;
-        //if distance between (the previous hit and the current one) is lower than "cluster_threshold"
-        if(diff < cluster_threshold){
-            //the current hit belongs to the current cluster
-            cluster[loop] = nb_cluster;
-            if(dynamic[loop] == 1)
-                nb_dynamic++;
-        }
+void display_clusters() {
+// the start of each cluster is displayed in green, its end in red
 
-        else {//the current hit doesnt belong to the same hit
-            //1/ we end the current cluster, so we update:
-            //- cluster-end to store the last hit of the current cluster
-            //- cluster_dynamic to store the percentage of hits of the current cluster that are dynamic
-            //- cluster_size to store the size of the cluster ie, the distance between the first hit of the cluster and the last one
-            //- cluster_middle to store the middle of the cluster
-
-            cluster_end[nb_cluster] = loop - 1;
-
-            float dist = 0;
-            for(int i = cluster_start[nb_cluster]; i < cluster_end[nb_cluster]; i++)
-                dist += distancePoints(current_scan[i], current_scan[i+1]);
-            cluster_size[nb_cluster] = dist;
-
-            float mid_x, diff_x;
-            float mid_y, diff_y;
-
-            diff_x = current_scan[cluster_end[nb_cluster]].x - current_scan[cluster_start[nb_cluster]].x;
-            diff_y = current_scan[cluster_end[nb_cluster]].y - current_scan[cluster_start[nb_cluster]].y;
-
-            mid_x = diff_x/2 + current_scan[cluster_start[nb_cluster]].x;
-            mid_y = diff_y/2 + current_scan[cluster_start[nb_cluster]].y;
-            
-            cluster_middle[nb_cluster].x = mid_x;
-            cluster_middle[nb_cluster].y = mid_y;
-            cluster_middle[nb_cluster].z = 0.0;
-
-            cluster_dynamic[nb_cluster] = (float)nb_dynamic/(float)(cluster_end[nb_cluster] - cluster_start[nb_cluster] + 1)*100;
-
-            //graphical display of the end of the current cluster in red
-            display[nb_pts].x = current_scan[cluster_end[nb_cluster]].x;
-            display[nb_pts].y = current_scan[cluster_end[nb_cluster]].y;
-            display[nb_pts].z = current_scan[cluster_end[nb_cluster]].z;
-
-            colors[nb_pts].r = 1;
-            colors[nb_pts].g = 0;
-            colors[nb_pts].b = 0;
-            colors[nb_pts].a = 1.0;
-            nb_pts++;
-
-            //textual display
-            ROS_INFO("cluster[%i]: [%i](%f, %f) -> [%i](%f, %f), size: %f, dynamic: %i", nb_cluster, cluster_start[nb_cluster], current_scan[cluster_start[nb_cluster]].x, current_scan[cluster_start[nb_cluster]].y, cluster_end[nb_cluster], current_scan[cluster_end[nb_cluster]].x, current_scan[cluster_end[nb_cluster]].y, cluster_size[nb_cluster], cluster_dynamic[nb_cluster]);
-
-            //2/ we starta new cluster with the current hit
-            nb_dynamic = 0;// to count the number of hits of the current cluster that are dynamic
-            nb_cluster++;
-            cluster_start[nb_cluster] = loop;
-            cluster[loop] = nb_cluster;
-            if ( dynamic[loop] )
-                nb_dynamic++;
-
-            //graphical display of the start of the current cluster in green
-            display[nb_pts].x = current_scan[cluster_start[nb_cluster]].x;
-            display[nb_pts].y = current_scan[cluster_start[nb_cluster]].y;
-            display[nb_pts].z = current_scan[cluster_start[nb_cluster]].z;
-
-            colors[nb_pts].r = 0;
-            colors[nb_pts].g = 1;
-            colors[nb_pts].b = 0;
-            colors[nb_pts].a = 1.0;
-            nb_pts++;
+    for (size_t loop=0; loop<detector->clusters.size(); loop++) {
+        const detector_cluster& c = detector->clusters[loop];
+        add_display(c.start, 0, 1, 0);
+        add_display(c.end, 1, 0, 0);
 
-        }
+        //textual display
+        ROS_INFO("cluster[%i] (id %i): [%i](%f, %f) -> [%i](%f, %f), size: %f, dynamic: %i", (int)loop, c.id, c.start, detector->hit_x[c.start], detector->hit_y[c.start], c.end, detector->hit_x[c.end], detector->hit_y[c.end], c.size, c.dynamic);
     }
 
-    //Dont forget to update the different information for the last cluster
-    cluster_end[nb_cluster] = nb_beams - 1;
-
-    float dist = 0;
-    for(int i = cluster_start[nb_cluster]; i < cluster_end[nb_cluster]; i++)
-        dist += distancePoints(current_scan[i], current_scan[i+1]);
-    cluster_size[nb_cluster] = dist;
-
-    float mid_x, diff_x;
-    float mid_y, diff_y;
-
-    diff_x = current_scan[cluster_end[nb_cluster]].x - current_scan[cluster_start[nb_cluster]].x;
-    diff_y = current_scan[cluster_end[nb_cluster]].y - current_scan[cluster_start[nb_cluster]].y;
-
-    mid_x = diff_x/2 + current_scan[cluster_start[nb_cluster]].x;
-    mid_y = diff_y/2 + current_scan[cluster_start[nb_cluster]].y;
-    
-    cluster_middle[nb_cluster].x = mid_x;
-    cluster_middle[nb_cluster].y = mid_y;
-    cluster_middle[nb_cluster].z = 0.0;
-
-    cluster_dynamic[nb_cluster] = (float)nb_dynamic/(float)(cluster_end[nb_cluster] - cluster_start[nb_cluster] + 1)*100;
-
-    //graphical display of the end of the current cluster in red
-    display[nb_pts].x = current_scan[cluster_end[nb_cluster]].x;
-    display[nb_pts].y = current_scan[cluster_end[nb_cluster]].y;
-    display[nb_pts].z = current_scan[cluster_end[nb_cluster]].z;
-
-    colors[nb_pts].r = 1;
-    colors[nb_pts].g = 0;
-    colors[nb_pts].b = 0;
-    colors[nb_pts].a = 1.0;
-    nb_pts++;
-
-    //textual display
-    ROS_INFO("cluster[%i]: [%i](%f, %f) -> [%i](%f, %f), size: %f, dynamic: %i", nb_cluster, cluster_start[nb_cluster], current_scan[cluster_start[nb_cluster]].x, current_scan[cluster_start[nb_cluster]].y, cluster_end[nb_cluster], current_scan[cluster_end[nb_cluster]].x, current_scan[cluster_end[nb_cluster]].y, cluster_size[nb_cluster], cluster_dynamic[nb_cluster]);
-
-
-    nb_cluster++;
-
     ROS_INFO("clustering performed");
 
-}//perfor_clustering
-
-// DETECTION OF MOVING PERSON
-/*//////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
-//////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////*/
-void detect_moving_legs() {
-// a moving leg is a cluster:
-// - with a size higher than "leg_size_min";
-// - with a size lower than "leg_size_max;
-// - more than "dynamic_threshold"% of its hits are dynamic (see, cluster_dynamic table)
-
-    ROS_INFO("detecting moving legs");
-    nb_moving_legs_detected = 0;
-
-    for (int loop=0; loop<nb_cluster; loop++){//loop over all the clusters
-        //if the size of the current cluster is higher than "leg_size_min" and lower than "leg_size_max" and it has "dynamic_threshold"% of its hits that are dynamic
-        //then the current cluster is a moving leg
-        if(cluster_size[loop] > leg_size_min && cluster_size[loop] < leg_size_max && cluster_dynamic[loop] >= dynamic_threshold){
-
-            // we update the moving_leg_detected table to store the middle of the moving leg
-            moving_leg_detected[nb_moving_legs_detected].x = cluster_middle[loop].x;
-            moving_leg_detected[nb_moving_legs_detected].y = cluster_middle[loop].y;
-            moving_leg_detected[nb_moving_legs_detected].z = cluster_middle[loop].z;
+}//display_clusters
 
-            //textual display
-            ROS_INFO("moving leg detected[%i]: cluster[%i]", nb_moving_legs_detected, loop);
+void display_moving_legs() {
+// the hits of the moving legs are white
 
-
-            nb_moving_legs_detected++;
-
-            //graphical display
-            for(int loop2=cluster_start[loop]; loop2<=cluster_end[loop]; loop2++) {
-                // moving legs are white
-                display[nb_pts].x = current_scan[loop2].x;
-                display[nb_pts].y = current_scan[loop2].y;
-                display[nb_pts].z = current_scan[loop2].z;
-
-                colors[nb_pts].r = 1;
-                colors[nb_pts].g = 1;
-                colors[nb_pts].b = 1;
-                colors[nb_pts].a = 1.0;
-
-                nb_pts++;
-            }
-        }
+    for (size_t loop=0; loop<detector->moving_legs.size(); loop++) {
+        const detector_cluster& c = detector->clusters[detector->moving_legs[loop]];
+        ROS_INFO("moving leg detected[%i]: cluster[%i]", (int)loop, detector->moving_legs[loop]);
+        for (int loop2=c.start; loop2<=c.end; loop2++)
+            add_display(loop2, 1, 1, 1);
     }
 
-    if ( nb_moving_legs_detected )
-        ROS_INFO("%d moving legs have been detected.\n", nb_moving_legs_detected);
-
-    ROS_INFO("moving legs detected");
-
-}//detect_moving_legs
-
-void detect_moving_persons() {
-// a moving person has two moving legs located at less than "legs_distance_max" one from the other
-
-    ROS_INFO("detecting moving persons");
-    nb_moving_persons_detected = 0;
-
-    for (int loop_leg1=0; loop_leg1<nb_moving_legs_detected; loop_leg1++){//loop over all the legs
-        for (int loop_leg2=loop_leg1+1; loop_leg2<nb_moving_legs_detected; loop_leg2++){//loop over all the legs
-            //if the distance between two moving legs is lower than "legs_distance_max"
-            //then we find a moving person
-            if(distancePoints(moving_leg_detected[loop_leg1], moving_leg_detected[loop_leg2]) < legs_distance_max){
-                // we update the moving_persons_detected table to store the middle of the moving person
+    if ( !detector->moving_legs.empty() )
+        ROS_INFO("%d moving legs have been detected.\n", (int)detector->moving_legs.size());
 
-                float mid_x, diff_x;
-                float mid_y, diff_y;
+}//display_moving_legs
 
-                diff_x = moving_leg_detected[loop_leg2].x - moving_leg_detected[loop_leg1].x;
-                diff_y = moving_leg_detected[loop_leg2].y - moving_leg_detected[loop_leg1].y;
+void display_moving_persons() {
+// the moving persons are yellow
 
-                mid_x = diff_x/2 + moving_leg_detected[loop_leg1].x;
-                mid_y = diff_y/2 + moving_leg_detected[loop_leg1].y;
-                
-                moving_persons_detected[nb_moving_persons_detected].x = mid_x;
-                moving_persons_detected[nb_moving_persons_detected].y = mid_y;
-                moving_persons_detected[nb_moving_persons_detected].z = 0.0;
-
-                // textual display
-                ROS_INFO("moving person detected[%i]: leg[%i]+leg[%i] -> (%f, %f)", nb_moving_persons_detected, loop_leg1, loop_leg2, moving_persons_detected[nb_moving_persons_detected].x, moving_persons_detected[nb_moving_persons_detected].y);
-
-
-                // the moving persons are yellow
-                display[nb_pts].x = moving_persons_detected[nb_moving_persons_detected].x;
-                display[nb_pts].y = moving_persons_detected[nb_moving_persons_detected].y;
-                display[nb_pts].z = moving_persons_detected[nb_moving_persons_detected].z;
+    for (size_t loop=0; loop<detector->moving_persons.size(); loop++) {
+        const detector_point& p = detector->moving_persons[loop];
+        ROS_INFO("moving person detected[%i]: (%f, %f)", (int)loop, p.x, p.y);
+        add_display(p.x, p.y, 1, 1, 0);
+    }
 
-                colors[nb_pts].r = 1;
-                colors[nb_pts].g = 1;
-                colors[nb_pts].b = 0;
-                colors[nb_pts].a = 1.0;
+    if ( !detector->moving_persons.empty() )
+        ROS_INFO("%d moving persons have been detected.\n", (int)detector->moving_persons.size());
 
-                nb_pts++;
+}//display_moving_persons
 
-                //update of the goal and publish of the goal
-                goal_to_reach.x = mid_x;
-                goal_to_reach.y = mid_y;
-                goal_to_reach.z = 0;
+void add_display(int hit, float r, float g, float b) {
 
-                nb_moving_persons_detected++;
+    add_display(detector->hit_x[hit], detector->hit_y[hit], r, g, b);
 
-                //exit(1);
-            }
-        }
-    }
+}
 
-    if ( nb_moving_persons_detected )
-        ROS_INFO("%d moving persons have been detected.\n", nb_moving_persons_detected);
+void add_display(float x, float y, float r, float g, float b) {
 
-    ROS_INFO("moving persons detected");
+    geometry_msgs::Point p;
+    p.x = x;
+    p.y = y;
+    p.z = 0;
+    display.push_back(p);
 
+    std_msgs::ColorRGBA c;
+    c.r = r;
+    c.g = g;
+    c.b = b;
+    c.a = 1.0;
+    colors.push_back(c);
 
-}//detect_moving_persons
+}
 
 //CALLBACKS
 /*//////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 //////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////*/
 void scanCallback(const sensor_msgs::LaserScan::ConstPtr& scan) {
 
+    // a scan without beam is not processed
+    if ( scan->ranges.empty() )
+        return;
     init_laser = true;
-    // store the important data related to laserscanner
+    last_scan = scan;
+    long dropped_before = scheduler.nb_dropped;
+    scheduler.scan_received(scan->header.stamp.toSec(), scan->scan_time);
+    scans_received->add();
+    scans_dropped->add(scheduler.nb_dropped - dropped_before);
+
+}//scanCallback
+
+// the newest scan is given to the detector
+void set_scan() {
+
+    const sensor_msgs::LaserScan::ConstPtr& scan = last_scan;
     range_min = scan->range_min;
     range_max = scan->range_max;
     angle_min = scan->angle_min;
     angle_max = scan->angle_max;
-    angle_inc = scan->angle_increment;
-    nb_beams = ((-1 * angle_min) + angle_max)/angle_inc;
 
-    // store the range and the coordinates in cartesian framework of each hit
-    float beam_angle = angle_min;
-    for ( int loop=0 ; loop < nb_beams; loop++, beam_angle += angle_inc ) {
-        if ( ( scan->ranges[loop] < range_max ) && ( scan->ranges[loop] > range_min ) )
-            range[loop] = scan->ranges[loop];
-        else
-            range[loop] = range_max;
+    // the version of the core is chosen with the first scan, and changed only if the laser changes
+    int nb_beams = scan->ranges.size();
+    if ( !nb_beams )
+        return;
+    if ( !detector || !detector->accepts(nb_beams, scan->angle_min, scan->angle_increment) ) {
+        delete detector;
+        detector = make_detector_pipeline(nb_beams, scan->angle_min, scan->angle_increment);
+        detector->frontend.config = frontend;
+        detector->incremental = incremental_clustering;
+        if ( filter_ranges )
+            detector->filter.config = filter_config(detector->name());
+        ROS_INFO("(moving_person_detector) %i beams: %s version of the detector", nb_beams, detector->name());
+    }
 
-        //transform the scan in cartesian framework
-        current_scan[loop].x = range[loop] * cos(beam_angle);
-        current_scan[loop].y = range[loop] * sin(beam_angle);
-        current_scan[loop].z = 0.0;
+    // store the range and the coordinates in cartesian framework of each hit
+    detector->set_scan(&scan->ranges[0], nb_beams, scan->angle_min, scan->angle_increment, scan->range_min, scan->range_max);
+
+}//set_scan
+
+range_filter_config filter_config(const char* laser) {
+
+    range_filter_config c = range_filter_preset(laser);
+    if ( filter_median_window >= 0 )
+        c.median_window = filter_median_window;
+    if ( filter_veiling_angle >= 0 )
+        c.veiling_angle = filter_veiling_angle;
+    if ( filter_isolated_beams >= 0 )
+        c.isolated_beams = filter_isolated_beams;
+    if ( filter_isolated_distance >= 0 )
+        c.isolated_distance = filter_isolated_distance;
+    if ( !range_filter_config_valid(c) ) {
+        ROS_WARN("(moving_person_detector) range filter: median of %i beams (odd, at most %i) or isolated runs of %i beams (below %i) not supported, preset of %s used",
+                 c.median_window, range_filter_median_max, c.isolated_beams, range_filter_padding, laser);
+        c = range_filter_preset(laser);
     }
+    ROS_INFO("(moving_person_detector) range filter of %s: median of %i beams, veiling_angle: %f, isolated runs of up to %i beams (%f m)", laser, c.median_window,
+             c.veiling_angle, c.isolated_beams, c.isolated_distance);
+    return c;
 
-}//scanCallback
+}
 
-void robot_movingCallback(const std_msgs::Bool::ConstPtr& state) {
+void motion_stateCallback(const follow_me::MotionState::ConstPtr& state) {
 
     init_robot = true;
-    previous_robot_moving = current_robot_moving;
-    current_robot_moving = state->data;
+    inputs.add_motion(state->since.toSec(), state->moving);
 
-}//robot_movingCallback
+}//motion_stateCallback
 
-// Distance between two points
-float distancePoints(geometry_msgs::Point pa, geometry_msgs::Point pb) {
+void odomCallback(const nav_msgs::Odometry::ConstPtr& o) {
 
-    return sqrt(pow((pa.x-pb.x),2.0) + pow((pa.y-pb.y),2.0));
+    log_pose pose;
+    pose.stamp = o->header.stamp.isZero() ? ros::Time::now().toSec() : o->header.stamp.toSec();
+    pose.x = o->pose.pose.position.x;
+    pose.y = o->pose.pose.position.y;
+    pose.yaw = tf::getYaw(o->pose.pose.orientation);
+    pose.linear_speed = o->twist.twist.linear.x;
+    pose.angular_speed = o->twist.twist.angular.z;
+    inputs.add_odom(pose);
 
-}
+}//odomCallback
 
 // Draw the field of view and other references
 void populateMarkerReference() {
@@ -534,34 +482,22 @@ void populateMarkerReference() {
     references.color.b = 1.0f;
     references.color.a = 1.0;
     geometry_msgs::Point v;
-
-    v.x =  0.02 * cos(-2.356194);
-    v.y =  0.02 * sin(-2.356194);
-    v.z = 0.0;
-    references.points.push_back(v);
-
-    v.x =  5.6 * cos(-2.356194);
-    v.y =  5.6 * sin(-2.356194);
+    // the field of view of the laser, with one point per degree whatever the resolution of the laser
+    v.x = range_min * cos(angle_min);
+    v.y = range_min * sin(angle_min);
     v.z = 0.0;
     references.points.push_back(v);
 
-    float beam_angle = -2.356194 + 0.006136;
-    // first and last beam are already included
-    for (int i=0 ; i< 723; i++, beam_angle += 0.006136){
-        v.x =  5.6 * cos(beam_angle);
-        v.y =  5.6 * sin(beam_angle);
-        v.z = 0.0;
+    int nb_points = ( angle_max - angle_min ) * 180 / M_PI + 1;
+    for (int i=0; i<=nb_points; i++) {
+        float beam_angle = angle_min + i * ( angle_max - angle_min ) / nb_points;
+        v.x = range_max * cos(beam_angle);
+        v.y = range_max * sin(beam_angle);
         references.points.push_back(v);
     }
 
-    v.x =  5.6 * cos(2.092350);
-    v.y =  5.6 * sin(2.092350);
-    v.z = 0.0;
-    references.points.push_back(v);
-
-    v.x =  0.02 * cos(2.092350);
-    v.y =  0.02 * sin(2.092350);
-    v.z = 0.0;
+    v.x = range_min * cos(angle_max);
+    v.y = range_min * sin(angle_max);
     references.points.push_back(v);
 
     pub_moving_persons_detector_marker.publish(references);
@@ -586,8 +522,8 @@ void populateMarkerTopic(){
 
     marker.color.a = 1.0;
 
-    //ROS_INFO("%i points to display", nb_pts);
-    for (int loop = 0; loop < nb_pts; loop++) {
+    //ROS_INFO("%i points to display", (int)display.size());
+    for (size_t loop = 0; loop < display.size(); loop++) {
             geometry_msgs::Point p;
             std_msgs::ColorRGBA c;
 
@@ -616,6 +552,37 @@ int main(int argc, char **argv){
 
     ros::init(argc, argv, "moving_persons_detector");
 
+    ROS_INFO("(moving_person_detector) PARAMETERS");
+    ros::param::get("/moving_person_detector_node/decimation_spacing", frontend.decimation_spacing);
+    ros::param::get("/moving_person_detector_node/deadline", frontend.deadline);
+    ros::param::get("/moving_person_detector_node/roi_range", frontend.roi_range);
+    ros::param::get("/moving_person_detector_node/roi_angle_min", frontend.roi_angle_min);
+    ros::param::get("/moving_person_detector_node/roi_angle_max", frontend.roi_angle_max);
+    ros::param::get("/moving_person_detector_node/roi_range_min", frontend.roi_range_min);
+    ROS_INFO("(moving_person_detector) decimation_spacing: %f, deadline: %f, roi_range: %f, roi_angle_min: %f, roi_angle_max: %f, roi_range_min: %f",
+             frontend.decimation_spacing, frontend.deadline, frontend.roi_range, frontend.roi_angle_min, frontend.roi_angle_max, frontend.roi_range_min);
+    ros::param::get("/moving_person_detector_node/incremental_clustering", incremental_clustering);
+    ROS_INFO("(moving_person_detector) incremental_clustering: %i", incremental_clustering);
+    ros::param::get("/moving_person_detector_node/filter_ranges", filter_ranges);
+    ros::param::get("/moving_person_detector_node/filter_median_window", filter_median_window);
+    ros::param::get("/moving_person_detector_node/filter_veiling_angle", filter_veiling_angle);
+    ros::param::get("/moving_person_detector_node/filter_isolated_beams", filter_isolated_beams);
+    ros::param::get("/moving_person_detector_node/filter_isolated_distance", filter_isolated_distance);
+    ROS_INFO("(moving_person_detector) filter_ranges: %i, filter_median_window: %i, filter_veiling_angle: %f, filter_isolated_beams: %i, filter_isolated_distance: %f",
+             filter_ranges, filter_median_window, filter_veiling_angle, filter_isolated_beams, filter_isolated_distance);
+    ros::param::get("/moving_person_detector_node/frame_deadline", scheduling.deadline);
+    ros::param::get("/moving_person_detector_node/degrade_age", scheduling.degrade_age);
+    ros::param::get("/moving_person_detector_node/stale_age", scheduling.stale_age);
+    ros::param::get("/moving_person_detector_node/input_poll", input_poll);
+    ROS_INFO("(moving_person_detector) frame_deadline: %f, degrade_age: %f, stale_age: %f, input_poll: %f", scheduling.deadline, scheduling.degrade_age,
+             scheduling.stale_age, input_poll);
+    ros::param::get("/moving_person_detector_node/background_distance", background_distance);
+    ros::param::get("/moving_person_detector_node/background_angle", background_angle);
+    ROS_INFO("(moving_person_detector) background_distance: %f, background_angle: %f", background_distance, background_angle);
+    ros::param::get("/moving_person_detector_node/metrics_socket", metrics_socket);
+    ros::param::get("/moving_person_detector_node/metrics_port", metrics_port);
+    ROS_INFO("(moving_person_detector) metrics_socket: %s, metrics_port: %i", metrics_socket.c_str(), metrics_port);
+
     moving_persons_detector bsObject;
 
     ros::spin();
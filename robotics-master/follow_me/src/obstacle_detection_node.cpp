@@ -9,6 +9,7 @@
 #include "std_msgs/Float32.h"
 #include "std_msgs/Int32.h"
 #include <cmath>
+#include <vector>
 #include "nav_msgs/Odometry.h"
 #include <tf/transform_datatypes.h>
 #include <tf/transform_listener.h>
@@ -18,8 +19,14 @@
 #include "tf/transform_broadcaster.h"
 #include "message_filters/subscriber.h"
 #include "tf/message_filter.h"
+// scans processed and closest obstacle, exposed to prometheus (see metrics.h)
+#include "follow_me/metrics.h"
+// distances, angles and changes of frame (see geometry.h)
+#include "follow_me/geometry.h"
 
 float robair_size = 0.25;//0.2 for small robair
+std::string metrics_socket = "/tmp/follow_me_obstacle_detection.metrics";// "" for none
+int metrics_port = 0;// localhost tcp port of the metrics, 0 for none
 
 using namespace std;
 
@@ -36,11 +43,14 @@ private:
     ros::Publisher pub_closest_obstacle_marker;
 
     // to store, process and display both laserdata
+    // the storage has the size of the scan received and is reused from scan to scan
     int nb_beams;
     float range_min, range_max;
     float angle_min, angle_max, angle_inc;
-    float range[1000];
-    geometry_msgs::Point current_scan[1000];
+    std::vector<float> range;
+    std::vector<geometry_msgs::Point> current_scan;
+    std::vector<float> beam_cos, beam_sin;// computed once for a laser
+    float scan_angle_min, scan_angle_inc;// laser of beam_cos and beam_sin
     bool init_laser;
     geometry_msgs::Point transform_laser;
 
@@ -48,13 +58,17 @@ private:
     geometry_msgs::Point closest_obstacle;
 
     // GRAPHICAL DISPLAY
-    int nb_pts;
-    geometry_msgs::Point display[2000];
-    std_msgs::ColorRGBA colors[2000];
+    std::vector<geometry_msgs::Point> display;
+    std::vector<std_msgs::ColorRGBA> colors;
+
+    metrics_registry metrics;
+    metrics_server metrics_endpoint;
+    metric_counter* scans;
+    metric_gauge* closest_distance;// m, in front of the robot
 
 public:
 
-obstacle_detection() {
+obstacle_detection() : metrics_endpoint(metrics) {
 
     // Communication with laser scanner
     sub_scan = n.subscribe("scan", 1, &obstacle_detection::scanCallback, this);
@@ -63,6 +77,12 @@ obstacle_detection() {
     pub_closest_obstacle = n.advertise<geometry_msgs::Point>("closest_obstacle", 1);
     pub_closest_obstacle_marker = n.advertise<visualization_msgs::Marker>("closest_obstacle_marker", 1); // Preparing a topic to publish our results. This will be used by the visualization tool rviz
     init_laser = false;
+    scan_angle_min = scan_angle_inc = 0;
+
+    scans = metrics.counter("follow_me_obstacle_scans_total", "scans received by obstacle_detection_node");
+    closest_distance = metrics.gauge("follow_me_closest_obstacle_meters", "distance along x of the closest obstacle in front of the robot");
+    if ( !metrics_endpoint.start(metrics_socket, metrics_port) )
+        ROS_WARN("(obstacle_detection) cannot serve the metrics on %s / port %i", metrics_socket.c_str(), metrics_port);
 
     //INFINTE LOOP TO COLLECT LASER DATA AND PROCESS THEM
     ros::Rate r(10);// this node will run at 10hz
@@ -83,27 +103,28 @@ void update() {
         closest_obstacle.x = range_max;
         closest_obstacle.y = range_max;
 
-        float beam_angle = angle_min;
-        for ( int loop=0; loop < nb_beams; loop++, beam_angle += angle_inc ) {
-            //ROS_INFO("hit[%i]: (%f, %f) -> (%f, %f)", loop, range[loop], beam_angle*180/M_PI, current_scan[loop].x, current_scan[loop].y);
+        for ( int loop=0; loop < nb_beams; loop++ ) {
+            //ROS_INFO("hit[%i]: (%f, %f) -> (%f, %f)", loop, range[loop], (angle_min+loop*angle_inc)*180/M_PI, current_scan[loop].x, current_scan[loop].y);
             if ( ( fabs(current_scan[loop].y) < robair_size ) && ( fabs(closest_obstacle.x) > fabs(current_scan[loop].x) ) && ( current_scan[loop].x > 0 ) )
                 closest_obstacle = current_scan[loop];
         }
 
         pub_closest_obstacle.publish(closest_obstacle);
+        closest_distance->set(closest_obstacle.x);
 
-        nb_pts=0;
+        display.clear();
+        colors.clear();
         // closest obstacle is red
-        display[nb_pts] = closest_obstacle;
-
-        colors[nb_pts].r = 1;
-        colors[nb_pts].g = 0;
-        colors[nb_pts].b = 0;
-        colors[nb_pts].a = 1.0;
-        nb_pts++;
+        std_msgs::ColorRGBA c;
+        c.r = 1;
+        c.g = 0;
+        c.b = 0;
+        c.a = 1.0;
+        display.push_back(closest_obstacle);
+        colors.push_back(c);
         populateMarkerTopic();
 
-        if ( distancePoints(closest_obstacle, previous_closest_obstacle) > 0.05 ) {
+        if ( point_distance(closest_obstacle, previous_closest_obstacle) > 0.05 ) {
             ROS_INFO("closest obstacle: (%f; %f)", closest_obstacle.x, closest_obstacle.y);
 
             previous_closest_obstacle.x = closest_obstacle.x;
@@ -113,19 +134,13 @@ void update() {
 
 }
 
-// Distance between two points
-float distancePoints(geometry_msgs::Point pa, geometry_msgs::Point pb) {
-
-    return sqrt(pow((pa.x-pb.x),2.0) + pow((pa.y-pb.y),2.0));
-
-}
-
 //CALLBACK
 /*//////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 //////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////*/
 void scanCallback(const sensor_msgs::LaserScan::ConstPtr& scan) {
 
     init_laser = true;
+    scans->add();
 
     // store the important data related to laserscanner
     range_min = scan->range_min;
@@ -133,21 +148,35 @@ void scanCallback(const sensor_msgs::LaserScan::ConstPtr& scan) {
     angle_min = scan->angle_min;
     angle_max = scan->angle_max;
     angle_inc = scan->angle_increment;
-    nb_beams = ((-1 * angle_min) + angle_max)/angle_inc;
+    nb_beams = scan->ranges.size();
+
+    // the angles of the beams are computed only when the laser changes
+    if ( ( (int)beam_cos.size() != nb_beams ) || ( scan_angle_min != angle_min ) || ( scan_angle_inc != angle_inc ) ) {
+        scan_angle_min = angle_min;
+        scan_angle_inc = angle_inc;
+        beam_cos.resize(nb_beams);
+        beam_sin.resize(nb_beams);
+        for ( int loop=0; loop < nb_beams; loop++ ) {
+            beam_cos[loop] = cos(angle_min + loop * angle_inc);
+            beam_sin[loop] = sin(angle_min + loop * angle_inc);
+        }
+        ROS_INFO("(obstacle_detection) laser of %i beams", nb_beams);
+    }
+    range.resize(nb_beams);
+    current_scan.resize(nb_beams);
 
     // store the range and the coordinates in cartesian framework of each hit
-    float beam_angle = angle_min;
-    for ( int loop=0 ; loop < nb_beams; loop++, beam_angle += angle_inc ) {
+    for ( int loop=0 ; loop < nb_beams; loop++ ) {
         if ( ( scan->ranges[loop] < range_max ) && ( scan->ranges[loop] > range_min ) )
             range[loop] = scan->ranges[loop];
         else
             range[loop] = range_max;
 
         //transform the scan in cartesian framewrok
-        current_scan[loop].x = range[loop] * cos(beam_angle);
-        current_scan[loop].y = range[loop] * sin(beam_angle);
+        current_scan[loop].x = range[loop] * beam_cos[loop];
+        current_scan[loop].y = range[loop] * beam_sin[loop];
         current_scan[loop].z = 0.0;
-        //ROS_INFO("laser[%i]: (%f, %f) -> (%f, %f)", loop, range[loop], beam_angle*180/M_PI, current_scan[loop].x, current_scan[loop].y);
+        //ROS_INFO("laser[%i]: (%f, %f) -> (%f, %f)", loop, range[loop], (angle_min+loop*angle_inc)*180/M_PI, current_scan[loop].x, current_scan[loop].y);
 
     }
 
@@ -173,34 +202,22 @@ void populateMarkerReference() {
     references.color.b = 1.0f;
     references.color.a = 1.0;
     geometry_msgs::Point v;
-
-    v.x =  0.02 * cos(-2.356194);
-    v.y =  0.02 * sin(-2.356194);
-    v.z = 0.0;
-    references.points.push_back(v);
-
-    v.x =  5.6 * cos(-2.356194);
-    v.y =  5.6 * sin(-2.356194);
+    // the field of view of the laser, with one point per degree whatever the resolution of the laser
+    v.x = range_min * cos(angle_min);
+    v.y = range_min * sin(angle_min);
     v.z = 0.0;
     references.points.push_back(v);
 
-    float beam_angle = -2.356194 + 0.006136;
-    // first and last beam are already included
-    for (int i=0 ; i< 723; i++, beam_angle += 0.006136){
-        v.x =  5.6 * cos(beam_angle);
-        v.y =  5.6 * sin(beam_angle);
-        v.z = 0.0;
+    int nb_points = ( angle_max - angle_min ) * 180 / M_PI + 1;
+    for (int i=0; i<=nb_points; i++) {
+        float beam_angle = angle_min + i * ( angle_max - angle_min ) / nb_points;
+        v.x = range_max * cos(beam_angle);
+        v.y = range_max * sin(beam_angle);
         references.points.push_back(v);
     }
 
-    v.x =  5.6 * cos(2.092350);
-    v.y =  5.6 * sin(2.092350);
-    v.z = 0.0;
-    references.points.push_back(v);
-
-    v.x =  0.02 * cos(2.092350);
-    v.y =  0.02 * sin(2.092350);
-    v.z = 0.0;
+    v.x = range_min * cos(angle_max);
+    v.y = range_min * sin(angle_max);
     references.points.push_back(v);
 
     pub_closest_obstacle_marker.publish(references);
@@ -225,8 +242,8 @@ void populateMarkerTopic(){
 
     marker.color.a = 1.0;
 
-    //ROS_INFO("%i points to display", nb_pts);
-    for (int loop = 0; loop < nb_pts; loop++) {
+    //ROS_INFO("%i points to display", (int)display.size());
+    for (size_t loop = 0; loop < display.size(); loop++) {
             geometry_msgs::Point p;
             std_msgs::ColorRGBA c;
 
@@ -262,6 +279,9 @@ int main(int argc, char **argv){
 
     ros::param::get("/obstacle_detection_node/robot_size", robair_size);
     ROS_INFO("(obstacle_detection) robot_size: %f", robair_size);
+    ros::param::get("/obstacle_detection_node/metrics_socket", metrics_socket);
+    ros::param::get("/obstacle_detection_node/metrics_port", metrics_port);
+    ROS_INFO("(obstacle_detection) metrics_socket: %s, metrics_port: %i", metrics_socket.c_str(), metrics_port);
 
     obstacle_detection bsObject;
 
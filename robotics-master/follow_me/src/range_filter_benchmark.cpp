@@ -0,0 +1,251 @@
+// effect and cost of the denoising of the ranges before the detector (see range_filter.h)
+// - the median of 3 to 9 beams (selection networks, 4 beams at a time) is compared with a median computed beam by beam
+// - cost: ns per beam of each step and of the preset, on recorded scans of the simulator with the known lasers of the
+//   detector (726 to 2048 beams)
+// - effect: a run of the simulator (robot stopped, one person walking, 1 cm of noise) is recorded, then artefacts are
+//   added to each scan: dropouts (range 0, i.e. range_max for the detector), veiling points at the edges of the
+//   objects, isolated spurious returns. The detector processes the clean scans, the scans with artefacts, and the scans
+//   with artefacts through the preset of the filter: clusters, dynamic hits and moving persons per scan are reported,
+//   and the persons detected are matched with the positions given by the simulator
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <vector>
+#include "follow_me/detection_evaluation.h"
+#include "follow_me/detector_core.h"
+#include "follow_me/geometry.h"
+#include "follow_me/range_filter.h"
+#include "follow_me/simulator.h"
+
+#define nb_scans 300
+#define nb_runs 20
+#define dropout_rate 0.01// per beam
+#define veiling_rate 0.5// per edge of more than edge_jump
+#define edge_jump 0.3// m
+#define spurious_rate 0.005// per beam
+
+typedef std::chrono::steady_clock benchmark_clock;
+
+double seconds_since(benchmark_clock::time_point start) {
+
+    return std::chrono::duration<double>(benchmark_clock::now() - start).count();
+
+}
+
+struct recorded_run {
+
+    sim_config config;
+    float angle_increment;
+    std::vector<std::vector<float> > scans;
+    std::vector<std::vector<log_person> > persons;// moving persons in the frame of the laser
+
+};
+
+// a laser of the traits of the detector core, so that its specialized version and its preset are used
+template <class Traits>
+void record(recorded_run& run) {
+
+    run.config = default_sim_config();
+    run.config.nb_beams = Traits::nb_beams;
+    run.config.angle_min = Traits::angle_min;
+    run.config.angle_max = Traits::angle_min + ( Traits::nb_beams - 1 ) * Traits::angle_increment;
+    run.config.range_min = Traits::range_min;
+    run.config.range_max = Traits::range_max;
+    simulator sim(run.config);
+    sim.default_world();
+    run.angle_increment = sim.angle_increment();
+    run.scans.assign(nb_scans, std::vector<float>(Traits::nb_beams));
+    run.persons.assign(nb_scans, std::vector<log_person>());
+    for (int loop=0; loop<nb_scans; loop++) {
+        sim.scan(&run.scans[loop][0]);
+        const frame_transform laser = make_frame_transform(sim.x, sim.y, sim.theta);
+        for (size_t p=0; p<sim.people.size(); p++)
+            if ( sim.people[p].walking ) {
+                log_person l;
+                l.stamp = sim.time;
+                l.x = sim.people[p].x;
+                l.y = sim.people[p].y;
+                l = to_child(laser, l);
+                float a = atan2(l.y, l.x);
+                if ( ( a >= run.config.angle_min ) && ( a <= run.config.angle_max ) && ( hypot(l.x, l.y) < run.config.range_max ) )
+                    run.persons[loop].push_back(l);
+            }
+        sim.step(0.1);
+    }
+
+}
+
+// random numbers of the benchmark, the same from run to run
+uint32_t random_state = 12345;
+
+float uniform() {
+
+    random_state = random_state * 1664525u + 1013904223u;
+    return ( random_state >> 8 ) * ( 1.0f / 16777216.0f );
+
+}
+
+void add_artefacts(std::vector<float>& r, float range_max) {
+
+    const int nb = r.size();
+    const std::vector<float> clean = r;
+    for (int loop=0; loop+1<nb; loop++)
+        if ( ( fabs(clean[loop] - clean[loop+1]) > edge_jump ) && ( clean[loop] < range_max ) && ( clean[loop+1] < range_max ) &&
+             ( uniform() < veiling_rate ) ) {
+            // the beam behind the edge returns a range between the object and the background
+            int behind = clean[loop] > clean[loop+1] ? loop : loop + 1;
+            float t = 0.2f + 0.6f * uniform();
+            r[behind] = clean[loop] + t * ( clean[loop+1] - clean[loop] );
+        }
+    for (int loop=0; loop<nb; loop++) {
+        float u = uniform();
+        if ( u < dropout_rate )
+            r[loop] = 0;
+        else
+            if ( u < dropout_rate + spurious_rate )
+                r[loop] = 0.3f + ( r[loop] - 0.3f ) * uniform();
+    }
+
+}
+
+struct detection_result {
+
+    double clusters, dynamic, persons;// per scan
+    detection_score score;
+
+};
+
+detection_result detect(const recorded_run& run, const std::vector<std::vector<float> >& scans, const range_filter_config& filter) {
+
+    detection_result result;
+    result.clusters = result.dynamic = result.persons = 0;
+    result.score = empty_detection_score();
+    detector_pipeline* detector = make_detector_pipeline(run.config.nb_beams, run.config.angle_min, run.angle_increment);
+    detector->filter.config = filter;
+    for (size_t loop=0; loop<scans.size(); loop++) {
+        detector->set_scan(&scans[loop][0], scans[loop].size(), run.config.angle_min, run.angle_increment, run.config.range_min, run.config.range_max);
+        if ( !loop )
+            detector->store_background();
+        detector->detect();
+        result.clusters += detector->clusters.size();
+        for (int beam=0; beam<detector->nb_beams; beam++)
+            result.dynamic += detector->dynamic[beam];
+        result.persons += detector->moving_persons.size();
+        score_frame(detector->moving_persons, run.persons[loop], result.score);
+    }
+    delete detector;
+    result.clusters /= scans.size();
+    result.dynamic /= scans.size();
+    result.persons /= scans.size();
+    return result;
+
+}
+
+void print(const char* name, const detection_result& r) {
+
+    printf("%-30s %9.1f %9.1f %9.2f %8.3f %8.3f\n", name, r.clusters, r.dynamic, r.persons, r.score.precision(), r.score.recall());
+
+}
+
+// median of each beam computed beam by beam, with the same padding as range_filter
+bool check_median(int window) {
+
+    const int nb = 1001;
+    std::vector<float> r(nb);
+    for (int loop=0; loop<nb; loop++)
+        r[loop] = 0.5f + 5 * uniform();
+    range_filter_config config = default_range_filter_config();
+    config.enabled = true;
+    config.median_window = window;
+    config.veiling_angle = 0;
+    config.isolated_beams = 0;
+    range_filter filter(config);
+    const float* m = filter.apply(&r[0], nb, 0.006, 0.02, 5.6);
+
+    const int half = window / 2;
+    for (int loop=0; loop<nb; loop++) {
+        std::vector<float> w;
+        for (int i=loop-half; i<=loop+half; i++)
+            w.push_back(r[std::max(0, std::min(nb - 1, i))]);
+        std::nth_element(w.begin(), w.begin() + half, w.end());
+        if ( w[half] != m[loop] )
+            return false;
+    }
+    return true;
+
+}
+
+// the result of the filter is read so that the compiler keeps it
+volatile float sink;
+
+template <class Traits>
+void cost() {
+
+    const int nb_beams = Traits::nb_beams;
+    recorded_run run;
+    record<Traits>(run);
+
+    struct step {
+
+        const char* name;
+        int median_window;
+        float veiling_angle;
+        int isolated_beams;
+
+    };
+    const step steps[] = { { "sanitize only", 1, 0, 0 }, { "median 3", 3, 0, 0 }, { "median 5", 5, 0, 0 }, { "median 7", 7, 0, 0 },
+                           { "median 9", 9, 0, 0 }, { "veiling points", 1, 10 * M_PI / 180, 0 }, { "isolated runs of 1-2", 1, 0, 2 } };
+    for (size_t s=0; s<sizeof(steps)/sizeof(steps[0]); s++) {
+        range_filter_config config = default_range_filter_config();
+        config.enabled = true;
+        config.median_window = steps[s].median_window;
+        config.veiling_angle = steps[s].veiling_angle;
+        config.isolated_beams = steps[s].isolated_beams;
+        range_filter filter(config);
+        benchmark_clock::time_point start = benchmark_clock::now();
+        for (int r=0; r<nb_runs; r++)
+            for (size_t loop=0; loop<run.scans.size(); loop++)
+                sink = filter.apply(&run.scans[loop][0], nb_beams, run.angle_increment, run.config.range_min, run.config.range_max)[nb_beams/2];
+        double time = seconds_since(start) / ( (double)nb_runs * run.scans.size() * nb_beams );
+        printf("%-16s %-22s %6.2f ns per beam\n", Traits::name, steps[s].name, time * 1e9);
+    }
+
+    range_filter filter(range_filter_preset(Traits::name));
+    benchmark_clock::time_point start = benchmark_clock::now();
+    for (int r=0; r<nb_runs; r++)
+        for (size_t loop=0; loop<run.scans.size(); loop++)
+            sink = filter.apply(&run.scans[loop][0], nb_beams, run.angle_increment, run.config.range_min, run.config.range_max)[nb_beams/2];
+    double time = seconds_since(start) / ( (double)nb_runs * run.scans.size() * nb_beams );
+    printf("%-16s %-22s %6.2f ns per beam (median %i, veiling points, isolated runs of 1-%i)\n", Traits::name, "preset", time * 1e9,
+           filter.config.median_window, filter.config.isolated_beams);
+
+}
+
+int main() {
+
+    for (int window=3; window<=range_filter_median_max; window+=2)
+        printf("median of %i with simd: %s\n", window, check_median(window) ? "identical" : "DIFFERENT");
+
+    printf("\n");
+    cost<hokuyo_urg_traits>();
+    cost<lidar_1440_traits>();
+    cost<lidar_2048_traits>();
+
+    recorded_run run;
+    record<hokuyo_urg_traits>(run);
+    std::vector<std::vector<float> > noisy = run.scans;
+    for (size_t loop=0; loop<noisy.size(); loop++)
+        add_artefacts(noisy[loop], run.config.range_max);
+
+    const range_filter_config off = default_range_filter_config(), preset = range_filter_preset(hokuyo_urg_traits::name);
+    printf("\n%-30s %9s %9s %9s %8s %8s\n", "hokuyo_urg_726, per scan", "clusters", "dynamic", "persons", "precis", "recall");
+    print("clean, no filter", detect(run, run.scans, off));
+    print("clean, filter", detect(run, run.scans, preset));
+    print("artefacts, no filter", detect(run, noisy, off));
+    print("artefacts, filter", detect(run, noisy, preset));
+
+    return 0;
+
+}
@@ -0,0 +1,281 @@
+// delay of the detection of the stops of the robot by robot_moving_node (see motion_estimator.h) on recorded odometry
+// usage: robot_moving_benchmark [log]
+// - with a log (see scan_log.h), its odom records are replayed, with its scans for the estimator that uses them
+// - without a log, runs of the simulator are recorded: the robot drives forward, turns, drives backward and stops
+//   between the moves, odometry at 20 hz and scans at 10 hz; the odometry is recorded without noise, then with noise
+//   on the poses and on the speeds
+// the stop of the odometry is the first record of a run of speeds below stopped_speed lasting stopped_hold, in the truth
+// records (the speeds of the odometry without noise) or in the odom records for a log without truth records. The delay
+// of a stop is the stamp of the odom record after which the stop is published minus the stop of the odometry; a stop
+// is missed when the robot moves again before it is published
+// the estimator, with and without the scans, is compared with the exact-equality counter that it replaced (5 odom
+// records with the same pose); the transitions published and the records published are reported (the counter
+// published the state at each record)
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <vector>
+#include "follow_me/motion_estimator.h"
+#include "follow_me/scan_log.h"
+#include "follow_me/simulator.h"
+
+#define odom_period 0.05// s, of the simulated odometry
+#define scan_period 0.1// s, of the simulated laser
+#define time_step 0.01// s, of the simulator
+#define nb_moves 40
+#define stopped_hold 0.5// s
+#define stopped_speed 0.002// m/s and rad/s
+#define counter_nb_static 5// records with the same pose for the counter
+#define target_delay 0.06// s
+#define match_window 0.5// s, a stop published this long before the stop of the odometry is matched with it
+
+struct stop_interval {
+
+    double start, end;// s, the robot moves again at "end"
+
+};
+
+struct transition {
+
+    double stamp;// s, of the record that made the transition
+    bool moving;
+
+};
+
+struct replay_result {
+
+    std::vector<transition> transitions;
+    int nb_published;// messages published
+
+};
+
+// random numbers of the benchmark, the same from run to run
+uint32_t random_state = 12345;
+
+float uniform() {
+
+    random_state = random_state * 1664525u + 1013904223u;
+    return ( random_state >> 8 ) * ( 1.0f / 16777216.0f );
+
+}
+
+float gaussian() {
+
+    float u = std::max(uniform(), 1e-7f);
+    return sqrt(-2 * log(u)) * cos(2 * M_PI * uniform());
+
+}
+
+// the robot drives forward, turns and drives backward, with a stop of a random duration after each move
+scan_log simulate(float position_noise, float yaw_noise, float speed_noise) {
+
+    scan_log log;
+    sim_config config = default_sim_config();
+    simulator sim(config);
+    sim.default_world();
+
+    const float moves[4][2] = { { 0.3, 0 }, { 0, 0.8 }, { -0.3, 0 }, { 0, -0.8 } };
+    double next_odom = 0, next_scan = 0;
+    for (int m=0; m<nb_moves; m++) {
+        const double move_end = sim.time + 1.5, stop_end = move_end + 1 + 2 * uniform();
+        while ( sim.time < stop_end ) {
+            if ( sim.time < move_end )
+                sim.set_command(moves[m % 4][0], moves[m % 4][1]);
+            else
+                sim.set_command(0, 0);
+            sim.step(time_step);
+
+            if ( sim.time >= next_odom - 1e-9 ) {
+                next_odom += odom_period;
+                log_pose o;
+                o.stamp = sim.time;
+                o.x = sim.odom_x + position_noise * gaussian();
+                o.y = sim.odom_y + position_noise * gaussian();
+                o.yaw = sim.odom_theta + yaw_noise * gaussian();
+                o.linear_speed = sim.linear_speed + speed_noise * gaussian();
+                o.angular_speed = sim.angular_speed + speed_noise * gaussian();
+                log.odom.push_back(o);
+                log_pose t = o;
+                t.x = sim.x;
+                t.y = sim.y;
+                t.yaw = sim.theta;
+                t.linear_speed = sim.linear_speed;
+                t.angular_speed = sim.angular_speed;
+                log.truth.push_back(t);
+            }
+            if ( sim.time >= next_scan - 1e-9 ) {
+                next_scan += scan_period;
+                log_scan s;
+                s.stamp = sim.time;
+                s.angle_min = config.angle_min;
+                s.angle_increment = sim.angle_increment();
+                s.range_min = config.range_min;
+                s.range_max = config.range_max;
+                s.ranges.resize(config.nb_beams);
+                sim.scan(&s.ranges[0]);
+                log.scans.push_back(s);
+            }
+        }
+    }
+    return log;
+
+}
+
+// stops of the odometry: from the speeds of the truth records if any, of the odom records otherwise
+std::vector<stop_interval> find_stops(const scan_log& log) {
+
+    std::vector<stop_interval> stops;
+    const std::vector<log_pose>& records = log.truth.empty() ? log.odom : log.truth;
+    size_t loop = 0;
+    while ( loop < records.size() ) {
+        // the run of records where the robot does not move, starting at "loop"
+        size_t end = loop;
+        while ( ( end < records.size() ) && ( fabs(records[end].linear_speed) < stopped_speed ) && ( fabs(records[end].angular_speed) < stopped_speed ) )
+            end++;
+        if ( end == loop ) {
+            loop++;
+            continue;
+        }
+
+        if ( records[end - 1].stamp - records[loop].stamp >= stopped_hold ) {
+            stop_interval s;
+            s.start = records[loop].stamp;
+            s.end = end < records.size() ? records[end].stamp : INFINITY;// the robot is still stopped at the end of the log
+            stops.push_back(s);
+        }
+        loop = end;
+    }
+    return stops;
+
+}
+
+// the odom records and the scans in the order of their stamps, as the node receives them
+replay_result replay_estimator(const scan_log& log, const motion_estimator_config& config) {
+
+    replay_result r;
+    r.nb_published = 0;
+    motion_estimator estimator(config);
+    size_t scan = 0;
+    for (size_t loop=0; loop<log.odom.size(); loop++) {
+        const log_pose& o = log.odom[loop];
+        for (; ( scan < log.scans.size() ) && ( log.scans[scan].stamp <= o.stamp ); scan++)
+            if ( config.use_scan && !log.scans[scan].ranges.empty() ) {
+                const log_scan& s = log.scans[scan];
+                estimator.update_scan(&s.ranges[0], s.ranges.size(), s.range_min, s.range_max);
+            }
+        if ( estimator.update_odom(o.stamp, o.x, o.y, o.yaw, o.linear_speed, o.angular_speed) ) {
+            transition t;
+            t.stamp = o.stamp;
+            t.moving = estimator.moving;
+            r.transitions.push_back(t);
+            r.nb_published++;
+        }
+    }
+    return r;
+
+}
+
+// the counter replaced by the estimator: stopped after counter_nb_static records with exactly the same pose
+replay_result replay_counter(const scan_log& log) {
+
+    replay_result r;
+    r.nb_published = log.odom.size();
+    bool moving = true;
+    int count = 0;
+    for (size_t loop=1; loop<log.odom.size(); loop++) {
+        const log_pose& o = log.odom[loop];
+        const log_pose& previous = log.odom[loop-1];
+        if ( ( o.x == previous.x ) && ( o.y == previous.y ) && ( o.yaw == previous.yaw ) ) {
+            count++;
+            if ( ( count == counter_nb_static ) && moving ) {
+                moving = false;
+                transition t = { o.stamp, false };
+                r.transitions.push_back(t);
+            }
+        }
+        else {
+            count = 0;
+            if ( !moving ) {
+                moving = true;
+                transition t = { o.stamp, true };
+                r.transitions.push_back(t);
+            }
+        }
+    }
+    return r;
+
+}
+
+void report(const char* name, const std::vector<stop_interval>& stops, const replay_result& r) {
+
+    int nb_detected = 0, missed = 0, false_stops = 0;
+    double total_delay = 0, max_delay = -1e9;
+    std::vector<bool> matched(r.transitions.size(), false);
+    for (size_t s=0; s<stops.size(); s++) {
+        size_t loop = 0;
+        while ( ( loop < r.transitions.size() ) && ( r.transitions[loop].moving || ( r.transitions[loop].stamp < stops[s].start - match_window ) ||
+                                                    matched[loop] ) && ( r.transitions[loop].stamp < stops[s].end ) )
+            loop++;
+        if ( ( loop < r.transitions.size() ) && !r.transitions[loop].moving && ( r.transitions[loop].stamp < stops[s].end ) ) {
+            matched[loop] = true;
+            double delay = r.transitions[loop].stamp - stops[s].start;
+            total_delay += delay;
+            max_delay = std::max(max_delay, delay);
+            nb_detected++;
+        }
+        else
+            missed++;
+    }
+    for (size_t loop=0; loop<r.transitions.size(); loop++)
+        if ( !r.transitions[loop].moving && !matched[loop] )
+            false_stops++;
+
+    if ( nb_detected )
+        printf("%-30s %9.1f %9.1f %7i %7i %11i %11i%s\n", name, total_delay / nb_detected * 1000, max_delay * 1000, missed, false_stops,
+               (int)r.transitions.size(), r.nb_published, max_delay < target_delay ? "" : " over the target");
+    else
+        printf("%-30s %9s %9s %7i %7i %11i %11i\n", name, "-", "-", missed, false_stops, (int)r.transitions.size(), r.nb_published);
+
+}
+
+void compare(const char* title, const scan_log& log) {
+
+    std::vector<stop_interval> stops = find_stops(log);
+    printf("%s: %i odom records, %i scans, %i stops of the odometry\n", title, (int)log.odom.size(), (int)log.scans.size(), (int)stops.size());
+    printf("%-30s %9s %9s %7s %7s %11s %11s\n", "estimator", "mean ms", "max ms", "missed", "false", "transitions", "published");
+
+    motion_estimator_config config = default_motion_estimator_config();
+    report("odometry", stops, replay_estimator(log, config));
+    if ( !log.scans.empty() ) {
+        config.use_scan = true;
+        report("odometry and scans", stops, replay_estimator(log, config));
+    }
+    report("exact-equality counter", stops, replay_counter(log));
+    printf("\n");
+
+}
+
+int main(int argc, char** argv) {
+
+    printf("target: stops detected in less than %.0f ms\n\n", target_delay * 1000);
+    if ( argc > 1 ) {
+        scan_log log;
+        if ( !log.load(argv[1]) ) {
+            printf("cannot read %s\n", argv[1]);
+            return 1;
+        }
+        if ( log.odom.empty() ) {
+            printf("%s has no odom record\n", argv[1]);
+            return 1;
+        }
+        compare(argv[1], log);
+        return 0;
+    }
+
+    compare("simulated odometry without noise", simulate(0, 0, 0));
+    // noise of 0.5 mm and 0.5 mrad on the poses, 2 mm/s and 2 mrad/s on the speeds
+    compare("simulated odometry with noise", simulate(0.0005, 0.0005, 0.002));
+    return 0;
+
+}
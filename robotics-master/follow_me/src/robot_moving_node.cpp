@@ -9,6 +9,7 @@
 #include "std_msgs/Float32.h"
 #include "std_msgs/Bool.h"
 #include <cmath>
+#include <vector>
 #include "nav_msgs/Odometry.h"
 #include <tf/transform_datatypes.h>
 #include <tf/transform_listener.h>
@@ -17,9 +18,12 @@
 #include "tf/transform_broadcaster.h"
 #include "message_filters/subscriber.h"
 #include "tf/message_filter.h"
+#include "follow_me/MotionState.h"
+// motion state estimated from the odometry and optionally the scans (see motion_estimator.h)
+#include "follow_me/motion_estimator.h"
 
-
-int nb_static = 5;
+// thresholds of the estimator, the stop delay and the use of the scans (see motion_estimator.h)
+motion_estimator_config estimator_config = default_motion_estimator_config();
 
 using namespace std;
 
@@ -30,81 +34,78 @@ private:
 
      // communication with person_detector
     ros::Publisher pub_robot_moving;
+    ros::Publisher pub_motion_state;
 
     // communication with odometry
     ros::Subscriber sub_odometry;
 
-    geometry_msgs::Point position, not_moving_position;
-    float orientation, not_moving_orientation;
-    int count;
-    bool moving;
-    bool new_odom;//to check if new data of odometry is available or not
+    // communication with the laser
+    ros::Subscriber sub_scan;
+
+    motion_estimator estimator;
+
+    int nb_transitions;
 
 public:
 
-robot_moving_node() {
+robot_moving_node() : estimator(estimator_config) {
 
     // communication with person_detector
-    pub_robot_moving = n.advertise<std_msgs::Bool>("robot_moving", 1);   
+    // the state is only published when it changes: the topics are latched so that a node started later receives the current state
+    pub_robot_moving = n.advertise<std_msgs::Bool>("robot_moving", 1, true);
+    pub_motion_state = n.advertise<follow_me::MotionState>("motion_state", 1, true);
 
     // communication with odometry
     sub_odometry = n.subscribe("odom", 1, &robot_moving_node::odomCallback, this);
 
-    moving = 1;
-    count = 0;
-    not_moving_position.x = 0;
-    not_moving_position.y = 0;
-    not_moving_orientation = 0;
-    new_odom = false;
+    if ( estimator_config.use_scan )
+        sub_scan = n.subscribe("scan", 1, &robot_moving_node::scanCallback, this);
 
-    ros::Rate r(20);//this node is updated at 20hz
+    nb_transitions = 0;
 
-    while (ros::ok()) {
-        ros::spinOnce();
-        update();
-        r.sleep();
-    }
+    // each odometry sample is processed as soon as it is received
+    ros::spin();
 
 }//robot_moving_node
 
 void odomCallback(const nav_msgs::Odometry::ConstPtr& o) {
 
-    new_odom = true;
-    position.x = o->pose.pose.position.x;
-    position.y = o->pose.pose.position.y;
-    orientation = tf::getYaw(o->pose.pose.orientation);
+    ros::Time stamp = o->header.stamp.isZero() ? ros::Time::now() : o->header.stamp;
+
+    if ( estimator.update_odom(stamp.toSec(), o->pose.pose.position.x, o->pose.pose.position.y, tf::getYaw(o->pose.pose.orientation),
+                               o->twist.twist.linear.x, o->twist.twist.angular.z) )
+        publish_state(stamp, ros::Time(estimator.since));
 
 }//odomCallback
 
-void update() {
-
-    if ( new_odom ) {//we wait for new data of odometry
-        new_odom = false;
-        if ( ( not_moving_position.x == position.x ) && ( not_moving_position.y == position.y ) && ( not_moving_orientation == orientation ) ) {
-            count++;
-            if ( ( count == nb_static ) && ( moving ) ) {
-                ROS_INFO("robot is not moving");
-                moving = false;
-            }
-        }
-        else {
-            not_moving_position.x = position.x;
-            not_moving_position.y = position.y;
-            not_moving_orientation = orientation;
-            count = 0;
-            if ( !moving ) {
-                ROS_INFO("robot is moving");
-                moving = true;
-            }
-        }
-
-        std_msgs::Bool robot_moving_msg;
-        robot_moving_msg.data = moving;
-
-        pub_robot_moving.publish(robot_moving_msg);
-    }
-
-}//update
+void scanCallback(const sensor_msgs::LaserScan::ConstPtr& scan) {
+// scan-to-scan stationarity: most of the beams must be unchanged
+
+    if ( !scan->ranges.empty() )
+        estimator.update_scan(&scan->ranges[0], scan->ranges.size(), scan->range_min, scan->range_max);
+
+}//scanCallback
+
+// publish the new state: "stamp" is the stamp of the odometry sample that triggered the transition,
+// "since" the stamp of the first sample of the new state
+void publish_state(const ros::Time& stamp, const ros::Time& since) {
+
+    std_msgs::Bool robot_moving_msg;
+    robot_moving_msg.data = estimator.moving;
+    pub_robot_moving.publish(robot_moving_msg);
+
+    follow_me::MotionState motion_state_msg;
+    motion_state_msg.header.stamp = stamp;
+    motion_state_msg.header.frame_id = "odom";
+    motion_state_msg.moving = estimator.moving;
+    motion_state_msg.since = since;
+    pub_motion_state.publish(motion_state_msg);
+
+    nb_transitions++;
+    // latency of the detection: from the first sample of the new state to the publication
+    ROS_INFO("robot is %s (transition %i, detected in %f ms)", estimator.moving ? "moving" : "not moving", nb_transitions, ( ros::Time::now() - since ).toSec()*1000);
+
+}
 
 };
 
@@ -115,11 +116,17 @@ int main(int argc, char **argv) {
 
     ROS_INFO("(robot_moving_node) check if the robot is moving or not");
 
+    ros::param::get("/robot_moving_node/stop_delay", estimator_config.stop_delay);
+    ros::param::get("/robot_moving_node/linear_speed_threshold", estimator_config.linear_speed_threshold);
+    ros::param::get("/robot_moving_node/angular_speed_threshold", estimator_config.angular_speed_threshold);
+    ros::param::get("/robot_moving_node/position_noise", estimator_config.position_noise);
+    ros::param::get("/robot_moving_node/orientation_noise", estimator_config.orientation_noise);
+    ros::param::get("/robot_moving_node/use_scan", estimator_config.use_scan);
+    ROS_INFO("(robot_moving_node) stop_delay: %f, use_scan: %i", estimator_config.stop_delay, estimator_config.use_scan);
+
     robot_moving_node bsObject;
     ros::spin();
 
     return 0;
 
 }
-
-
@@ -3,11 +3,23 @@
 #include "geometry_msgs/Point.h"
 #include "geometry_msgs/Quaternion.h"
 #include "nav_msgs/Odometry.h"
+#include "sensor_msgs/LaserScan.h"
 #include "std_msgs/String.h"
 #include "std_msgs/Float32.h"
+#include <cerrno>
 #include <cmath>
+#include <cstring>
 #include <tf/transform_datatypes.h>
 #include "geometry_msgs/Point.h"
+#include "follow_me/motion_profile.h"
+// commands and saturations of the PID, exposed to prometheus (see metrics.h)
+#include "follow_me/metrics.h"
+// collision of the footprint swept by the rotation with the scan
+#include "follow_me/footprint.h"
+// optional real-time mode of the loop: SCHED_FIFO, memory locked, logs through a lock-free queue
+#include "follow_me/realtime.h"
+// distances, angles and changes of frame (see geometry.h)
+#include "follow_me/geometry.h"
 
 #define rotation_error 0.2//radians
 
@@ -15,6 +27,22 @@
 #define ki 0
 #define kd 0
 
+//limits used to plan the profile of each rotation (max_rotation_jerk = 0 for a trapezoidal profile)
+#define max_rotation_speed 1.0
+#define max_rotation_acceleration 1.5
+#define max_rotation_jerk 6.0
+
+#define rotation_clearance 0.1// rad kept free in front of the swept footprint
+
+#define jitter_report_period 100// cycles between two reports of the latency of the loop
+
+footprint_config footprint = default_footprint_config();
+
+std::string metrics_socket = "/tmp/follow_me_rotation.metrics";// "" for none
+int metrics_port = 0;// localhost tcp port of the metrics, 0 for none
+
+realtime_config realtime = default_realtime_config();
+
 class rotation {
 private:
 
@@ -39,18 +67,55 @@ private:
     float init_orientation;
     float current_orientation;
 
+    // communication with the laser: the free rotation in each direction is computed at each scan, from the
+    // orientation of the robot at this scan, and checked at each odometry
+    ros::Subscriber sub_scan;
+    footprint_clearance clearance;
+    bool init_scan;
+    float free_counterclockwise, free_clockwise;
+    float scan_orientation;
+    float rotation_speed_sent;
+
+    // the PID tracks a time-optimal profile instead of the final orientation
+    motion_profile profile;
+    ros::Time profile_start;
+
     float error_integral;
     float error_previous;
 
     bool init_odom;
     bool display_odom;
 
+    metrics_registry metrics;
+    metrics_server metrics_endpoint;
+    metric_counter* commands;
+    metric_counter* saturations;// the PID asks for more than max_rotation_speed
+    metric_counter* obstacle_stops;
+    metric_gauge* tracking_error;// rad
+
+    // communication with flight_recorder: the saturations of the PID are recorded
+    ros::Publisher pub_flight_recorder_trigger;
+    bool saturated;
+
+    // the messages are allocated once: the loop only fills them
+    geometry_msgs::Twist twist;
+    std_msgs::Float32 msg_rotation_done;
+    std_msgs::String msg_trigger;
+
+    // real-time mode (see realtime.h): the loop sleeps on absolute deadlines under SCHED_FIFO, its logs are written
+    // by another thread; the latency of its wakeups is measured in both modes
+    bool realtime_active;
+    realtime_log log;
+    periodic_timer timer;
+    jitter_histogram jitter;
+    metric_histogram* loop_latency;// s
+
 public:
 
-rotation() {
+rotation() : clearance(footprint), metrics_endpoint(metrics), log(write_log), timer(0.1) {
 
-    // communication with cmd_vel to command the mobile robot
-    pub_cmd_vel = n.advertise<geometry_msgs::Twist>("cmd_vel", 1);
+    // communication with cmd_vel_mux to command the mobile robot
+    pub_cmd_vel = n.advertise<geometry_msgs::Twist>("rotation_cmd_vel", 1);
 
     // communication with odometry
     sub_odometry = n.subscribe("odom", 1, &rotation::odomCallback, this);
@@ -59,6 +124,11 @@ rotation() {
     init_odom = false;
     display_odom = false;
 
+    // communication with the laser
+    sub_scan = n.subscribe("scan", 1, &rotation::scanCallback, this);
+    init_scan = false;
+    rotation_speed_sent = 0;
+
     // communication with decision
     pub_rotation_done = n.advertise<std_msgs::Float32>("rotation_done", 1);
     sub_rotation_to_do = n.subscribe("rotation_to_do", 1, &rotation::rotation_to_doCallback, this);//this is the rotation that has to be performed
@@ -66,16 +136,83 @@ rotation() {
     error_integral = 0;
     error_previous = 0;
 
+    pub_flight_recorder_trigger = n.advertise<std_msgs::String>("flight_recorder_trigger", 1);
+    saturated = false;
+    msg_trigger.data.reserve(64);
+
+    commands = metrics.counter("follow_me_pid_commands_total", "commands computed by the PID", "node=\"rotation\"");
+    saturations = metrics.counter("follow_me_pid_saturations_total", "commands of the PID above the speed limit", "node=\"rotation\"");
+    obstacle_stops = metrics.counter("follow_me_obstacle_stops_total", "motions stopped by an obstacle", "node=\"rotation\"");
+    tracking_error = metrics.gauge("follow_me_pid_tracking_error", "error between the profile and the odometry (rad or m)", "node=\"rotation\"");
+    static const double latency_bounds[] = { 1e-5, 5e-5, 1e-4, 5e-4, 1e-3, 5e-3, 1e-2, 5e-2 };
+    loop_latency = metrics.histogram("follow_me_loop_latency_seconds", "latency of the wakeups of the loop", latency_bounds, 8, "node=\"rotation\"");
+    if ( !metrics_endpoint.start(metrics_socket, metrics_port) )
+        ROS_WARN("(rotation_node) cannot serve the metrics on %s / port %i", metrics_socket.c_str(), metrics_port);
+
+    start_realtime();
+
     //INFINTE LOOP TO COLLECT LASER DATA AND PROCESS THEM
     ros::Rate r(10);// this node will run at 10hz
+    timer.start();
     while (ros::ok()) {
         ros::spinOnce();//each callback is called once to collect new data: laser + robot_moving
         update();//processing of data
-        r.sleep();//we wait if the processing (ie, callback+update) has taken less than 0.1s (ie, 10 hz)
+        //we wait if the processing (ie, callback+update) has taken less than 0.1s (ie, 10 hz)
+        if ( realtime_active )
+            measure_latency(timer.sleep());
+        else {
+            r.sleep();// follows the simulated time
+            measure_latency(timer.observe());
+        }
+    }
+    log.stop();
+
+}
+
+// the threads of ros, of the metrics server and of the log are already created: they keep the normal priority
+void start_realtime() {
+
+    realtime_active = false;
+    if ( !realtime.enabled )
+        return;
+    if ( ros::Time::isSimTime() ) {
+        ROS_WARN("(rotation_node) real-time mode ignored: the loop follows the simulated time");
+        return;
+    }
+    log.start();
+    if ( !lock_memory(realtime.stack_size) )
+        ROS_WARN("(rotation_node) memory not locked: %s", strerror(errno));
+    if ( ( realtime.cpu >= 0 ) && !set_cpu(realtime.cpu) )
+        ROS_WARN("(rotation_node) cannot run on cpu %i: %s", realtime.cpu, strerror(errno));
+    if ( !set_fifo_priority(realtime.priority) )
+        ROS_WARN("(rotation_node) SCHED_FIFO refused: %s", strerror(errno));
+    else
+        ROS_INFO("(rotation_node) real-time mode: SCHED_FIFO priority %i", realtime.priority);
+    realtime_active = true;
+
+}
+
+void measure_latency(double latency) {
+
+    jitter.add(latency);
+    loop_latency->observe(latency);
+    if ( jitter.count() % jitter_report_period == 0 ) {
+        char text[256];
+        jitter.report(text, sizeof(text));
+        log.info("(rotation_node) latency of the loop: %s (us), %li overruns, %li log lines dropped", text, timer.nb_overruns, log.nb_dropped.load());
     }
 
 }
 
+static void write_log(int level, const char* text) {
+
+    if ( level == realtime_log::warn_level )
+        ROS_WARN("%s", text);
+    else
+        ROS_INFO("%s", text);
+
+}
+
 //UPDATE: main processing
 /*//////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 //////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////*/
@@ -84,95 +221,125 @@ void update() {
     // we receive a new /rotation_to_do
     if ( new_rotation_to_do && init_odom ) {
         new_rotation_to_do = false;
-        ROS_INFO("\n(rotation_node) processing the /rotation_to_do received from the decision node");
-        ROS_INFO("(rotation_node) rotation_to_do: %f", rotation_to_do*180/M_PI);
+        log.info("\n(rotation_node) processing the /rotation_to_do received from the decision node");
+        log.info("(rotation_node) rotation_to_do: %f", rotation_to_do*180/M_PI);
+
+        profile.plan(rotation_to_do, max_rotation_speed, max_rotation_acceleration, max_rotation_jerk);
+        profile_start = ros::Time::now();
+        log.info("(rotation_node) profile planned: duration %f s, max speed %f", profile.duration(), profile.max_velocity_reached()*180/M_PI);
 
         init_orientation = current_orientation;
         rotation_done = current_orientation;
-        rotation_to_do += current_orientation;
+        rotation_to_do = normalize_angle(rotation_to_do + current_orientation);
         cond_rotation = true;
-        error_previous = rotation_to_do;
-
-        if ( rotation_to_do > M_PI )
-            rotation_to_do -= 2*M_PI;
-        if ( rotation_to_do < -M_PI )
-            rotation_to_do += 2*M_PI;
+        error_previous = 0;
+        error_integral = 0;
     }
     //we are performing a rotation
     if ( init_odom && cond_rotation ) {
         rotation_done = current_orientation;
-        float error = ( rotation_to_do - rotation_done );
-
-        if ( error > M_PI ) {
-            ROS_WARN("(rotation node) error > 180 degrees: %f degrees -> %f degrees", error*180/M_PI, (error-2*M_PI)*180/M_PI);
-            error -= 2*M_PI;
+        float remaining = angle_difference(rotation_to_do, rotation_done);
+        if ( remaining != rotation_to_do - rotation_done )
+            log.warn("(rotation node) error beyond 180 degrees: %f degrees -> %f degrees", ( rotation_to_do - rotation_done )*180/M_PI, remaining*180/M_PI);
+
+        // the reference of the profile is taken at the middle of the next period
+        float t = ( ros::Time::now() - profile_start ).toSec();
+        float reference, reference_speed, reference_acceleration;
+        profile.sample(t + 0.05, reference, reference_speed, reference_acceleration);
+
+        // the error is the difference between the orientation of the profile and the current orientation
+        float error = angle_difference(init_orientation + reference, rotation_done);
+
+        cond_rotation = ( t < profile.duration() ) || ( fabs(remaining) > rotation_error );
+
+        // the footprint swept by the rest of the rotation must be free
+        float direction = ( remaining < 0 ) ? -1 : 1;
+        bool obstacle_detected = cond_rotation && init_scan && ( free_rotation_ahead(direction) < rotation_clearance );
+        if ( obstacle_detected ) {
+            log.warn("(rotation_node) obstacle in the swept footprint: %f degrees free, %f degrees remaining", free_rotation_ahead(direction)*180/M_PI, remaining*180/M_PI);
+            obstacle_stops->add();
+            msg_trigger.data = "rotation_obstacle_stop";
+            pub_flight_recorder_trigger.publish(msg_trigger);
+            cond_rotation = false;
         }
-        else
-            if ( error < -M_PI ) {
-                ROS_WARN("(rotation node) error < -180 degrees: %f degrees -> %f degrees", error*180/M_PI, (error+2*M_PI)*180/M_PI);
-                error += 2*M_PI;
-            }
-
-        cond_rotation = ( fabs(error) > rotation_error );
 
         float rotation_speed = 0;
         if ( cond_rotation ) {
-            //TO COMPLETE
-            //Implementation of a PID controller for rotation_to_do;
-            //rotation_speed = kp*error + ki * error + kp * error_derivation;
-
-            float error_derivation;//To complete
+            float error_derivation;
             error_derivation = error - error_previous;
-            ROS_INFO("error_derivaion: %f", error_derivation);
-
-            error_integral += error;//To complete
-            ROS_INFO("error_integral: %f", error_integral);
-
-            //control of rotation with a PID controller
-            rotation_speed = kp * error + ki * error_integral + kd * error_derivation;
-            ROS_INFO("(rotation_node) current_orientation: %f, orientation_to_reach: %f -> rotation_speed: %f", rotation_done*180/M_PI, rotation_to_do*180/M_PI, rotation_speed*180/M_PI);
+            error_previous = error;
+            log.info("error_derivaion: %f", error_derivation);
+
+            error_integral += error;
+            log.info("error_integral: %f", error_integral);
+
+            //control of rotation: velocity of the profile + PID controller on the tracking error
+            rotation_speed = reference_speed + kp * error + ki * error_integral + kd * error_derivation;
+            commands->add();
+            tracking_error->set(error);
+            bool saturation = fabs(rotation_speed) > max_rotation_speed;
+            if ( saturation ) {
+                saturations->add();
+                if ( !saturated ) {
+                    msg_trigger.data = "rotation_saturation";
+                    pub_flight_recorder_trigger.publish(msg_trigger);
+                }
+            }
+            saturated = saturation;
+
+            // we must be able to stop before the obstacles
+            direction = ( rotation_speed < 0 ) ? -1 : 1;
+            float max_speed = stopping_speed(direction);
+            if ( direction * rotation_speed > max_speed )
+                rotation_speed = direction * max_speed;
+            log.info("(rotation_node) current_orientation: %f, reference: %f, orientation_to_reach: %f -> rotation_speed: %f", rotation_done*180/M_PI, (init_orientation+reference)*180/M_PI, rotation_to_do*180/M_PI, rotation_speed*180/M_PI);
         }
         else {
-            ROS_INFO("(rotation_node) current_orientation: %f, orientation_to_reach: %f -> rotation_speed: %f", rotation_done*180/M_PI, rotation_to_do*180/M_PI, rotation_speed*180/M_PI);
-            rotation_done -= init_orientation;
-
-            if ( rotation_done > M_PI )
-                rotation_done -= 2*M_PI;
-            if ( rotation_done < -M_PI )
-                rotation_done += 2*M_PI;
+            log.info("(rotation_node) current_orientation: %f, orientation_to_reach: %f -> rotation_speed: %f", rotation_done*180/M_PI, rotation_to_do*180/M_PI, rotation_speed*180/M_PI);
+            rotation_done = angle_difference(rotation_done, init_orientation);
 
-            ROS_INFO("(rotation_node) final rotation_done: %f", rotation_done*180/M_PI);
-            ROS_INFO("(rotation_node) waiting for a /rotation_to_do");
+            log.info("(rotation_node) final rotation_done: %f", rotation_done*180/M_PI);
+            log.info("(rotation_node) waiting for a /rotation_to_do");
 
-            std_msgs::Float32 msg_rotation_done;
             msg_rotation_done.data = rotation_done;
             pub_rotation_done.publish(msg_rotation_done);
         }
 
-        geometry_msgs::Twist twist;
-        twist.linear.x = 0;
-        twist.linear.y = 0;
-        twist.linear.z = 0;
-
-        twist.angular.x = 0;
-        twist.angular.y = 0;
         twist.angular.z = rotation_speed;
 
         pub_cmd_vel.publish(twist);
+        rotation_speed_sent = rotation_speed;
     }
 
     //DISPLAY MSGS
     if ( !display_odom && !init_odom ) {
-        ROS_INFO("wait for odom");
+        log.info("wait for odom");
         display_odom = true;
     }
     if ( display_odom && init_odom )  {
-        ROS_INFO("odom is ok");
+        log.info("odom is ok");
         display_odom = false;
     }
 
 }// update
 
+// rotation (rad) free from the current orientation in the direction (1: counterclockwise, -1: clockwise)
+float free_rotation_ahead(float direction) {
+
+    float rotated = angle_difference(current_orientation, scan_orientation);
+    return ( ( direction > 0 ) ? free_counterclockwise : free_clockwise ) - direction * rotated;
+
+}
+
+// highest rotation speed in the direction that can stop before the obstacles
+float stopping_speed(float direction) {
+
+    if ( !init_scan )
+        return max_rotation_speed;
+    return sqrt(2 * max_rotation_acceleration * std::max(0.0, free_rotation_ahead(direction) - rotation_clearance));
+
+}
+
 //CALLBACKS
 /*//////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 //////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////*/
@@ -181,6 +348,29 @@ void odomCallback(const nav_msgs::Odometry::ConstPtr& o) {
     init_odom = true;
     current_orientation = tf::getYaw(o->pose.pose.orientation);
 
+    // between two updates, the command is reduced as soon as it cannot stop before the obstacles
+    if ( cond_rotation && init_scan && ( rotation_speed_sent != 0 ) ) {
+        float direction = ( rotation_speed_sent < 0 ) ? -1 : 1;
+        float max_speed = stopping_speed(direction);
+        if ( direction * rotation_speed_sent > max_speed ) {
+            rotation_speed_sent = direction * max_speed;
+            twist.angular.z = rotation_speed_sent;
+            pub_cmd_vel.publish(twist);
+        }
+    }
+
+}
+
+void scanCallback(const sensor_msgs::LaserScan::ConstPtr& scan) {
+
+    if ( !init_odom || scan->ranges.empty() )
+        return;
+    clearance.set_scan(&scan->ranges[0], scan->ranges.size(), scan->angle_min, scan->angle_increment, scan->range_min, scan->range_max);
+    free_counterclockwise = clearance.free_rotation(1);
+    free_clockwise = clearance.free_rotation(-1);
+    scan_orientation = current_orientation;
+    init_scan = true;
+
 }
 
 void rotation_to_doCallback(const std_msgs::Float32::ConstPtr & a) {
@@ -195,6 +385,21 @@ void rotation_to_doCallback(const std_msgs::Float32::ConstPtr & a) {
 int main(int argc, char **argv){
 
     ros::init(argc, argv, "rotation");
+    ros::param::get("/rotation_node/metrics_socket", metrics_socket);
+    ros::param::get("/rotation_node/metrics_port", metrics_port);
+    ROS_INFO("(rotation_node) metrics_socket: %s, metrics_port: %i", metrics_socket.c_str(), metrics_port);
+    ros::param::get("/rotation_node/footprint", footprint.polygon);
+    ros::param::get("/rotation_node/laser_x", footprint.laser_x);
+    ros::param::get("/rotation_node/laser_y", footprint.laser_y);
+    ros::param::get("/rotation_node/laser_yaw", footprint.laser_yaw);
+    ros::param::get("/rotation_node/footprint_margin", footprint.margin);
+    ros::param::get("/rotation_node/realtime", realtime.enabled);
+    ros::param::get("/rotation_node/realtime_priority", realtime.priority);
+    ros::param::get("/rotation_node/realtime_cpu", realtime.cpu);
+    ROS_INFO("(rotation_node) footprint of %i vertices, laser at (%f, %f, %f), footprint_margin: %f", (int)footprint.polygon.size() / 2,
+             footprint.laser_x, footprint.laser_y, footprint.laser_yaw, footprint.margin);
+
+    ROS_INFO("(rotation_node) realtime: %i, realtime_priority: %i, realtime_cpu: %i", realtime.enabled, realtime.priority, realtime.cpu);
 
     ROS_INFO("(rotation_node) waiting for a /rotation_to_do");
     rotation bsObject;
@@ -0,0 +1,234 @@
+// bandwidth and cpu of the compact transport of the scans and of the markers (see scan_codec.h)
+// usage: scan_codec_benchmark [log]
+// - with a log (see scan_log.h), its scans are encoded
+// - without a log, runs of the simulator are recorded with lasers of 726 to 16000 beams: robot stopped with one person
+//   walking (the follow cycle of robair), then robot turning
+// for each run: size of the serialized LaserScan, size of the encoded frames (keyframes included), compression ratio,
+// time to encode and to decode a scan, maximum error on the valid beams; the markers of the detector (clusters, legs,
+// persons and field of view, as published by moving_person_detector_node) are encoded in the same way
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <vector>
+#include "follow_me/detector_core.h"
+#include "follow_me/scan_codec.h"
+#include "follow_me/scan_log.h"
+#include "follow_me/simulator.h"
+
+#define nb_scans 300
+#define nb_runs 5
+
+typedef std::chrono::steady_clock benchmark_clock;
+
+double seconds_since(benchmark_clock::time_point start) {
+
+    return std::chrono::duration<double>(benchmark_clock::now() - start).count();
+
+}
+
+void record(int nb_beams, bool turning, scan_log& log) {
+
+    sim_config config = default_sim_config();
+    config.nb_beams = nb_beams;
+    simulator sim(config);
+    sim.default_world();
+    for (int loop=0; loop<nb_scans; loop++) {
+        log_scan s;
+        s.stamp = sim.time;
+        s.angle_min = config.angle_min;
+        s.angle_increment = sim.angle_increment();
+        s.range_min = config.range_min;
+        s.range_max = config.range_max;
+        s.ranges.resize(config.nb_beams);
+        sim.scan(&s.ranges[0]);
+        log.scans.push_back(s);
+        if ( turning )
+            sim.set_command(0, 0.5);
+        sim.step(0.1);
+    }
+
+}
+
+void run_scans(const char* name, const scan_log& log) {
+
+    double raw = 0, encoded = 0, encode_time = 0, decode_time = 0, max_error = 0, max_static_error = 0;
+    long nb_keyframes = 0, nb_dynamic = 0;
+    bool lossless_invalid = true;
+    std::vector<uint8_t> data;
+    scan_frame frame;
+    scan_codec_config config = default_scan_codec_config();
+    for (int r=0; r<nb_runs; r++) {
+        scan_encoder encoder(config);
+        scan_decoder decoder;
+        for (size_t loop=0; loop<log.scans.size(); loop++) {
+            const log_scan& s = log.scans[loop];
+            const int nb = s.ranges.size();
+            benchmark_clock::time_point start = benchmark_clock::now();
+            encoder.encode(&s.ranges[0], nb, s.angle_min, s.angle_increment, s.range_min, s.range_max, data);
+            encode_time += seconds_since(start);
+            start = benchmark_clock::now();
+            bool decoded = decoder.decode(&data[0], data.size(), frame);
+            decode_time += seconds_since(start);
+            if ( r )
+                continue;
+
+            raw += scan_codec::laser_scan_size(nb, 0, "laser");
+            encoded += data.size();
+            nb_dynamic += encoder.nb_dynamic;
+            if ( !decoded || ( (int)frame.ranges.size() != nb ) ) {
+                printf("%s: scan %i not decoded\n", name, (int)loop);
+                return;
+            }
+            for (int b=0; b<nb; b++) {
+                bool valid = ( s.ranges[b] > s.range_min ) && ( s.ranges[b] < s.range_max );
+                if ( valid != std::isfinite(frame.ranges[b]) )
+                    lossless_invalid = false;
+                else if ( valid ) {
+                    double error = fabs(frame.ranges[b] - s.ranges[b]);
+                    if ( frame.keyframe )
+                        max_error = std::max(max_error, error);
+                    else
+                        max_static_error = std::max(max_static_error, error);
+                }
+            }
+        }
+        if ( !r )
+            nb_keyframes = encoder.nb_keyframes;
+    }
+
+    const int nb = log.scans.size();
+    printf("%-28s %9.0f %9.0f %7.1f %9i %9.0f %9.1f %9.1f %9.1f %9.1f %s\n", name, raw / nb, encoded / nb, raw / encoded, (int)nb_keyframes,
+           (double)nb_dynamic / nb, encode_time / ( nb_runs * nb ) * 1e6, decode_time / ( nb_runs * nb ) * 1e6, max_error * 1000,
+           max_static_error * 1000, lossless_invalid ? "" : "invalid beams not preserved");
+
+}
+
+void add_point(compact_marker& m, float x, float y, float r, float g, float b) {
+
+    m.x.push_back(x);
+    m.y.push_back(y);
+    m.colors.push_back(pack_color(r, g, b, 1));
+
+}
+
+// the markers of moving_person_detector_node for each scan
+void run_markers(const char* name, const scan_log& log) {
+
+    double raw = 0, encoded = 0, encode_time = 0, max_error = 0;
+    long nb_points = 0;
+    std::vector<uint8_t> data;
+    compact_marker decoded;
+    detector_pipeline* detector = 0;
+    for (size_t loop=0; loop<log.scans.size(); loop++) {
+        const log_scan& s = log.scans[loop];
+        const int nb = s.ranges.size();
+        if ( !detector || !detector->accepts(nb, s.angle_min, s.angle_increment) ) {
+            delete detector;
+            detector = make_detector_pipeline(nb, s.angle_min, s.angle_increment);
+        }
+        detector->set_scan(&s.ranges[0], nb, s.angle_min, s.angle_increment, s.range_min, s.range_max);
+        if ( !loop )
+            detector->store_background();
+        detector->detect();
+
+        compact_marker points;
+        points.id = 0;
+        points.type = 8;// POINTS
+        points.scale_x = points.scale_y = 0.05;
+        points.color = pack_color(0, 0, 0, 1);
+        for (size_t c=0; c<detector->clusters.size(); c++) {
+            const detector_cluster& cluster = detector->clusters[c];
+            add_point(points, detector->hit_x[cluster.start], detector->hit_y[cluster.start], 0, 1, 0);
+            add_point(points, detector->hit_x[cluster.end], detector->hit_y[cluster.end], 1, 0, 0);
+        }
+        for (size_t l=0; l<detector->moving_legs.size(); l++) {
+            const detector_cluster& cluster = detector->clusters[detector->moving_legs[l]];
+            for (int h=cluster.start; h<=cluster.end; h++)
+                add_point(points, detector->hit_x[h], detector->hit_y[h], 1, 1, 1);
+        }
+        for (size_t p=0; p<detector->moving_persons.size(); p++)
+            add_point(points, detector->moving_persons[p].x, detector->moving_persons[p].y, 1, 1, 0);
+
+        // field of view, one point per degree
+        compact_marker references;
+        references.id = 1;
+        references.type = 4;// LINE_STRIP
+        references.scale_x = 0.02;
+        references.scale_y = 0;
+        references.color = pack_color(1, 1, 1, 1);
+        float angle_max = s.angle_min + ( nb - 1 ) * s.angle_increment;
+        int nb_fov = ( angle_max - s.angle_min ) * 180 / M_PI + 1;
+        references.x.push_back(s.range_min * cos(s.angle_min));
+        references.y.push_back(s.range_min * sin(s.angle_min));
+        for (int i=0; i<=nb_fov; i++) {
+            float beam_angle = s.angle_min + i * ( angle_max - s.angle_min ) / nb_fov;
+            references.x.push_back(s.range_max * cos(beam_angle));
+            references.y.push_back(s.range_max * sin(beam_angle));
+        }
+        references.x.push_back(s.range_min * cos(angle_max));
+        references.y.push_back(s.range_min * sin(angle_max));
+
+        const compact_marker* markers[2] = { &points, &references };
+        for (int m=0; m<2; m++) {
+            const compact_marker& marker = *markers[m];
+            raw += scan_codec::marker_size(marker.x.size(), marker.colors.size(), "laser", "example");
+            benchmark_clock::time_point start = benchmark_clock::now();
+            encoded += encode_marker(marker, data);
+            encode_time += seconds_since(start);
+            nb_points += marker.x.size();
+            if ( !decode_marker(&data[0], data.size(), decoded) || ( decoded.x.size() != marker.x.size() ) ) {
+                printf("%s: marker %i not decoded\n", name, (int)loop);
+                delete detector;
+                return;
+            }
+            for (size_t p=0; p<marker.x.size(); p++)
+                max_error = std::max(max_error, (double)std::max(fabs(decoded.x[p] - marker.x[p]), fabs(decoded.y[p] - marker.y[p])));
+        }
+    }
+    delete detector;
+
+    const int nb = log.scans.size();
+    printf("%-28s %9.0f %9.0f %7.1f %9.0f %9.1f %9.1f\n", name, raw / nb, encoded / nb, raw / encoded, (double)nb_points / nb,
+           encode_time / nb * 1e6, max_error * 1000);
+
+}
+
+int main(int argc, char** argv) {
+
+    printf("scans: size in bytes per scan, keyframes, dynamic beams per scan, time per scan, max error on the keyframes and the other frames\n");
+    printf("%-28s %9s %9s %7s %9s %9s %9s %9s %9s %9s\n", "run", "raw", "encoded", "ratio", "keyframes", "dynamic", "enc us", "dec us", "key mm", "delta mm");
+
+    std::vector<scan_log> logs;
+    std::vector<std::string> names;
+    if ( argc > 1 ) {
+        logs.resize(1);
+        if ( !logs[0].load(argv[1]) || logs[0].scans.empty() ) {
+            printf("cannot read %s\n", argv[1]);
+            return 1;
+        }
+        names.push_back(argv[1]);
+    }
+    else {
+        int beams[] = { 726, 1440, 4000, 16000 };
+        for (int b=0; b<4; b++)
+            for (int turning=0; turning<2; turning++) {
+                char name[64];
+                snprintf(name, sizeof(name), "%i beams, %s", beams[b], turning ? "turning" : "stopped");
+                logs.push_back(scan_log());
+                record(beams[b], turning, logs.back());
+                names.push_back(name);
+            }
+    }
+    for (size_t loop=0; loop<logs.size(); loop++)
+        run_scans(names[loop].c_str(), logs[loop]);
+
+    printf("\nmarkers: size in bytes per scan (points and field of view), points per scan, encoding time per scan, max error\n");
+    printf("%-28s %9s %9s %7s %9s %9s %9s\n", "run", "raw", "encoded", "ratio", "points", "enc us", "max mm");
+    for (size_t loop=0; loop<logs.size(); loop++)
+        run_markers(names[loop].c_str(), logs[loop]);
+
+    return 0;
+
+}
@@ -0,0 +1,102 @@
+// rebuilds the scans and the markers sent by scan_encoder_node (see scan_codec.h) on the monitoring computer:
+// scan_compressed and moving_person_detector_compressed are republished on scan_decoded and
+// moving_person_detector_decoded for rviz; the invalid ranges are +inf, the ranges are exact to the millimetre on the
+// keyframes and on the beams that have changed, to static_tolerance on the others
+
+#include "ros/ros.h"
+#include "sensor_msgs/LaserScan.h"
+#include "visualization_msgs/Marker.h"
+#include "follow_me/CompressedData.h"
+#include "follow_me/scan_codec.h"
+
+class scan_decoder_node {
+private:
+
+    ros::NodeHandle n;
+
+    ros::Subscriber sub_scan;
+    ros::Subscriber sub_marker;
+    ros::Publisher pub_scan;
+    ros::Publisher pub_marker;
+
+    scan_decoder decoder;
+    scan_frame frame;
+    compact_marker marker;
+
+public:
+
+scan_decoder_node() {
+
+    pub_scan = n.advertise<sensor_msgs::LaserScan>("scan_decoded", 1);
+    pub_marker = n.advertise<visualization_msgs::Marker>("moving_person_detector_decoded", 10);
+    sub_scan = n.subscribe("scan_compressed", 10, &scan_decoder_node::scanCallback, this);
+    sub_marker = n.subscribe("moving_person_detector_compressed", 10, &scan_decoder_node::markerCallback, this);
+
+    ros::spin();
+
+}
+
+void scanCallback(const follow_me::CompressedData::ConstPtr& c) {
+
+    if ( c->data.empty() || !decoder.decode(&c->data[0], c->data.size(), frame) ) {
+        ROS_WARN_THROTTLE(5, "(scan_decoder) frame rejected, waiting for a keyframe");
+        return;
+    }
+
+    sensor_msgs::LaserScan scan;
+    scan.header = c->header;
+    scan.angle_min = frame.angle_min;
+    scan.angle_increment = frame.angle_increment;
+    scan.angle_max = frame.angle_min + ( (int)frame.ranges.size() - 1 ) * frame.angle_increment;
+    scan.range_min = frame.range_min;
+    scan.range_max = frame.range_max;
+    scan.ranges = frame.ranges;
+    pub_scan.publish(scan);
+
+}
+
+void markerCallback(const follow_me::CompressedData::ConstPtr& c) {
+
+    if ( c->data.empty() || !decode_marker(&c->data[0], c->data.size(), marker) ) {
+        ROS_WARN("(scan_decoder) malformed marker");
+        return;
+    }
+
+    visualization_msgs::Marker m;
+    m.header = c->header;
+    m.ns = "example";
+    m.id = marker.id;
+    m.type = marker.type;
+    m.action = visualization_msgs::Marker::ADD;
+    m.pose.orientation.w = 1;
+    m.scale.x = marker.scale_x;
+    m.scale.y = marker.scale_y;
+    m.color.r = color_channel(marker.color, 0);
+    m.color.g = color_channel(marker.color, 1);
+    m.color.b = color_channel(marker.color, 2);
+    m.color.a = color_channel(marker.color, 3);
+    m.points.resize(marker.x.size());
+    m.colors.resize(marker.x.size());
+    for (size_t loop=0; loop<marker.x.size(); loop++) {
+        m.points[loop].x = marker.x[loop];
+        m.points[loop].y = marker.y[loop];
+        m.points[loop].z = 0;
+        m.colors[loop].r = color_channel(marker.colors[loop], 0);
+        m.colors[loop].g = color_channel(marker.colors[loop], 1);
+        m.colors[loop].b = color_channel(marker.colors[loop], 2);
+        m.colors[loop].a = color_channel(marker.colors[loop], 3);
+    }
+    pub_marker.publish(m);
+
+}
+
+};
+
+int main(int argc, char **argv){
+
+    ros::init(argc, argv, "scan_decoder");
+
+    scan_decoder_node bsObject;
+
+    return 0;
+}
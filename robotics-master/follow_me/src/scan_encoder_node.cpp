@@ -0,0 +1,126 @@
+// compact transport of the scans and of the markers of the detector (see scan_codec.h), for the monitoring of robair
+// over a slow link: scan and moving_person_detector are republished on scan_compressed and
+// moving_person_detector_compressed, scan_decoder_node rebuilds them on the monitoring computer
+// parameters: /scan_encoder_node/keyframe_period (frames), static_tolerance (mm), max_dynamic_ratio, max_rotation (rad)
+
+#include "ros/ros.h"
+#include "sensor_msgs/LaserScan.h"
+#include "visualization_msgs/Marker.h"
+#include "follow_me/CompressedData.h"
+#include <chrono>
+#include "follow_me/scan_codec.h"
+
+#define stats_period 100// scans
+
+scan_codec_config codec = default_scan_codec_config();
+
+class scan_encoder_node {
+private:
+
+    ros::NodeHandle n;
+
+    ros::Subscriber sub_scan;
+    ros::Subscriber sub_marker;
+    ros::Publisher pub_scan;
+    ros::Publisher pub_marker;
+
+    scan_encoder encoder;
+    follow_me::CompressedData scan_msg, marker_msg;// their data is reused from message to message
+    compact_marker marker;
+    uint32_t nb_decoders;
+
+    // statistics over the last stats_period scans
+    double raw_bytes, encoded_bytes, encode_time;
+    long nb_stats, keyframes_at_stats;
+
+public:
+
+scan_encoder_node() : encoder(codec) {
+
+    nb_decoders = 0;
+    raw_bytes = encoded_bytes = encode_time = 0;
+    nb_stats = keyframes_at_stats = 0;
+
+    pub_scan = n.advertise<follow_me::CompressedData>("scan_compressed", 1);
+    pub_marker = n.advertise<follow_me::CompressedData>("moving_person_detector_compressed", 10);
+    sub_scan = n.subscribe("scan", 1, &scan_encoder_node::scanCallback, this);
+    sub_marker = n.subscribe("moving_person_detector", 10, &scan_encoder_node::markerCallback, this);
+
+    ros::spin();
+
+}
+
+void scanCallback(const sensor_msgs::LaserScan::ConstPtr& scan) {
+
+    // a new decoder cannot use the frames before the next keyframe
+    uint32_t nb = pub_scan.getNumSubscribers();
+    if ( nb > nb_decoders )
+        encoder.request_keyframe();
+    nb_decoders = nb;
+    if ( !nb || scan->ranges.empty() )
+        return;
+
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    encoder.encode(&scan->ranges[0], scan->ranges.size(), scan->angle_min, scan->angle_increment, scan->range_min, scan->range_max, scan_msg.data);
+    encode_time += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    scan_msg.header = scan->header;
+    pub_scan.publish(scan_msg);
+
+    raw_bytes += scan_codec::laser_scan_size(scan->ranges.size(), scan->intensities.size(), scan->header.frame_id);
+    encoded_bytes += scan_msg.data.size();
+    if ( ++nb_stats == stats_period ) {
+        ROS_INFO("(scan_encoder) %i scans: %.0f bytes per scan instead of %.0f (%.1fx), %li keyframes, encoding %.1f us",
+                 stats_period, encoded_bytes / stats_period, raw_bytes / stats_period, raw_bytes / encoded_bytes,
+                 encoder.nb_keyframes - keyframes_at_stats, encode_time / stats_period * 1e6);
+        raw_bytes = encoded_bytes = encode_time = 0;
+        nb_stats = 0;
+        keyframes_at_stats = encoder.nb_keyframes;
+    }
+
+}
+
+void markerCallback(const visualization_msgs::Marker::ConstPtr& m) {
+
+    if ( !pub_marker.getNumSubscribers() )
+        return;
+
+    marker.id = m->id;
+    marker.type = m->type;
+    marker.scale_x = m->scale.x;
+    marker.scale_y = m->scale.y;
+    marker.color = pack_color(m->color.r, m->color.g, m->color.b, m->color.a);
+    marker.x.resize(m->points.size());
+    marker.y.resize(m->points.size());
+    for (size_t loop=0; loop<m->points.size(); loop++) {
+        marker.x[loop] = m->points[loop].x;
+        marker.y[loop] = m->points[loop].y;
+    }
+    marker.colors.resize(m->colors.size() == m->points.size() ? m->colors.size() : 0);
+    for (size_t loop=0; loop<marker.colors.size(); loop++)
+        marker.colors[loop] = pack_color(m->colors[loop].r, m->colors[loop].g, m->colors[loop].b, m->colors[loop].a);
+
+    if ( !encode_marker(marker, marker_msg.data) ) {
+        ROS_WARN("(scan_encoder) marker %i has too many colours, not sent", m->id);
+        return;
+    }
+    marker_msg.header = m->header;
+    pub_marker.publish(marker_msg);
+
+}
+
+};
+
+int main(int argc, char **argv){
+
+    ros::init(argc, argv, "scan_encoder");
+    ros::param::get("/scan_encoder_node/keyframe_period", codec.keyframe_period);
+    ros::param::get("/scan_encoder_node/static_tolerance", codec.static_tolerance);
+    ros::param::get("/scan_encoder_node/max_dynamic_ratio", codec.max_dynamic_ratio);
+    ros::param::get("/scan_encoder_node/max_rotation", codec.max_rotation);
+    ROS_INFO("(scan_encoder) keyframe every %i frames, static tolerance: %i mm, keyframe above %.0f%% of dynamic beams, max rotation: %f rad",
+             codec.keyframe_period, codec.static_tolerance, codec.max_dynamic_ratio * 100, codec.max_rotation);
+
+    scan_encoder_node bsObject;
+
+    return 0;
+}
@@ -0,0 +1,86 @@
+// records the scans and the odometry in a text log (see scan_log.h) for the offline benchmarks and tools
+// parameter: /scan_logger_node/file (default: follow_me.log)
+
+#include "ros/ros.h"
+#include "sensor_msgs/LaserScan.h"
+#include "nav_msgs/Odometry.h"
+#include <cstdio>
+#include <string>
+#include <tf/transform_datatypes.h>
+#include "follow_me/scan_log.h"
+
+std::string log_file = "follow_me.log";
+
+class scan_logger {
+private:
+
+    ros::NodeHandle n;
+
+    ros::Subscriber sub_scan;
+    ros::Subscriber sub_odometry;
+
+    FILE* f;
+    int nb_scans;
+
+public:
+
+scan_logger() {
+
+    f = fopen(log_file.c_str(), "w");
+    if ( !f ) {
+        ROS_ERROR("(scan_logger) cannot open %s", log_file.c_str());
+        return;
+    }
+    fprintf(f, "# follow_me scan log\n");
+    nb_scans = 0;
+
+    // the queues are large: the logger must not drop any message
+    sub_scan = n.subscribe("scan", 100, &scan_logger::scanCallback, this);
+    sub_odometry = n.subscribe("odom", 100, &scan_logger::odomCallback, this);
+
+    ros::spin();
+
+    fclose(f);
+    ROS_INFO("(scan_logger) %i scans written in %s", nb_scans, log_file.c_str());
+
+}
+
+void scanCallback(const sensor_msgs::LaserScan::ConstPtr& scan) {
+
+    log_scan s;
+    s.stamp = scan->header.stamp.toSec();
+    s.angle_min = scan->angle_min;
+    s.angle_increment = scan->angle_increment;
+    s.range_min = scan->range_min;
+    s.range_max = scan->range_max;
+    s.ranges = scan->ranges;
+    scan_log::write_scan(f, s);
+    nb_scans++;
+
+}
+
+void odomCallback(const nav_msgs::Odometry::ConstPtr& o) {
+
+    log_pose p;
+    p.stamp = o->header.stamp.toSec();
+    p.x = o->pose.pose.position.x;
+    p.y = o->pose.pose.position.y;
+    p.yaw = tf::getYaw(o->pose.pose.orientation);
+    p.linear_speed = o->twist.twist.linear.x;
+    p.angular_speed = o->twist.twist.angular.z;
+    scan_log::write_odom(f, p);
+
+}
+
+};
+
+int main(int argc, char **argv){
+
+    ros::init(argc, argv, "scan_logger");
+    ros::param::get("/scan_logger_node/file", log_file);
+    ROS_INFO("(scan_logger) recording scan and odom in %s", log_file.c_str());
+
+    scan_logger bsObject;
+
+    return 0;
+}
@@ -0,0 +1,197 @@
+// accuracy and throughput of the scan matcher
+// usage: scan_matcher_benchmark [log]
+// - with a log (see scan_log.h), the scans and the odometry of the log are used; the "truth" records, if any, give the reference
+// - without a log, a synthetic run is generated: a room with pillars, a 1000 beams laser and a slipping odometry
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+#include "follow_me/geometry.h"
+#include "follow_me/scan_log.h"
+#include "follow_me/scan_matcher.h"
+
+#define time_budget 0.002// s per scan
+
+struct segment {
+
+    float x1, y1, x2, y2;
+
+};
+
+// range of the first segment hit by the ray, max_range if none
+float cast_ray(const std::vector<segment>& world, float ox, float oy, float angle, float max_range) {
+
+    float dx = cos(angle), dy = sin(angle);
+    float best = max_range;
+    for (size_t loop=0; loop<world.size(); loop++) {
+        const segment& s = world[loop];
+        float ex = s.x2 - s.x1, ey = s.y2 - s.y1;
+        float denominator = dx * ey - dy * ex;
+        if ( fabs(denominator) < 1e-9 )
+            continue;
+        float t = ( ( s.x1 - ox ) * ey - ( s.y1 - oy ) * ex ) / denominator;
+        float u = ( ( s.x1 - ox ) * dy - ( s.y1 - oy ) * dx ) / denominator;
+        if ( ( t > 0 ) && ( t < best ) && ( u >= 0 ) && ( u <= 1 ) )
+            best = t;
+    }
+    return best;
+
+}
+
+void add_box(std::vector<segment>& world, float x, float y, float half_size) {
+
+    segment s[4] = { { x - half_size, y - half_size, x + half_size, y - half_size },
+                     { x + half_size, y - half_size, x + half_size, y + half_size },
+                     { x + half_size, y + half_size, x - half_size, y + half_size },
+                     { x - half_size, y + half_size, x - half_size, y - half_size } };
+    world.insert(world.end(), s, s + 4);
+
+}
+
+float gaussian() {
+
+    float u1 = ( rand() + 1.0f ) / ( RAND_MAX + 2.0f );
+    float u2 = ( rand() + 1.0f ) / ( RAND_MAX + 2.0f );
+    return sqrt(-2 * log(u1)) * cos(2 * M_PI * u2);
+
+}
+
+// synthetic run: the robot drives a loop in a 10m x 8m room, the odometry overestimates the distances by 5%
+// and underestimates the rotations by 4%
+void generate_log(scan_log& log, int nb_beams) {
+
+    std::vector<segment> world;
+    add_box(world, 0, 0, 5);
+    add_box(world, 2, 1.5, 0.3);
+    add_box(world, -2, -1, 0.2);
+    add_box(world, 3, -2.5, 0.4);
+    add_box(world, -3, 2.5, 0.25);
+
+    pose2d truth = make_pose(-1, -2, 0);
+    pose2d odom = truth;
+    const float dt = 0.1;
+    const float angle_min = -2.356194, angle_max = 2.356194;
+
+    for (int step=0; step<600; step++) {
+        double stamp = step * dt;
+        float v = 0.3;
+        float w = 0.25 * sin(step * dt * 0.3);
+
+        log_scan s;
+        s.stamp = stamp;
+        s.angle_min = angle_min;
+        s.angle_increment = ( angle_max - angle_min ) / ( nb_beams - 1 );
+        s.range_min = 0.02;
+        s.range_max = 5.6;
+        s.ranges.resize(nb_beams);
+        for (int loop=0; loop<nb_beams; loop++) {
+            float r = cast_ray(world, truth.x, truth.y, truth.theta + angle_min + loop * s.angle_increment, s.range_max);
+            s.ranges[loop] = ( r < s.range_max ) ? r + 0.01 * gaussian() : s.range_max;
+        }
+        log.scans.push_back(s);
+
+        log_pose p;
+        p.stamp = stamp;
+        p.x = truth.x; p.y = truth.y; p.yaw = truth.theta;
+        p.linear_speed = v; p.angular_speed = w;
+        log.truth.push_back(p);
+        p.x = odom.x; p.y = odom.y; p.yaw = odom.theta;
+        log.odom.push_back(p);
+
+        truth = compose(truth, make_pose(v * dt, 0, w * dt));
+        odom = compose(odom, make_pose(1.05 * v * dt, 0, 0.96 * w * dt + 0.002 * gaussian()));
+        // the walls of the room: the robot turns back before hitting them
+        if ( ( fabs(truth.x) > 3.5 ) || ( fabs(truth.y) > 3 ) ) {
+            truth.theta += M_PI / 2;
+            odom.theta += M_PI / 2;
+        }
+    }
+
+}
+
+float position_error(const pose2d& a, const log_pose& b) {
+
+    return point_distance(a, b);
+
+}
+
+int main(int argc, char** argv) {
+
+    scan_log log;
+    if ( argc > 1 ) {
+        if ( !log.load(argv[1]) ) {
+            printf("cannot read %s\n", argv[1]);
+            return 1;
+        }
+        printf("log %s: %i scans, %i odometry samples, %i truth samples\n", argv[1], (int)log.scans.size(), (int)log.odom.size(), (int)log.truth.size());
+    }
+    else {
+        generate_log(log, 1000);
+        printf("synthetic run: %i scans of %i beams\n", (int)log.scans.size(), (int)log.scans[0].ranges.size());
+    }
+
+    scan_odometry matcher;
+    std::vector<double> times;
+    double odom_error_sum = 0, matched_error_sum = 0;
+    float odom_error_last = 0, matched_error_last = 0;
+    int nb_compared = 0;
+    pose2d first_truth_offset = make_pose(0, 0, 0);
+    bool init = false;
+
+    for (size_t loop=0; loop<log.scans.size(); loop++) {
+        const log_scan& s = log.scans[loop];
+        log_pose o;
+        if ( !scan_log::interpolate(log.odom, s.stamp, o) )
+            continue;
+        pose2d odom = make_pose(o.x, o.y, o.yaw);
+
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        pose2d corrected = matcher.update(&s.ranges[0], s.ranges.size(), s.angle_min, s.angle_increment, s.range_min, s.range_max, odom);
+        times.push_back(std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+
+        log_pose t;
+        if ( scan_log::interpolate(log.truth, s.stamp, t) ) {
+            // the truth is expressed in the frame of the first odometry sample
+            if ( !init ) {
+                init = true;
+                first_truth_offset = between(make_pose(t.x, t.y, t.yaw), odom);
+            }
+            pose2d truth = compose(make_pose(t.x, t.y, t.yaw), first_truth_offset);
+            log_pose truth_pose = t;
+            truth_pose.x = truth.x;
+            truth_pose.y = truth.y;
+            odom_error_last = position_error(odom, truth_pose);
+            matched_error_last = position_error(corrected, truth_pose);
+            odom_error_sum += odom_error_last * odom_error_last;
+            matched_error_sum += matched_error_last * matched_error_last;
+            nb_compared++;
+        }
+    }
+
+    if ( times.empty() ) {
+        printf("no scan with odometry\n");
+        return 1;
+    }
+
+    std::vector<double> sorted = times;
+    std::sort(sorted.begin(), sorted.end());
+    double total = 0;
+    for (size_t loop=0; loop<times.size(); loop++)
+        total += times[loop];
+    int over_budget = sorted.end() - std::upper_bound(sorted.begin(), sorted.end(), time_budget);
+
+    printf("throughput: %.0f scans/s, mean %.3f ms, median %.3f ms, p99 %.3f ms, max %.3f ms\n", times.size() / total, total / times.size() * 1000,
+           sorted[sorted.size() / 2] * 1000, sorted[sorted.size() * 99 / 100] * 1000, sorted.back() * 1000);
+    printf("budget %.1f ms: %i/%i scans over budget, %i failed matches\n", time_budget * 1000, over_budget, (int)times.size(), matcher.nb_failures);
+    if ( nb_compared )
+        printf("position error: odometry rms %.3f m (final %.3f m), scan matching rms %.3f m (final %.3f m)\n", sqrt(odom_error_sum / nb_compared), odom_error_last,
+               sqrt(matched_error_sum / nb_compared), matched_error_last);
+    else
+        printf("no truth in the log: accuracy not evaluated\n");
+
+    return 0;
+
+}
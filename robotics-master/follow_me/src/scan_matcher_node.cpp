@@ -0,0 +1,128 @@
+// odometry corrected by scan matching
+// each scan is matched against the last keyframe with a point-to-line ICP (see scan_matcher.h), starting from the wheel odometry
+// the corrected pose is published on /odom_corrected at the scan rate and, between two scans, at the odometry rate
+// the nodes that trust the odometry (rotation_node, translation_node, robot_moving_node) can use it by remapping odom to odom_corrected
+
+#include "ros/ros.h"
+#include "ros/time.h"
+#include "sensor_msgs/LaserScan.h"
+#include "nav_msgs/Odometry.h"
+#include <cmath>
+#include <tf/transform_datatypes.h>
+#include "follow_me/scan_matcher.h"
+
+#define time_budget 0.002// s per scan
+
+using namespace std;
+
+class scan_matcher_node {
+private:
+
+    ros::NodeHandle n;
+
+    // communication with the laser and the odometry
+    ros::Subscriber sub_scan;
+    ros::Subscriber sub_odometry;
+    bool init_odom;
+    nav_msgs::Odometry last_odom;
+    pose2d odom_pose;
+
+    // correction to apply to the odometry: corrected pose = correction (+) odometry
+    pose2d correction;
+    scan_odometry matcher;
+
+    ros::Publisher pub_odom_corrected;
+
+    // to measure the processing time
+    int nb_scans, nb_over_budget;
+    double time_sum, time_max;
+    ros::Time last_report;
+
+public:
+
+scan_matcher_node() {
+
+    sub_scan = n.subscribe("scan", 1, &scan_matcher_node::scanCallback, this);
+    sub_odometry = n.subscribe("odom", 1, &scan_matcher_node::odomCallback, this);
+    pub_odom_corrected = n.advertise<nav_msgs::Odometry>("odom_corrected", 1);
+
+    init_odom = false;
+    correction = make_pose(0, 0, 0);
+
+    nb_scans = nb_over_budget = 0;
+    time_sum = time_max = 0;
+    last_report = ros::Time::now();
+
+    // the scans and the odometry are processed as soon as they are received
+    ros::spin();
+
+}
+
+//CALLBACKS
+/*//////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////*/
+void odomCallback(const nav_msgs::Odometry::ConstPtr& o) {
+
+    init_odom = true;
+    last_odom = *o;
+    odom_pose = make_pose(o->pose.pose.position.x, o->pose.pose.position.y, tf::getYaw(o->pose.pose.orientation));
+
+    publish(compose(correction, odom_pose), o->header.stamp);
+
+}
+
+void scanCallback(const sensor_msgs::LaserScan::ConstPtr& scan) {
+
+    if ( !init_odom || scan->ranges.empty() )
+        return;
+
+    ros::WallTime start = ros::WallTime::now();
+    pose2d corrected = matcher.update(&scan->ranges[0], scan->ranges.size(), scan->angle_min, scan->angle_increment, scan->range_min, scan->range_max, odom_pose);
+    double processing_time = ( ros::WallTime::now() - start ).toSec();
+
+    correction = compose(corrected, inverse(odom_pose));
+    publish(corrected, scan->header.stamp);
+
+    nb_scans++;
+    time_sum += processing_time;
+    if ( processing_time > time_max )
+        time_max = processing_time;
+    if ( processing_time > time_budget )
+        nb_over_budget++;
+
+    if ( !matcher.last_match.success )
+        ROS_WARN("(scan_matcher) match failed: %i correspondences, the odometry is used", matcher.last_match.nb_correspondences);
+
+    ros::Time now = ros::Time::now();
+    if ( ( now - last_report ).toSec() > 5 ) {
+        ROS_INFO("(scan_matcher) %i scans: mean %f ms, max %f ms, %i over the budget of %f ms, %i failed matches", nb_scans, time_sum/nb_scans*1000, time_max*1000, nb_over_budget, time_budget*1000, matcher.nb_failures);
+        ROS_INFO("(scan_matcher) correction of the odometry: (%f, %f, %f)", correction.x, correction.y, correction.theta*180/M_PI);
+        nb_scans = nb_over_budget = 0;
+        time_sum = time_max = 0;
+        last_report = now;
+    }
+
+}//scanCallback
+
+void publish(const pose2d& pose, const ros::Time& stamp) {
+
+    nav_msgs::Odometry corrected = last_odom;
+    corrected.header.stamp = stamp;
+    corrected.pose.pose.position.x = pose.x;
+    corrected.pose.pose.position.y = pose.y;
+    corrected.pose.pose.position.z = 0;
+    corrected.pose.pose.orientation = tf::createQuaternionMsgFromYaw(pose.theta);
+    pub_odom_corrected.publish(corrected);
+
+}
+
+};
+
+int main(int argc, char **argv){
+
+    ros::init(argc, argv, "scan_matcher");
+
+    scan_matcher_node bsObject;
+
+    return 0;
+}
@@ -0,0 +1,56 @@
+// cost of the detector (generic version of detector_core.h) as a function of the number of beams
+// the scans are simulated over the field of view of robair's laser with 1000 to 32000 beams; the time per beam should
+// stay constant (linear cost) and a 16k beams scan must be processed well within the 25 ms of a 40 hz laser
+
+#include <chrono>
+#include <cstdio>
+#include <vector>
+#include "follow_me/detector_core.h"
+#include "follow_me/simulator.h"
+
+#define frame_budget 0.025// s, 40 hz
+
+int main() {
+
+    const int beams[6] = { 1000, 2000, 4000, 8000, 16000, 32000 };
+    const int nb_scans = 100;
+    double first_time_per_beam = 0, last_time_per_beam = 0;
+
+    // the same detector is used for all the sizes: its storage grows and is reused
+    detector_core<generic_laser_traits> detector;
+
+    printf("%8s %12s %12s %10s %10s\n", "beams", "us/scan", "ns/beam", "x budget", "persons");
+    for (int b=0; b<6; b++) {
+        sim_config config = default_sim_config();
+        config.nb_beams = beams[b];
+        simulator sim(config);
+        sim.default_world();
+
+        std::vector<std::vector<float> > scans(nb_scans, std::vector<float>(beams[b]));
+        for (int loop=0; loop<nb_scans; loop++) {
+            sim.scan(&scans[loop][0]);
+            sim.step(0.1);
+        }
+
+        int nb_persons = 0;
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        for (int loop=0; loop<nb_scans; loop++) {
+            detector.set_scan(&scans[loop][0], beams[b], config.angle_min, sim.angle_increment(), config.range_min, config.range_max);
+            if ( !loop )
+                detector.store_background();
+            detector.detect();
+            nb_persons += detector.moving_persons.size();
+        }
+        double time = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count() / nb_scans;
+        double time_per_beam = time / beams[b];
+        if ( !b )
+            first_time_per_beam = time_per_beam;
+        last_time_per_beam = time_per_beam;
+
+        printf("%8i %12.1f %12.2f %10.4f %10i\n", beams[b], time * 1e6, time_per_beam * 1e9, time / frame_budget, nb_persons);
+    }
+    printf("time per beam at %i beams relative to 1000 beams: %.2f (1 = linear)\n", beams[5], last_time_per_beam / first_time_per_beam);
+
+    return 0;
+
+}
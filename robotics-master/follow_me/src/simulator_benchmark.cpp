@@ -0,0 +1,137 @@
+// speed of the headless simulator (see simulator.h)
+// usage: simulator_benchmark [world]
+// - ray casting: time per scan for several numbers of beams, checked against a plain scalar ray casting
+// - closed loop: a simple controller follows the first person; the simulated time is compared to the wall time
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <vector>
+#include "follow_me/geometry.h"
+#include "follow_me/simulator.h"
+
+double elapsed(std::chrono::steady_clock::time_point start) {
+
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+}
+
+// reference: one beam at a time, without any optimization
+float reference_range(const simulator& sim, float angle) {
+
+    float dx = cos(angle), dy = sin(angle);
+    float best = sim.config.range_max;
+    for (size_t loop=0; loop<sim.walls.size(); loop++) {
+        const sim_segment& s = sim.walls[loop];
+        float ex = s.x2 - s.x1, ey = s.y2 - s.y1;
+        float denominator = dx * ey - dy * ex;
+        if ( fabs(denominator) < 1e-9 )
+            continue;
+        float t = ( ( s.x1 - sim.x ) * ey - ( s.y1 - sim.y ) * ex ) / denominator;
+        float u = ( ( s.x1 - sim.x ) * dy - ( s.y1 - sim.y ) * dx ) / denominator;
+        if ( ( t > 0 ) && ( t < best ) && ( u >= 0 ) && ( u <= 1 ) )
+            best = t;
+    }
+    for (size_t loop=0; loop<sim.people.size(); loop++) {
+        float legs_x[2], legs_y[2];
+        sim.legs(sim.people[loop], legs_x, legs_y);
+        for (int leg=0; leg<2; leg++) {
+            float cx = legs_x[leg] - sim.x, cy = legs_y[leg] - sim.y;
+            float b = dx * cx + dy * cy;
+            float discriminant = b * b - ( cx * cx + cy * cy - sim.config.leg_radius * sim.config.leg_radius );
+            if ( discriminant > 0 ) {
+                float t = b - sqrt(discriminant);
+                if ( ( t > 0 ) && ( t < best ) )
+                    best = t;
+            }
+        }
+    }
+    return best;
+
+}
+
+void init_world(simulator& sim, const char* world) {
+
+    if ( !world || !sim.load(world) )
+        sim.default_world();
+
+}
+
+void benchmark_scan(int nb_beams, const char* world) {
+
+    sim_config config = default_sim_config();
+    config.nb_beams = nb_beams;
+    config.range_noise = 0;
+    simulator sim(config);
+    init_world(sim, world);
+
+    std::vector<float> ranges(nb_beams);
+    const int nb_scans = 2000;
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    for (int loop=0; loop<nb_scans; loop++) {
+        sim.step(0.01);
+        sim.scan(&ranges[0]);
+    }
+    double time = elapsed(start) / nb_scans;
+
+    float max_error = 0;
+    for (int loop=0; loop<nb_beams; loop++) {
+        float error = fabs(ranges[loop] - reference_range(sim, sim.theta + config.angle_min + loop * sim.angle_increment()));
+        if ( error > max_error )
+            max_error = error;
+    }
+
+    printf("%5i beams, %i walls, %i legs: %7.1f us per scan, max difference with the reference %.5f m\n", nb_beams, (int)sim.walls.size(),
+           2 * (int)sim.people.size(), time * 1e6, max_error);
+
+}
+
+int main(int argc, char** argv) {
+
+    const char* world = argc > 1 ? argv[1] : 0;
+
+    printf("ray casting\n");
+    int beams[3] = { 726, 1440, 2048 };
+    for (int loop=0; loop<3; loop++)
+        benchmark_scan(beams[loop], world);
+
+    // closed loop at the rates of simulator_node: 5 ms steps, scans at 10 hz, a controller at 10 hz
+    simulator sim;
+    init_world(sim, world);
+    std::vector<float> ranges(sim.config.nb_beams);
+    const float duration = 600;// s of simulated time
+    const float time_step = 0.005;
+    int nb_scans = 0;
+    double next_scan = 0;
+    float distance_sum = 0;
+
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    while ( sim.time < duration ) {
+        sim.step(time_step);
+        if ( sim.time < next_scan )
+            continue;
+        next_scan += 0.1;
+        sim.scan(&ranges[0]);
+        nb_scans++;
+
+        if ( sim.people.empty() )
+            continue;
+        // go toward the first person and stop at 1m
+        float dx = sim.people[0].x - sim.x, dy = sim.people[0].y - sim.y;
+        float distance = sqrt(dx * dx + dy * dy);
+        float angle = angle_difference((float)atan2(dy, dx), sim.theta);
+        float linear = fabs(angle) < 0.5 ? 0.5 * ( distance - 1 ) : 0;
+        linear = linear < 0 ? 0 : ( linear > 0.5 ? 0.5 : linear );
+        sim.set_command(linear, 1.5 * angle);
+        distance_sum += distance;
+    }
+    double time = elapsed(start);
+
+    printf("closed loop: %.0f s simulated in %.3f s (%.0f x real time), %i scans, %i collisions", duration, time, duration / time, nb_scans, sim.nb_collisions);
+    if ( !sim.people.empty() )
+        printf(", mean distance to the person %.2f m", distance_sum / nb_scans);
+    printf("\n");
+
+    return 0;
+
+}
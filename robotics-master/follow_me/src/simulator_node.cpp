@@ -0,0 +1,239 @@
+// headless simulator of the robot, its laser and the people around it (see simulator.h)
+// it replaces the robot: it consumes /cmd_vel and publishes /scan, /odom and the simulated time on /clock
+// the other nodes must be started with /use_sim_time set to true so that their ros::Rate follow the simulated time
+// with real_time_factor = 0, the simulation runs as fast as possible
+// it also publishes the true pose of the robot on /truth, the true poses of the people on /people_truth
+// and their legs on /simulated_people (rviz)
+
+#include "ros/ros.h"
+#include "ros/time.h"
+#include "rosgraph_msgs/Clock.h"
+#include "sensor_msgs/LaserScan.h"
+#include "nav_msgs/Odometry.h"
+#include "geometry_msgs/Twist.h"
+#include "geometry_msgs/Point.h"
+#include "geometry_msgs/PoseArray.h"
+#include "visualization_msgs/Marker.h"
+#include <string>
+#include <tf/transform_datatypes.h>
+#include "follow_me/simulator.h"
+// changes of frame (see geometry.h)
+#include "follow_me/geometry.h"
+
+std::string world_file;
+int nb_beams = 726;
+float scan_rate = 10;// hz
+float odom_rate = 50;// hz
+float time_step = 0.005;// s
+float real_time_factor = 1;// 0: as fast as possible
+float range_noise = 0.01;// m
+float odom_linear_error = 0;
+float odom_angular_error = 0;
+
+using namespace std;
+
+class simulator_node {
+private:
+
+    ros::NodeHandle n;
+
+    ros::Subscriber sub_cmd_vel;
+    ros::Publisher pub_clock;
+    ros::Publisher pub_scan;
+    ros::Publisher pub_odom;
+    ros::Publisher pub_truth;
+    ros::Publisher pub_people;
+    ros::Publisher pub_people_truth;
+
+    simulator sim;
+    sensor_msgs::LaserScan scan;
+    double next_scan, next_odom;
+
+public:
+
+simulator_node() {
+
+    sim_config config = default_sim_config();
+    config.nb_beams = nb_beams;
+    config.range_noise = range_noise;
+    config.odom_linear_error = odom_linear_error;
+    config.odom_angular_error = odom_angular_error;
+    // the field of view of the default laser is kept: the resolution depends on nb_beams
+    sim = simulator(config);
+
+    if ( world_file.empty() )
+        sim.default_world();
+    else
+        if ( !sim.load(world_file.c_str()) ) {
+            ROS_ERROR("(simulator) cannot read %s, the default world is used", world_file.c_str());
+            sim.default_world();
+        }
+    ROS_INFO("(simulator) %i walls, %i people, laser of %i beams", (int)sim.walls.size(), (int)sim.people.size(), nb_beams);
+
+    sub_cmd_vel = n.subscribe("cmd_vel", 1, &simulator_node::cmd_velCallback, this);
+    pub_clock = n.advertise<rosgraph_msgs::Clock>("/clock", 1);
+    pub_scan = n.advertise<sensor_msgs::LaserScan>("scan", 1);
+    pub_odom = n.advertise<nav_msgs::Odometry>("odom", 1);
+    pub_truth = n.advertise<nav_msgs::Odometry>("truth", 1);
+    pub_people = n.advertise<visualization_msgs::Marker>("simulated_people", 1);
+    pub_people_truth = n.advertise<geometry_msgs::PoseArray>("people_truth", 1);
+
+    // the scan message is allocated once
+    scan.header.frame_id = "laser";
+    scan.angle_min = config.angle_min;
+    scan.angle_max = config.angle_max;
+    scan.angle_increment = sim.angle_increment();
+    scan.time_increment = 0;
+    scan.scan_time = 1 / scan_rate;
+    scan.range_min = config.range_min;
+    scan.range_max = config.range_max;
+    scan.ranges.resize(nb_beams);
+
+    next_scan = next_odom = 0;
+
+    ros::WallTime start = ros::WallTime::now();
+    ros::WallTime last_report = start;
+    double report_time = 0;
+    while ( ros::ok() ) {
+        ros::spinOnce();
+        update();
+
+        if ( real_time_factor > 0 ) {
+            // we wait until the wall time has caught up with the simulated time
+            ros::WallDuration ahead = ros::WallDuration(sim.time / real_time_factor) - ( ros::WallTime::now() - start );
+            if ( ahead.toSec() > 0 )
+                ahead.sleep();
+        }
+
+        ros::WallTime now = ros::WallTime::now();
+        if ( ( now - last_report ).toSec() > 5 ) {
+            ROS_INFO("(simulator) t = %.1f s, %.1f x real time, %i collisions", sim.time, ( sim.time - report_time ) / ( now - last_report ).toSec(), sim.nb_collisions);
+            last_report = now;
+            report_time = sim.time;
+        }
+    }
+
+}
+
+//UPDATE: one step of simulation
+/*//////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////*/
+void update() {
+
+    sim.step(time_step);
+    ros::Time stamp = sim_stamp();
+
+    rosgraph_msgs::Clock clock;
+    clock.clock = stamp;
+    pub_clock.publish(clock);
+
+    if ( sim.time >= next_odom ) {
+        next_odom += 1 / odom_rate;
+        publish_odometry(pub_odom, stamp, "odom", sim.odom_x, sim.odom_y, sim.odom_theta);
+        publish_odometry(pub_truth, stamp, "map", sim.x, sim.y, sim.theta);
+    }
+
+    if ( sim.time >= next_scan ) {
+        next_scan += 1 / scan_rate;
+        scan.header.stamp = stamp;
+        sim.scan(&scan.ranges[0]);
+        pub_scan.publish(scan);
+        publish_people(stamp);
+    }
+
+}
+
+//CALLBACKS
+/*//////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////*/
+void cmd_velCallback(const geometry_msgs::Twist::ConstPtr& cmd) {
+
+    sim.set_command(cmd->linear.x, cmd->angular.z);
+
+}
+
+// the simulated time starts at 1s: a zero stamp means "no time" for ROS
+ros::Time sim_stamp() {
+
+    return ros::Time(1 + sim.time);
+
+}
+
+void publish_odometry(ros::Publisher& pub, const ros::Time& stamp, const char* frame, float x, float y, float theta) {
+
+    nav_msgs::Odometry o;
+    o.header.stamp = stamp;
+    o.header.frame_id = frame;
+    o.child_frame_id = "base_link";
+    o.pose.pose.position.x = x;
+    o.pose.pose.position.y = y;
+    o.pose.pose.orientation = tf::createQuaternionMsgFromYaw(theta);
+    o.twist.twist.linear.x = sim.linear_speed;
+    o.twist.twist.angular.z = sim.angular_speed;
+    pub.publish(o);
+
+}
+
+// legs of the people in the frame of the laser, and their true poses
+void publish_people(const ros::Time& stamp) {
+
+    visualization_msgs::Marker marker;
+    marker.header.frame_id = "laser";
+    marker.header.stamp = stamp;
+    marker.ns = "simulator";
+    marker.id = 0;
+    marker.type = visualization_msgs::Marker::SPHERE_LIST;
+    marker.action = visualization_msgs::Marker::ADD;
+    marker.pose.orientation.w = 1;
+    marker.scale.x = marker.scale.y = marker.scale.z = 2 * sim.config.leg_radius;
+    marker.color.g = 1.0f;
+    marker.color.a = 1.0;
+
+    const frame_transform laser = make_frame_transform(sim.x, sim.y, sim.theta);
+    for (size_t loop=0; loop<sim.people.size(); loop++) {
+        float legs_x[2], legs_y[2];
+        sim.legs(sim.people[loop], legs_x, legs_y);
+        for (int leg=0; leg<2; leg++) {
+            geometry_msgs::Point p;
+            p.x = legs_x[leg];
+            p.y = legs_y[leg];
+            p.z = 0;
+            marker.points.push_back(to_child(laser, p));
+        }
+    }
+    pub_people.publish(marker);
+
+    geometry_msgs::PoseArray truth;
+    truth.header.frame_id = "map";
+    truth.header.stamp = stamp;
+    truth.poses.resize(sim.people.size());
+    for (size_t loop=0; loop<sim.people.size(); loop++) {
+        truth.poses[loop].position.x = sim.people[loop].x;
+        truth.poses[loop].position.y = sim.people[loop].y;
+        truth.poses[loop].orientation = tf::createQuaternionMsgFromYaw(sim.people[loop].heading);
+    }
+    pub_people_truth.publish(truth);
+
+}
+
+};
+
+int main(int argc, char **argv){
+
+    ros::init(argc, argv, "simulator");
+
+    ros::param::get("/simulator_node/world", world_file);
+    ros::param::get("/simulator_node/nb_beams", nb_beams);
+    ros::param::get("/simulator_node/scan_rate", scan_rate);
+    ros::param::get("/simulator_node/odom_rate", odom_rate);
+    ros::param::get("/simulator_node/time_step", time_step);
+    ros::param::get("/simulator_node/real_time_factor", real_time_factor);
+    ros::param::get("/simulator_node/range_noise", range_noise);
+    ros::param::get("/simulator_node/odom_linear_error", odom_linear_error);
+    ros::param::get("/simulator_node/odom_angular_error", odom_angular_error);
+    ROS_INFO("(simulator) scan at %f hz, odom at %f hz, real time factor %f", scan_rate, odom_rate, real_time_factor);
+
+    simulator_node bsObject;
+
+    return 0;
+}
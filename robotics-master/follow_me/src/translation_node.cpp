@@ -4,9 +4,22 @@
 #include "geometry_msgs/Point.h"
 #include "std_msgs/ColorRGBA.h"
 #include "std_msgs/Float32.h"
+#include "std_msgs/Bool.h"
+#include "std_msgs/String.h"
+#include <cerrno>
 #include <cmath>
+#include <cstring>
 #include "nav_msgs/Odometry.h"
 #include <tf/transform_datatypes.h>
+#include "follow_me/motion_profile.h"
+// commands and saturations of the PID, exposed to prometheus (see metrics.h)
+#include "follow_me/metrics.h"
+// collision of the footprint swept by the translation with the scan
+#include "follow_me/footprint.h"
+// optional real-time mode of the loop: SCHED_FIFO, memory locked, logs through a lock-free queue
+#include "follow_me/realtime.h"
+// distances, angles and changes of frame (see geometry.h)
+#include "follow_me/geometry.h"
 
 using namespace std;
 
@@ -16,6 +29,26 @@ using namespace std;
 #define ki 0
 #define kd 0
 
+//limits used to plan the profile of each translation (max_translation_jerk = 0 for a trapezoidal profile)
+#define max_translation_speed 0.5
+#define max_translation_acceleration 0.5
+#define max_translation_jerk 2.0
+
+#define translation_clearance 0.15// m kept free in front of the swept footprint
+
+// the local planner gives up after 30 s (max_duration of local_planner_node): past this delay without /local_goal_done,
+// the translation ends on the obstacle as without local planner
+#define avoidance_timeout 35// s
+
+#define jitter_report_period 100// cycles between two reports of the latency of the loop
+
+footprint_config footprint = default_footprint_config();
+
+std::string metrics_socket = "/tmp/follow_me_translation.metrics";// "" for none
+int metrics_port = 0;// localhost tcp port of the metrics, 0 for none
+
+realtime_config realtime = default_realtime_config();
+
 class translation {
 private:
 
@@ -34,6 +67,14 @@ private:
     // communication with obstacle_detection
     ros::Subscriber sub_obstacle_detection;
 
+    // communication with local_planner: when an obstacle blocks the translation, the local planner goes around it
+    ros::Publisher pub_local_goal;
+    ros::Subscriber sub_local_goal_done;
+    bool cond_avoidance;// to check if the local planner is performing the end of the translation
+    ros::Time avoidance_start;
+    bool new_local_goal_done;
+    bool local_goal_reached;
+
     bool new_translation_to_do;//to check if a new /translation_to_do is available or not
     bool init_odom;//to check if new data from odometry are available
     bool display_odom;
@@ -45,6 +86,10 @@ private:
 
     float translation_to_do;
 
+    // the PID tracks a time-optimal profile instead of the final position
+    motion_profile profile;
+    ros::Time profile_start;
+
     float error_integral;
     float error_previous;
 
@@ -52,12 +97,47 @@ private:
 
     geometry_msgs::Point closest_obstacle;
 
+    // communication with the laser: the free translation in each direction is computed at each scan, from the
+    // position of the robot at this scan, and checked at each odometry; without scan, the corridor of
+    // obstacle_detection (closest_obstacle) is used
+    ros::Subscriber sub_scan;
+    footprint_clearance clearance;
+    bool init_scan;
+    float free_forward, free_backward;
+    geometry_msgs::Point scan_position;
+    float translation_speed_sent;
+
+    metrics_registry metrics;
+    metrics_server metrics_endpoint;
+    metric_counter* commands;
+    metric_counter* saturations;// the PID asks for more than max_translation_speed or than the speed to stop before the obstacle
+    metric_counter* obstacle_stops;
+    metric_gauge* tracking_error;// m
+
+    // communication with flight_recorder: the obstacle stops and the saturations of the PID are recorded
+    ros::Publisher pub_flight_recorder_trigger;
+    bool saturated;
+
+    // the messages are allocated once: the loop only fills them
+    geometry_msgs::Twist twist;
+    std_msgs::Float32 msg_translation_done;
+    geometry_msgs::Point msg_local_goal;
+    std_msgs::String msg_trigger;
+
+    // real-time mode (see realtime.h): the loop sleeps on absolute deadlines under SCHED_FIFO, its logs are written
+    // by another thread; the latency of its wakeups is measured in both modes
+    bool realtime_active;
+    realtime_log log;
+    periodic_timer timer;
+    jitter_histogram jitter;
+    metric_histogram* loop_latency;// s
+
 public:
 
-translation() {
+translation() : clearance(footprint), metrics_endpoint(metrics), log(write_log), timer(0.1) {
 
-    // communication with cmd_vel
-    pub_cmd_vel = n.advertise<geometry_msgs::Twist>("cmd_vel", 1);
+    // communication with cmd_vel_mux
+    pub_cmd_vel = n.advertise<geometry_msgs::Twist>("translation_cmd_vel", 1);
 
     // communication with odometry
     sub_odometry = n.subscribe("odom", 1, &translation::odomCallback, this);
@@ -70,25 +150,103 @@ translation() {
     // communication with obstacle_detection
     sub_obstacle_detection = n.subscribe("closest_obstacle", 1, &translation::closest_obstacleCallback, this);
 
+    // communication with the laser
+    sub_scan = n.subscribe("scan", 1, &translation::scanCallback, this);
+    init_scan = false;
+    translation_speed_sent = 0;
+
+    // communication with local_planner
+    pub_local_goal = n.advertise<geometry_msgs::Point>("local_goal", 1);
+    sub_local_goal_done = n.subscribe("local_goal_done", 1, &translation::local_goal_doneCallback, this);
+    cond_avoidance = false;
+    new_local_goal_done = false;
+
     error_integral = 0;
     error_previous = 0;
 
+    pub_flight_recorder_trigger = n.advertise<std_msgs::String>("flight_recorder_trigger", 1);
+    saturated = false;
+    msg_trigger.data.reserve(64);
+
+    commands = metrics.counter("follow_me_pid_commands_total", "commands computed by the PID", "node=\"translation\"");
+    saturations = metrics.counter("follow_me_pid_saturations_total", "commands of the PID above the speed limit", "node=\"translation\"");
+    obstacle_stops = metrics.counter("follow_me_obstacle_stops_total", "motions stopped by an obstacle", "node=\"translation\"");
+    tracking_error = metrics.gauge("follow_me_pid_tracking_error", "error between the profile and the odometry (rad or m)", "node=\"translation\"");
+    static const double latency_bounds[] = { 1e-5, 5e-5, 1e-4, 5e-4, 1e-3, 5e-3, 1e-2, 5e-2 };
+    loop_latency = metrics.histogram("follow_me_loop_latency_seconds", "latency of the wakeups of the loop", latency_bounds, 8, "node=\"translation\"");
+    if ( !metrics_endpoint.start(metrics_socket, metrics_port) )
+        ROS_WARN("(translation_node) cannot serve the metrics on %s / port %i", metrics_socket.c_str(), metrics_port);
+
     new_translation_to_do = false;
     init_odom = false;
     display_odom = false;
     init_obstacle = false;
     display_obstacle = false;
 
+    start_realtime();
+
     //INFINTE LOOP TO COLLECT LASER DATA AND PROCESS THEM
     ros::Rate r(10);// this node will run at 10hz
+    timer.start();
     while (ros::ok()) {
         ros::spinOnce();//each callback is called once to collect new data: laser + robot_moving
         update();//processing of data
-        r.sleep();//we wait if the processing (ie, callback+update) has taken less than 0.1s (ie, 10 hz)
+        //we wait if the processing (ie, callback+update) has taken less than 0.1s (ie, 10 hz)
+        if ( realtime_active )
+            measure_latency(timer.sleep());
+        else {
+            r.sleep();// follows the simulated time
+            measure_latency(timer.observe());
+        }
+    }
+    log.stop();
+
+}
+
+// the threads of ros, of the metrics server and of the log are already created: they keep the normal priority
+void start_realtime() {
+
+    realtime_active = false;
+    if ( !realtime.enabled )
+        return;
+    if ( ros::Time::isSimTime() ) {
+        ROS_WARN("(translation_node) real-time mode ignored: the loop follows the simulated time");
+        return;
+    }
+    log.start();
+    if ( !lock_memory(realtime.stack_size) )
+        ROS_WARN("(translation_node) memory not locked: %s", strerror(errno));
+    if ( ( realtime.cpu >= 0 ) && !set_cpu(realtime.cpu) )
+        ROS_WARN("(translation_node) cannot run on cpu %i: %s", realtime.cpu, strerror(errno));
+    if ( !set_fifo_priority(realtime.priority) )
+        ROS_WARN("(translation_node) SCHED_FIFO refused: %s", strerror(errno));
+    else
+        ROS_INFO("(translation_node) real-time mode: SCHED_FIFO priority %i", realtime.priority);
+    realtime_active = true;
+
+}
+
+void measure_latency(double latency) {
+
+    jitter.add(latency);
+    loop_latency->observe(latency);
+    if ( jitter.count() % jitter_report_period == 0 ) {
+        char text[256];
+        jitter.report(text, sizeof(text));
+        log.info("(translation_node) latency of the loop: %s (us), %li overruns, %li log lines dropped", text, timer.nb_overruns, log.nb_dropped.load());
     }
 
 }
 
+static void write_log(int level, const char* text) {
+
+    if ( level == realtime_log::warn_level )
+        ROS_WARN("%s", text);
+    else
+        ROS_INFO("%s", text);
+
+}
+
 //UPDATE: main processing
 /*//////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 //////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////*/
@@ -98,92 +256,171 @@ void update() {
     // we receive a new /translation_to_do
     if ( new_translation_to_do && init_odom && init_obstacle ) {
         new_translation_to_do = false;
-        ROS_INFO("\n(translation_node) processing the /translation_to_do received from the decision node");
-        ROS_INFO("(translation_node) translation_to_do: %f", translation_to_do);
-        ROS_INFO("wait for obstacle_detection_node");
+        log.info("\n(translation_node) processing the /translation_to_do received from the decision node");
+        log.info("(translation_node) translation_to_do: %f", translation_to_do);
+        log.info("wait for obstacle_detection_node");
 
         start_position.x = current_position.x;
         start_position.y = current_position.y;
 
+        profile.plan(translation_to_do, max_translation_speed, max_translation_acceleration, max_translation_jerk);
+        profile_start = ros::Time::now();
+        log.info("(translation_node) profile planned: duration %f s, max speed %f", profile.duration(), profile.max_velocity_reached());
+
+        error_integral = 0;
+        error_previous = 0;
         cond_translation = true;
     }
 
     //we are performing a translation
     if ( init_odom && cond_translation && init_obstacle ) {
-        float translation_done = distancePoints( start_position, current_position );
-        float error = translation_to_do - translation_done;
-
-        // the error is the minimum between the difference between /translation_to_do and /translation_done and the distance with the closest obstacle
-        if ( fabs(error) > closest_obstacle.x )
-            error = closest_obstacle.x;
-
-        bool obstacle_detected = ( fabs(closest_obstacle.x) < safety_distance );
-
-        if ( obstacle_detected )
-            ROS_WARN("obstacle detected: (%f, %f)", closest_obstacle.x, closest_obstacle.y);
+        float translation_done = point_distance(start_position, current_position);
+        float remaining = translation_to_do - translation_done;
+
+        // the reference of the profile is taken at the middle of the next period
+        float t = ( ros::Time::now() - profile_start ).toSec();
+        float reference, reference_speed, reference_acceleration;
+        profile.sample(t + 0.05, reference, reference_speed, reference_acceleration);
+
+        // the error is the difference between the reference of the profile and /translation_done
+        float error = reference - translation_done;
+
+        // the footprint swept by the rest of the translation must be free
+        float direction = ( remaining < 0 ) ? -1 : 1;
+        bool obstacle_detected;
+        if ( init_scan )
+            obstacle_detected = ( free_translation_ahead(direction) < translation_clearance );
+        else
+            obstacle_detected = ( fabs(closest_obstacle.x) < safety_distance );
+
+        if ( obstacle_detected ) {
+            if ( init_scan )
+                log.warn("obstacle in the swept footprint: %f m free, %f m remaining", free_translation_ahead(direction), remaining);
+            else
+                log.warn("obstacle detected: (%f, %f)", closest_obstacle.x, closest_obstacle.y);
+            obstacle_stops->add();
+            trigger_flight_recorder("obstacle_stop");
+        }
 
-        cond_translation = ( fabs(error) > translation_error ) && !obstacle_detected;
+        cond_translation = ( ( t < profile.duration() ) || ( fabs(remaining) > translation_error ) ) && !obstacle_detected;
         float translation_speed = 0;
         if ( cond_translation ) {
-            //TO COMPLETE
-            //Implementation of a PID controller for translation_to_do;
-            //rotation_speed = kp*error + ki * error + kp * error_derivation;
-
-            float error_derivation;//To complete
+            float error_derivation;
             error_derivation = error - error_previous;
-            ROS_INFO("error_derivaion: %f", error_derivation);
+            error_previous = error;
+            log.info("error_derivaion: %f", error_derivation);
 
-            //error_integral = ...;//To complete
             error_integral += error;
-            ROS_INFO("error_integral: %f", error_integral);
-
-            //control of translation with a PID controller
-            translation_speed = kp * error + ki * error_integral + kd * error_derivation;
-            ROS_INFO("(translation_node) translation_done: %f, translation_to_do: %f -> translation_speed: %f", translation_done, translation_to_do, translation_speed);
+            log.info("error_integral: %f", error_integral);
+
+            //control of translation: velocity of the profile + PID controller on the tracking error
+            translation_speed = reference_speed + kp * error + ki * error_integral + kd * error_derivation;
+
+            // we must be able to stop before the closest obstacle
+            direction = ( translation_speed < 0 ) ? -1 : 1;
+            float max_speed = stopping_speed(direction);
+            commands->add();
+            tracking_error->set(error);
+            bool saturation = ( direction * translation_speed > max_speed ) || ( fabs(translation_speed) > max_translation_speed );
+            if ( saturation ) {
+                saturations->add();
+                if ( !saturated )
+                    trigger_flight_recorder("translation_saturation");
+            }
+            saturated = saturation;
+            if ( direction * translation_speed > max_speed )
+                translation_speed = direction * max_speed;
+
+            log.info("(translation_node) translation_done: %f, reference: %f, translation_to_do: %f -> translation_speed: %f", translation_done, reference, translation_to_do, translation_speed);
+        }
+        else if ( obstacle_detected && ( fabs(remaining) > translation_error ) && pub_local_goal.getNumSubscribers() ) {
+            // instead of giving up, the end of the translation is performed by the local planner around the obstacle
+            msg_local_goal.x = remaining;
+            log.info("(translation_node) obstacle on the way: the local planner performs the remaining %f m", remaining);
+            pub_local_goal.publish(msg_local_goal);
+            cond_avoidance = true;
+            avoidance_start = ros::Time::now();
+            new_local_goal_done = false;
         }
         else {
-            ROS_INFO("(translation_node) translation_done: %f, translation_to_do: %f -> translation_speed: %f", translation_done, translation_to_do, translation_speed);
-            float translation_done = distancePoints(start_position, current_position);
-            ROS_INFO("(translation_node) final translation_done: %f", translation_done);
-            ROS_INFO("(translation_node) waiting for a /translation_to_do");
-
-            std_msgs::Float32 msg_translation_done;
-            msg_translation_done.data = translation_done;
-
-            pub_translation_done.publish(msg_translation_done);
-            init_obstacle = false;
+            log.info("(translation_node) translation_done: %f, translation_to_do: %f -> translation_speed: %f", translation_done, translation_to_do, translation_speed);
+            end_translation();
         }
 
-        geometry_msgs::Twist twist;
         twist.linear.x = translation_speed;//we perform a translation on the x-axis
-        twist.linear.y = 0;
-        twist.linear.z = 0;
-
-        twist.angular.x = 0;
-        twist.angular.y = 0;
-        twist.angular.z = 0;
 
         pub_cmd_vel.publish(twist);
+        translation_speed_sent = translation_speed;
+    }
+
+    //the local planner has finished the end of the translation, or has not answered in time
+    if ( cond_avoidance && new_local_goal_done ) {
+        new_local_goal_done = false;
+        cond_avoidance = false;
+        if ( local_goal_reached )
+            log.info("(translation_node) the local planner has reached the goal");
+        else
+            log.warn("(translation_node) the local planner has not reached the goal");
+        end_translation();
+    }
+    if ( cond_avoidance && ( ( ros::Time::now() - avoidance_start ).toSec() > avoidance_timeout ) ) {
+        cond_avoidance = false;
+        log.warn("(translation_node) no /local_goal_done after %i s: the translation stops on the obstacle", avoidance_timeout);
+        end_translation();
     }
+
     if ( !display_odom && !init_odom ) {
-        ROS_INFO("wait for odom");
+        log.info("wait for odom");
         display_odom = true;
     }
     if ( display_odom && init_odom )  {
-        ROS_INFO("odom is ok");
+        log.info("odom is ok");
         display_odom = false;
     }
     if ( !display_obstacle && !init_obstacle ) {
-        ROS_INFO("wait for obstacle_detection_node");
+        log.info("wait for obstacle_detection_node");
         display_obstacle = true;
     }
     if ( display_obstacle && init_obstacle ) {
-        ROS_INFO("obstacle_detection_node is ok");
+        log.info("obstacle_detection_node is ok");
         display_obstacle = false;
     }
 
 }// update
 
+// /translation_done is sent to decision with the translation performed
+void end_translation() {
+
+    float translation_done = point_distance(start_position, current_position);
+    log.info("(translation_node) final translation_done: %f", translation_done);
+    log.info("(translation_node) waiting for a /translation_to_do");
+
+    msg_translation_done.data = translation_done;
+
+    pub_translation_done.publish(msg_translation_done);
+    init_obstacle = false;
+
+}
+
+// translation (m) free from the current position in the direction (1: forward, -1: backward)
+float free_translation_ahead(float direction) {
+
+    return ( ( direction > 0 ) ? free_forward : free_backward ) - point_distance(scan_position, current_position);
+
+}
+
+// highest speed in the direction that can stop before the obstacles
+float stopping_speed(float direction) {
+
+    if ( init_scan )
+        return sqrt(2 * max_translation_acceleration * std::max(0.0, free_translation_ahead(direction) - translation_clearance));
+    // the corridor of obstacle_detection is only in front of the robot
+    if ( direction > 0 )
+        return sqrt(2 * max_translation_acceleration * fabs(closest_obstacle.x - safety_distance));
+    return max_translation_speed;
+
+}
+
 //CALLBACKS
 /*//////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 //////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////*/
@@ -194,6 +431,29 @@ void odomCallback(const nav_msgs::Odometry::ConstPtr& o) {
     current_position.y = o->pose.pose.position.y;
     current_position.z = o->pose.pose.position.z;
 
+    // between two updates, the command is reduced as soon as it cannot stop before the obstacles
+    if ( cond_translation && init_scan && ( translation_speed_sent != 0 ) ) {
+        float direction = ( translation_speed_sent < 0 ) ? -1 : 1;
+        float max_speed = stopping_speed(direction);
+        if ( direction * translation_speed_sent > max_speed ) {
+            translation_speed_sent = direction * max_speed;
+            twist.linear.x = translation_speed_sent;
+            pub_cmd_vel.publish(twist);
+        }
+    }
+
+}
+
+void scanCallback(const sensor_msgs::LaserScan::ConstPtr& scan) {
+
+    if ( !init_odom || scan->ranges.empty() )
+        return;
+    clearance.set_scan(&scan->ranges[0], scan->ranges.size(), scan->angle_min, scan->angle_increment, scan->range_min, scan->range_max);
+    free_forward = clearance.free_translation(1);
+    free_backward = clearance.free_translation(-1);
+    scan_position = current_position;
+    init_scan = true;
+
 }
 
 void translation_to_doCallback(const std_msgs::Float32::ConstPtr & r) {
@@ -213,10 +473,17 @@ void closest_obstacleCallback(const geometry_msgs::Point::ConstPtr& obs) {
 
 }//closest_obstacleCallback
 
-// Distance between two points
-float distancePoints(geometry_msgs::Point pa, geometry_msgs::Point pb) {
+void local_goal_doneCallback(const std_msgs::Bool::ConstPtr& done) {
+
+    new_local_goal_done = true;
+    local_goal_reached = done->data;
+
+}
+
+void trigger_flight_recorder(const char* reason) {
 
-    return sqrt(pow((pa.x-pb.x),2.0) + pow((pa.y-pb.y),2.0));
+    msg_trigger.data = reason;
+    pub_flight_recorder_trigger.publish(msg_trigger);
 
 }
 
@@ -227,6 +494,21 @@ int main(int argc, char **argv){
 
     ROS_INFO("(translation_node) waiting for a /translation_to_do");
     ros::init(argc, argv, "translation");
+    ros::param::get("/translation_node/metrics_socket", metrics_socket);
+    ros::param::get("/translation_node/metrics_port", metrics_port);
+    ROS_INFO("(translation_node) metrics_socket: %s, metrics_port: %i", metrics_socket.c_str(), metrics_port);
+    ros::param::get("/translation_node/footprint", footprint.polygon);
+    ros::param::get("/translation_node/laser_x", footprint.laser_x);
+    ros::param::get("/translation_node/laser_y", footprint.laser_y);
+    ros::param::get("/translation_node/laser_yaw", footprint.laser_yaw);
+    ros::param::get("/translation_node/footprint_margin", footprint.margin);
+    ros::param::get("/translation_node/realtime", realtime.enabled);
+    ros::param::get("/translation_node/realtime_priority", realtime.priority);
+    ros::param::get("/translation_node/realtime_cpu", realtime.cpu);
+    ROS_INFO("(translation_node) footprint of %i vertices, laser at (%f, %f, %f), footprint_margin: %f", (int)footprint.polygon.size() / 2,
+             footprint.laser_x, footprint.laser_y, footprint.laser_yaw, footprint.margin);
+
+    ROS_INFO("(translation_node) realtime: %i, realtime_priority: %i, realtime_cpu: %i", realtime.enabled, realtime.priority, realtime.cpu);
 
     translation bsObject;
 
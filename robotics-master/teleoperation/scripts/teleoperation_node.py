@@ -33,7 +33,7 @@ import rospy
 
 from geometry_msgs.msg import Twist
 
-import sys, select, termios, tty
+import sys, select, termios, tty, time
 
 msg = """
 Control Your Wifibot!
@@ -72,17 +72,44 @@ speedBindings={
         'c':(1,.9),
           }
 
+# latency of the keys, from the wakeup of select to the publication of teleop_cmd_vel, displayed every 5s as
+# teleoperation_node.cpp displays it
+wakeup = -1
+nb_inputs = 0
+wakeup_sum = 0
+wakeup_max = 0
+last_report = time.time()
+
 def getKey():
+    global wakeup
     tty.setraw(sys.stdin.fileno())
     rlist, _, _ = select.select([sys.stdin], [], [], 0.1)
     if rlist:
+        wakeup = time.time()
         key = sys.stdin.read(1)
     else:
+        wakeup = -1
         key = ''
 
     termios.tcsetattr(sys.stdin, termios.TCSADRAIN, settings)
     return key
 
+def report():
+    global nb_inputs, wakeup_sum, wakeup_max, last_report
+    now = time.time()
+    if wakeup >= 0:
+        nb_inputs = nb_inputs + 1
+        wakeup_sum = wakeup_sum + now - wakeup
+        wakeup_max = max(wakeup_max, now - wakeup)
+    if now - last_report >= 5:
+        if nb_inputs:
+            rospy.loginfo("(teleoperation) %i inputs, from the wakeup of select to teleop_cmd_vel: mean %f ms, max %f ms", nb_inputs,
+                          wakeup_sum / nb_inputs * 1000, wakeup_max * 1000)
+        nb_inputs = 0
+        wakeup_sum = 0
+        wakeup_max = 0
+        last_report = now
+
 speed = .2
 turn = .2
 
@@ -93,7 +120,7 @@ if __name__=="__main__":
     settings = termios.tcgetattr(sys.stdin)
     
     rospy.init_node('wifibot_teleop_key')
-    pub = rospy.Publisher('cmd_vel', Twist)
+    pub = rospy.Publisher('teleop_cmd_vel', Twist)
     #pub = rospy.Publisher('~cmd_vel', Twist)
 
     x = 0
@@ -157,6 +184,7 @@ if __name__=="__main__":
             twist.linear.x = control_speed; twist.linear.y = 0; twist.linear.z = 0
             twist.angular.x = 0; twist.angular.y = 0; twist.angular.z = control_turn
             pub.publish(twist)
+            report()
 
             #print("loop: {0}".format(count))
             #print("target: vx: {0}, wz: {1}".format(target_speed, target_turn))
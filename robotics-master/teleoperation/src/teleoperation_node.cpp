@@ -0,0 +1,441 @@
+// teleoperation of robair from the keyboard (termios) or from a joystick (evdev), replaces scripts/teleoperation_node.py
+// - the inputs are read as soon as they arrive (poll) and the command is published at once, then every 10 ms (100 hz)
+// - deadman: with the keyboard, the command stops if no key is received during deadman_timeout (the auto-repeat of a
+//   held key keeps it alive); with a joystick, the deadman button must be held
+// - shared autonomy: the forward speed is scaled down near the closest obstacle published by obstacle_detection_node,
+//   from 1 at slow_distance to 0 at stop_distance; without any closest_obstacle for obstacle_timeout, it is limited
+//   to unknown_scale
+// - the latency of the inputs and the jitter of the 100 hz loop are displayed every 5 s (mean, max). The latency is
+//   measured from the wakeup of poll to the publication of teleop_cmd_vel, as scripts/teleoperation_node.py measures
+//   it from the wakeup of select, to compare the two nodes; with a joystick, it is also measured from the time of the
+//   event stamped by evdev (a terminal gives no time for a key)
+// keys (as the python script):
+//    u    i    o
+//    j    k    l
+//    m    ,    .
+// q/z: increase/decrease max speeds by 10%, w/x: linear speed only, e/c: angular speed only, space or k: stop,
+// CTRL-C: quit
+// parameters: /teleoperation_node/device (evdev device of the joystick, keyboard if empty), deadman_button,
+// axis_linear, axis_angular, deadman_timeout, slow_distance, stop_distance, obstacle_timeout, unknown_scale,
+// max_linear_acceleration, max_angular_acceleration, speed, turn
+
+#include "ros/ros.h"
+#include <geometry_msgs/Twist.h>
+#include "geometry_msgs/Point.h"
+#include <algorithm>
+#include <cerrno>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+#include <fcntl.h>
+#include <linux/input.h>
+#include <poll.h>
+#include <string>
+#include <sys/ioctl.h>
+#include <termios.h>
+#include <unistd.h>
+
+#define teleop_frequency 100
+
+std::string device;// evdev joystick, keyboard if empty
+int deadman_button = BTN_TL;
+int axis_linear = ABS_Y;
+int axis_angular = ABS_X;
+float deadman_timeout = 0.5;// s, keyboard: longer than the delay before the auto-repeat of a held key
+float slow_distance = 1.0;// m, the forward speed is reduced below this distance to the closest obstacle
+float stop_distance = 0.4;// m, no forward motion below this distance
+float obstacle_timeout = 0.5;// s
+float unknown_scale = 0.3;// of the forward speed when closest_obstacle is not received
+float max_linear_acceleration = 0.5;// m/s^2
+float max_angular_acceleration = 2.0;// rad/s^2
+float speed = 0.2;// m/s
+float turn = 0.2;// rad/s
+
+// time of a clock in s
+double now(clockid_t clock) {
+
+    timespec t;
+    clock_gettime(clock, &t);
+    return t.tv_sec + t.tv_nsec * 1e-9;
+
+}
+
+// monotonic time in s
+double now_monotonic() { return now(CLOCK_MONOTONIC); }
+
+class teleoperation {
+private:
+
+    ros::NodeHandle n;
+
+    // communication with cmd_vel_mux
+    ros::Publisher pub_cmd_vel;
+
+    // communication with obstacle_detection
+    ros::Subscriber sub_obstacle_detection;
+    float closest_obstacle;// m, ahead of the robot
+    double closest_obstacle_time;
+
+    // input
+    int fd;// stdin or the joystick
+    bool keyboard;
+    termios terminal_settings;
+    bool terminal_raw;
+    float axis_min[ABS_CNT], axis_max[ABS_CNT];
+    bool deadman_pressed;
+
+    // command of the operator in [-1, 1], and command sent
+    float target_linear, target_angular;
+    double last_input;
+    geometry_msgs::Twist cmd_vel;
+    double last_publish;
+    bool quit;
+
+    // latency of the inputs (from the wakeup of poll, and from the time of the joystick event) and jitter of the loop
+    int nb_inputs, nb_ticks;
+    double wakeup_sum, wakeup_max, event_sum, event_max, jitter_sum, jitter_max;
+    double last_report;
+    clockid_t event_clock;// of the evdev events, CLOCK_REALTIME if they cannot be stamped with the clock of the loop
+
+public:
+
+teleoperation() {
+
+    pub_cmd_vel = n.advertise<geometry_msgs::Twist>("teleop_cmd_vel", 1);
+    sub_obstacle_detection = n.subscribe("closest_obstacle", 1, &teleoperation::closest_obstacleCallback, this, ros::TransportHints().tcpNoDelay());
+    closest_obstacle = 0;
+    closest_obstacle_time = -1;
+
+    target_linear = target_angular = 0;
+    last_input = -1;
+    deadman_pressed = false;
+    quit = false;
+    terminal_raw = false;
+    nb_inputs = nb_ticks = 0;
+    wakeup_sum = wakeup_max = event_sum = event_max = jitter_sum = jitter_max = 0;
+    last_publish = last_report = now_monotonic();
+    event_clock = CLOCK_REALTIME;
+
+    if ( !open_input() )
+        return;
+
+    // 100 hz loop on absolute deadlines: the inputs are processed while waiting for the next one
+    const double period = 1.0 / teleop_frequency;
+    double next_tick = now_monotonic() + period;
+    while ( ros::ok() && !quit ) {
+        wait_input(next_tick);
+        double tick = now_monotonic();
+        double jitter = tick - next_tick;
+        jitter_sum += jitter;
+        jitter_max = std::max(jitter_max, jitter);
+        nb_ticks++;
+        next_tick += period;
+        if ( next_tick < tick )
+            next_tick = tick + period;// late by more than a period: the lost ticks are not caught up
+
+        ros::spinOnce();
+        update(tick);
+        report(tick);
+    }
+
+    // the robot is stopped when the node quits
+    cmd_vel = geometry_msgs::Twist();
+    pub_cmd_vel.publish(cmd_vel);
+    close_input();
+
+}
+
+//UPDATE: command sent to cmd_vel_mux
+/*//////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////*/
+void update(double now) {
+
+    // deadman
+    bool alive = keyboard ? ( last_input >= 0 ) && ( now - last_input < deadman_timeout ) : deadman_pressed;
+    float linear = alive ? speed * target_linear : 0;
+    float angular = alive ? turn * target_angular : 0;
+
+    // shared autonomy: the forward speed decreases near the obstacles
+    if ( linear > 0 )
+        linear *= obstacle_scale(now);
+
+    float dt = std::min(now - last_publish, 5.0 / teleop_frequency);
+    last_publish = now;
+    cmd_vel.linear.x = limit_acceleration(cmd_vel.linear.x, linear, max_linear_acceleration * dt);
+    cmd_vel.angular.z = limit_acceleration(cmd_vel.angular.z, angular, max_angular_acceleration * dt);
+    // the stop near an obstacle is not subject to the acceleration limit
+    if ( ( linear <= 0 ) && ( cmd_vel.linear.x > 0 ) && ( obstacle_scale(now) == 0 ) )
+        cmd_vel.linear.x = 0;
+    pub_cmd_vel.publish(cmd_vel);
+
+}// update
+
+float obstacle_scale(double now) const {
+
+    if ( ( closest_obstacle_time < 0 ) || ( now - closest_obstacle_time > obstacle_timeout ) )
+        return unknown_scale;
+    if ( closest_obstacle <= stop_distance )
+        return 0;
+    if ( closest_obstacle >= slow_distance )
+        return 1;
+    return ( closest_obstacle - stop_distance ) / ( slow_distance - stop_distance );
+
+}
+
+float limit_acceleration(float current, float target, float max_delta) {
+
+    if ( target > current + max_delta )
+        return current + max_delta;
+    if ( target < current - max_delta )
+        return current - max_delta;
+    return target;
+
+}
+
+// every 5s, we display the latency from the inputs to teleop_cmd_vel and the jitter of the loop
+void report(double now) {
+
+    if ( now - last_report < 5 )
+        return;
+    if ( nb_inputs ) {
+        ROS_INFO("(teleoperation) %i inputs, from the wakeup of poll to teleop_cmd_vel: mean %f ms, max %f ms", nb_inputs, wakeup_sum / nb_inputs * 1000,
+                 wakeup_max * 1000);
+        if ( !keyboard )
+            ROS_INFO("(teleoperation) from the time of the event to teleop_cmd_vel: mean %f ms, max %f ms", event_sum / nb_inputs * 1000, event_max * 1000);
+    }
+    if ( nb_ticks )
+        ROS_INFO("(teleoperation) loop jitter: mean %f ms, max %f ms", jitter_sum / nb_ticks * 1000, jitter_max * 1000);
+    nb_inputs = nb_ticks = 0;
+    wakeup_sum = wakeup_max = event_sum = event_max = jitter_sum = jitter_max = 0;
+    last_report = now;
+
+}
+
+// INPUTS
+/*//////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////*/
+bool open_input() {
+
+    keyboard = device.empty();
+    if ( keyboard ) {
+        fd = STDIN_FILENO;
+        if ( tcgetattr(fd, &terminal_settings) ) {
+            ROS_ERROR("(teleoperation) stdin is not a terminal");
+            return false;
+        }
+        // raw mode for the whole run, not toggled at each key as in the python script
+        termios raw = terminal_settings;
+        cfmakeraw(&raw);
+        raw.c_cc[VMIN] = 0;
+        raw.c_cc[VTIME] = 0;
+        tcsetattr(fd, TCSANOW, &raw);
+        terminal_raw = true;
+        printf("teleoperation of robair: u i o / j k l / m , . to move, q z w x e c to change the speeds, space or k to stop, CTRL-C to quit\r\n");
+        return true;
+    }
+
+    fd = open(device.c_str(), O_RDONLY | O_NONBLOCK);
+    if ( fd < 0 ) {
+        ROS_ERROR("(teleoperation) cannot open %s", device.c_str());
+        return false;
+    }
+    // the events are stamped with the clock of the loop if the driver allows it
+    int clock = CLOCK_MONOTONIC;
+    if ( ioctl(fd, EVIOCSCLOCKID, &clock) )
+        ROS_WARN("(teleoperation) the events of %s cannot be stamped with CLOCK_MONOTONIC (%s), their latency is measured with CLOCK_REALTIME",
+                 device.c_str(), strerror(errno));
+    else
+        event_clock = CLOCK_MONOTONIC;
+    for (int axis=0; axis<ABS_CNT; axis++) {
+        input_absinfo info;
+        axis_min[axis] = -1;
+        axis_max[axis] = 1;
+        if ( !ioctl(fd, EVIOCGABS(axis), &info) && ( info.maximum > info.minimum ) ) {
+            axis_min[axis] = info.minimum;
+            axis_max[axis] = info.maximum;
+        }
+    }
+    ROS_INFO("(teleoperation) joystick %s, hold the button %i to move", device.c_str(), deadman_button);
+    return true;
+
+}
+
+void close_input() {
+
+    if ( terminal_raw )
+        tcsetattr(fd, TCSANOW, &terminal_settings);
+    else
+        if ( fd >= 0 )
+            close(fd);
+
+}
+
+// process the inputs until "deadline" (monotonic time): each input is published at once
+void wait_input(double deadline) {
+
+    while ( !quit ) {
+        double remaining = deadline - now_monotonic();
+        if ( remaining <= 0 )
+            return;
+        pollfd p;
+        p.fd = fd;
+        p.events = POLLIN;
+        // poll has a resolution of 1 ms: the end of the wait is a sleep until the deadline
+        if ( poll(&p, 1, (int)( remaining * 1000 )) <= 0 ) {
+            sleep_until(deadline);
+            return;
+        }
+        double wakeup = now_monotonic();
+        double event_time = keyboard ? read_keyboard() : read_joystick();
+        if ( event_time >= 0 ) {
+            update(now_monotonic());
+            double published = now_monotonic();
+            wakeup_sum += published - wakeup;
+            wakeup_max = std::max(wakeup_max, published - wakeup);
+            if ( !keyboard ) {
+                double latency = now(event_clock) - event_time;
+                event_sum += latency;
+                event_max = std::max(event_max, latency);
+            }
+            nb_inputs++;
+        }
+    }
+
+}
+
+void sleep_until(double deadline) {
+
+    timespec t;
+    t.tv_sec = (time_t)deadline;
+    t.tv_nsec = (long)( ( deadline - t.tv_sec ) * 1e9 );
+    clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &t, 0);
+
+}
+
+// returns the time of the read of the keys, -1 if no command has changed
+double read_keyboard() {
+
+    double event_time = now_monotonic();
+    char keys[16];
+    int nb = read(fd, keys, sizeof(keys));
+    bool command = false;
+    for (int loop=0; loop<nb; loop++) {
+        char key = keys[loop];
+        int x = 2, th = 0;// x = 2: not a move key
+        switch ( key ) {
+            case 'i': x = 1; th = 0; break;
+            case 'o': x = 1; th = -1; break;
+            case 'j': x = 0; th = 1; break;
+            case 'l': x = 0; th = -1; break;
+            case 'u': x = 1; th = 1; break;
+            case ',': x = -1; th = 0; break;
+            case '.': x = -1; th = 1; break;
+            case 'm': x = -1; th = -1; break;
+            case 'q': speed *= 1.1; turn *= 1.1; break;
+            case 'z': speed *= 0.9; turn *= 0.9; break;
+            case 'w': speed *= 1.1; break;
+            case 'x': speed *= 0.9; break;
+            case 'e': turn *= 1.1; break;
+            case 'c': turn *= 0.9; break;
+            case ' ':
+            case 'k':
+                // force stop
+                target_linear = target_angular = 0;
+                cmd_vel = geometry_msgs::Twist();
+                last_input = event_time;
+                command = true;
+                break;
+            case 3:// CTRL-C
+                quit = true;
+                break;
+        }
+        if ( x != 2 ) {
+            target_linear = x;
+            target_angular = th;
+            last_input = event_time;
+            command = true;
+        }
+        else
+            if ( strchr("qzwxec", key) )
+                printf("currently:\tspeed %f\tturn %f\r\n", speed, turn);
+    }
+    return command ? event_time : -1;
+
+}
+
+// returns the time of the last event of a command (on event_clock), -1 if no command has changed
+double read_joystick() {
+
+    input_event events[32];
+    int nb = read(fd, events, sizeof(events));
+    if ( nb <= 0 ) {
+        if ( nb == 0 ) {
+            ROS_ERROR("(teleoperation) %s disconnected", device.c_str());
+            quit = true;
+        }
+        return -1;
+    }
+    double event_time = -1;
+    for (int loop=0; loop<nb/(int)sizeof(input_event); loop++) {
+        const input_event& e = events[loop];
+        if ( ( e.type == EV_KEY ) && ( e.code == deadman_button ) )
+            deadman_pressed = e.value != 0;
+        else if ( ( e.type == EV_ABS ) && ( e.code < ABS_CNT ) && ( ( e.code == axis_linear ) || ( e.code == axis_angular ) ) ) {
+            // up and left are negative on the joysticks
+            float v = -( 2 * ( e.value - axis_min[e.code] ) / ( axis_max[e.code] - axis_min[e.code] ) - 1 );
+            if ( fabs(v) < 0.05 )
+                v = 0;// dead zone of the stick
+            if ( e.code == axis_linear )
+                target_linear = v;
+            else
+                target_angular = v;
+        }
+        else
+            continue;
+        event_time = e.time.tv_sec + e.time.tv_usec * 1e-6;
+    }
+    return event_time;
+
+}
+
+//CALLBACKS
+/*//////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////*/
+void closest_obstacleCallback(const geometry_msgs::Point::ConstPtr& obs) {
+
+    closest_obstacle = fabs(obs->x);
+    closest_obstacle_time = now_monotonic();
+
+}
+
+};
+
+int main(int argc, char **argv){
+
+    ros::init(argc, argv, "teleoperation");
+
+    ROS_INFO("(teleoperation) PARAMETERS");
+    ros::param::get("/teleoperation_node/device", device);
+    ros::param::get("/teleoperation_node/deadman_button", deadman_button);
+    ros::param::get("/teleoperation_node/axis_linear", axis_linear);
+    ros::param::get("/teleoperation_node/axis_angular", axis_angular);
+    ros::param::get("/teleoperation_node/deadman_timeout", deadman_timeout);
+    ros::param::get("/teleoperation_node/slow_distance", slow_distance);
+    ros::param::get("/teleoperation_node/stop_distance", stop_distance);
+    ros::param::get("/teleoperation_node/obstacle_timeout", obstacle_timeout);
+    ros::param::get("/teleoperation_node/unknown_scale", unknown_scale);
+    ros::param::get("/teleoperation_node/max_linear_acceleration", max_linear_acceleration);
+    ros::param::get("/teleoperation_node/max_angular_acceleration", max_angular_acceleration);
+    ros::param::get("/teleoperation_node/speed", speed);
+    ros::param::get("/teleoperation_node/turn", turn);
+    ROS_INFO("(teleoperation) device: %s, deadman_timeout: %f", device.empty() ? "keyboard" : device.c_str(), deadman_timeout);
+    ROS_INFO("(teleoperation) slow_distance: %f, stop_distance: %f, obstacle_timeout: %f, unknown_scale: %f", slow_distance, stop_distance, obstacle_timeout, unknown_scale);
+    ROS_INFO("(teleoperation) max_linear_acceleration: %f, max_angular_acceleration: %f, speed: %f, turn: %f", max_linear_acceleration, max_angular_acceleration, speed, turn);
+
+    teleoperation bsObject;
+
+    ros::shutdown();
+
+    return 0;
+}